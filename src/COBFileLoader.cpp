@@ -10,6 +10,15 @@
 
 namespace t3d {
 
+// frees a scratch array of the loader whichever way it returns
+struct CobScratch
+{
+	CobScratch() : p(NULL) {}
+	~CobScratch() { if (p) free(p); }
+
+	void* p;
+};
+
 int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* pos, 
 			 const vec4* rot, int vertex_flags, bool mipmap)
 {
@@ -41,9 +50,6 @@ int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* p
 
 	int r,g,b;              // working colors
 
-	// cache for texture vertices
-	vec2 texture_vertices[RenderObject::MAX_VERTICES];
-
 	int num_texture_vertices = 0;
 
 	mat4 mat_local,  // storage for local transform if user requests it in cob format
@@ -423,7 +429,8 @@ int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* p
 	// inline with Quake II md2 format, in 99% of the cases a single object can be textured
 	// with a single skin and the texture coordinates can be unique for each vertex and 1:1
 
-	int poly_material[RenderObject::MAX_POLYS]; // this holds the material index for each polygon
+	int* poly_material = NULL; // this holds the material index for each polygon
+	CobScratch poly_material_guard;
 	// we need these indices since when reading the file
 	// we read the polygons BEFORE the materials, so we need
 	// this data, so we can go back later and extract the material
@@ -461,6 +468,16 @@ int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* p
 			// finally set number of polys
 			obj->_num_polys = parser.pints[0];
 
+			// there's no limit on the polygons so this is sized to the mesh
+			if (!(poly_material = (int*)malloc(sizeof(int)*obj->_num_polys)))
+			{
+				Modules::GetLog().WriteError("\nCan't allocate the materials of %d faces in .COB file %s.", 
+					obj->_num_polys, filename);
+				return(0);
+			} // end if
+
+			poly_material_guard.p = poly_material;
+
 			break;
 		} // end if
 	} // end while
@@ -1116,6 +1133,9 @@ int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* p
 		// fix up offset
 		poly_material[curr_poly]  = poly_material[curr_poly] + materials.Size();
 
+		// the lighting looks up the specular term through the material
+		obj->_plist[curr_poly].mati = poly_material[curr_poly];
+
 		// we need to know what color depth we are dealing with, so check
 		// the bits per pixel, this assumes that the system has already
 		// made the call to DDraw_Init() or set the bit depth
@@ -1341,6 +1361,9 @@ int load_cob(RenderObject* obj, char *filename, const vec4* scale, const vec4* p
 	// compute vertex normals for any gouraud shaded polys
 	obj->ComputeVertexNormals();
 
+	// group the polygons for culling
+	obj->BuildClusters();
+
 	// return success
 	return(1);
 }
@@ -0,0 +1,144 @@
+#include <math.h>
+#include <xmmintrin.h>
+
+#include "tools.h"
+#include "tmath.h"
+#include "defines.h"
+#include "Polygon.h"
+
+namespace t3d {
+
+// the depth only rasterizer for shadow maps, no color, no texture, only
+// 1/z is written, 1/z is linear in screen space so the triangle is set up
+// once as the plane 1/z = a*x + b*y + c and the spans are filled 4 pixels
+// at a time with SSE, keeping the larger 1/z (the nearer surface), the
+// buffer holds floats and 0 means nothing drawn, the clipping rectangle is
+// the size of the buffer rather than the screen since the shadow maps
+// don't match it
+
+void DrawDepthTriangle32(PolygonF* face, unsigned char* _zbuffer, int zpitch, int width, int height)
+{
+	float* zbuffer = (float*)_zbuffer;
+
+#ifdef DEBUG_ON
+	// track rendering stats
+	debug_polys_rendered_per_frame++;
+#endif
+
+	// adjust memory pitch to floats
+	zpitch >>= 2;
+
+	float x[3], y[3], w[3];
+
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		x[vertex] = face->tvlist[vertex].x;
+		y[vertex] = face->tvlist[vertex].y;
+		w[vertex] = 1.0f / face->tvlist[vertex].z;
+	} // end for vertex
+
+	// first trivial clipping rejection tests
+	if (((y[0] < 0) && (y[1] < 0) && (y[2] < 0)) ||
+		((y[0] > height-1) && (y[1] > height-1) && (y[2] > height-1)) ||
+		((x[0] < 0) && (x[1] < 0) && (x[2] < 0)) ||
+		((x[0] > width-1) && (x[1] > width-1) && (x[2] > width-1)))
+		return;
+
+	// the plane of 1/z
+	float det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+	// degenerate triangle
+	if (det == 0)
+		return;
+
+	float a = ((w[1] - w[0]) * (y[2] - y[0]) - (w[2] - w[0]) * (y[1] - y[0])) / det;
+	float b = ((x[1] - x[0]) * (w[2] - w[0]) - (x[2] - x[0]) * (w[1] - w[0])) / det;
+	float c = w[0] - a * x[0] - b * y[0];
+
+	// sort vertices
+	int v0 = 0, v1 = 1, v2 = 2;
+
+	if (y[v1] < y[v0])
+		std::swap(v0, v1);
+
+	if (y[v2] < y[v0])
+		std::swap(v0, v2);
+
+	if (y[v2] < y[v1])
+		std::swap(v1, v2);
+
+	// the rows whose sample points the triangle covers
+	int ystart = (int)ceilf(y[v0]);
+	int yend   = (int)ceilf(y[v2]);
+
+	if (ystart < 0)
+		ystart = 0;
+
+	if (yend > height)
+		yend = height;
+
+	// is the middle vertex left of the long edge v0->v2?
+	bool mid_left = (x[v1] - x[v0]) * (y[v2] - y[v0]) < (x[v2] - x[v0]) * (y[v1] - y[v0]);
+
+	float long_dxdy  = (x[v2] - x[v0]) / (y[v2] - y[v0]);
+
+	// 4 pixels of a span at once, the step of 1/z across them
+	__m128 step4 = _mm_set1_ps(4 * a);
+	__m128 ramp  = _mm_set_ps(3 * a, 2 * a, a, 0);
+
+	float* z_ptr = zbuffer + ystart * zpitch;
+
+	for (int yi = ystart; yi < yend; yi++, z_ptr += zpitch)
+	{
+		float yc = (float)yi;
+
+		float x_long = x[v0] + (yc - y[v0]) * long_dxdy;
+		float x_short;
+
+		if (yc < y[v1])
+			x_short = x[v0] + (yc - y[v0]) * (x[v1] - x[v0]) / (y[v1] - y[v0]);
+		else
+			x_short = x[v1] + (yc - y[v1]) * (x[v2] - x[v1]) / (y[v2] - y[v1]);
+
+		float xl = mid_left ? x_short : x_long;
+		float xr = mid_left ? x_long : x_short;
+
+		int xstart = (int)ceilf(xl);
+		int xend   = (int)ceilf(xr);
+
+		// test for x clipping
+		if (xstart < 0)
+			xstart = 0;
+
+		if (xend > width)
+			xend = width;
+
+		if (xstart >= xend)
+			continue;
+
+		float wi = a * xstart + b * yc + c;
+
+		int xi = xstart;
+
+		// the body of the span 4 pixels at a time
+		__m128 w4 = _mm_add_ps(_mm_set1_ps(wi), ramp);
+
+		for (; xi + 4 <= xend; xi += 4)
+		{
+			__m128 old = _mm_loadu_ps(z_ptr + xi);
+			_mm_storeu_ps(z_ptr + xi, _mm_max_ps(old, w4));
+			w4 = _mm_add_ps(w4, step4);
+		} // end for xi
+
+		// and the rest
+		wi += a * (xi - xstart);
+
+		for (; xi < xend; xi++, wi += a)
+		{
+			if (wi > z_ptr[xi])
+				z_ptr[xi] = wi;
+		} // end for xi
+	} // end for yi
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,353 @@
+#include "tools.h"
+#include "tmath.h"
+#include "defines.h"
+#include "Modules.h"
+#include "Graphics.h"
+#include "Polygon.h"
+#include "Light.h"
+
+namespace t3d {
+
+// the fast phong rasterizers, rather than interpolating the lit colors of
+// the vertices like gouraud shading, the vertex normals are quantized and
+// interpolated across the polygon, and each pixel fetches the lighting of
+// its normal from a NormalLightTable, the table holds the ambient and
+// infinite lights, the point and spot lights depend on the position as
+// well so they're still lit at the vertices, lit_color[] of the polygon
+// holds them per vertex and they're interpolated and added on top, so the
+// final pixel is
+// color = base * table[n] / 256 + lit_color
+// all the variants share one scan converter, the z buffer mode is a
+// template parameter so the inner loop has no tests for it, the same
+// scan converter fills the GBuffer of the deferred lighting, there it
+// writes the base color, the packed normal and 1/z instead of a color
+
+static const int PHONG_NOBUFFER   = 0;
+static const int PHONG_ZBUFFER    = 1;
+static const int PHONG_WTZBUFFER  = 2;  // write thru, no compare
+static const int PHONG_INVZBUFFER = 3;
+static const int PHONG_GBUFFER    = 4;  // 1/z test, writes a GBuffer
+
+// interpolants of the scan converter, all 16.16 fixed point except 1/z
+static const int PHONG_Z  = 0;
+static const int PHONG_NX = 1;
+static const int PHONG_NY = 2;
+static const int PHONG_NZ = 3;
+static const int PHONG_R  = 4;
+static const int PHONG_G  = 5;
+static const int PHONG_B  = 6;
+static const int PHONG_ATTRS = 7;
+
+struct PhongVertex
+{
+	int x, y;
+	int a[PHONG_ATTRS];
+};
+
+struct PhongEdge
+{
+	int x, dxdy;
+	int a[PHONG_ATTRS], dady[PHONG_ATTRS];
+};
+
+static void SetupPhongEdge(PhongEdge& edge, const PhongVertex& top, const PhongVertex& bottom, int ystart)
+{
+	// walks the edge top->bottom starting at scanline ystart
+	int dy = bottom.y - top.y;
+	int skip = ystart - top.y;
+
+	edge.dxdy = ((bottom.x - top.x) << FIXP16_SHIFT) / dy;
+	edge.x = (top.x << FIXP16_SHIFT) + edge.dxdy * skip;
+
+	for (int k = 0; k < PHONG_ATTRS; k++)
+	{
+		edge.dady[k] = (bottom.a[k] - top.a[k]) / dy;
+		edge.a[k] = top.a[k] + edge.dady[k] * skip;
+	} // end for k
+}
+
+static inline void StepPhongEdge(PhongEdge& edge)
+{
+	edge.x += edge.dxdy;
+
+	for (int k = 0; k < PHONG_ATTRS; k++)
+		edge.a[k] += edge.dady[k];
+}
+
+template <int ZMODE>
+static void DrawPhongTriangle(PolygonF* face, const NormalLightTable* table, unsigned char* _dest_buffer,
+							  int mem_pitch, unsigned char* _zbuffer, int zpitch, int alpha,
+							  unsigned char* _nbuffer = NULL, int npitch = 0)
+{
+	unsigned int *dest_buffer = (unsigned int*)_dest_buffer,
+				 *zbuffer     = (unsigned int*)_zbuffer;
+	unsigned short *nbuffer   = (unsigned short*)_nbuffer;
+
+#ifdef DEBUG_ON
+	// track rendering stats
+	debug_polys_rendered_per_frame++;
+#endif
+
+	// adjust memory pitches to words, divide by 4
+	mem_pitch >>= 2;
+	zpitch >>= 2;
+	npitch >>= 1;
+
+	int min_clip_x;
+	int max_clip_x;
+	int min_clip_y;
+	int max_clip_y;
+	Modules::GetGraphics().GetClipValue(min_clip_x,
+		max_clip_x, min_clip_y, max_clip_y);
+
+	// load the vertices, apply the fill convention to the coordinates
+	PhongVertex p[3];
+
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		const Vertex& v = face->tvlist[vertex];
+
+		p[vertex].x = (int)(v.x+0.0);
+		p[vertex].y = (int)(v.y+0.0);
+
+		if (ZMODE == PHONG_INVZBUFFER || ZMODE == PHONG_GBUFFER)
+			p[vertex].a[PHONG_Z] = (1 << FIXP28_SHIFT) / (int)(v.z+0.5);
+		else if (ZMODE != PHONG_NOBUFFER)
+			p[vertex].a[PHONG_Z] = ((int)(v.z+0.5)) << FIXP16_SHIFT;
+		else
+			p[vertex].a[PHONG_Z] = 0;
+
+		p[vertex].a[PHONG_NX] = NormalLightTable::Quantize(v.nx) << FIXP16_SHIFT;
+		p[vertex].a[PHONG_NY] = NormalLightTable::Quantize(v.ny) << FIXP16_SHIFT;
+		p[vertex].a[PHONG_NZ] = NormalLightTable::Quantize(v.nz) << FIXP16_SHIFT;
+
+		int tmpa, r, g, b;
+		_RGB8888FROM32BIT(face->lit_color[vertex], &tmpa, &r, &g, &b);
+
+		p[vertex].a[PHONG_R] = r << FIXP16_SHIFT;
+		p[vertex].a[PHONG_G] = g << FIXP16_SHIFT;
+		p[vertex].a[PHONG_B] = b << FIXP16_SHIFT;
+	} // end for vertex
+
+	// first trivial clipping rejection tests
+	if (((p[0].y < min_clip_y) && (p[1].y < min_clip_y) && (p[2].y < min_clip_y)) ||
+		((p[0].y > max_clip_y) && (p[1].y > max_clip_y) && (p[2].y > max_clip_y)) ||
+		((p[0].x < min_clip_x) && (p[1].x < min_clip_x) && (p[2].x < min_clip_x)) ||
+		((p[0].x > max_clip_x) && (p[1].x > max_clip_x) && (p[2].x > max_clip_x)))
+		return;
+
+	// sort vertices
+	int v0 = 0, v1 = 1, v2 = 2;
+
+	if (p[v1].y < p[v0].y)
+		std::swap(v0, v1);
+
+	if (p[v2].y < p[v0].y)
+		std::swap(v0, v2);
+
+	if (p[v2].y < p[v1].y)
+		std::swap(v1, v2);
+
+	// degenerate triangle
+	if (p[v0].y == p[v2].y)
+		return;
+
+	// the base color lit by the table
+	int tmpa, r_base, g_base, b_base;
+	_RGB8888FROM32BIT(face->color, &tmpa, &r_base, &g_base, &b_base);
+
+	// is the middle vertex left or right of the long edge v0->v2?
+	bool mid_left = (p[v1].x - p[v0].x) * (p[v2].y - p[v0].y) <
+					(p[v2].x - p[v0].x) * (p[v1].y - p[v0].y);
+
+	// the triangle is drawn in 2 halves, v0->v1 and v1->v2, both against
+	// the long edge
+	for (int half = 0; half < 2; half++)
+	{
+		const PhongVertex& top    = half == 0 ? p[v0] : p[v1];
+		const PhongVertex& bottom = half == 0 ? p[v1] : p[v2];
+
+		// flat top or bottom
+		if (top.y == bottom.y)
+			continue;
+
+		int ystart = top.y < min_clip_y ? min_clip_y : top.y;
+		int yend   = bottom.y > max_clip_y+1 ? max_clip_y+1 : bottom.y;
+
+		if (ystart >= yend)
+			continue;
+
+		PhongEdge short_edge, long_edge;
+		SetupPhongEdge(short_edge, top, bottom, ystart);
+		SetupPhongEdge(long_edge, p[v0], p[v2], ystart);
+
+		PhongEdge& left  = mid_left ? short_edge : long_edge;
+		PhongEdge& right = mid_left ? long_edge : short_edge;
+
+		unsigned int* screen_ptr = dest_buffer + (ystart * mem_pitch);
+		unsigned int* z_ptr = zbuffer + (ystart * zpitch);
+		unsigned short* n_ptr = nbuffer + (ystart * npitch);
+
+		for (int yi = ystart; yi < yend; yi++)
+		{
+			int xstart = ((left.x  + FIXP16_ROUND_UP) >> FIXP16_SHIFT);
+			int xend   = ((right.x + FIXP16_ROUND_UP) >> FIXP16_SHIFT);
+
+			int dx = xend - xstart;
+
+			if (dx > 0)
+			{
+				// the span deltas
+				int d[PHONG_ATTRS], ai[PHONG_ATTRS];
+
+				for (int k = 0; k < PHONG_ATTRS; k++)
+				{
+					d[k]  = (right.a[k] - left.a[k]) / dx;
+					ai[k] = left.a[k];
+				} // end for k
+
+				// test for x clipping, LHS
+				if (xstart < min_clip_x)
+				{
+					int skip = min_clip_x - xstart;
+
+					for (int k = 0; k < PHONG_ATTRS; k++)
+						ai[k] += d[k] * skip;
+
+					xstart = min_clip_x;
+				} // end if
+
+				// test for x clipping RHS
+				if (xend > max_clip_x+1)
+					xend = max_clip_x+1;
+
+				int zi  = ai[PHONG_Z],  dz  = d[PHONG_Z];
+				int nxi = ai[PHONG_NX], dnx = d[PHONG_NX];
+				int nyi = ai[PHONG_NY], dny = d[PHONG_NY];
+				int nzi = ai[PHONG_NZ], dnz = d[PHONG_NZ];
+				int ri  = ai[PHONG_R],  dr  = d[PHONG_R];
+				int gi  = ai[PHONG_G],  dg  = d[PHONG_G];
+				int bi  = ai[PHONG_B],  db  = d[PHONG_B];
+
+				// draw span
+				for (int xi = xstart; xi < xend; xi++)
+				{
+					// test if z of current pixel is nearer than current z buffer value
+					bool visible = true;
+
+					if (ZMODE == PHONG_ZBUFFER)
+						visible = (unsigned int)zi < z_ptr[xi];
+					else if (ZMODE == PHONG_INVZBUFFER || ZMODE == PHONG_GBUFFER)
+						visible = (unsigned int)zi > z_ptr[xi];
+
+					if (ZMODE == PHONG_GBUFFER)
+					{
+						if (visible)
+						{
+							// the lighting is done later by GBuffer::Shade()
+							screen_ptr[xi] = face->color;
+							n_ptr[xi] = (unsigned short)NormalLightTable::Index(
+								nxi >> FIXP16_SHIFT, nyi >> FIXP16_SHIFT, nzi >> FIXP16_SHIFT);
+							z_ptr[xi] = zi;
+						} // end if
+					} // end if
+					else if (visible)
+					{
+						unsigned int light = table->Lookup(NormalLightTable::Index(
+							nxi >> FIXP16_SHIFT, nyi >> FIXP16_SHIFT, nzi >> FIXP16_SHIFT));
+
+						int r = ((r_base * (int)(light >> 20)) >> 8) + (ri >> FIXP16_SHIFT);
+						int g = ((g_base * (int)((light >> 10) & 0x3ff)) >> 8) + (gi >> FIXP16_SHIFT);
+						int b = ((b_base * (int)(light & 0x3ff)) >> 8) + (bi >> FIXP16_SHIFT);
+
+						// make sure colors aren't out of range
+						if (r > 255) r = 255;
+						if (g > 255) g = 255;
+						if (b > 255) b = 255;
+
+						if (alpha >= 0)
+						{
+							int r1, g1, b1;
+							_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+							r = (r * alpha + r1 * (255 - alpha)) >> 8;
+							g = (g * alpha + g1 * (255 - alpha)) >> 8;
+							b = (b * alpha + b1 * (255 - alpha)) >> 8;
+						} // end if
+
+						screen_ptr[xi] = _RGB32BIT(255, r, g, b);
+
+						// update z-buffer
+						if (ZMODE != PHONG_NOBUFFER)
+							z_ptr[xi] = zi;
+					} // end if
+
+					// interpolate z, n and the point light color
+					zi  += dz;
+					nxi += dnx;
+					nyi += dny;
+					nzi += dnz;
+					ri  += dr;
+					gi  += dg;
+					bi  += db;
+				} // end for xi
+			} // end if
+
+			// interpolate along right and left edge
+			StepPhongEdge(left);
+			StepPhongEdge(right);
+
+			// advance screen ptr
+			screen_ptr += mem_pitch;
+			z_ptr += zpitch;
+			n_ptr += npitch;
+		} // end for yi
+	} // end for half
+}
+
+void DrawPhongTriangle32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch)
+{
+	DrawPhongTriangle<PHONG_NOBUFFER>(face, &table, dest_buffer, mempitch, NULL, 0, -1);
+}
+
+void DrawPhongTriangleAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch, int alpha)
+{
+	DrawPhongTriangle<PHONG_NOBUFFER>(face, &table, dest_buffer, mempitch, NULL, 0, alpha);
+}
+
+void DrawPhongTriangleZB32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch,
+						   unsigned char* zbuffer, int zpitch)
+{
+	DrawPhongTriangle<PHONG_ZBUFFER>(face, &table, dest_buffer, mempitch, zbuffer, zpitch, -1);
+}
+
+void DrawPhongTriangleWTZB32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch,
+							 unsigned char* zbuffer, int zpitch)
+{
+	DrawPhongTriangle<PHONG_WTZBUFFER>(face, &table, dest_buffer, mempitch, zbuffer, zpitch, -1);
+}
+
+void DrawPhongTriangleZBAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch,
+								unsigned char* zbuffer, int zpitch, int alpha)
+{
+	DrawPhongTriangle<PHONG_ZBUFFER>(face, &table, dest_buffer, mempitch, zbuffer, zpitch, alpha);
+}
+
+void DrawPhongTriangleINVZB32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch,
+							  unsigned char* zbuffer, int zpitch)
+{
+	DrawPhongTriangle<PHONG_INVZBUFFER>(face, &table, dest_buffer, mempitch, zbuffer, zpitch, -1);
+}
+
+void DrawPhongTriangleINVZBAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char* dest_buffer, int mempitch,
+								   unsigned char* zbuffer, int zpitch, int alpha)
+{
+	DrawPhongTriangle<PHONG_INVZBUFFER>(face, &table, dest_buffer, mempitch, zbuffer, zpitch, alpha);
+}
+
+void DrawGBufferTriangle32(PolygonF* face, unsigned char* albedo, int apitch, unsigned char* normals, int npitch,
+						   unsigned char* zbuffer, int zpitch)
+{
+	DrawPhongTriangle<PHONG_GBUFFER>(face, NULL, albedo, apitch, zbuffer, zpitch, -1, normals, npitch);
+}
+
+}
\ No newline at end of file
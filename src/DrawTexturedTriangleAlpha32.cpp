@@ -349,12 +349,17 @@ void DrawTexturedTriangleAlpha32(PolygonF* face,   // ptr to face
 				int tmpa;
 				int r0, g0, b0;
 				_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-				int r1, g1, b1;
-				_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-				r0 = r0 * alpha + r1 * (255 - alpha);
-				g0 = g0 * alpha + g1 * (255 - alpha);
-				b0 = b0 * alpha + b1 * (255 - alpha);
-				screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				// clear texels are skipped, the others scale the polygon alpha
+				if (tmpa)
+				{
+					int a = (alpha * (tmpa + 1)) >> 8;
+					int r1, g1, b1;
+					_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+					r0 = r0 * a + r1 * (255 - a);
+					g0 = g0 * a + g1 * (255 - a);
+					b0 = b0 * a + b1 * (255 - a);
+					screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				} // end if
 
 				// interpolate u,v
 				ui+=du;
@@ -412,12 +417,17 @@ void DrawTexturedTriangleAlpha32(PolygonF* face,   // ptr to face
 				int tmpa;
 				int r0, g0, b0;
 				_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-				int r1, g1, b1;
-				_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-				r0 = r0 * alpha + r1 * (255 - alpha);
-				g0 = g0 * alpha + g1 * (255 - alpha);
-				b0 = b0 * alpha + b1 * (255 - alpha);
-				screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				// clear texels are skipped, the others scale the polygon alpha
+				if (tmpa)
+				{
+					int a = (alpha * (tmpa + 1)) >> 8;
+					int r1, g1, b1;
+					_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+					r0 = r0 * a + r1 * (255 - a);
+					g0 = g0 * a + g1 * (255 - a);
+					b0 = b0 * a + b1 * (255 - a);
+					screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				} // end if
 				
 				// interpolate u,v
 				ui+=du;
@@ -677,12 +687,17 @@ void DrawTexturedTriangleAlpha32(PolygonF* face,   // ptr to face
 				int tmpa;
 				int r0, g0, b0;
 				_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-				int r1, g1, b1;
-				_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-				r0 = r0 * alpha + r1 * (255 - alpha);
-				g0 = g0 * alpha + g1 * (255 - alpha);
-				b0 = b0 * alpha + b1 * (255 - alpha);
-				screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				// clear texels are skipped, the others scale the polygon alpha
+				if (tmpa)
+				{
+					int a = (alpha * (tmpa + 1)) >> 8;
+					int r1, g1, b1;
+					_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+					r0 = r0 * a + r1 * (255 - a);
+					g0 = g0 * a + g1 * (255 - a);
+					b0 = b0 * a + b1 * (255 - a);
+					screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				} // end if
 						
 				// interpolate u,v
 				ui+=du;
@@ -789,12 +804,17 @@ void DrawTexturedTriangleAlpha32(PolygonF* face,   // ptr to face
 				int tmpa;
 				int r0, g0, b0;
 				_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-				int r1, g1, b1;
-				_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-				r0 = r0 * alpha + r1 * (255 - alpha);
-				g0 = g0 * alpha + g1 * (255 - alpha);
-				b0 = b0 * alpha + b1 * (255 - alpha);
-				screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				// clear texels are skipped, the others scale the polygon alpha
+				if (tmpa)
+				{
+					int a = (alpha * (tmpa + 1)) >> 8;
+					int r1, g1, b1;
+					_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+					r0 = r0 * a + r1 * (255 - a);
+					g0 = g0 * a + g1 * (255 - a);
+					b0 = b0 * a + b1 * (255 - a);
+					screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+				} // end if
 
 				// interpolate u,v
 				ui+=du;
@@ -381,14 +381,19 @@ void DrawTexturedTriangleINVZBAlpha32(PolygonF* face, unsigned char* _dest_buffe
 							int tmpa;
 							int r0, g0, b0;
 							_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-							int r1, g1, b1;
-							_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-							r0 = r0 * alpha + r1 * (255 - alpha);
-							g0 = g0 * alpha + g1 * (255 - alpha);
-							b0 = b0 * alpha + b1 * (255 - alpha);
-							screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
-							// update z-buffer
-							z_ptr[xi] = zi;           
+							// clear texels are skipped, the others scale the polygon alpha
+							if (tmpa)
+							{
+								int a = (alpha * (tmpa + 1)) >> 8;
+								int r1, g1, b1;
+								_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+								r0 = r0 * a + r1 * (255 - a);
+								g0 = g0 * a + g1 * (255 - a);
+								b0 = b0 * a + b1 * (255 - a);
+								screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+								// update z-buffer
+								z_ptr[xi] = zi;           
+							} // end if
 						} // end if
 
 						// interpolate u,v,z
@@ -462,14 +467,19 @@ void DrawTexturedTriangleINVZBAlpha32(PolygonF* face, unsigned char* _dest_buffe
 							int tmpa;
 							int r0, g0, b0;
 							_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-							int r1, g1, b1;
-							_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-							r0 = r0 * alpha + r1 * (255 - alpha);
-							g0 = g0 * alpha + g1 * (255 - alpha);
-							b0 = b0 * alpha + b1 * (255 - alpha);
-							screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
-							// update z-buffer
-							z_ptr[xi] = zi;           
+							// clear texels are skipped, the others scale the polygon alpha
+							if (tmpa)
+							{
+								int a = (alpha * (tmpa + 1)) >> 8;
+								int r1, g1, b1;
+								_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+								r0 = r0 * a + r1 * (255 - a);
+								g0 = g0 * a + g1 * (255 - a);
+								b0 = b0 * a + b1 * (255 - a);
+								screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+								// update z-buffer
+								z_ptr[xi] = zi;           
+							} // end if
 						} // end if
 
 						// interpolate u,v,z
@@ -766,14 +776,19 @@ void DrawTexturedTriangleINVZBAlpha32(PolygonF* face, unsigned char* _dest_buffe
 									int tmpa;
 									int r0, g0, b0;
 									_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-									int r1, g1, b1;
-									_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-									r0 = r0 * alpha + r1 * (255 - alpha);
-									g0 = g0 * alpha + g1 * (255 - alpha);
-									b0 = b0 * alpha + b1 * (255 - alpha);
-									screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
-									// update z-buffer
-									z_ptr[xi] = zi;           
+									// clear texels are skipped, the others scale the polygon alpha
+									if (tmpa)
+									{
+										int a = (alpha * (tmpa + 1)) >> 8;
+										int r1, g1, b1;
+										_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+										r0 = r0 * a + r1 * (255 - a);
+										g0 = g0 * a + g1 * (255 - a);
+										b0 = b0 * a + b1 * (255 - a);
+										screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+										// update z-buffer
+										z_ptr[xi] = zi;           
+									} // end if
 								} // end if
 
 								// interpolate u,v,z
@@ -899,15 +914,20 @@ void DrawTexturedTriangleINVZBAlpha32(PolygonF* face, unsigned char* _dest_buffe
 									int tmpa;
 									int r0, g0, b0;
 									_RGB8888FROM32BIT(textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)], &tmpa, &r0, &g0, &b0);
-									int r1, g1, b1;
-									_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-									r0 = r0 * alpha + r1 * (255 - alpha);
-									g0 = g0 * alpha + g1 * (255 - alpha);
-									b0 = b0 * alpha + b1 * (255 - alpha);
-									screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
-
-									// update z-buffer
-									z_ptr[xi] = zi;           
+									// clear texels are skipped, the others scale the polygon alpha
+									if (tmpa)
+									{
+										int a = (alpha * (tmpa + 1)) >> 8;
+										int r1, g1, b1;
+										_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
+										r0 = r0 * a + r1 * (255 - a);
+										g0 = g0 * a + g1 * (255 - a);
+										b0 = b0 * a + b1 * (255 - a);
+										screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
+
+										// update z-buffer
+										z_ptr[xi] = zi;           
+									} // end if
 								} // end if
 
 								// interpolate u,v
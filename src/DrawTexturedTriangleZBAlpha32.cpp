@@ -381,15 +381,17 @@ void DrawTexturedTriangleZBAlpha32(PolygonF* face, unsigned char* _dest_buffer,
 						{
 							// write textel
 							textel = textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)];
-							if (textel & 0x00ffffff)
+							// skip the black and the clear texels
+							if ((textel & 0xff000000) && (textel & 0x00ffffff))
 							{
 								int r0, g0, b0;
 								_RGB8888FROM32BIT(textel, &tmpa, &r0, &g0, &b0);
+								int a = (alpha * (tmpa + 1)) >> 8;
 								int r1, g1, b1;
 								_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-								r0 = r0 * alpha + r1 * (255 - alpha);
-								g0 = g0 * alpha + g1 * (255 - alpha);
-								b0 = b0 * alpha + b1 * (255 - alpha);
+								r0 = r0 * a + r1 * (255 - a);
+								g0 = g0 * a + g1 * (255 - a);
+								b0 = b0 * a + b1 * (255 - a);
 								screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
 
 								// update z-buffer
@@ -466,15 +468,17 @@ void DrawTexturedTriangleZBAlpha32(PolygonF* face, unsigned char* _dest_buffer,
 						{
 							// write textel
 							textel = textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)];
-							if (textel & 0x00ffffff)
+							// skip the black and the clear texels
+							if ((textel & 0xff000000) && (textel & 0x00ffffff))
 							{
 								int r0, g0, b0;
 								_RGB8888FROM32BIT(textel, &tmpa, &r0, &g0, &b0);
+								int a = (alpha * (tmpa + 1)) >> 8;
 								int r1, g1, b1;
 								_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-								r0 = r0 * alpha + r1 * (255 - alpha);
-								g0 = g0 * alpha + g1 * (255 - alpha);
-								b0 = b0 * alpha + b1 * (255 - alpha);
+								r0 = r0 * a + r1 * (255 - a);
+								g0 = g0 * a + g1 * (255 - a);
+								b0 = b0 * a + b1 * (255 - a);
 								screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
 
 								// update z-buffer
@@ -774,15 +778,17 @@ void DrawTexturedTriangleZBAlpha32(PolygonF* face, unsigned char* _dest_buffer,
 								{
 									// write textel
 									textel = textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)];
-									if (textel & 0x00ffffff)
+									// skip the black and the clear texels
+									if ((textel & 0xff000000) && (textel & 0x00ffffff))
 									{
 										int r0, g0, b0;
 										_RGB8888FROM32BIT(textel, &tmpa, &r0, &g0, &b0);
+										int a = (alpha * (tmpa + 1)) >> 8;
 										int r1, g1, b1;
 										_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-										r0 = r0 * alpha + r1 * (255 - alpha);
-										g0 = g0 * alpha + g1 * (255 - alpha);
-										b0 = b0 * alpha + b1 * (255 - alpha);
+										r0 = r0 * a + r1 * (255 - a);
+										g0 = g0 * a + g1 * (255 - a);
+										b0 = b0 * a + b1 * (255 - a);
 										screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
 
 										// update z-buffer
@@ -911,15 +917,17 @@ void DrawTexturedTriangleZBAlpha32(PolygonF* face, unsigned char* _dest_buffer,
 								{
 									// write textel
 									textel = textmap[(ui >> FIXP16_SHIFT) + ((vi >> FIXP16_SHIFT) << texture_shift2)];
-									if (textel & 0x00ffffff)
+									// skip the black and the clear texels
+									if ((textel & 0xff000000) && (textel & 0x00ffffff))
 									{
 										int r0, g0, b0;
 										_RGB8888FROM32BIT(textel, &tmpa, &r0, &g0, &b0);
+										int a = (alpha * (tmpa + 1)) >> 8;
 										int r1, g1, b1;
 										_RGB8888FROM32BIT(screen_ptr[xi], &tmpa, &r1, &g1, &b1);
-										r0 = r0 * alpha + r1 * (255 - alpha);
-										g0 = g0 * alpha + g1 * (255 - alpha);
-										b0 = b0 * alpha + b1 * (255 - alpha);
+										r0 = r0 * a + r1 * (255 - a);
+										g0 = g0 * a + g1 * (255 - a);
+										b0 = b0 * a + b1 * (255 - a);
 										screen_ptr[xi] = _RGB32BIT(255, r0 >> 8, g0 >> 8, b0 >> 8);
 
 										// update z-buffer
@@ -0,0 +1,147 @@
+#include "FramePipeline.h"
+
+#include "Modules.h"
+#include "Log.h"
+#include "RenderList.h"
+
+namespace t3d {
+
+FramePipeline::FramePipeline()
+	: _builder(NULL)
+	, _front(0)
+	, _cam(NULL)
+	, _thread(NULL)
+	, _start(NULL)
+	, _done(NULL)
+	, _building(false)
+	, _quit(0)
+{
+	_lists[0] = new RenderList;
+	_lists[1] = new RenderList;
+}
+
+FramePipeline::~FramePipeline()
+{
+	Shutdown();
+
+	delete _lists[0];
+	delete _lists[1];
+	delete _cam;
+}
+
+bool FramePipeline::Init(FrameBuilder* builder)
+{
+	// already running?
+	if (_thread)
+		return true;
+
+	_builder = builder;
+
+	_start = CreateEvent(NULL, FALSE, FALSE, NULL);
+	_done  = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!_start || !_done)
+	{
+		Modules::GetLog().WriteError("\nFramePipeline: couldn't create the events");
+		return false;
+	}
+
+	_quit = 0;
+	_thread = CreateThread(NULL, 0, GeometryProc, this, 0, NULL);
+	if (_thread == NULL)
+	{
+		// BeginFrame() will build the frames itself
+		Modules::GetLog().WriteError("\nFramePipeline: couldn't create the geometry thread");
+	}
+
+	return true;
+}
+
+void FramePipeline::Shutdown()
+{
+	// the geometry thread may still be using a list
+	if (_building)
+		EndFrame();
+
+	if (_thread)
+	{
+		InterlockedExchange(&_quit, 1);
+		SetEvent(_start);
+		WaitForSingleObject(_thread, INFINITE);
+		CloseHandle(_thread), _thread = NULL;
+	}
+
+	if (_start)
+		CloseHandle(_start), _start = NULL;
+	if (_done)
+		CloseHandle(_done), _done = NULL;
+}
+
+void FramePipeline::SetListAttr(int attr)
+{
+	_lists[0]->SetAttr(attr);
+	_lists[1]->SetAttr(attr);
+}
+
+void FramePipeline::BeginFrame(const Camera& cam, const LightsMgr& lights)
+{
+	// a frame is still being built? then finish it first
+	if (_building)
+		EndFrame();
+
+	// take the snapshots, from now on the game is free to change its own
+	// camera and lights
+	if (_cam == NULL)
+		_cam = new Camera(cam);
+	else
+		*_cam = cam;
+	_lights = lights;
+
+	_building = true;
+
+	// no thread, build it right here
+	if (_thread == NULL)
+	{
+		_builder->BuildFrame(*_lists[_front^1], *_cam, _lights);
+		return;
+	}
+
+	SetEvent(_start);
+}
+
+void FramePipeline::EndFrame()
+{
+	if (!_building)
+		return;
+
+	if (_thread)
+		WaitForSingleObject(_done, INFINITE);
+
+	_building = false;
+
+	// the list just built is drawn next frame
+	_front ^= 1;
+}
+
+DWORD WINAPI FramePipeline::GeometryProc(LPVOID param)
+{
+	FramePipeline* pipeline = (FramePipeline*)param;
+
+	for (;;)
+	{
+		WaitForSingleObject(pipeline->_start, INFINITE);
+
+		if (pipeline->_quit)
+			break;
+
+		// the back list and the snapshots belong to this thread until
+		// the done event is set
+		pipeline->_builder->BuildFrame(*pipeline->_lists[pipeline->_front^1], 
+			*pipeline->_cam, pipeline->_lights);
+
+		SetEvent(pipeline->_done);
+	}
+
+	return 0;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Windows.h>
+
+#include "Camera.h"
+#include "Light.h"
+
+namespace t3d {
+
+class RenderList;
+
+// the geometry half of a frame, BuildFrame() is called on the geometry
+// thread of the pipeline and has to fill the sent render list all the
+// way to screen coordinates, it gets its own copy of the camera and the 
+// lights, the objects it inserts must not be touched by the game until
+// FramePipeline::EndFrame() returns
+class FrameBuilder
+{
+public:
+	virtual ~FrameBuilder() {}
+
+	virtual void BuildFrame(RenderList& list, const Camera& cam, LightsMgr& lights) = 0;
+
+}; // FrameBuilder
+
+// double buffered frames, while the game rasterizes the render list of
+// frame N the geometry thread builds the render list of frame N+1
+//
+// the ownership of the lists is handed over like this:
+//   BeginFrame() - the camera and lights are copied, the back list and the
+//                  copies now belong to the geometry thread
+//   DrawList()   - the front list, built during the previous frame, it
+//                  belongs to the caller, so it can be drawn
+//   EndFrame()   - waits for the geometry thread and swaps the lists, the
+//                  new front list is drawn next frame
+class FramePipeline
+{
+public:
+	FramePipeline();
+	~FramePipeline();
+
+	bool Init(FrameBuilder* builder);
+	void Shutdown();
+
+	// sets the attributes of both render lists
+	void SetListAttr(int attr);
+
+	void BeginFrame(const Camera& cam, const LightsMgr& lights);
+	void EndFrame();
+
+	RenderList& DrawList() { return *_lists[_front]; }
+
+private:
+	static DWORD WINAPI GeometryProc(LPVOID param);
+
+private:
+	FrameBuilder* _builder;
+
+	// the list being drawn is _lists[_front], the other one is built
+	RenderList* _lists[2];
+	int _front;
+
+	// snapshots of the frame being built, the camera has no default
+	// constructor so it's copied in on the first frame
+	Camera* _cam;
+	LightsMgr _lights;
+
+	HANDLE _thread;
+	HANDLE _start;   // set by BeginFrame()
+	HANDLE _done;    // set by the geometry thread when the list is built
+	bool _building;  // between BeginFrame() and EndFrame()
+
+	volatile LONG _quit;
+
+}; // FramePipeline
+
+}
\ No newline at end of file
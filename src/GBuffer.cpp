@@ -0,0 +1,338 @@
+#include "GBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tools.h"
+#include "defines.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Modules.h"
+#include "Graphics.h"
+#include "JobSystem.h"
+
+namespace t3d {
+
+GBuffer::GBuffer()
+	: _albedo(NULL)
+	, _normal(NULL)
+	, _depth(NULL)
+	, _width(0)
+	, _height(0)
+	, _tiles_x(0)
+	, _tiles_y(0)
+	, _unit_normals(NULL)
+	, _lights(NULL)
+{
+}
+
+GBuffer::~GBuffer()
+{
+	Delete();
+}
+
+int GBuffer::Create(int width, int height)
+{
+	// is there any memory already allocated
+	Delete();
+
+	_width   = width;
+	_height  = height;
+	_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	_albedo = (unsigned int*)malloc(width * height * sizeof(unsigned int));
+	_normal = (unsigned short*)malloc(width * height * sizeof(unsigned short));
+	_depth  = (unsigned int*)malloc(width * height * sizeof(unsigned int));
+	_unit_normals = (float*)malloc(3 * NormalLightTable::SIZE * sizeof(float));
+	_lights = (PointLight*)malloc(LightsMgr::MAX_LIGHTS * sizeof(PointLight));
+
+	if (!_albedo || !_normal || !_depth || !_unit_normals || !_lights)
+	{
+		Delete();
+		return(0);
+	} // end if
+
+	// the direction of each cell of the packed normals, the same
+	// quantization the NormalLightTable uses
+	const float scale = 2.0f / (NormalLightTable::LEVELS - 1);
+
+	for (int qx = 0; qx < NormalLightTable::LEVELS; qx++)
+		for (int qy = 0; qy < NormalLightTable::LEVELS; qy++)
+			for (int qz = 0; qz < NormalLightTable::LEVELS; qz++)
+			{
+				float* n = &_unit_normals[3 * NormalLightTable::Index(qx, qy, qz)];
+
+				n[0] = qx * scale - 1;
+				n[1] = qy * scale - 1;
+				n[2] = qz * scale - 1;
+
+				float length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+				float inv = length > 0 ? 1.0f / length : 0;
+
+				n[0] *= inv;
+				n[1] *= inv;
+				n[2] *= inv;
+			} // end for qz
+
+	Clear();
+
+	return(1);
+}
+
+int GBuffer::Delete()
+{
+	if (_albedo)
+		free(_albedo);
+	if (_normal)
+		free(_normal);
+	if (_depth)
+		free(_depth);
+	if (_unit_normals)
+		free(_unit_normals);
+	if (_lights)
+		free(_lights);
+
+	_albedo = NULL;
+	_normal = NULL;
+	_depth  = NULL;
+	_unit_normals = NULL;
+	_lights = NULL;
+	_width = _height = 0;
+	_tiles_x = _tiles_y = 0;
+
+	return(1);
+}
+
+void GBuffer::Clear()
+{
+	// only the depth is cleared, the other buffers are just read where
+	// something was drawn
+	if (_depth)
+		Mem_Set_QUAD((void *)_depth, 0, _width * _height);
+}
+
+void GBuffer::Shade(const LightsMgr& lights, const Camera& cam, unsigned char* video_buffer, int lpitch)
+{
+	if (!_depth)
+		return;
+
+	ShadeJob job;
+	job.video_buffer = (unsigned int*)video_buffer;
+	job.lpitch       = lpitch >> 2;
+	job.alpha        = 0.5f * cam.ViewportWidth() - 0.5f;
+	job.beta         = 0.5f * cam.ViewportHeight() - 0.5f;
+	job.inv_dx       = 1.0f / (job.alpha * cam.ViewDist());
+	job.inv_dy       = 1.0f / (job.beta * cam.ViewDist() * cam.AspectRatio());
+	job.num_lights   = 0;
+
+	const float near_z = cam.NearClipZ();
+
+	// move the point lights to camera space and find the rectangle of the
+	// screen their sphere of influence projects to
+	for (int i = 0; i < lights.Size(); i++)
+	{
+		const Light& light = lights[i];
+
+		if (light.state != LIGHT_STATE_ON || 
+			(light.attr & (LIGHT_ATTR_POINT | LIGHT_ATTR_DEFERRED)) != (LIGHT_ATTR_POINT | LIGHT_ATTR_DEFERRED))
+			continue;
+
+		// a light that never fades would cover the whole screen anyway
+		float r = light.Range();
+
+		if (r == LIGHT_RANGE_INFINITE)
+			continue;
+
+		vec4 pos = cam.CameraMat() * light.pos;
+
+		// entirely behind the near plane
+		if (pos.z + r < near_z)
+			continue;
+
+		PointLight& pl = _lights[job.num_lights];
+
+		pl.x = pos.x;
+		pl.y = pos.y;
+		pl.z = pos.z;
+		pl.kc = light.kc;
+		pl.kl = light.kl;
+		pl.kq = light.kq;
+		pl.r = light.c_diffuse.r;
+		pl.g = light.c_diffuse.g;
+		pl.b = light.c_diffuse.b;
+		pl.range = r;
+
+		if (pos.z - r <= near_z)
+		{
+			// the camera is inside or close to the sphere
+			pl.x0 = 0;
+			pl.y0 = 0;
+			pl.x1 = _width - 1;
+			pl.y1 = _height - 1;
+		} // end if
+		else
+		{
+			// the sphere lies in the box [x-r,x+r] [y-r,y+r] [z-r,z+r], x/z
+			// is monotonic along each edge so the corners bound it
+			float zn = pos.z - r, zf = pos.z + r;
+			float dx = 1.0f / job.inv_dx, dy = 1.0f / job.inv_dy;
+
+			float xmin = (pos.x - r) / (pos.x - r < 0 ? zn : zf);
+			float xmax = (pos.x + r) / (pos.x + r > 0 ? zn : zf);
+			float ymin = (pos.y - r) / (pos.y - r < 0 ? zn : zf);
+			float ymax = (pos.y + r) / (pos.y + r > 0 ? zn : zf);
+
+			pl.x0 = (int)(job.alpha + xmin * dx);
+			pl.x1 = (int)(job.alpha + xmax * dx) + 1;
+			pl.y0 = (int)(job.beta - ymax * dy);
+			pl.y1 = (int)(job.beta - ymin * dy) + 1;
+
+			// off the screen
+			if (pl.x1 < 0 || pl.y1 < 0 || pl.x0 >= _width || pl.y0 >= _height)
+				continue;
+
+			if (pl.x0 < 0) pl.x0 = 0;
+			if (pl.y0 < 0) pl.y0 = 0;
+			if (pl.x1 >= _width) pl.x1 = _width - 1;
+			if (pl.y1 >= _height) pl.y1 = _height - 1;
+		} // end else
+
+		++job.num_lights;
+	} // end for i
+
+	if (job.num_lights == 0)
+		return;
+
+	// the tiles don't share any pixel, so they can be shaded in parallel
+	Modules::GetJobs().ParallelFor(_tiles_x * _tiles_y, 4, this, &GBuffer::ShadeTiles, job);
+}
+
+void GBuffer::ShadeTiles(const ShadeJob& job, int start, int end)
+{
+	int tile_lights[LightsMgr::MAX_LIGHTS];
+
+	for (int tile = start; tile < end; tile++)
+	{
+		int x0 = (tile % _tiles_x) * TILE_SIZE;
+		int y0 = (tile / _tiles_x) * TILE_SIZE;
+		int x1 = x0 + TILE_SIZE < _width ? x0 + TILE_SIZE : _width;
+		int y1 = y0 + TILE_SIZE < _height ? y0 + TILE_SIZE : _height;
+
+		// the depth range of the tile, in 1/z
+		unsigned int iz_min = 0xffffffff, iz_max = 0;
+
+		for (int y = y0; y < y1; y++)
+		{
+			const unsigned int* depth = _depth + y * _width;
+
+			for (int x = x0; x < x1; x++)
+			{
+				unsigned int iz = depth[x];
+
+				if (iz == 0)
+					continue;
+
+				if (iz < iz_min) iz_min = iz;
+				if (iz > iz_max) iz_max = iz;
+			} // end for x
+		} // end for y
+
+		// nothing drawn in the tile
+		if (iz_max == 0)
+			continue;
+
+		float z_near = (float)(1 << FIXP28_SHIFT) / iz_max;
+		float z_far  = (float)(1 << FIXP28_SHIFT) / iz_min;
+
+		// the lights whose rectangle and depth range touch the tile
+		int num_tile_lights = 0;
+
+		for (int i = 0; i < job.num_lights; i++)
+		{
+			const PointLight& pl = _lights[i];
+
+			if (pl.x1 < x0 || pl.x0 >= x1 || pl.y1 < y0 || pl.y0 >= y1)
+				continue;
+
+			if (pl.z + pl.range < z_near || pl.z - pl.range > z_far)
+				continue;
+
+			tile_lights[num_tile_lights++] = i;
+		} // end for i
+
+		if (num_tile_lights == 0)
+			continue;
+
+		for (int y = y0; y < y1; y++)
+		{
+			const unsigned int* depth    = _depth + y * _width;
+			const unsigned int* albedo   = _albedo + y * _width;
+			const unsigned short* normal = _normal + y * _width;
+			unsigned int* screen         = job.video_buffer + y * job.lpitch;
+
+			float yc_z = (job.beta - y) * job.inv_dy;
+
+			for (int x = x0; x < x1; x++)
+			{
+				// empty or not lit per pixel
+				if (depth[x] == 0 || albedo[x] == 0)
+					continue;
+
+				// rebuild the camera space position of the pixel
+				float z  = (float)(1 << FIXP28_SHIFT) / depth[x];
+				float xc = (x - job.alpha) * job.inv_dx * z;
+				float yc = yc_z * z;
+
+				const float* n = &_unit_normals[3 * normal[x]];
+
+				float r_sum = 0, g_sum = 0, b_sum = 0;
+
+				for (int i = 0; i < num_tile_lights; i++)
+				{
+					const PointLight& pl = _lights[tile_lights[i]];
+
+					float lx = pl.x - xc, ly = pl.y - yc, lz = pl.z - z;
+					float dist2 = lx*lx + ly*ly + lz*lz;
+
+					if (dist2 >= pl.range * pl.range)
+						continue;
+
+					float dp = n[0]*lx + n[1]*ly + n[2]*lz;
+
+					if (dp <= 0)
+						continue;
+
+					float dist = sqrtf(dist2);
+					float atten = pl.kc + pl.kl*dist + pl.kq*dist2;
+					float i_light = dp / (dist * atten);
+
+					r_sum += pl.r * i_light;
+					g_sum += pl.g * i_light;
+					b_sum += pl.b * i_light;
+				} // end for i
+
+				if (r_sum == 0 && g_sum == 0 && b_sum == 0)
+					continue;
+
+				int tmpa, r_base, g_base, b_base, r, g, b;
+				_RGB8888FROM32BIT(albedo[x], &tmpa, &r_base, &g_base, &b_base);
+				_RGB8888FROM32BIT(screen[x], &tmpa, &r, &g, &b);
+
+				r += (int)(r_base * r_sum) >> 8;
+				g += (int)(g_base * g_sum) >> 8;
+				b += (int)(b_base * b_sum) >> 8;
+
+				// make sure colors aren't out of range
+				if (r > 255) r = 255;
+				if (g > 255) g = 255;
+				if (b > 255) b = 255;
+
+				screen[x] = _RGB32BIT(255, r, g, b);
+			} // end for x
+		} // end for y
+	} // end for tile
+}
+
+}
\ No newline at end of file
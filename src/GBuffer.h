@@ -0,0 +1,87 @@
+#pragma once
+
+namespace t3d {
+
+class Camera;
+class LightsMgr;
+
+// a compact geometry buffer for deferred point lights, per pixel it holds
+// the base color of the polygon (albedo), its camera space normal packed
+// into the 15 bit index of a NormalLightTable, and 1/z in 4.28 fixed
+// point like the 1/z buffer, RenderList::DrawGBuffer() fills it after the
+// list is drawn, then Shade() adds the deferred point lights on top,
+// each light only to the screen tiles its sphere of influence covers, so
+// the cost follows the lit screen area rather than polygons times lights
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	// allocates the buffers, returns 0 if out of memory
+	int Create(int width, int height);
+
+	int Delete();
+
+	// empties the buffer, call it each frame before DrawGBuffer()
+	void Clear();
+
+	// adds the active point lights flagged LIGHT_ATTR_DEFERRED to the sent
+	// 32 bit image, the regular lighting skips those, and lights all the
+	// others
+	void Shade(const LightsMgr& lights, const Camera& cam, unsigned char* video_buffer, int lpitch);
+
+	unsigned char* Albedo() { return (unsigned char*)_albedo; }
+	unsigned char* Normal() { return (unsigned char*)_normal; }
+	unsigned char* Depth()  { return (unsigned char*)_depth; }
+
+	// pitches in bytes of the buffers
+	int AlbedoPitch() const { return _width * sizeof(unsigned int); }
+	int NormalPitch() const { return _width * sizeof(unsigned short); }
+	int DepthPitch()  const { return _width * sizeof(unsigned int); }
+
+public:
+	// size of the screen tiles the lights are binned into
+	static const int TILE_SIZE = 16;
+
+private:
+	// a point light in camera space and the screen rectangle it covers
+	struct PointLight
+	{
+		float x, y, z;
+		float kc, kl, kq;
+		float r, g, b;
+		float range;
+		int x0, y0, x1, y1;
+	};
+
+	// what the tiles need to rebuild the camera space position of a pixel
+	struct ShadeJob
+	{
+		unsigned int* video_buffer;
+		int lpitch;
+		float alpha, beta;  // half the viewport
+		float inv_dx, inv_dy;  // 1 / (alpha * d), 1 / (beta * d * aspect)
+		int num_lights;
+	};
+
+	void ShadeTiles(const ShadeJob& job, int start, int end);
+
+private:
+	unsigned int* _albedo;
+	unsigned short* _normal;
+	unsigned int* _depth;  // 1/z, 0 = nothing drawn
+
+	int _width;
+	int _height;
+	int _tiles_x;
+	int _tiles_y;
+
+	// unit normal of each packed normal index, x,y,z
+	float* _unit_normals;
+
+	PointLight* _lights;
+
+}; // GBuffer
+
+}
\ No newline at end of file
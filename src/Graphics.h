@@ -64,6 +64,15 @@ public:
 		ymax = max_clip_y;
 	}
 
+	// the rasterizers clip to this rectangle, to draw into an offscreen
+	// image set it to the image and put the old one back after
+	void SetClipValue(int xmin, int xmax, int ymin, int ymax) {
+		min_clip_x = xmin;
+		max_clip_x = xmax;
+		min_clip_y = ymin;
+		max_clip_y = ymax;
+	}
+
 	LPDIRECTDRAW7 GetDraw() const { return lpdd; }
 	LPDIRECTDRAWSURFACE7 GetBackSurface() const { return lpddsback; }
 	LPDIRECTDRAWSURFACE7 GetFrontSurface() const { return lpddsprimary; }
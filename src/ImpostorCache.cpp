@@ -0,0 +1,336 @@
+#include "ImpostorCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tmath.h"
+#include "defines.h"
+#include "BmpImg.h"
+#include "Camera.h"
+#include "Polygon.h"
+#include "RenderObject.h"
+#include "RenderList.h"
+#include "Modules.h"
+#include "Graphics.h"
+#include "Light.h"
+#include "Log.h"
+
+namespace t3d {
+
+// the right and up axes of a view along dir, the same ones
+// Camera::BuildMatrixUVN() builds, false if dir is about vertical
+static bool ViewAxes(const vec4& dir, vec4& right, vec4& up)
+{
+	right = vec4(0, 1, 0, 1).Cross(dir);
+
+	if (right.Length() < 0.01f)
+		return false;
+
+	right.Normalize();
+
+	up = dir.Cross(right);
+	up.Normalize();
+
+	return true;
+}
+
+ImpostorCache::ImpostorCache()
+	: _impostors(NULL)
+	, _num_impostors(0)
+	, _size(0)
+	, _zbuffer(NULL)
+	, _list(NULL)
+	, _lights(NULL)
+	, _cos_angle(0)
+	, _dist_ratio(0)
+	, _renders(0)
+{
+	SetThresholds(5, 1.25f);
+}
+
+ImpostorCache::~ImpostorCache()
+{
+	Delete();
+}
+
+int ImpostorCache::Create(int num_impostors, int size)
+{
+	Delete();
+
+	// the rasterizers shift by the log of the texture width
+	if (size < 2 || (size & (size - 1)))
+	{
+		Modules::GetLog().WriteError("\nImpostorCache::Create: the size %d isn't a power of 2", size);
+		return(0);
+	} // end if
+
+	if (!(_impostors = (Impostor*)malloc(num_impostors * sizeof(Impostor))))
+		return(0);
+
+	if (!(_zbuffer = (unsigned int*)malloc(size * size * sizeof(unsigned int))))
+	{
+		Delete();
+		return(0);
+	} // end if
+
+	_num_impostors = num_impostors;
+	_size = size;
+
+	for (int i = 0; i < _num_impostors; i++)
+	{
+		_impostors[i].image = NULL;
+		_impostors[i].valid = false;
+	} // end for i
+
+	for (int i = 0; i < _num_impostors; i++)
+	{
+		_impostors[i].image = new BmpImg(0, 0, size, size, 32);
+
+		if (!_impostors[i].image->Buffer())
+		{
+			Delete();
+			return(0);
+		} // end if
+	} // end for i
+
+	_list = new RenderList;
+	_lights = new LightsSoA;
+
+	return(1);
+}
+
+int ImpostorCache::Delete()
+{
+	for (int i = 0; i < _num_impostors; i++)
+		delete _impostors[i].image;
+
+	if (_impostors)
+		free(_impostors);
+
+	if (_zbuffer)
+		free(_zbuffer);
+
+	delete _list;
+	delete _lights;
+
+	_impostors = NULL;
+	_num_impostors = 0;
+	_size = 0;
+	_zbuffer = NULL;
+	_list = NULL;
+	_lights = NULL;
+
+	return(1);
+}
+
+void ImpostorCache::SetThresholds(float max_angle, float dist_ratio)
+{
+	_cos_angle  = cos(DEG_TO_RAD(max_angle));
+	_dist_ratio = dist_ratio > 1 ? dist_ratio : 1;
+}
+
+void ImpostorCache::Invalidate(int id)
+{
+	for (int i = 0; i < _num_impostors; i++)
+		if (id < 0 || id == i)
+			_impostors[i].valid = false;
+}
+
+void ImpostorCache::Begin()
+{
+	if (_lights)
+		_lights->Build(Modules::GetGraphics().GetLights());
+}
+
+unsigned int ImpostorCache::LightsHash(const vec4& center, float radius) const
+{
+	vec4 box_min, box_max;
+	box_min.Assign(center.x - radius, center.y - radius, center.z - radius);
+	box_max.Assign(center.x + radius, center.y + radius, center.z + radius);
+
+	LightsSoA lights;
+	lights.Select(*_lights, box_min, box_max);
+
+	return lights.Hash();
+}
+
+bool ImpostorCache::Insert(RenderList& list, const Camera& cam, int id, RenderObject& obj)
+{
+	if (id < 0 || id >= _num_impostors)
+		return false;
+
+	Impostor& imp = _impostors[id];
+
+	const vec4& center = obj.GetWorldPos();
+
+	vec4 dir = center - cam.Pos();
+	float dist = dir.Length();
+
+	// the image must hold the whole bounding sphere, with a texel to spare
+	// on each side
+	float radius = obj.GetMaxRadius() * (1 + 2.0f / _size);
+
+	if (dist <= radius * 1.01f)
+		return false;
+
+	dir = dir * (1.0f / dist);
+
+	vec4 right, up;
+	if (!ViewAxes(dir, right, up))
+		return false;
+
+	// both polygons or none, the object is inserted instead if the list
+	// can't grow
+	if (!list.Reserve(list.GetNumPolys() + 2))
+		return false;
+
+	// draw the image again if the view moved too far from it, or the
+	// lights it was lit with changed, the hash covers the position, the
+	// attenuation and the color of the lights reaching the object
+	unsigned int lights_hash = LightsHash(center, obj.GetMaxRadius());
+
+	if (!imp.valid ||
+		dir.Dot(imp.dir) < _cos_angle ||
+		dist > imp.dist * _dist_ratio ||
+		dist * _dist_ratio < imp.dist ||
+		imp.lights_hash != lights_hash)
+	{
+		Render(imp, obj, dir, dist);
+
+		imp.lights_hash = lights_hash;
+	} // end if
+
+	// the quad faces the camera, with the corners of the image at the
+	// corners of the view the image was drawn with, the texture
+	// coordinates are in texels
+	float h  = imp.half_size;
+	float uv = (float)(_size - 1);
+
+	vec4 corners[4];
+	corners[0] = center - right * h + up * h;
+	corners[1] = center + right * h + up * h;
+	corners[2] = center + right * h - up * h;
+	corners[3] = center - right * h - up * h;
+
+	static const float corner_u[4] = { 0, 1, 1, 0 };
+	static const float corner_v[4] = { 0, 0, 1, 1 };
+	static const int tris[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+
+	PolygonF face;
+
+	face.state   = POLY_STATE_ACTIVE;
+	face.attr    = POLY_ATTR_2SIDED | POLY_ATTR_RGB24 | POLY_ATTR_TRANSPARENT |
+				   POLY_ATTR_SHADE_MODE_CONSTANT | POLY_ATTR_SHADE_MODE_TEXTURE;
+	face.color   = _RGB32BIT(255, 255, 255, 255);
+	face.nlength = 1;
+	face.texture = imp.image;
+	face.mati    = -1;
+
+	for (int tri = 0; tri < 2; tri++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			int corner = tris[tri][i];
+
+			face.lit_color[i] = face.color;
+
+			face.vlist[i].v = corners[corner];
+			face.vlist[i].n.Assign(0, 0, 0, 0);
+			face.vlist[i].u0 = corner_u[corner] * uv;
+			face.vlist[i].v0 = corner_v[corner] * uv;
+			face.vlist[i].attr = VERTEX_ATTR_POINT | VERTEX_ATTR_TEXTURE;
+
+			face.tvlist[i] = face.vlist[i];
+		} // end for i
+
+		// can't fail, see Reserve() above
+		list.Insert(face);
+	} // end for tri
+
+	return true;
+}
+
+void ImpostorCache::Render(Impostor& imp, RenderObject& obj, const vec4& dir, float dist)
+{
+	const vec4& center = obj.GetWorldPos();
+
+	float radius = obj.GetMaxRadius() * (1 + 2.0f / _size);
+
+	// the camera sits where the viewer is, so the perspective is the same,
+	// with a field of view that just holds the bounding sphere, note the
+	// constructor sets the view distance to tan(fov/2) for its 2 wide
+	// view plane
+	float view_dist = sqrt(dist * dist - radius * radius) / radius;
+
+	Camera cam(CAM_MODEL_UVN,
+			   center - dir * dist,
+			   vec4(0, 0, 0, 1),
+			   center,
+			   dist - radius,
+			   dist + radius,
+			   2 * RAD_TO_DEG(atan(view_dist)),
+			   (float)_size,
+			   (float)_size);
+
+	cam.BuildMatrixUVN(UVN_MODE_SIMPLE);
+
+	// the half width of the view at the distance of the object, which is
+	// where the quad is
+	imp.half_size = dist * 0.5f * cam.ViewplaneWidth() / cam.ViewDist();
+	imp.dir       = dir;
+	imp.dist      = dist;
+	imp.valid     = true;
+
+	// the usual pipeline into the private list, lit in world space
+	obj.ModelToWorld();
+
+	_list->Reset();
+	_list->Insert(obj);
+	_list->RemoveBackfaces(cam);
+	_list->LightWorld32(cam);
+	_list->WorldToCamera(cam);
+	_list->CameraToPerspective(cam);
+	_list->PerspectiveToScreen(cam);
+
+	unsigned int* pixels = (unsigned int*)imp.image->Buffer();
+	int num_pixels = _size * _size;
+
+	memset(pixels, 0, num_pixels * sizeof(unsigned int));
+	memset(_zbuffer, 0, num_pixels * sizeof(unsigned int));
+
+	RenderContext rc;
+
+	rc.attr           = RENDER_ATTR_INVZBUFFER | RENDER_ATTR_TEXTURE_PERSPECTIVE_AFFINE;
+	rc.video_buffer   = (unsigned char*)pixels;
+	rc.lpitch         = _size * sizeof(unsigned int);
+	rc.zbuffer        = (unsigned char*)_zbuffer;
+	rc.zpitch         = _size * sizeof(unsigned int);
+	rc.mip_dist       = 0;
+	rc.texture_dist   = 0;
+	rc.alpha_override = -1;
+
+	// the rasterizers clip to the image while it's drawn
+	Graphics& graphics = Modules::GetGraphics();
+
+	int min_clip_x, max_clip_x, min_clip_y, max_clip_y;
+	graphics.GetClipValue(min_clip_x, max_clip_x, min_clip_y, max_clip_y);
+	graphics.SetClipValue(0, _size - 1, 0, _size - 1);
+
+	_list->DrawContext(rc);
+
+	graphics.SetClipValue(min_clip_x, max_clip_x, min_clip_y, max_clip_y);
+
+	// the pixels the object covered are opaque, the rest stays clear
+	for (int i = 0; i < num_pixels; i++)
+	{
+		if (_zbuffer[i])
+			pixels[i] |= 0xff000000;
+		else
+			pixels[i] = 0;
+	} // end for i
+
+	_renders++;
+}
+
+}
\ No newline at end of file
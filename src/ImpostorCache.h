@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Vector.h"
+
+namespace t3d {
+
+class BmpImg;
+class Camera;
+class LightsSoA;
+class RenderList;
+class RenderObject;
+
+// impostors of distant objects, each object is drawn once into a small
+// image from the direction the camera sees it, clear around it, and then
+// only the image is inserted, as 2 transparent textured triangles facing
+// the camera, so a far tree or soldier costs 2 polygons instead of its
+// mesh, the image is kept and drawn again only when the view direction
+// turns or the distance changes too much since it was drawn
+//
+// typical use, for the objects far enough from the camera
+//
+// impostors.Begin();
+// ...
+// obj->Reset();
+// obj->SetWorldPos(pos.x, pos.y, pos.z);
+// if (!obj->Cull(*cam, CULL_OBJECT_XYZ_PLANES))
+//     if (!impostors.Insert(*list, *cam, index, *obj))
+//         { obj->ModelToWorld(); list->Insert(*obj); }
+//
+// the list is drawn with RENDER_ATTR_ALPHA and no alpha override, the
+// lighting is baked into the image, so it's drawn again when the lights 
+// reaching the object change, a moving light only redraws the images of
+// the objects it reaches
+class ImpostorCache
+{
+public:
+	ImpostorCache();
+	~ImpostorCache();
+
+	// allocates num_impostors images of size x size, the size must be a
+	// power of 2 like any texture, returns 0 if out of memory
+	int Create(int num_impostors, int size = IMPOSTOR_SIZE);
+	int Delete();
+
+	// the image is drawn again once the view direction turns by more than
+	// max_angle degrees, or the distance grows or shrinks by more than
+	// dist_ratio times
+	void SetThresholds(float max_angle, float dist_ratio);
+
+	// the image is drawn again the next time, for an object that changed,
+	// -1 for all of them
+	void Invalidate(int id = -1);
+
+	// takes the lights of the graphics module for the frame, call it once
+	// per frame before the impostors are inserted
+	void Begin();
+
+	// inserts the impostor id of the object at its world position, the
+	// image is drawn from the object first if it's out of date, that's the
+	// only time the object is transformed, by ModelToWorld() so without
+	// any rotation, returns false if the camera is inside the bounding
+	// sphere or right above or below the object, then the object should be
+	// inserted itself
+	bool Insert(RenderList& list, const Camera& cam, int id, RenderObject& obj);
+
+	// the images drawn so far, for the statistics
+	int Renders() const { return _renders; }
+
+public:
+	static const int IMPOSTOR_SIZE = 64;
+
+private:
+	struct Impostor
+	{
+		BmpImg* image;     // the object, alpha 0 around it
+		vec4 dir;          // unit direction from the camera to the object
+		float dist;        // and its distance when the image was drawn
+		float half_size;   // half the side of the quad in the world
+		unsigned int lights_hash;   // hash of the lights that reached it
+		bool valid;
+	};
+
+	// hash of the lights of the frame that reach the bounding sphere, like
+	// RenderObject::SelectLights() picks them
+	unsigned int LightsHash(const vec4& center, float radius) const;
+
+	// draws the object into the image seen along dir from dist away
+	void Render(Impostor& imp, RenderObject& obj, const vec4& dir, float dist);
+
+private:
+	Impostor* _impostors;
+	int _num_impostors;
+	int _size;
+
+	unsigned int* _zbuffer;  // 1/z of the image being drawn
+	RenderList* _list;       // the polygons of the object being drawn
+	LightsSoA* _lights;      // all the lights, see Begin()
+
+	float _cos_angle;
+	float _dist_ratio;
+
+	int _renders;
+
+}; // ImpostorCache
+
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "JobSystem.h"
+
+#include <stdlib.h>
+
+#include "Modules.h"
+#include "Log.h"
+
+namespace t3d {
+
+JobSystem::JobSystem()
+	: _num_workers(0)
+	, _wake(NULL)
+	, _done(NULL)
+	, _pending(0)
+	, _busy(0)
+	, _quit(0)
+{
+	for (int i = 0; i <= MAX_WORKERS; i++)
+	{
+		InitializeCriticalSection(&_queues[i].lock);
+		_queues[i].jobs = NULL;
+		_queues[i].head = _queues[i].tail = 0;
+		_queues[i].max_jobs = 0;
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+
+	for (int i = 0; i <= MAX_WORKERS; i++)
+	{
+		DeleteCriticalSection(&_queues[i].lock);
+		free(_queues[i].jobs);
+	}
+}
+
+bool JobSystem::Init(int num_workers)
+{
+	// already running?
+	if (_wake)
+		return true;
+
+	// leave one core for the calling thread, it works on its own queue
+	if (num_workers < 0)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		num_workers = (int)info.dwNumberOfProcessors - 1;
+	}
+	num_workers = max(0, min(num_workers, MAX_WORKERS));
+
+	_wake = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+	_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!_wake || !_done)
+	{
+		Modules::GetLog().WriteError("\nJobSystem: couldn't create the events");
+		return false;
+	}
+
+	_quit = 0;
+	_num_workers = 0;
+	for (int i = 0; i < num_workers; i++)
+	{
+		_params[i].jobs = this;
+		_params[i].index = i+1;
+
+		_threads[i] = CreateThread(NULL, 0, WorkerProc, &_params[i], 0, NULL);
+		if (_threads[i] == NULL)
+		{
+			// run with what we have
+			Modules::GetLog().WriteError("\nJobSystem: couldn't create worker %d", i);
+			break;
+		}
+
+		_num_workers++;
+	} // end for i
+
+	return true;
+}
+
+void JobSystem::Shutdown()
+{
+	if (_wake == NULL)
+		return;
+
+	// wake everybody up and tell them to leave
+	InterlockedExchange(&_quit, 1);
+	if (_num_workers > 0)
+	{
+		ReleaseSemaphore(_wake, _num_workers, NULL);
+		WaitForMultipleObjects(_num_workers, _threads, TRUE, INFINITE);
+	}
+
+	for (int i = 0; i < _num_workers; i++)
+		CloseHandle(_threads[i]);
+	_num_workers = 0;
+
+	CloseHandle(_wake), _wake = NULL;
+	CloseHandle(_done), _done = NULL;
+}
+
+void JobSystem::ParallelFor(int count, int chunk_size, ParallelTask& task)
+{
+	if (count <= 0)
+		return;
+
+	if (chunk_size < 1)
+		chunk_size = 1;
+
+	// not worth it, or somebody is already using the pool, in which case
+	// the caller is most likely one of the tasks, just do it right here
+	if (_num_workers == 0 || count <= chunk_size ||
+		InterlockedCompareExchange(&_busy, 1, 0) != 0)
+	{
+		task.Run(0, count);
+		return;
+	}
+
+	int num_chunks  = (count + chunk_size - 1) / chunk_size;
+	int num_threads = _num_workers + 1;
+
+	ResetEvent(_done);
+	InterlockedExchange(&_pending, num_chunks);
+
+	// hand out contiguous runs of chunks, so each thread starts on its
+	// own part of the data, the stealing evens out the rest
+	for (int thread = 0; thread < num_threads; thread++)
+	{
+		int first = thread * num_chunks / num_threads;
+		int last  = (thread+1) * num_chunks / num_threads;
+
+		JobQueue& queue = _queues[thread];
+
+		EnterCriticalSection(&queue.lock);
+
+		if (queue.max_jobs < last - first)
+		{
+			int max_jobs = max(last - first, 2*queue.max_jobs);
+			Job* jobs = (Job*)realloc(queue.jobs, max_jobs*sizeof(Job));
+			if (jobs == NULL)
+			{
+				// can't queue them, do them ourselves
+				LeaveCriticalSection(&queue.lock);
+				for (int chunk = first; chunk < last; chunk++)
+				{
+					task.Run(chunk*chunk_size, min(count, (chunk+1)*chunk_size));
+					InterlockedDecrement(&_pending);
+				}
+				continue;
+			}
+
+			queue.jobs = jobs;
+			queue.max_jobs = max_jobs;
+		}
+
+		queue.head = queue.tail = 0;
+		for (int chunk = first; chunk < last; chunk++)
+		{
+			Job& job = queue.jobs[queue.tail++];
+			job.task  = &task;
+			job.start = chunk*chunk_size;
+			job.end   = min(count, (chunk+1)*chunk_size);
+		} // end for chunk
+
+		LeaveCriticalSection(&queue.lock);
+	} // end for thread
+
+	ReleaseSemaphore(_wake, _num_workers, NULL);
+
+	// work along, then wait for the chunks still running on the workers
+	while (_pending > 0)
+	{
+		if (!RunJob(0))
+			WaitForSingleObject(_done, INFINITE);
+	}
+
+	InterlockedExchange(&_busy, 0);
+}
+
+DWORD WINAPI JobSystem::WorkerProc(LPVOID param)
+{
+	WorkerParam* worker = (WorkerParam*)param;
+	JobSystem* jobs = worker->jobs;
+
+	for (;;)
+	{
+		WaitForSingleObject(jobs->_wake, INFINITE);
+
+		if (jobs->_quit)
+			break;
+
+		// work until there is nothing left to steal
+		while (jobs->RunJob(worker->index))
+			;
+	}
+
+	return 0;
+}
+
+bool JobSystem::RunJob(int index)
+{
+	Job job;
+
+	// own queue first, then try to steal from the others
+	bool found = PopFront(index, job);
+
+	int num_queues = _num_workers + 1;
+	for (int i = 1; !found && i < num_queues; i++)
+		found = PopBack((index + i) % num_queues, job);
+
+	if (!found)
+		return false;
+
+	job.task->Run(job.start, job.end);
+
+	if (InterlockedDecrement(&_pending) == 0)
+		SetEvent(_done);
+
+	return true;
+}
+
+bool JobSystem::PopFront(int index, Job& job)
+{
+	JobQueue& queue = _queues[index];
+
+	// cheap test before taking the lock
+	if (queue.head >= queue.tail)
+		return false;
+
+	bool found = false;
+
+	EnterCriticalSection(&queue.lock);
+	if (queue.head < queue.tail)
+	{
+		job = queue.jobs[queue.head++];
+		found = true;
+	}
+	LeaveCriticalSection(&queue.lock);
+
+	return found;
+}
+
+bool JobSystem::PopBack(int index, Job& job)
+{
+	JobQueue& queue = _queues[index];
+
+	if (queue.head >= queue.tail)
+		return false;
+
+	bool found = false;
+
+	EnterCriticalSection(&queue.lock);
+	if (queue.head < queue.tail)
+	{
+		job = queue.jobs[--queue.tail];
+		found = true;
+	}
+	LeaveCriticalSection(&queue.lock);
+
+	return found;
+}
+
+}
\ No newline at end of file
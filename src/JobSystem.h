@@ -0,0 +1,131 @@
+#pragma once
+
+#include <Windows.h>
+
+namespace t3d {
+
+// a piece of work that can be split in independent ranges, Run() is
+// called with [start, end) from any of the threads of the job system
+class ParallelTask
+{
+public:
+	virtual ~ParallelTask() {}
+
+	virtual void Run(int start, int end) = 0;
+
+}; // ParallelTask
+
+// binds a member function of the form void T::Func(const A& arg, int start, int end)
+// so the pipeline stages can be split without writing a task class for each
+template <class T, class A>
+class MemberTask : public ParallelTask
+{
+public:
+	typedef void (T::*Func)(const A& arg, int start, int end);
+
+	MemberTask(T* obj, Func func, const A& arg)
+		: _obj(obj)
+		, _func(func)
+		, _arg(arg)
+	{}
+
+	virtual void Run(int start, int end) {
+		(_obj->*_func)(_arg, start, end);
+	}
+
+private:
+	T* _obj;
+	Func _func;
+	const A& _arg;
+
+}; // MemberTask
+
+// a small work stealing thread pool, each thread (the calling thread is
+// queue 0) owns a queue of chunks, it pops its own chunks from the front
+// and once it runs dry it steals from the back of the other queues
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// starts the worker threads, -1 means one less than the number of cores
+	// since the calling thread takes part in the work as well
+	bool Init(int num_workers = -1);
+	void Shutdown();
+
+	// number of threads working on a ParallelFor(), including the caller
+	int NumThreads() const { return _num_workers + 1; }
+
+	// splits [0, count) in chunks of chunk_size and runs them on all the
+	// threads, returns when every chunk is done, if the pool is already
+	// busy (nested or from another thread) the task is run serially
+	void ParallelFor(int count, int chunk_size, ParallelTask& task);
+
+	template <class T, class A>
+	void ParallelFor(int count, int chunk_size, T* obj,
+		void (T::*func)(const A&, int, int), const A& arg)
+	{
+		MemberTask<T, A> task(obj, func, arg);
+		ParallelFor(count, chunk_size, task);
+	}
+
+	// the tasks keep their statistics in locals and add them to the
+	// shared counters once per chunk with this
+	static void AddCounter(int& counter, int value) {
+		if (value != 0)
+			InterlockedExchangeAdd((volatile LONG*)&counter, value);
+	}
+
+private:
+	struct Job
+	{
+		ParallelTask* task;
+		int start, end;
+	};
+
+	// a double ended queue of jobs, only ever filled by ParallelFor()
+	// while the workers are idle, so it never wraps around
+	struct JobQueue
+	{
+		CRITICAL_SECTION lock;
+		Job* jobs;
+		volatile int head, tail;  // jobs[head..tail) are pending
+		int max_jobs;
+	};
+
+	struct WorkerParam
+	{
+		JobSystem* jobs;
+		int index;  // queue of the worker
+	};
+
+	static DWORD WINAPI WorkerProc(LPVOID param);
+
+	// pops a job of the queue of the sent thread, or steals one
+	// from the others, and runs it, returns false if all are empty
+	bool RunJob(int index);
+
+	bool PopFront(int index, Job& job);
+	bool PopBack(int index, Job& job);
+
+private:
+	static const int MAX_WORKERS = 15;
+
+	int _num_workers;
+	HANDLE _threads[MAX_WORKERS];
+	WorkerParam _params[MAX_WORKERS];
+
+	// queue 0 belongs to the calling thread
+	JobQueue _queues[MAX_WORKERS+1];
+
+	HANDLE _wake;  // semaphore the workers sleep on
+	HANDLE _done;  // set when the last chunk finishes
+
+	volatile LONG _pending;  // chunks not finished yet
+	volatile LONG _busy;     // a ParallelFor() is running
+	volatile LONG _quit;
+
+}; // JobSystem
+
+}
\ No newline at end of file
@@ -1,9 +1,51 @@
 #include "Light.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xmmintrin.h>
+
 #include "defines.h"
+#include "Vertex.h"
+#include "Material.h"
+#include "JobSystem.h"
 
 namespace t3d {
 
+//////////////////////////////////////////////////////////////////////////
+// class Light
+//////////////////////////////////////////////////////////////////////////
+
+float Light::Range() const
+{
+	// the ambient and infinite lights reach everything, and so do the lights
+	// that don't attenuate with distance
+	if ((attr & (LIGHT_ATTR_AMBIENT | LIGHT_ATTR_INFINITE)) ||
+		!(attr & (LIGHT_ATTR_POINT | LIGHT_ATTR_SPOTLIGHT1 | LIGHT_ATTR_SPOTLIGHT2)))
+		return LIGHT_RANGE_INFINITE;
+
+	// brightest channel of the light, the specular highlight can outshine
+	// the diffuse term
+	float c_max = c_diffuse.r;
+	if (c_diffuse.g > c_max) c_max = c_diffuse.g;
+	if (c_diffuse.b > c_max) c_max = c_diffuse.b;
+	if (c_specular.r > c_max) c_max = c_specular.r;
+	if (c_specular.g > c_max) c_max = c_specular.g;
+	if (c_specular.b > c_max) c_max = c_specular.b;
+
+	// solve kq*d2 + kl*d + (kc - c_max) = 0 for d
+	float c = kc - c_max;
+
+	if (c >= 0)
+		return 0;  // never bright enough to show
+	else if (kq > 0)
+		return (-kl + sqrtf(kl*kl - 4*kq*c)) / (2*kq);
+	else if (kl > 0)
+		return -c / kl;
+	else
+		return LIGHT_RANGE_INFINITE;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // class LightsMgr
 //////////////////////////////////////////////////////////////////////////
@@ -18,6 +60,8 @@ void LightsMgr::Reset()
 	// reset number of lights
 	num_lights = 0;
 
+	MarkChanged();
+
 	// reset first time
 	first_time = 0;
 }
@@ -71,6 +115,12 @@ void LightsMgr::Init(int           index,      // index of light to create (0..M
 	lights[index].pf          = _pf;         // power factor/falloff for spot lights
 
 	++num_lights;
+	MarkChanged();
+}
+
+void LightsMgr::MarkChanged()
+{
+	JobSystem::AddCounter(version, 1);
 }
 
 void LightsMgr::Transform(const mat4& mt, int coord_select)
@@ -131,6 +181,8 @@ void LightsMgr::Transform(const mat4& mt, int coord_select)
 
 			} // end for
 
+			// only the local/world lights are used for lighting
+			MarkChanged();
 		} 
 		break;
 
@@ -176,5 +228,604 @@ void LightsMgr::Transform(const mat4& mt, int coord_select)
 	} // end switch
 }
 
+//////////////////////////////////////////////////////////////////////////
+// class LightsSoA
+//////////////////////////////////////////////////////////////////////////
+
+void LightsSoA::Build(const LightsMgr& lights)
+{
+	// copies the active lights into the arrays, one pass per light type so
+	// the lighting loops don't need to test the type of each light
+
+	static const int types[4] = { LIGHT_ATTR_INFINITE, LIGHT_ATTR_POINT, 
+		LIGHT_ATTR_SPOTLIGHT1, LIGHT_ATTR_SPOTLIGHT2 };
+
+	int* ends[4] = { &_end_infinite, &_end_point, &_end_spot1, &_num_lights };
+
+	_ambient[0] = _ambient[1] = _ambient[2] = 0;
+	_num_lights = 0;
+
+	for (int curr_light = 0; curr_light < lights.Size(); curr_light++)
+	{
+		const Light& light = lights[curr_light];
+
+		if (light.state == LIGHT_STATE_OFF || !(light.attr & LIGHT_ATTR_AMBIENT) ||
+			(light.attr & LIGHT_ATTR_DEFERRED))
+			continue;
+
+		_ambient[0] += light.c_ambient.r;
+		_ambient[1] += light.c_ambient.g;
+		_ambient[2] += light.c_ambient.b;
+	} // end for light
+
+	int num = 0;
+
+	for (int type = 0; type < 4; type++)
+	{
+		for (int curr_light = 0; curr_light < lights.Size(); curr_light++)
+		{
+			const Light& light = lights[curr_light];
+
+			// the same precedence as the scalar lighting functions, the 
+			// first type bit set wins, the deferred lights are left to the
+			// GBuffer
+			if (light.state == LIGHT_STATE_OFF || 
+				(light.attr & (LIGHT_ATTR_AMBIENT | LIGHT_ATTR_DEFERRED)))
+				continue;
+
+			int attr = light.attr & (LIGHT_ATTR_INFINITE | LIGHT_ATTR_POINT | 
+				LIGHT_ATTR_SPOTLIGHT1 | LIGHT_ATTR_SPOTLIGHT2);
+
+			if ((attr & -attr) != types[type])
+				continue;
+
+			_pos_x[num] = light.pos.x;
+			_pos_y[num] = light.pos.y;
+			_pos_z[num] = light.pos.z;
+			_dir_x[num] = light.dir.x;
+			_dir_y[num] = light.dir.y;
+			_dir_z[num] = light.dir.z;
+			_kc[num] = light.kc;
+			_kl[num] = light.kl;
+			_kq[num] = light.kq;
+			_r[num] = light.c_diffuse.r;
+			_g[num] = light.c_diffuse.g;
+			_b[num] = light.c_diffuse.b;
+			_sr[num] = light.c_specular.r;
+			_sg[num] = light.c_specular.g;
+			_sb[num] = light.c_specular.b;
+			_pf[num] = light.pf >= 1 ? (int)light.pf : 1;
+			_range[num] = light.Range();
+			_index[num] = curr_light;
+
+			num++;
+		} // end for light
+
+		*ends[type] = num;
+	} // end for type
+}
+
+void LightsSoA::Select(const LightsSoA& src, const vec4& box_min, const vec4& box_max)
+{
+	// a light reaches the box if the closest point of the box to the light
+	// is within its range, the types stay grouped since the lights are 
+	// copied in order
+
+	const int* src_ends[4] = { &src._end_infinite, &src._end_point, &src._end_spot1, &src._num_lights };
+	int* ends[4] = { &_end_infinite, &_end_point, &_end_spot1, &_num_lights };
+
+	_ambient[0] = src._ambient[0];
+	_ambient[1] = src._ambient[1];
+	_ambient[2] = src._ambient[2];
+
+	int num = 0;
+	int curr_light = 0;
+
+	for (int type = 0; type < 4; type++)
+	{
+		for (; curr_light < *src_ends[type]; curr_light++)
+		{
+			float range = src._range[curr_light];
+
+			if (range != LIGHT_RANGE_INFINITE)
+			{
+				// distance from the light to the box
+				float dx = src._pos_x[curr_light] < box_min.x ? box_min.x - src._pos_x[curr_light] :
+						   src._pos_x[curr_light] > box_max.x ? src._pos_x[curr_light] - box_max.x : 0;
+				float dy = src._pos_y[curr_light] < box_min.y ? box_min.y - src._pos_y[curr_light] :
+						   src._pos_y[curr_light] > box_max.y ? src._pos_y[curr_light] - box_max.y : 0;
+				float dz = src._pos_z[curr_light] < box_min.z ? box_min.z - src._pos_z[curr_light] :
+						   src._pos_z[curr_light] > box_max.z ? src._pos_z[curr_light] - box_max.z : 0;
+
+				if (dx*dx + dy*dy + dz*dz > range*range)
+					continue;
+			} // end if
+
+			CopyLight(num++, src, curr_light);
+		} // end for light
+
+		*ends[type] = num;
+	} // end for type
+}
+
+void LightsSoA::SelectDirectional(const LightsSoA& src)
+{
+	_ambient[0] = src._ambient[0];
+	_ambient[1] = src._ambient[1];
+	_ambient[2] = src._ambient[2];
+
+	for (int curr_light = 0; curr_light < src._end_infinite; curr_light++)
+		CopyLight(curr_light, src, curr_light);
+
+	_end_infinite = _end_point = _end_spot1 = _num_lights = src._end_infinite;
+}
+
+void LightsSoA::SelectLocal(const LightsSoA& src)
+{
+	_ambient[0] = _ambient[1] = _ambient[2] = 0;
+
+	for (int curr_light = src._end_infinite; curr_light < src._num_lights; curr_light++)
+		CopyLight(curr_light - src._end_infinite, src, curr_light);
+
+	_end_infinite = 0;
+	_end_point    = src._end_point - src._end_infinite;
+	_end_spot1    = src._end_spot1 - src._end_infinite;
+	_num_lights   = src._num_lights - src._end_infinite;
+}
+
+void LightsSoA::CopyLight(int index, const LightsSoA& src, int src_index)
+{
+	_pos_x[index] = src._pos_x[src_index];
+	_pos_y[index] = src._pos_y[src_index];
+	_pos_z[index] = src._pos_z[src_index];
+	_dir_x[index] = src._dir_x[src_index];
+	_dir_y[index] = src._dir_y[src_index];
+	_dir_z[index] = src._dir_z[src_index];
+	_kc[index] = src._kc[src_index];
+	_kl[index] = src._kl[src_index];
+	_kq[index] = src._kq[src_index];
+	_r[index] = src._r[src_index];
+	_g[index] = src._g[src_index];
+	_b[index] = src._b[src_index];
+	_sr[index] = src._sr[src_index];
+	_sg[index] = src._sg[src_index];
+	_sb[index] = src._sb[src_index];
+	_pf[index] = src._pf[src_index];
+	_range[index] = src._range[src_index];
+	_index[index] = src._index[src_index];
+}
+
+void LightsSoA::Mark(bool marks[LightsMgr::MAX_LIGHTS]) const
+{
+	memset(marks, 0, LightsMgr::MAX_LIGHTS * sizeof(bool));
+
+	for (int curr_light = 0; curr_light < _num_lights; curr_light++)
+		marks[_index[curr_light]] = true;
+}
+
+// FNV-1a over a block of memory
+static inline unsigned int HashBytes(unsigned int hash, const void* data, int size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (int index = 0; index < size; index++)
+		hash = (hash ^ bytes[index]) * 16777619;
+
+	return hash;
+}
+
+unsigned int LightsSoA::Hash() const
+{
+	unsigned int hash = 2166136261;
+
+	hash = HashBytes(hash, _ambient, sizeof(_ambient));
+	hash = HashBytes(hash, &_end_infinite, sizeof(int));
+	hash = HashBytes(hash, &_end_point, sizeof(int));
+	hash = HashBytes(hash, &_end_spot1, sizeof(int));
+	hash = HashBytes(hash, &_num_lights, sizeof(int));
+
+	// only the lights in use
+	int size = _num_lights * sizeof(float);
+
+	hash = HashBytes(hash, _pos_x, size);
+	hash = HashBytes(hash, _pos_y, size);
+	hash = HashBytes(hash, _pos_z, size);
+	hash = HashBytes(hash, _dir_x, size);
+	hash = HashBytes(hash, _dir_y, size);
+	hash = HashBytes(hash, _dir_z, size);
+	hash = HashBytes(hash, _kc, size);
+	hash = HashBytes(hash, _kl, size);
+	hash = HashBytes(hash, _kq, size);
+	hash = HashBytes(hash, _r, size);
+	hash = HashBytes(hash, _g, size);
+	hash = HashBytes(hash, _b, size);
+	hash = HashBytes(hash, _sr, size);
+	hash = HashBytes(hash, _sg, size);
+	hash = HashBytes(hash, _sb, size);
+	hash = HashBytes(hash, _pf, _num_lights * sizeof(int));
+
+	return hash;
+}
+
+// x^n for integral n >= 1 by repeated squaring, this replaces the
+// multiply loop of the spot light falloff
+static inline __m128 PowInt4(__m128 x, int n)
+{
+	__m128 result = _mm_set1_ps(1.0f);
+
+	while (n)
+	{
+		if (n & 1)
+			result = _mm_mul_ps(result, x);
+
+		x = _mm_mul_ps(x, x);
+		n >>= 1;
+	} // end while
+
+	return result;
+}
+
+void LightsSoA::LightVerts4(const Vertex* const verts[4], int out[4][3]) const
+{
+	// this is the same lighting model as the gouraud shader of LightWorld32(),
+	// infinite: I = Cl * (n . l)
+	// point:    I = Cl * (n . l) / (|l| * (kc + kl*d + kq*d2))
+	// spot 1:   I = Cl * (n . dir) / (kc + kl*d + kq*d2)
+	// spot 2:   I = Cl * (n . dir) * ((s . dir)/|s|)^pf / (kc + kl*d + kq*d2)
+	// and a light only adds if its dot products are positive, the tests are
+	// done with masks so all 4 lanes go thru the same instructions
+
+	const __m128 zero = _mm_setzero_ps();
+
+	// transpose the vertices into the lanes
+	__m128 x  = _mm_set_ps(verts[3]->x,  verts[2]->x,  verts[1]->x,  verts[0]->x);
+	__m128 y  = _mm_set_ps(verts[3]->y,  verts[2]->y,  verts[1]->y,  verts[0]->y);
+	__m128 z  = _mm_set_ps(verts[3]->z,  verts[2]->z,  verts[1]->z,  verts[0]->z);
+	__m128 nx = _mm_set_ps(verts[3]->nx, verts[2]->nx, verts[1]->nx, verts[0]->nx);
+	__m128 ny = _mm_set_ps(verts[3]->ny, verts[2]->ny, verts[1]->ny, verts[0]->ny);
+	__m128 nz = _mm_set_ps(verts[3]->nz, verts[2]->nz, verts[1]->nz, verts[0]->nz);
+
+	__m128 sum_r = zero, sum_g = zero, sum_b = zero;
+
+	int curr_light = 0;
+
+	// infinite lights
+	for (; curr_light < _end_infinite; curr_light++)
+	{
+		__m128 dp = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_set1_ps(_dir_x[curr_light])),
+			_mm_mul_ps(ny, _mm_set1_ps(_dir_y[curr_light]))),
+			_mm_mul_ps(nz, _mm_set1_ps(_dir_z[curr_light])));
+
+		__m128 i = _mm_and_ps(dp, _mm_cmpgt_ps(dp, zero));
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_r[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_g[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_b[curr_light])));
+	} // end for infinite
+
+	// point lights
+	for (; curr_light < _end_point; curr_light++)
+	{
+		// vector from surface to light
+		__m128 lx = _mm_sub_ps(_mm_set1_ps(_pos_x[curr_light]), x);
+		__m128 ly = _mm_sub_ps(_mm_set1_ps(_pos_y[curr_light]), y);
+		__m128 lz = _mm_sub_ps(_mm_set1_ps(_pos_z[curr_light]), z);
+
+		__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)));
+
+		__m128 dp = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz));
+
+		__m128 atten = _mm_add_ps(_mm_set1_ps(_kc[curr_light]), _mm_mul_ps(dist,
+			_mm_add_ps(_mm_set1_ps(_kl[curr_light]), _mm_mul_ps(dist, _mm_set1_ps(_kq[curr_light])))));
+
+		__m128 i = _mm_div_ps(dp, _mm_mul_ps(dist, atten));
+		i = _mm_and_ps(i, _mm_cmpgt_ps(dp, zero));
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_r[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_g[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_b[curr_light])));
+	} // end for point
+
+	// spot lights type 1
+	for (; curr_light < _end_spot1; curr_light++)
+	{
+		__m128 lx = _mm_sub_ps(_mm_set1_ps(_pos_x[curr_light]), x);
+		__m128 ly = _mm_sub_ps(_mm_set1_ps(_pos_y[curr_light]), y);
+		__m128 lz = _mm_sub_ps(_mm_set1_ps(_pos_z[curr_light]), z);
+
+		__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)));
+
+		// use the direction of the light rather than the vector to the light
+		__m128 dp = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_set1_ps(_dir_x[curr_light])),
+			_mm_mul_ps(ny, _mm_set1_ps(_dir_y[curr_light]))),
+			_mm_mul_ps(nz, _mm_set1_ps(_dir_z[curr_light])));
+
+		__m128 atten = _mm_add_ps(_mm_set1_ps(_kc[curr_light]), _mm_mul_ps(dist,
+			_mm_add_ps(_mm_set1_ps(_kl[curr_light]), _mm_mul_ps(dist, _mm_set1_ps(_kq[curr_light])))));
+
+		__m128 i = _mm_div_ps(dp, atten);
+		i = _mm_and_ps(i, _mm_cmpgt_ps(dp, zero));
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_r[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_g[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_b[curr_light])));
+	} // end for spot 1
+
+	// spot lights type 2
+	for (; curr_light < _num_lights; curr_light++)
+	{
+		__m128 dir_x = _mm_set1_ps(_dir_x[curr_light]);
+		__m128 dir_y = _mm_set1_ps(_dir_y[curr_light]);
+		__m128 dir_z = _mm_set1_ps(_dir_z[curr_light]);
+
+		__m128 dp = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, dir_x), _mm_mul_ps(ny, dir_y)), _mm_mul_ps(nz, dir_z));
+
+		// vector from light to surface
+		__m128 sx = _mm_sub_ps(x, _mm_set1_ps(_pos_x[curr_light]));
+		__m128 sy = _mm_sub_ps(y, _mm_set1_ps(_pos_y[curr_light]));
+		__m128 sz = _mm_sub_ps(z, _mm_set1_ps(_pos_z[curr_light]));
+
+		__m128 dists = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz)));
+
+		// spot light term (s . l)
+		__m128 dpsl = _mm_div_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(sx, dir_x), _mm_mul_ps(sy, dir_y)), _mm_mul_ps(sz, dir_z)), dists);
+
+		__m128 atten = _mm_add_ps(_mm_set1_ps(_kc[curr_light]), _mm_mul_ps(dists,
+			_mm_add_ps(_mm_set1_ps(_kl[curr_light]), _mm_mul_ps(dists, _mm_set1_ps(_kq[curr_light])))));
+
+		__m128 i = _mm_div_ps(_mm_mul_ps(dp, PowInt4(dpsl, _pf[curr_light])), atten);
+		i = _mm_and_ps(i, _mm_and_ps(_mm_cmpgt_ps(dp, zero), _mm_cmpgt_ps(dpsl, zero)));
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_r[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_g[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_b[curr_light])));
+	} // end for spot 2
+
+	float r[4], g[4], b[4];
+	_mm_storeu_ps(r, sum_r);
+	_mm_storeu_ps(g, sum_g);
+	_mm_storeu_ps(b, sum_b);
+
+	for (int vertex = 0; vertex < 4; vertex++)
+	{
+		out[vertex][0] = _ambient[0] + (int)r[vertex];
+		out[vertex][1] = _ambient[1] + (int)g[vertex];
+		out[vertex][2] = _ambient[2] + (int)b[vertex];
+	} // end for vertex
+}
+
+// the specular power of 4 lanes thru the table
+static inline __m128 Lookup4(const SpecularTable& table, __m128 x)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, x);
+
+	for (int lane = 0; lane < 4; lane++)
+		lanes[lane] = table.Lookup(lanes[lane]);
+
+	return _mm_loadu_ps(lanes);
+}
+
+// 1/|v| of 4 vectors, the reciprocal square root estimate is plenty for
+// the half vectors
+static inline __m128 InvLength4(__m128 x, __m128 y, __m128 z)
+{
+	__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+	return _mm_rsqrt_ps(_mm_max_ps(len2, _mm_set1_ps(1e-12f)));
+}
+
+void LightsSoA::SpecularVerts4(const Vertex* const verts[4], const vec4& view_pos, 
+							   const SpecularTable& table, int out[4][3]) const
+{
+	// the specular model is 
+	// I = Cs * (n . h)^power / (kc + kl*d + kq*d2), h = |l + v|
+	// where l and v are the unit vectors to the light and the viewer, it's 
+	// only added if the diffuse term of the light is, the reflectivity rs of
+	// the material is applied by the caller
+
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 x  = _mm_set_ps(verts[3]->x,  verts[2]->x,  verts[1]->x,  verts[0]->x);
+	__m128 y  = _mm_set_ps(verts[3]->y,  verts[2]->y,  verts[1]->y,  verts[0]->y);
+	__m128 z  = _mm_set_ps(verts[3]->z,  verts[2]->z,  verts[1]->z,  verts[0]->z);
+	__m128 nx = _mm_set_ps(verts[3]->nx, verts[2]->nx, verts[1]->nx, verts[0]->nx);
+	__m128 ny = _mm_set_ps(verts[3]->ny, verts[2]->ny, verts[1]->ny, verts[0]->ny);
+	__m128 nz = _mm_set_ps(verts[3]->nz, verts[2]->nz, verts[1]->nz, verts[0]->nz);
+
+	// unit vectors to the viewer
+	__m128 vx = _mm_sub_ps(_mm_set1_ps(view_pos.x), x);
+	__m128 vy = _mm_sub_ps(_mm_set1_ps(view_pos.y), y);
+	__m128 vz = _mm_sub_ps(_mm_set1_ps(view_pos.z), z);
+
+	__m128 inv = InvLength4(vx, vy, vz);
+	vx = _mm_mul_ps(vx, inv);
+	vy = _mm_mul_ps(vy, inv);
+	vz = _mm_mul_ps(vz, inv);
+
+	// the view direction of the first vertex for the infinite lights
+	vec4 view0 = view_pos - verts[0]->v;
+	view0.Normalize();
+
+	__m128 sum_r = zero, sum_g = zero, sum_b = zero;
+
+	int curr_light = 0;
+
+	// infinite lights, the light and the viewer are taken as far away so
+	// the half vector is the same over the batch
+	for (; curr_light < _end_infinite; curr_light++)
+	{
+		vec4 h(_dir_x[curr_light] + view0.x, _dir_y[curr_light] + view0.y, 
+			_dir_z[curr_light] + view0.z, 1);
+		h.Normalize();
+
+		__m128 dp = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_set1_ps(_dir_x[curr_light])),
+			_mm_mul_ps(ny, _mm_set1_ps(_dir_y[curr_light]))),
+			_mm_mul_ps(nz, _mm_set1_ps(_dir_z[curr_light])));
+
+		__m128 dph = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, _mm_set1_ps(h.x)), _mm_mul_ps(ny, _mm_set1_ps(h.y))), 
+			_mm_mul_ps(nz, _mm_set1_ps(h.z)));
+
+		__m128 i = _mm_and_ps(Lookup4(table, dph), _mm_cmpgt_ps(dp, zero));
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_sr[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_sg[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_sb[curr_light])));
+	} // end for infinite
+
+	// point and spot lights, the half vector is per vertex
+	for (; curr_light < _num_lights; curr_light++)
+	{
+		// unit vector from surface to light
+		__m128 lx = _mm_sub_ps(_mm_set1_ps(_pos_x[curr_light]), x);
+		__m128 ly = _mm_sub_ps(_mm_set1_ps(_pos_y[curr_light]), y);
+		__m128 lz = _mm_sub_ps(_mm_set1_ps(_pos_z[curr_light]), z);
+
+		__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)));
+
+		__m128 inv_dist = _mm_div_ps(_mm_set1_ps(1.0f), dist);
+		lx = _mm_mul_ps(lx, inv_dist);
+		ly = _mm_mul_ps(ly, inv_dist);
+		lz = _mm_mul_ps(lz, inv_dist);
+
+		// the same test as the diffuse term, the spot lights use their
+		// direction rather than the vector to the light
+		__m128 mask;
+
+		if (curr_light < _end_point)
+		{
+			mask = _mm_cmpgt_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz)), zero);
+		}
+		else
+		{
+			mask = _mm_cmpgt_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(nx, _mm_set1_ps(_dir_x[curr_light])),
+				_mm_mul_ps(ny, _mm_set1_ps(_dir_y[curr_light]))),
+				_mm_mul_ps(nz, _mm_set1_ps(_dir_z[curr_light]))), zero);
+		} // end else
+
+		__m128 hx = _mm_add_ps(lx, vx);
+		__m128 hy = _mm_add_ps(ly, vy);
+		__m128 hz = _mm_add_ps(lz, vz);
+
+		__m128 dph = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, hx), _mm_mul_ps(ny, hy)), _mm_mul_ps(nz, hz)), 
+			InvLength4(hx, hy, hz));
+
+		__m128 atten = _mm_add_ps(_mm_set1_ps(_kc[curr_light]), _mm_mul_ps(dist,
+			_mm_add_ps(_mm_set1_ps(_kl[curr_light]), _mm_mul_ps(dist, _mm_set1_ps(_kq[curr_light])))));
+
+		__m128 i = _mm_div_ps(Lookup4(table, dph), atten);
+
+		// the type 2 spot lights fall off away from their direction
+		if (curr_light >= _end_spot1)
+		{
+			// spot light term (s . l), s = -l
+			__m128 dpsl = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(lx, _mm_set1_ps(_dir_x[curr_light])),
+				_mm_mul_ps(ly, _mm_set1_ps(_dir_y[curr_light]))),
+				_mm_mul_ps(lz, _mm_set1_ps(_dir_z[curr_light]))));
+
+			i = _mm_mul_ps(i, PowInt4(dpsl, _pf[curr_light]));
+			mask = _mm_and_ps(mask, _mm_cmpgt_ps(dpsl, zero));
+		} // end if
+
+		i = _mm_and_ps(i, mask);
+
+		sum_r = _mm_add_ps(sum_r, _mm_mul_ps(i, _mm_set1_ps(_sr[curr_light])));
+		sum_g = _mm_add_ps(sum_g, _mm_mul_ps(i, _mm_set1_ps(_sg[curr_light])));
+		sum_b = _mm_add_ps(sum_b, _mm_mul_ps(i, _mm_set1_ps(_sb[curr_light])));
+	} // end for point and spot
+
+	float r[4], g[4], b[4];
+	_mm_storeu_ps(r, sum_r);
+	_mm_storeu_ps(g, sum_g);
+	_mm_storeu_ps(b, sum_b);
+
+	for (int vertex = 0; vertex < 4; vertex++)
+	{
+		out[vertex][0] = (int)r[vertex];
+		out[vertex][1] = (int)g[vertex];
+		out[vertex][2] = (int)b[vertex];
+	} // end for vertex
+}
+
+NormalLightTable::~NormalLightTable()
+{
+	free(_table);
+}
+
+bool NormalLightTable::Build(const LightsSoA& lights)
+{
+	LightsSoA directional;
+	directional.SelectDirectional(lights);
+
+	unsigned int hash = directional.Hash();
+
+	// the same lights as last time?
+	if (_table && hash == _hash)
+		return true;
+
+	if (!_table)
+	{
+		_table = (unsigned int*)malloc(SIZE*sizeof(unsigned int));
+		if (!_table)
+			return false;
+	} // end if
+
+	_hash = hash;
+
+	// the cells are lit in batches of 4 like the vertices, only the normal
+	// matters to these lights so the position is left at the origin
+	Vertex verts[4];
+	memset(verts, 0, sizeof(verts));
+
+	const Vertex* batch[4] = { &verts[0], &verts[1], &verts[2], &verts[3] };
+	int light[4][3];
+
+	const float scale = 2.0f / (LEVELS-1);
+
+	for (int index = 0; index < SIZE; index += 4)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			int cell = index + lane;
+
+			// the direction at the center of the cell
+			vec4 n((cell >> (2*BITS)) * scale - 1, ((cell >> BITS) & (LEVELS-1)) * scale - 1, 
+				(cell & (LEVELS-1)) * scale - 1, 0);
+
+			float length = n.Length();
+			if (length > 0)
+				n = n * (1.0f / length);
+
+			verts[lane].n = n;
+		} // end for lane
+
+		directional.LightVerts4(batch, light);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			int r = light[lane][0] > 1023 ? 1023 : light[lane][0];
+			int g = light[lane][1] > 1023 ? 1023 : light[lane][1];
+			int b = light[lane][2] > 1023 ? 1023 : light[lane][2];
+
+			_table[index + lane] = (r << 20) | (g << 10) | b;
+		} // end for lane
+	} // end for index
+
+	return true;
 }
 
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <float.h>
+
 #include "Vector.h"
 #include "Color.h"
 #include "Matrix.h"
@@ -13,15 +15,25 @@ namespace t3d {
 #define LIGHT_ATTR_POINT        0x0004    // point light source
 #define LIGHT_ATTR_SPOTLIGHT1   0x0008    // spotlight type 1 (simple)
 #define LIGHT_ATTR_SPOTLIGHT2   0x0010    // spotlight type 2 (complex)
+#define LIGHT_ATTR_DEFERRED     0x0020    // point light added per pixel by GBuffer::Shade() only
 
 #define LIGHT_STATE_ON          1         // light on
 #define LIGHT_STATE_OFF         0         // light off
 
+#define LIGHT_RANGE_INFINITE    FLT_MAX   // range of the lights that don't attenuate
+
 class Light
 {
 public:
 	Light() : ptr(0) {}
 
+	// the diffuse and specular terms of the point and spot lights are at
+	// most c_diffuse or c_specular / (kc + kl*d + kq*d2), this finds the
+	// distance d where the brighter one drops under 1 (out of 256), past
+	// it the light can't change a color,
+	// it's computed from the current fields so it never goes stale
+	float Range() const;
+
 public:
 	int state; // state of light
 	int id;    // id of light
@@ -49,13 +61,27 @@ public:
 class LightsMgr
 {
 public:
-	LightsMgr() : num_lights(0) {}
+	LightsMgr() : num_lights(0), version(0) {}
 
+	// handing out a light for writing doesn't count as a change, the objects
+	// still catch the changes by the hash of the lights reaching them, but
+	// call MarkChanged() after changing a light to be sure
 	Light& operator [] (int index) {
 		return index < MAX_LIGHTS ? lights[index] : lights[MAX_LIGHTS-1];
 	}
+	const Light& operator [] (int index) const {
+		return index < MAX_LIGHTS ? lights[index] : lights[MAX_LIGHTS-1];
+	}
 	int Size() const { return num_lights; }
 
+	// bumped by Init(), Reset(), Transform() of the world lights and 
+	// MarkChanged(), the objects keep their lighting across frames while 
+	// this and the hash of the lights reaching them stay the same
+	int Version() const { return version; }
+
+	// the lights were changed through operator [], safe from any thread
+	void MarkChanged();
+
 	void Reset();
 
 	void Init(int           index,      // index of light to create (0..MAX_LIGHTS-1)
@@ -76,13 +102,127 @@ public:
 	void Transform(const mat4& mt,		// transformation matrix
 				   int coord_select);   // selects coords to transform);
 
-private:
-	static const int MAX_LIGHTS = 8;         // good luck with 1!
+public:
+	// the lights are culled by range against the objects and blocks of
+	// polygons before lighting, so a scene can afford plenty of small ones
+	static const int MAX_LIGHTS = 64;
 
 private:
 	Light lights[MAX_LIGHTS];    // lights in system
 	int num_lights;              // current number of lights
+	int version;                 // see Version()
 
 }; // LightsMgr
 
+struct Vertex;
+class SpecularTable;
+
+// the active lights rearranged as a structure of arrays, grouped by type,
+// so a batch of vertices can be lit against all of them with SIMD, the 
+// vertices sit in the 4 lanes and the lights are walked one by one, the 
+// ambient lights are summed up front since they are the same everywhere
+class LightsSoA
+{
+public:
+	LightsSoA() : _num_lights(0) {}
+
+	void Build(const LightsMgr& lights);
+
+	// lights 4 vertices at once, the vertices must be in the same space as
+	// the lights and have unit normals, out[] gets the light intensity r,g,b
+	// of each vertex scaled so 256 is the full base color, to light less than
+	// 4 vertices just repeat the last one
+	void LightVerts4(const Vertex* const verts[4], int out[4][3]) const;
+
+	// the specular term of 4 vertices seen from view_pos, using the blinn
+	// half vector h, for the infinite lights h is computed once from the
+	// view direction of the first vertex, out[] gets the intensity r,g,b 
+	// scaled so 256 is the full specular color of the material
+	void SpecularVerts4(const Vertex* const verts[4], const vec4& view_pos, 
+		const SpecularTable& table, int out[4][3]) const;
+
+	// copies the lights of src whose range reaches the sent box, the 
+	// ambient and infinite lights are always copied
+	void Select(const LightsSoA& src, const vec4& box_min, const vec4& box_max);
+
+	// copies only the ambient and infinite lights of src, which don't depend
+	// on the position of the surface, or only the point and spot lights
+	void SelectDirectional(const LightsSoA& src);
+	void SelectLocal(const LightsSoA& src);
+
+	int Size() const { return _num_lights; }
+
+	// sets marks[i] for each light i of the manager the set was built from 
+	// that is in the set, the ambient lights are never marked
+	void Mark(bool marks[LightsMgr::MAX_LIGHTS]) const;
+
+	// hash of the lights, two sets with the same hash light the same
+	unsigned int Hash() const;
+
+private:
+	void CopyLight(int index, const LightsSoA& src, int src_index);
+
+private:
+	int _ambient[3];  // sum of the ambient lights
+
+	// the lights are stored in this order, _end_xxx is one past the last
+	// light of that type
+	int _end_infinite;
+	int _end_point;
+	int _end_spot1;
+	int _num_lights;  // end of the type 2 spot lights
+
+	float _pos_x[LightsMgr::MAX_LIGHTS], _pos_y[LightsMgr::MAX_LIGHTS], _pos_z[LightsMgr::MAX_LIGHTS];
+	float _dir_x[LightsMgr::MAX_LIGHTS], _dir_y[LightsMgr::MAX_LIGHTS], _dir_z[LightsMgr::MAX_LIGHTS];
+	float _kc[LightsMgr::MAX_LIGHTS], _kl[LightsMgr::MAX_LIGHTS], _kq[LightsMgr::MAX_LIGHTS];
+	float _r[LightsMgr::MAX_LIGHTS], _g[LightsMgr::MAX_LIGHTS], _b[LightsMgr::MAX_LIGHTS];
+	float _sr[LightsMgr::MAX_LIGHTS], _sg[LightsMgr::MAX_LIGHTS], _sb[LightsMgr::MAX_LIGHTS];
+	int _pf[LightsMgr::MAX_LIGHTS];  // integral spot light power, at least 1
+	float _range[LightsMgr::MAX_LIGHTS];
+	int _index[LightsMgr::MAX_LIGHTS];  // index of the light in the manager
+
+}; // LightsSoA
+
+// the directional lighting (ambient and infinite lights) of every quantized
+// normal, the fast phong rasterizers interpolate the quantized normal across
+// the polygon and fetch its lighting from here, so each pixel costs a table
+// lookup instead of a dot product per light, the cells hold the lighting of
+// the normalized cell direction, so the interpolated normals don't have to 
+// be normalized either
+class NormalLightTable
+{
+public:
+	NormalLightTable() : _table(0), _hash(0) {}
+	~NormalLightTable();
+
+	// rebuilds the table if the ambient or infinite lights of the set changed,
+	// returns false if out of memory
+	bool Build(const LightsSoA& lights);
+
+	bool IsBuilt() const { return _table != 0; }
+
+	// maps a normal component in [-1,1] to 0..LEVELS-1
+	static int Quantize(float n) {
+		int q = (int)((n + 1) * (0.5f * (LEVELS-1)) + 0.5f);
+		return q < 0 ? 0 : (q > LEVELS-1 ? LEVELS-1 : q);
+	}
+
+	static int Index(int qx, int qy, int qz) {
+		return (qx << (2*BITS)) | (qy << BITS) | qz;
+	}
+
+	// the intensity r,g,b packed 10.10.10, 256 = full base color
+	unsigned int Lookup(int index) const { return _table[index]; }
+
+public:
+	static const int BITS = 5;
+	static const int LEVELS = 1 << BITS;
+	static const int SIZE = 1 << (3*BITS);
+
+private:
+	unsigned int* _table;
+	unsigned int _hash;  // hash of the directional lights in the table
+
+}; // NormalLightTable
+
 }
\ No newline at end of file
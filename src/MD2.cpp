@@ -560,6 +560,7 @@ void MD2Container::ExtractFrame(RenderObject* obj)
 
 	} // end if
 
+	obj->LocalVertsChanged();
 }
 
 void MD2Container::SetAnimation(int anim_state, int anim_mode)
@@ -1 +1,26 @@
-#include "Material.h"
\ No newline at end of file
+#include "Material.h"
+
+#include <math.h>
+
+#include "defines.h"
+
+namespace t3d {
+
+void SpecularTable::Build(float power)
+{
+	for (int i = 0; i <= SIZE; i++)
+		table[i] = powf((float)i / SIZE, power);
+}
+
+void Material::EnableSpecular(bool enable)
+{
+	if (enable)
+	{
+		spec_table.Build(power);
+		SET_BIT(attr, MAT_ATTR_SPECULAR);
+	}
+	else
+		RESET_BIT(attr, MAT_ATTR_SPECULAR);
+}
+
+}
\ No newline at end of file
@@ -20,6 +20,30 @@ namespace t3d {
 #define MAT_ATTR_SHADE_MODE_GOURAUD     0x0080
 #define MAT_ATTR_SHADE_MODE_FASTPHONG   0x0100
 #define MAT_ATTR_SHADE_MODE_TEXTURE     0x0200
+#define MAT_ATTR_SPECULAR               0x0400 // add the specular term when lighting
+
+// x^power for x in [0,1] sampled in a table, so the specular term of each
+// vertex is a lookup rather than a pow(), the samples are interpolated
+class SpecularTable
+{
+public:
+	void Build(float power);
+
+	float Lookup(float x) const {
+		if (x <= 0) return 0;
+		if (x >= 1) return table[SIZE];
+		float f = x * SIZE;
+		int i = (int)f;
+		return table[i] + (f - i) * (table[i+1] - table[i]);
+	}
+
+public:
+	static const int SIZE = 256;
+
+private:
+	float table[SIZE+1];
+
+}; // SpecularTable
 
 class Material
 {
@@ -53,10 +77,16 @@ public:
 	char texture_file[80];   // file location of texture
 	BmpImg* texture;		 // actual texture map (if any)
 
+	SpecularTable spec_table; // (n . h)^power, see EnableSpecular()
+
 	int   iaux1, iaux2;      // auxiliary vars for future expansion
 	float faux1, faux2;
 	void *ptr;
 
+	// turns the specular term on or off for the polygons of this material,
+	// the highlight is rs * (n . h)^power, call it again after changing power
+	void EnableSpecular(bool enable);
+
 }; // Material
 
 class MaterialsMgr
@@ -70,6 +100,13 @@ public:
 	int Size() const { return num_materials; }
 	void SetSize(int size) { num_materials = size; }
 
+	// the material of a polygon if it has the specular term enabled
+	const Material* GetSpecular(int index) const {
+		if (index < 0 || index >= num_materials)
+			return NULL;
+		return (materials[index].attr & MAT_ATTR_SPECULAR) ? &materials[index] : NULL;
+	}
+
 public:
 	static const int MAX_MATERIALS = 256;
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Vector.h"
+#include "Matrix.h"
+#include "RenderObject.h"
+
+namespace t3d {
+
+// attributes of a mesh instance
+#define INSTANCE_ATTR_COLOR           0x0001 // color replaces the polygon colors
+
+// one copy of a shared mesh in the world, the mesh is a RenderObject that
+// is loaded once and only read while its instances are inserted, see
+// RenderList::InsertInstances(), so a crowd of the same model costs a
+// position, an orientation and a frame per member rather than a full copy
+// of the vertices and polygons
+struct MeshInstance
+{
+	MeshInstance()
+		: mrot(mat4::Identity())
+		, frame(0)
+		, color(0)
+		, attr(0)
+		, state(OBJECT_STATE_ACTIVE | OBJECT_STATE_VISIBLE)
+	{
+		pos.Assign(0, 0, 0);
+	}
+
+	vec4 pos;        // world position
+	mat4 mrot;       // orientation, the mesh goes to the world as local*mrot + pos
+	int frame;       // frame of a multi frame mesh
+	int color;       // color of all the polygons with INSTANCE_ATTR_COLOR
+	int attr;        // INSTANCE_ATTR_*
+	int state;       // OBJECT_STATE_*, the culled flag is set by the insertion
+
+}; // MeshInstance
+
+}
\ No newline at end of file
@@ -0,0 +1,628 @@
+#include "MeshSimplifier.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "RenderObject.h"
+#include "Modules.h"
+#include "Log.h"
+
+namespace t3d {
+
+void MeshSimplifier::Quadric::Clear()
+{
+	memset(m, 0, sizeof(m));
+}
+
+void MeshSimplifier::Quadric::AddPlane(double a, double b, double c, double d)
+{
+	// adds the plane ax + by + cz + d = 0, with (a,b,c) unit length, the
+	// upper triangle of the product of the plane with itself is kept
+	m[0] += a*a; m[1] += a*b; m[2] += a*c; m[3] += a*d;
+	             m[4] += b*b; m[5] += b*c; m[6] += b*d;
+	                          m[7] += c*c; m[8] += c*d;
+	                                       m[9] += d*d;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& q)
+{
+	for (int i = 0; i < 10; i++)
+		m[i] += q.m[i];
+}
+
+double MeshSimplifier::Quadric::Error(const vec4& p) const
+{
+	double x = p.x, y = p.y, z = p.z;
+
+	return     m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+		     + m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y
+		     + m[7]*z*z + 2*m[8]*z
+		     + m[9];
+}
+
+MeshSimplifier::MeshSimplifier()
+	: _verts(NULL)
+	, _num_verts(0)
+	, _max_verts(0)
+	, _tris(NULL)
+	, _num_tris(0)
+	, _max_tris(0)
+	, _live_tris(0)
+	, _refs(NULL)
+	, _max_refs(0)
+	, _mark(NULL)
+	, _stamp(0)
+	, _remap(NULL)
+	, _max_remap(0)
+{
+}
+
+MeshSimplifier::~MeshSimplifier()
+{
+	free(_verts);
+	free(_tris);
+	free(_refs);
+	free(_mark);
+	free(_remap);
+}
+
+bool MeshSimplifier::Alloc(int num_verts, int num_tris)
+{
+	// grows the arrays to the sent mesh, they are kept between calls so
+	// the levels of a mesh are built without allocating again
+
+	if (num_verts > _max_verts)
+	{
+		Vert* verts = (Vert*)realloc(_verts, num_verts*sizeof(Vert));
+		if (!verts)
+			return false;
+		_verts = verts;
+
+		int* mark = (int*)realloc(_mark, num_verts*sizeof(int));
+		if (!mark)
+			return false;
+		_mark = mark;
+
+		_max_verts = num_verts;
+	} // end if
+
+	if (num_tris > _max_tris)
+	{
+		Tri* tris = (Tri*)realloc(_tris, num_tris*sizeof(Tri));
+		if (!tris)
+			return false;
+		_tris = tris;
+
+		Ref* refs = (Ref*)realloc(_refs, 3*num_tris*sizeof(Ref));
+		if (!refs)
+			return false;
+		_refs = refs;
+
+		_max_tris = num_tris;
+		_max_refs = 3*num_tris;
+	} // end if
+
+	// the output remaps the vertices and the texture coordinates, there
+	// are at most 3 of those per polygon
+	int num_remap = num_verts > 3*num_tris ? num_verts : 3*num_tris;
+
+	if (num_remap > _max_remap)
+	{
+		int* remap = (int*)realloc(_remap, num_remap*sizeof(int));
+		if (!remap)
+			return false;
+		_remap = remap;
+
+		_max_remap = num_remap;
+	} // end if
+
+	// the stamps start over with the new marks
+	memset(_mark, 0, num_verts*sizeof(int));
+	_stamp = 0;
+
+	return true;
+}
+
+void MeshSimplifier::UpdateNormal(Tri& tri) const
+{
+	const vec4& p0 = _verts[tri.v[0]].p;
+
+	vec4 u = _verts[tri.v[1]].p - p0;
+	vec4 v = _verts[tri.v[2]].p - p0;
+
+	tri.n = u.Cross(v);
+
+	float length = tri.n.Length();
+
+	if (length > 0)
+	{
+		tri.n.x /= length;
+		tri.n.y /= length;
+		tri.n.z /= length;
+	} // end if
+}
+
+void MeshSimplifier::BuildRefs()
+{
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+		_verts[vertex].num_refs = 0;
+
+	// count the corners of each vertex
+	for (int tri = 0; tri < _num_tris; tri++)
+	{
+		if (_tris[tri].removed)
+			continue;
+
+		for (int corner = 0; corner < 3; corner++)
+			_verts[_tris[tri].v[corner]].num_refs++;
+	} // end for tri
+
+	// give each vertex its range
+	int first = 0;
+
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+	{
+		_verts[vertex].first_ref = first;
+		first += _verts[vertex].num_refs;
+		_verts[vertex].num_refs = 0;
+	} // end for vertex
+
+	// and fill them
+	for (int tri = 0; tri < _num_tris; tri++)
+	{
+		if (_tris[tri].removed)
+			continue;
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			Vert& vert = _verts[_tris[tri].v[corner]];
+			Ref& ref = _refs[vert.first_ref + vert.num_refs++];
+
+			ref.tri = tri;
+			ref.corner = corner;
+		} // end for corner
+	} // end for tri
+}
+
+void MeshSimplifier::FindLockedVerts(const RenderObject& src)
+{
+	// a vertex is locked if moving it would tear the mesh open, mix the
+	// texture coordinates of 2 sides of a seam or move the border between
+	// polygons of different looks
+
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+	{
+		Vert& vert = _verts[vertex];
+
+		vert.locked = false;
+		vert.text = -1;
+
+		if (vert.num_refs == 0)
+			continue;
+
+		const Ref* refs = &_refs[vert.first_ref];
+
+		const Polygon& first = src._plist[_tris[refs[0].tri].poly];
+
+		vert.text = _tris[refs[0].tri].text[refs[0].corner];
+
+		for (int ref = 1; ref < vert.num_refs; ref++)
+		{
+			const Tri& tri = _tris[refs[ref].tri];
+			const Polygon& poly = src._plist[tri.poly];
+
+			// a seam of the texture
+			if (tri.text[refs[ref].corner] != vert.text)
+				vert.text = -1;
+
+			// a border between different polygons
+			if (poly.attr != first.attr || poly.color != first.color ||
+				poly.texture != first.texture || poly.mati != first.mati)
+				vert.locked = true;
+		} // end for ref
+
+		if (vert.text < 0)
+			vert.locked = true;
+
+		// an edge used by a single triangle is on the border of the mesh,
+		// count how many triangles around the vertex use each neighbour,
+		// with 2 stamps per vertex, the first time and the second time
+		_stamp += 2;
+
+		for (int ref = 0; ref < vert.num_refs && !vert.locked; ref++)
+		{
+			const Tri& tri = _tris[refs[ref].tri];
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				int other = tri.v[corner];
+				if (other == vertex)
+					continue;
+
+				if (_mark[other] == _stamp-1)
+					_mark[other] = _stamp;
+				else if (_mark[other] != _stamp)
+					_mark[other] = _stamp-1;
+			} // end for corner
+		} // end for ref
+
+		for (int ref = 0; ref < vert.num_refs && !vert.locked; ref++)
+		{
+			const Tri& tri = _tris[refs[ref].tri];
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				int other = tri.v[corner];
+				if (other != vertex && _mark[other] == _stamp-1)
+					vert.locked = true;
+			} // end for corner
+		} // end for ref
+
+	} // end for vertex
+}
+
+double MeshSimplifier::CollapseError(int from, int to)
+{
+	const Vert& vfrom = _verts[from];
+	const Vert& vto = _verts[to];
+
+	// the vertex moved must be free, and the one it lands on must have
+	// a single texture coordinate for the corners that come along
+	if (vfrom.locked || vfrom.removed || vto.removed || vto.text < 0)
+		return -1;
+
+	// the 2 vertices must share exactly the 2 neighbours of the triangles
+	// on the edge, else the mesh would be pinched
+	_stamp += 2;
+
+	const Ref* refs = &_refs[vfrom.first_ref];
+
+	for (int ref = 0; ref < vfrom.num_refs; ref++)
+	{
+		const Tri& tri = _tris[refs[ref].tri];
+
+		// the lists were built at the start of the pass
+		if (tri.removed)
+			continue;
+
+		for (int corner = 0; corner < 3; corner++)
+			_mark[tri.v[corner]] = _stamp-1;
+	} // end for ref
+
+	int shared = 0;
+
+	refs = &_refs[vto.first_ref];
+
+	for (int ref = 0; ref < vto.num_refs; ref++)
+	{
+		const Tri& tri = _tris[refs[ref].tri];
+
+		if (tri.removed)
+			continue;
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int other = tri.v[corner];
+
+			if (other != from && other != to && _mark[other] == _stamp-1)
+			{
+				_mark[other] = _stamp;
+				shared++;
+			} // end if
+		} // end for corner
+	} // end for ref
+
+	if (shared != 2)
+		return -1;
+
+	// the triangles that stay must not fold over
+	refs = &_refs[vfrom.first_ref];
+
+	for (int ref = 0; ref < vfrom.num_refs; ref++)
+	{
+		const Tri& tri = _tris[refs[ref].tri];
+
+		if (tri.removed || tri.v[0] == to || tri.v[1] == to || tri.v[2] == to)
+			continue;
+
+		vec4 p[3];
+		for (int corner = 0; corner < 3; corner++)
+			p[corner] = _verts[tri.v[corner]].p;
+
+		p[refs[ref].corner] = vto.p;
+
+		vec4 n = (p[1] - p[0]).Cross(p[2] - p[0]);
+		float length = n.Length();
+
+		if (length <= 0 || n.Dot(tri.n) < 0.2f*length)
+			return -1;
+	} // end for ref
+
+	return vfrom.q.Error(vto.p) + vto.q.Error(vto.p);
+}
+
+void MeshSimplifier::Collapse(int from, int to)
+{
+	Vert& vfrom = _verts[from];
+	Vert& vto = _verts[to];
+
+	// the triangles around from now use to, the 2 on the edge are gone
+	const Ref* refs = &_refs[vfrom.first_ref];
+
+	for (int ref = 0; ref < vfrom.num_refs; ref++)
+	{
+		Tri& tri = _tris[refs[ref].tri];
+
+		if (tri.removed)
+			continue;
+
+		tri.dirty = true;
+
+		if (tri.v[0] == to || tri.v[1] == to || tri.v[2] == to)
+		{
+			tri.removed = true;
+			_live_tris--;
+			continue;
+		} // end if
+
+		tri.v[refs[ref].corner] = to;
+		tri.text[refs[ref].corner] = vto.text;
+
+		UpdateNormal(tri);
+	} // end for ref
+
+	// the lists of to are stale until the next pass, so none of its
+	// triangles is touched again in this one
+	refs = &_refs[vto.first_ref];
+
+	for (int ref = 0; ref < vto.num_refs; ref++)
+		_tris[refs[ref].tri].dirty = true;
+
+	vto.q.Add(vfrom.q);
+	vfrom.removed = true;
+}
+
+int MeshSimplifier::Simplify(const RenderObject& src, RenderObject& dst, int target_polys)
+{
+	// this function works in passes, in each the triangles are walked and
+	// every edge whose collapse costs less than a threshold is collapsed,
+	// unless one of the triangles around it already changed in the pass,
+	// the threshold grows each pass until the target is reached, this is
+	// not as exact as keeping all the edges in a priority queue, but it
+	// needs no more than a few flat arrays
+
+	if (!Alloc(src._num_vertices, src._num_polys))
+	{
+		Modules::GetLog().WriteError("\nMeshSimplifier: out of memory for %d vertices, %d polygons.",
+			src._num_vertices, src._num_polys);
+		return(0);
+	} // end if
+
+	const Vertex* vlist = src._head_vlist_local;
+
+	// step 1: copy the mesh and build the quadric of each vertex from the
+	// planes of its polygons
+	_num_verts = src._num_vertices;
+
+	float radius = 0;
+
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+	{
+		Vert& vert = _verts[vertex];
+
+		vert.p = vlist[vertex].v;
+		vert.q.Clear();
+		vert.removed = false;
+
+		float length = vert.p.Length();
+		if (length > radius)
+			radius = length;
+	} // end for vertex
+
+	_num_tris = 0;
+
+	for (int poly = 0; poly < src._num_polys; poly++)
+	{
+		const Polygon& curr_poly = src._plist[poly];
+
+		if (!(curr_poly.state & POLY_STATE_ACTIVE))
+			continue;
+
+		Tri& tri = _tris[_num_tris++];
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			tri.v[corner] = curr_poly.vert[corner];
+			tri.text[corner] = curr_poly.text[corner];
+		} // end for corner
+
+		tri.poly = poly;
+		tri.removed = false;
+		tri.dirty = false;
+
+		UpdateNormal(tri);
+
+		double d = -(tri.n.x*_verts[tri.v[0]].p.x + tri.n.y*_verts[tri.v[0]].p.y + tri.n.z*_verts[tri.v[0]].p.z);
+
+		for (int corner = 0; corner < 3; corner++)
+			_verts[tri.v[corner]].q.AddPlane(tri.n.x, tri.n.y, tri.n.z, d);
+	} // end for poly
+
+	_live_tris = _num_tris;
+
+	BuildRefs();
+	FindLockedVerts(src);
+
+	// step 2: collapse the edges, the errors are squared distances, so the
+	// thresholds are relative to the squared size of the mesh
+	double size2 = (double)radius * radius;
+
+	for (int pass = 0; pass < MAX_PASSES && _live_tris > target_polys; pass++)
+	{
+		if (pass > 0)
+			BuildRefs();
+
+		for (int tri = 0; tri < _num_tris; tri++)
+			_tris[tri].dirty = false;
+
+		double threshold = size2 * 1e-9 * pow((double)(pass + 3), 7.0);
+
+		for (int tri = 0; tri < _num_tris && _live_tris > target_polys; tri++)
+		{
+			if (_tris[tri].removed || _tris[tri].dirty)
+				continue;
+
+			for (int edge = 0; edge < 3; edge++)
+			{
+				int v0 = _tris[tri].v[edge];
+				int v1 = _tris[tri].v[(edge + 1) % 3];
+
+				// try both ways along the edge
+				double error01 = CollapseError(v0, v1);
+				double error10 = CollapseError(v1, v0);
+
+				int from = v0, to = v1;
+				double error = error01;
+
+				if (error10 >= 0 && (error < 0 || error10 < error))
+				{
+					from = v1;
+					to = v0;
+					error = error10;
+				} // end if
+
+				if (error < 0 || error > threshold)
+					continue;
+
+				Collapse(from, to);
+				break;
+			} // end for edge
+		} // end for tri
+	} // end for pass
+
+	// step 3: build the simplified object
+	return Output(src, dst);
+}
+
+int MeshSimplifier::Output(const RenderObject& src, RenderObject& dst)
+{
+	// the vertices and texture coordinates still used are packed and the
+	// polygons copied from the ones they came from
+
+	int num_verts = 0;
+	int num_text = 0;
+
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+		_remap[vertex] = -1;
+
+	for (int tri = 0; tri < _num_tris; tri++)
+	{
+		if (_tris[tri].removed)
+			continue;
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int& remap = _remap[_tris[tri].v[corner]];
+			if (remap < 0)
+				remap = num_verts++;
+		} // end for corner
+	} // end for tri
+
+	if (!dst.Init(num_verts, _live_tris, 1, true))
+	{
+		Modules::GetLog().WriteError("\nMeshSimplifier: can't allocate %d vertices, %d polygons.",
+			num_verts, _live_tris);
+		return(0);
+	} // end if
+
+	// the object itself is the same as the source
+	dst._id = src._id;
+	memcpy(dst._name, src._name, sizeof(dst._name));
+	dst._state = src._state;
+	dst._attr = src._attr;
+	dst._mati = src._mati;
+	dst._world_pos = src._world_pos;
+	dst._dir = src._dir;
+	dst._ux = src._ux;
+	dst._uy = src._uy;
+	dst._uz = src._uz;
+	dst._texture = src._texture;
+
+	// the vertices, the normals are built again below
+	for (int vertex = 0; vertex < _num_verts; vertex++)
+	{
+		if (_remap[vertex] < 0)
+			continue;
+
+		Vertex& out = dst._vlist_local[_remap[vertex]];
+
+		out = src._head_vlist_local[vertex];
+		out.n.Assign(0, 0, 0, 0);
+
+		dst._vlist_trans[_remap[vertex]] = out;
+	} // end for vertex
+
+	// the polygons, on the packed vertices
+	int poly = 0;
+
+	for (int tri = 0; tri < _num_tris; tri++)
+	{
+		const Tri& curr_tri = _tris[tri];
+
+		if (curr_tri.removed)
+			continue;
+
+		Polygon& out = dst._plist[poly++];
+
+		out = src._plist[curr_tri.poly];
+
+		out.state = POLY_STATE_ACTIVE;
+		out.vlist = dst._vlist_local;
+		out.tlist = dst._tlist;
+
+		for (int corner = 0; corner < 3; corner++)
+			out.vert[corner] = _remap[curr_tri.v[corner]];
+	} // end for tri
+
+	// and their texture coordinates are packed the same way
+	int max_text = 3*src._num_polys;
+
+	for (int text = 0; text < max_text; text++)
+		_remap[text] = -1;
+
+	poly = 0;
+
+	for (int tri = 0; tri < _num_tris; tri++)
+	{
+		const Tri& curr_tri = _tris[tri];
+
+		if (curr_tri.removed)
+			continue;
+
+		Polygon& out = dst._plist[poly++];
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int text = curr_tri.text[corner];
+
+			if (_remap[text] < 0)
+			{
+				_remap[text] = num_text;
+				dst._tlist[num_text++] = src._tlist[text];
+			} // end if
+
+			out.text[corner] = _remap[text];
+		} // end for corner
+	} // end for tri
+
+	// finish it like the loaders do
+	dst.ComputeRadius();
+	dst.ComputePolyNormals();
+	dst.ComputeVertexNormals();
+	dst.BuildClusters();
+
+	return(1);
+}
+
+}
\ No newline at end of file
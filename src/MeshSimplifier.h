@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Vector.h"
+
+namespace t3d {
+
+class RenderObject;
+
+// builds simplified copies of a mesh by collapsing its edges, cheapest
+// first, the cost of moving a vertex is the sum of the squared distances
+// to the planes of the polygons that met at it (quadric error metric), the
+// vertices are only moved onto one of their neighbours, so the texture 
+// coordinates and the attributes of the polygons carry over unchanged, the
+// vertices on the border of the mesh, on a seam of the texture or between
+// polygons of different shading, color or material stay where they are
+class MeshSimplifier
+{
+public:
+	MeshSimplifier();
+	~MeshSimplifier();
+
+	// fills dst with a copy of the first frame of src reduced to about
+	// target_polys polygons, returns 0 if out of memory
+	int Simplify(const RenderObject& src, RenderObject& dst, int target_polys);
+
+private:
+	// the symmetric 4x4 matrix of a sum of planes, so p^T Q p is the sum
+	// of the squared distances of p to all of them
+	struct Quadric
+	{
+		double m[10];
+
+		void Clear();
+		void AddPlane(double a, double b, double c, double d);
+		void Add(const Quadric& q);
+		double Error(const vec4& p) const;
+	};
+
+	struct Vert
+	{
+		vec4 p;
+		Quadric q;
+		int first_ref;		// its polygons in _refs[]
+		int num_refs;
+		int text;			// texture coordinate of all its corners, -1 if several
+		bool locked;		// can't be moved onto a neighbour
+		bool removed;
+	};
+
+	struct Tri
+	{
+		int v[3];
+		int text[3];
+		int poly;			// polygon of the source mesh
+		vec4 n;				// unit normal
+		bool removed;
+		bool dirty;			// a vertex of it moved this pass
+	};
+
+	// a corner of a triangle using a vertex
+	struct Ref
+	{
+		int tri;
+		int corner;
+	};
+
+	bool Alloc(int num_verts, int num_tris);
+
+	// rebuilds the lists of the triangles around each vertex
+	void BuildRefs();
+
+	void FindLockedVerts(const RenderObject& src);
+
+	// error of moving the vertex from onto the vertex to, -1 if it's not
+	// allowed, the triangles around it must not fold over or the mesh
+	// be pinched
+	double CollapseError(int from, int to);
+
+	void Collapse(int from, int to);
+
+	void UpdateNormal(Tri& tri) const;
+
+	int Output(const RenderObject& src, RenderObject& dst);
+
+private:
+	// passes over the triangles, each one collapses the edges below a
+	// threshold that grows with every pass
+	static const int MAX_PASSES = 40;
+
+	Vert* _verts;
+	int _num_verts;
+	int _max_verts;
+
+	Tri* _tris;
+	int _num_tris;
+	int _max_tris;
+	int _live_tris;
+
+	Ref* _refs;
+	int _max_refs;
+
+	// per vertex scratch of the tests and of the output
+	int* _mark;
+	int _stamp;
+	int* _remap;
+	int _max_remap;
+
+}; // MeshSimplifier
+
+}
\ No newline at end of file
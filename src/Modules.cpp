@@ -7,6 +7,7 @@
 #include "Music.h"
 #include "Graphics.h"
 #include "Image.h"
+#include "JobSystem.h"
 
 namespace t3d {
 
@@ -17,6 +18,7 @@ Sound* Modules::_sound = NULL;
 //Music* Modules::_music = NULL;
 Graphics* Modules::_graphics = NULL;
 Image* Modules::_image = NULL;
+JobSystem* Modules::_jobs = NULL;
 
 bool Modules::Init()
 {
@@ -27,12 +29,18 @@ bool Modules::Init()
 //	if (_music == NULL) _music = new Music();
 	if (_graphics == NULL) _graphics = new Graphics();
 	if (_image == NULL) _image = new Image();
+	if (_jobs == NULL)
+	{
+		_jobs = new JobSystem();
+		_jobs->Init();
+	}
 
 	return true;
 }
 
 void Modules::Release()
 {
+	delete _jobs, _jobs = NULL;
 	delete _image, _image = NULL;
 	delete _graphics, _graphics = NULL;
 //	delete _music, _music = NULL;
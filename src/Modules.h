@@ -9,6 +9,7 @@ class Sound;
 class Music;
 class Graphics;
 class Image;
+class JobSystem;
 
 // conditionally compilation for engine stats
 extern int debug_total_polys_per_frame;
@@ -34,6 +35,7 @@ public:
 //	static Music& GetMusic() { return *_music; }
 	static Graphics& GetGraphics() { return *_graphics; }
 	static Image& GetImage() { return *_image; }
+	static JobSystem& GetJobs() { return *_jobs; }
 
 private:
 	static Log* _log;
@@ -43,6 +45,7 @@ private:
 //	static Music* _music;
 	static Graphics* _graphics;
 	static Image* _image;
+	static JobSystem* _jobs;
 
 }; // Modules
 
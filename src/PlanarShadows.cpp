@@ -0,0 +1,665 @@
+#include "PlanarShadows.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "tmath.h"
+#include "defines.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Polygon.h"
+#include "RenderObject.h"
+#include "RenderList.h"
+#include "Modules.h"
+#include "Graphics.h"
+#include "Log.h"
+
+namespace t3d {
+
+// the ray of a shadow is walked down to the terrain this many times, each
+// step intersects it with the plane at the height found by the last one
+static const int GROUND_STEPS = 3;
+
+// number of casters allocated at once
+static const int CASTER_GROW = 8;
+
+PlanarShadows::PlanarShadows()
+	: _buffer(NULL)
+	, _width(0)
+	, _height(0)
+	, _dirty_y0(0)
+	, _dirty_y1(-1)
+	, _terrain(NULL)
+	, _ground_y(0)
+	, _intensity(128)
+	, _lift(10)
+	, _casters(NULL)
+	, _num_casters(0)
+	, _max_casters(0)
+	, _rebuilt(0)
+{
+}
+
+PlanarShadows::~PlanarShadows()
+{
+	Delete();
+}
+
+int PlanarShadows::Create(int width, int height)
+{
+	if (_buffer)
+		free(_buffer);
+
+	_width  = width;
+	_height = height;
+
+	if (!(_buffer = (unsigned char*)malloc(width * height)))
+		return(0);
+
+	memset(_buffer, 0, width * height);
+
+	_dirty_y0 = 0;
+	_dirty_y1 = -1;
+
+	return(1);
+}
+
+int PlanarShadows::Delete()
+{
+	if (_buffer)
+		free(_buffer);
+
+	for (int i = 0; i < _num_casters; i++)
+		if (_casters[i].tris)
+			free(_casters[i].tris);
+
+	if (_casters)
+		free(_casters);
+
+	_buffer = NULL;
+	_width = _height = 0;
+
+	_casters = NULL;
+	_num_casters = _max_casters = 0;
+
+	return(1);
+}
+
+void PlanarShadows::SetReceiver(const RenderObject* terrain, float ground_y)
+{
+	if (terrain != _terrain || ground_y != _ground_y)
+	{
+		// every shadow falls somewhere else now
+		for (int i = 0; i < _num_casters; i++)
+			_casters[i].obj = NULL;
+	} // end if
+
+	_terrain  = terrain;
+	_ground_y = ground_y;
+}
+
+void PlanarShadows::SetShadow(int intensity, float lift)
+{
+	if (lift != _lift)
+	{
+		for (int i = 0; i < _num_casters; i++)
+			_casters[i].obj = NULL;
+	} // end if
+
+	_intensity = intensity < 0 ? 0 : (intensity > 255 ? 255 : intensity);
+	_lift      = lift;
+}
+
+void PlanarShadows::Begin()
+{
+	for (int i = 0; i < _num_casters; i++)
+	{
+		// not cast during the whole last frame, the slot is free again, its
+		// triangle buffer is kept for the next caster
+		if (!_casters[i].active)
+			_casters[i].obj = NULL;
+
+		_casters[i].active = false;
+	} // end for i
+
+	_rebuilt = 0;
+}
+
+PlanarShadows::Caster* PlanarShadows::FindCaster(const RenderObject& obj, const Light& light)
+{
+	// the shadow of the same instance from the last frames, the object may
+	// be drawn at several positions in a frame so the world position is
+	// part of the key, and a caster already cast this frame belongs to
+	// another instance, else a free slot, else the slot of another
+	// instance of the pair that wasn't cast yet
+	const vec4& obj_pos = obj.GetWorldPos();
+
+	Caster* free_caster = NULL;
+	Caster* pair_caster = NULL;
+
+	for (int i = 0; i < _num_casters; i++)
+	{
+		Caster& caster = _casters[i];
+
+		if (caster.active)
+			continue;
+
+		if (caster.obj == &obj && caster.light == &light)
+		{
+			if (caster.obj_pos.Equal(obj_pos))
+				return &caster;
+
+			if (!pair_caster)
+				pair_caster = &caster;
+		} // end if
+		else if (!free_caster && !caster.obj)
+			free_caster = &caster;
+	} // end for i
+
+	if (!free_caster)
+		free_caster = pair_caster;
+
+	if (!free_caster)
+	{
+		if (_num_casters == _max_casters)
+		{
+			int max_casters = _max_casters + CASTER_GROW;
+			Caster* casters = (Caster*)realloc(_casters, max_casters * sizeof(Caster));
+
+			if (!casters)
+				return NULL;
+
+			_casters = casters;
+			_max_casters = max_casters;
+		} // end if
+
+		free_caster = &_casters[_num_casters++];
+		free_caster->tris = NULL;
+		free_caster->max_tris = 0;
+		free_caster->active = false;
+	} // end if
+
+	free_caster->obj = NULL;
+	free_caster->light = &light;
+	free_caster->num_tris = 0;
+
+	return free_caster;
+}
+
+bool PlanarShadows::Cast(const RenderObject& obj, const Light& light)
+{
+	if (!(light.attr & (LIGHT_ATTR_POINT | LIGHT_ATTR_INFINITE)))
+		return false;
+
+	Caster* caster = FindCaster(obj, light);
+
+	if (!caster)
+		return false;
+
+	caster->active = true;
+
+	const vec4& light_pos = (light.attr & LIGHT_ATTR_POINT) ? light.pos : light.dir;
+	unsigned int verts_hash = HashVerts(obj);
+
+	// still where it was last projected?
+	if (caster->obj == &obj &&
+		caster->verts_hash == verts_hash &&
+		caster->obj_pos.Equal(obj.GetWorldPos()) &&
+		caster->light_pos.Equal(light_pos))
+		return true;
+
+	caster->obj = &obj;
+	caster->verts_hash = verts_hash;
+	caster->obj_pos = obj.GetWorldPos();
+	caster->light_pos = light_pos;
+
+	++_rebuilt;
+
+	if (!Project(*caster, obj, light))
+	{
+		caster->obj = NULL;
+		caster->active = false;
+		return false;
+	} // end if
+
+	return true;
+}
+
+unsigned int PlanarShadows::HashVerts(const RenderObject& obj)
+{
+	// FNV-1a over the bits of the world vertices, cheap next to projecting
+	// them, and it doesn't depend on how the vertices got there, only the
+	// vertices of the polygons Project() uses, the backfaces culled before
+	// the transform may have stale ones
+	unsigned int hash = 2166136261u;
+
+	for (int poly = 0; poly < obj.PolyNum(); poly++)
+	{
+		const Polygon& curr_poly = obj.GetPolygon(poly);
+
+		if (!(curr_poly.state & POLY_STATE_ACTIVE) ||
+			(curr_poly.state & POLY_STATE_BACKFACE))
+			continue;
+
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const Vertex& v = obj.GetTransVertex(curr_poly.vert[vertex]);
+			const unsigned int* bits = (const unsigned int*)&v.x;
+
+			for (int k = 0; k < 3; k++)
+			{
+				hash ^= bits[k];
+				hash *= 16777619u;
+			} // end for k
+		} // end for vertex
+	} // end for poly
+
+	return hash;
+}
+
+bool PlanarShadows::Project(Caster& caster, const RenderObject& obj, const Light& light)
+{
+	caster.num_tris = 0;
+
+	bool point = (light.attr & LIGHT_ATTR_POINT) != 0;
+
+	for (int poly = 0; poly < obj.PolyNum(); poly++)
+	{
+		const Polygon& curr_poly = obj.GetPolygon(poly);
+
+		// the backfaces culled in object space weren't transformed, see
+		// RenderObject::RemoveBackfacesLocal()
+		if (!(curr_poly.state & POLY_STATE_ACTIVE) ||
+			(curr_poly.state & POLY_STATE_BACKFACE))
+			continue;
+
+		const vec4& p0 = obj.GetTransVertex(curr_poly.vert[0]).v;
+		const vec4& p1 = obj.GetTransVertex(curr_poly.vert[1]).v;
+		const vec4& p2 = obj.GetTransVertex(curr_poly.vert[2]).v;
+
+		// only the polygons facing the light, the others are inside the
+		// same silhouette
+		vec4 u = p1 - p0, v = p2 - p0;
+		vec4 n = u.Cross(v);
+
+		vec4 to_light = point ? light.pos - p0 : light.dir;
+
+		if (n.Dot(to_light) <= 0)
+			continue;
+
+		if (caster.num_tris == caster.max_tris)
+		{
+			int max_tris = caster.max_tris ? caster.max_tris * 2 : 64;
+			float* tris = (float*)realloc(caster.tris, max_tris * 9 * sizeof(float));
+
+			if (!tris)
+			{
+				Modules::GetLog().WriteError("\nPlanarShadows: out of memory projecting a shadow");
+				return false;
+			} // end if
+
+			caster.tris = tris;
+			caster.max_tris = max_tris;
+		} // end if
+
+		float* tri = &caster.tris[caster.num_tris * 9];
+		const vec4* p[3] = { &p0, &p1, &p2 };
+		bool below = true;
+
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			// the ray leaving the light through the vertex
+			vec4 dir;
+
+			if (point)
+				dir = *p[vertex] - light.pos;
+			else
+				dir.Assign(-light.dir.x, -light.dir.y, -light.dir.z);
+
+			// a ray going up never reaches the ground
+			if (dir.y >= 0)
+			{
+				below = false;
+				break;
+			} // end if
+
+			ProjectToGround(*p[vertex], dir, &tri[vertex * 3]);
+		} // end for vertex
+
+		if (below)
+			++caster.num_tris;
+	} // end for poly
+
+	return true;
+}
+
+void PlanarShadows::ProjectToGround(const vec4& p, const vec4& dir, float* out) const
+{
+	// p + t*dir meets the plane at height h for t = (h - p.y) / dir.y, the
+	// height of the terrain is taken again at each hit, this settles quickly
+	// unless the ground is very steep
+	float x = p.x, z = p.z;
+	float h = GroundHeight(x, z);
+
+	for (int step = 0; step < GROUND_STEPS; step++)
+	{
+		float t = (h - p.y) / dir.y;
+
+		// a vertex under the ground stays where it is
+		if (t < 0)
+			t = 0;
+
+		x = p.x + t * dir.x;
+		z = p.z + t * dir.z;
+
+		if (!_terrain)
+			break;
+
+		h = GroundHeight(x, z);
+	} // end for step
+
+	out[0] = x;
+	out[1] = h + _lift;
+	out[2] = z;
+}
+
+float PlanarShadows::GroundHeight(float x, float z) const
+{
+	if (!_terrain)
+		return _ground_y;
+
+	// see RenderObject::GenerateTerrain(), the vertices are a grid of
+	// columns x rows starting at the corner vertex 0
+	int columns = (int)_terrain->GetIVar1();
+	int rows    = (int)_terrain->GetIVar2();
+
+	const Vertex& origin = _terrain->GetTransVertex(0);
+
+	float fx = (x - origin.x) / _terrain->GetFVar1();
+	float fz = (z - origin.z) / _terrain->GetFVar2();
+
+	// off the terrain, use its border
+	if (fx < 0) fx = 0;
+	if (fz < 0) fz = 0;
+	if (fx > columns - 1.001f) fx = columns - 1.001f;
+	if (fz > rows - 1.001f) fz = rows - 1.001f;
+
+	int cell_x = (int)fx;
+	int cell_z = (int)fz;
+
+	float dx = fx - cell_x;
+	float dz = fz - cell_z;
+
+	int v0 = cell_x + cell_z * columns;
+
+	float h0 = _terrain->GetTransVertex(v0).y;
+	float h1 = _terrain->GetTransVertex(v0 + 1).y;
+	float h2 = _terrain->GetTransVertex(v0 + columns).y;
+	float h3 = _terrain->GetTransVertex(v0 + columns + 1).y;
+
+	// bilinear in the cell
+	return (h0 + (h1 - h0) * dx) * (1 - dz) + (h2 + (h3 - h2) * dx) * dz;
+}
+
+void PlanarShadows::Draw(const Camera& cam, const RenderContext& rc)
+{
+	if (!_buffer)
+		return;
+
+	int zmode = 0;
+
+	if (rc.attr & (RENDER_ATTR_ZBUFFER | RENDER_ATTR_WRITETHRUZBUFFER))
+		zmode = RENDER_ATTR_ZBUFFER;
+	else if (rc.attr & RENDER_ATTR_INVZBUFFER)
+		zmode = RENDER_ATTR_INVZBUFFER;
+
+	const mat4& mcam = cam.CameraMat();
+	const float near_z = cam.NearClipZ();
+
+	// camera to screen, see RenderList::CameraToPerspective() and
+	// PerspectiveToScreen()
+	float d      = cam.ViewDist();
+	float aspect = cam.AspectRatio();
+	float alpha  = 0.5f * cam.ViewportWidth() - 0.5f;
+	float beta   = 0.5f * cam.ViewportHeight() - 0.5f;
+
+	for (int i = 0; i < _num_casters; i++)
+	{
+		const Caster& caster = _casters[i];
+
+		if (!caster.active)
+			continue;
+
+		for (int tri = 0; tri < caster.num_tris; tri++)
+		{
+			const float* world = &caster.tris[tri * 9];
+
+			// to camera space
+			vec4 cv[3];
+			int num_behind = 0;
+
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				vec4 v(world[vertex*3], world[vertex*3+1], world[vertex*3+2], 1);
+				cv[vertex] = mcam * v;
+
+				if (cv[vertex].z < near_z)
+					++num_behind;
+			} // end for vertex
+
+			if (num_behind == 3)
+				continue;
+
+			// clip against the near plane, a triangle becomes at most a quad
+			vec4 clipped[4];
+			int num_clipped = 0;
+
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				const vec4& a = cv[vertex];
+				const vec4& b = cv[(vertex + 1) % 3];
+
+				if (a.z >= near_z)
+					clipped[num_clipped++] = a;
+
+				if ((a.z >= near_z) != (b.z >= near_z))
+				{
+					float t = (near_z - a.z) / (b.z - a.z);
+					clipped[num_clipped++].Assign(a.x + t * (b.x - a.x),
+												  a.y + t * (b.y - a.y),
+												  near_z);
+				} // end if
+			} // end for vertex
+
+			// project
+			float sx[4], sy[4], sz[4];
+
+			for (int vertex = 0; vertex < num_clipped; vertex++)
+			{
+				const vec4& v = clipped[vertex];
+
+				sx[vertex] = alpha + alpha * (d * v.x / v.z);
+				sy[vertex] = beta - beta * (d * v.y * aspect / v.z);
+				sz[vertex] = v.z;
+			} // end for vertex
+
+			// fan the polygon
+			for (int vertex = 1; vertex < num_clipped - 1; vertex++)
+			{
+				float x[3] = { sx[0], sx[vertex], sx[vertex+1] };
+				float y[3] = { sy[0], sy[vertex], sy[vertex+1] };
+				float z[3] = { sz[0], sz[vertex], sz[vertex+1] };
+
+				DrawShadowTriangle(x, y, z, (unsigned int*)rc.zbuffer, rc.zpitch, zmode);
+			} // end for vertex
+		} // end for tri
+	} // end for i
+
+	Apply(rc.video_buffer, rc.lpitch);
+}
+
+void PlanarShadows::DrawShadowTriangle(const float* x, const float* y, const float* z,
+									   unsigned int* zbuffer, int zpitch, int zmode)
+{
+	int min_clip_x;
+	int max_clip_x;
+	int min_clip_y;
+	int max_clip_y;
+	Modules::GetGraphics().GetClipValue(min_clip_x,
+		max_clip_x, min_clip_y, max_clip_y);
+
+	if (max_clip_x >= _width)  max_clip_x = _width - 1;
+	if (max_clip_y >= _height) max_clip_y = _height - 1;
+
+	// the value compared with the z buffer, interpolated linearly in
+	// screen space like the rasterizers do
+	float zv[3];
+
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		if (zmode == RENDER_ATTR_INVZBUFFER)
+			zv[vertex] = (float)(1 << FIXP28_SHIFT) / z[vertex];
+		else
+			zv[vertex] = z[vertex] * (1 << FIXP16_SHIFT);
+	} // end for vertex
+
+	// sort vertices
+	int v0 = 0, v1 = 1, v2 = 2;
+
+	if (y[v1] < y[v0])
+		std::swap(v0, v1);
+
+	if (y[v2] < y[v0])
+		std::swap(v0, v2);
+
+	if (y[v2] < y[v1])
+		std::swap(v1, v2);
+
+	// the rows whose centers the triangle covers
+	int ystart = (int)ceilf(y[v0]);
+	int yend   = (int)ceilf(y[v2]);
+
+	if (ystart < min_clip_y)
+		ystart = min_clip_y;
+
+	if (yend > max_clip_y + 1)
+		yend = max_clip_y + 1;
+
+	if (ystart >= yend)
+		return;
+
+	// twice the signed area, the middle vertex is left of the long edge if
+	// it's negative
+	float area = (x[v1] - x[v0]) * (y[v2] - y[v0]) - (x[v2] - x[v0]) * (y[v1] - y[v0]);
+
+	if (area == 0)
+		return;
+
+	if (ystart < _dirty_y0 || _dirty_y1 < _dirty_y0)
+		_dirty_y0 = ystart;
+
+	if (yend - 1 > _dirty_y1)
+		_dirty_y1 = yend - 1;
+
+	zpitch >>= 2;
+
+	for (int yi = ystart; yi < yend; yi++)
+	{
+		float yc = (float)yi;
+
+		// the long edge v0->v2
+		float t_long = (yc - y[v0]) / (y[v2] - y[v0]);
+		float x_long = x[v0] + t_long * (x[v2] - x[v0]);
+		float z_long = zv[v0] + t_long * (zv[v2] - zv[v0]);
+
+		// the short edge, v0->v1 or v1->v2
+		float x_short, z_short;
+
+		if (yc < y[v1])
+		{
+			float t = (yc - y[v0]) / (y[v1] - y[v0]);
+			x_short = x[v0] + t * (x[v1] - x[v0]);
+			z_short = zv[v0] + t * (zv[v1] - zv[v0]);
+		} // end if
+		else
+		{
+			float t = y[v2] != y[v1] ? (yc - y[v1]) / (y[v2] - y[v1]) : 0;
+			x_short = x[v1] + t * (x[v2] - x[v1]);
+			z_short = zv[v1] + t * (zv[v2] - zv[v1]);
+		} // end else
+
+		float xl = x_long, xr = x_short, zl = z_long, zr = z_short;
+
+		if (area > 0)
+		{
+			std::swap(xl, xr);
+			std::swap(zl, zr);
+		} // end if
+
+		int xstart = (int)ceilf(xl);
+		int xend   = (int)ceilf(xr);
+
+		if (xend <= xstart)
+			continue;
+
+		float dz = (zr - zl) / (xr - xl);
+		float zi = zl + (xstart - xl) * dz;
+
+		// test for x clipping
+		if (xstart < min_clip_x)
+		{
+			zi += dz * (min_clip_x - xstart);
+			xstart = min_clip_x;
+		} // end if
+
+		if (xend > max_clip_x + 1)
+			xend = max_clip_x + 1;
+
+		unsigned char* shadow_ptr = _buffer + yi * _width;
+		unsigned int* z_ptr = zbuffer + yi * zpitch;
+
+		for (int xi = xstart; xi < xend; xi++, zi += dz)
+		{
+			// hidden by the scene?
+			if (zmode == RENDER_ATTR_ZBUFFER && (unsigned int)zi >= z_ptr[xi])
+				continue;
+			else if (zmode == RENDER_ATTR_INVZBUFFER && (unsigned int)zi <= z_ptr[xi])
+				continue;
+
+			shadow_ptr[xi] = (unsigned char)_intensity;
+		} // end for xi
+	} // end for yi
+}
+
+void PlanarShadows::Apply(unsigned char* video_buffer, int lpitch)
+{
+	lpitch >>= 2;
+
+	for (int y = _dirty_y0; y <= _dirty_y1; y++)
+	{
+		unsigned char* shadow_ptr = _buffer + y * _width;
+		unsigned int* screen_ptr = (unsigned int*)video_buffer + y * lpitch;
+
+		for (int x = 0; x < _width; x++)
+		{
+			if (!shadow_ptr[x])
+				continue;
+
+			int scale = 256 - shadow_ptr[x];
+
+			int a, r, g, b;
+			_RGB8888FROM32BIT(screen_ptr[x], &a, &r, &g, &b);
+
+			screen_ptr[x] = _RGB32BIT(a, (r * scale) >> 8, (g * scale) >> 8, (b * scale) >> 8);
+
+			// clear it for the next frame on the way
+			shadow_ptr[x] = 0;
+		} // end for x
+	} // end for y
+
+	_dirty_y0 = 0;
+	_dirty_y1 = -1;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Vector.h"
+
+namespace t3d {
+
+class Camera;
+class Light;
+class RenderObject;
+struct RenderContext;
+
+// planar shadows cast by objects on a terrain made with
+// RenderObject::GenerateTerrain(), or on a flat ground plane, the
+// polygons of an occluder that face the light are projected along the
+// light rays onto the ground, their union is the area inside the
+// silhouette of the occluder, the projected triangles are kept in world
+// space and reused while neither the light nor the occluder move, each
+// frame Draw() rasterizes all of them into one screen sized shadow
+// intensity buffer, depth tested against the scene, and darkens the
+// image in one pass, overlapping shadows don't darken twice
+//
+// typical use, after the scene is drawn
+//
+// shadows.Begin();
+// shadows.Cast(*obj, lights[POINT_LIGHT_INDEX]);
+// shadows.Draw(*cam, rc);
+class PlanarShadows
+{
+public:
+	PlanarShadows();
+	~PlanarShadows();
+
+	// allocates the shadow buffer for a screen of the sent size,
+	// returns 0 if out of memory
+	int Create(int width, int height);
+	int Delete();
+
+	// the terrain the shadows fall on, it must not be rotated, NULL casts
+	// them on the plane y = ground_y
+	void SetReceiver(const RenderObject* terrain, float ground_y = 0);
+
+	// darkness of the shadows, 0 none .. 255 black, and how far they're
+	// lifted off the ground so they stay in front of it in the z buffer
+	void SetShadow(int intensity, float lift);
+
+	// starts a new frame, forgets the casters of the last one but keeps
+	// their projected shadows around for one frame, the casters that 
+	// weren't cast during it free their slots
+	void Begin();
+
+	// casts the shadow of the object from a point or infinite light, the
+	// world vertices of the object must be current, the polygons culled 
+	// as backfaces are left out, returns false if out of memory or the 
+	// light type can't cast shadows, an object drawn at several positions
+	// is cast once per position, each instance keeps its own shadow as
+	// long as it's cast at the same place
+	bool Cast(const RenderObject& obj, const Light& light);
+
+	// rasterizes the shadows of the casters since Begin() with the z
+	// buffer mode and buffers of the context, and darkens its image
+	void Draw(const Camera& cam, const RenderContext& rc);
+
+	// number of casters whose shadow had to be projected again this frame
+	int Rebuilt() const { return _rebuilt; }
+
+private:
+	// the projected shadow of an occluder at a position from a light, and
+	// what it's for
+	struct Caster
+	{
+		const RenderObject* obj;
+		const Light* light;
+		bool active;  // cast since Begin()
+
+		vec4 light_pos;  // position or direction of the light
+		vec4 obj_pos;
+		unsigned int verts_hash;  // hash of the world vertices
+
+		float* tris;  // 9 floats per triangle, world x,y,z of 3 vertices
+		int num_tris;
+		int max_tris;
+	};
+
+	Caster* FindCaster(const RenderObject& obj, const Light& light);
+
+	// projects the occluder again, returns false if out of memory
+	bool Project(Caster& caster, const RenderObject& obj, const Light& light);
+
+	// moves the point p along the ray dir until it meets the ground
+	void ProjectToGround(const vec4& p, const vec4& dir, float* out) const;
+	float GroundHeight(float x, float z) const;
+
+	static unsigned int HashVerts(const RenderObject& obj);
+
+	// rasterizes a triangle in screen space into the shadow buffer,
+	// z holds the value the z buffer of the context stores
+	void DrawShadowTriangle(const float* x, const float* y, const float* z,
+		unsigned int* zbuffer, int zpitch, int zmode);
+
+	void Apply(unsigned char* video_buffer, int lpitch);
+
+private:
+	unsigned char* _buffer;  // shadow intensity of each pixel
+	int _width;
+	int _height;
+
+	// rows of _buffer written since the last Apply()
+	int _dirty_y0;
+	int _dirty_y1;
+
+	const RenderObject* _terrain;
+	float _ground_y;
+
+	int _intensity;
+	float _lift;
+
+	Caster* _casters;
+	int _num_casters;
+	int _max_casters;
+
+	int _rebuilt;
+
+}; // PlanarShadows
+
+}
\ No newline at end of file
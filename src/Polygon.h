@@ -11,6 +11,7 @@ namespace t3d {
 #define POLY_STATE_CLIPPED            0x0002
 #define POLY_STATE_BACKFACE           0x0004
 #define POLY_STATE_LIT                0x0008
+#define POLY_STATE_INDEXED            0x0010 // vertices live in the render list vertex pool
 
 // attributes of polygons and polygon faces
 #define POLY_ATTR_2SIDED              0x0001
@@ -24,7 +25,7 @@ namespace t3d {
 #define POLY_ATTR_SHADE_MODE_EMISSIVE   0x0020 // (alias)
 #define POLY_ATTR_SHADE_MODE_FLAT       0x0040
 #define POLY_ATTR_SHADE_MODE_GOURAUD    0x0080
-#define POLY_ATTR_SHADE_MODE_PHONG      0x0100
+#define POLY_ATTR_SHADE_MODE_PHONG      0x0100 // per pixel ambient and infinite lights, the point and spot lights are per vertex
 #define POLY_ATTR_SHADE_MODE_FASTPHONG  0x0100 // (alias)
 #define POLY_ATTR_SHADE_MODE_TEXTURE    0x0200 
 #define POLY_ATTR_MIPMAP				0x0400 // flags if polygon has a mipmap
@@ -91,6 +92,9 @@ public:
 	Vertex vlist[3];		// the vertices of this triangle
 	Vertex tvlist[3];		// the vertices after transformation if needed
 
+	int vert[3];		// indices into the render list vertex pool, only
+						// valid if the state has POLY_STATE_INDEXED set
+
 	PolygonF *next;		// pointer to next polygon in list??
 	PolygonF *prev;		// pointer to previous polygon in list??
 
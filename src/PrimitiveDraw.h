@@ -5,6 +5,7 @@
 namespace t3d {
 
 class PolygonF;
+class NormalLightTable;
 
 extern int DrawClipLine(int x0,int y0, int x1, int y1, int color,unsigned char* dest_buffer, int lpitch);
 extern int DrawClipLine16(int x0,int y0, int x1, int y1, int color,unsigned char* dest_buffer, int lpitch);
@@ -33,6 +34,15 @@ extern void DrawGouraudTriangleWTZB32(PolygonF* face, unsigned char *dest_buffer
 extern void DrawGouraudTriangleZBAlpha32(PolygonF* face, unsigned char* _dest_buffer, int mem_pitch, unsigned char* _zbuffer, int zpitch, int alpha);
 extern void DrawGouraudTriangleINVZB32(PolygonF* face, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch);
 extern void DrawGouraudTriangleINVZBAlpha32(PolygonF* face, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch, int alpha);
+extern void DrawPhongTriangle32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch);
+extern void DrawPhongTriangleAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, int alpha);
+extern void DrawPhongTriangleZB32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch);
+extern void DrawPhongTriangleWTZB32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch);
+extern void DrawPhongTriangleZBAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch, int alpha);
+extern void DrawPhongTriangleINVZB32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch);
+extern void DrawPhongTriangleINVZBAlpha32(PolygonF* face, const NormalLightTable& table, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch, int alpha);
+extern void DrawGBufferTriangle32(PolygonF* face, unsigned char* albedo, int apitch, unsigned char* normals, int npitch, unsigned char* zbuffer, int zpitch);
+extern void DrawDepthTriangle32(PolygonF* face, unsigned char* zbuffer, int zpitch, int width, int height);
 extern void DrawTexturedTriangle32(PolygonF* face, unsigned char *dest_buffer, int mempitch); 
 extern void DrawTexturedTriangleAlpha32(PolygonF* face, unsigned char *dest_buffer, int mempitch, int alpha); 
 extern void DrawTexturedTriangleZB32(PolygonF* face, unsigned char *dest_buffer, int mempitch, unsigned char* zbuffer, int zpitch);
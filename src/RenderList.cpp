@@ -3,6 +3,8 @@
 #include <locale.h>
 #include <string.h>
 #include <float.h>
+#include <stdlib.h>
+#include <xmmintrin.h>
 
 #include "defines.h"
 #include "Camera.h"
@@ -13,39 +15,251 @@
 #include "Light.h"
 #include "Log.h"
 #include "BmpImg.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "GBuffer.h"
+#include "MeshInstance.h"
 
 namespace t3d {
 
+RenderList::RenderList()
+	: _state(0)
+	, _attr(0)
+	, _poly_ptrs(NULL)
+	, _max_polys(0)
+	, _poly_chunks(NULL)
+	, _num_chunks(0)
+	, _max_chunks(0)
+	, _num_polys(0)
+	, _vert_local(NULL)
+	, _vert_trans(NULL)
+	, _vert_mark(NULL)
+	, _vert_light(NULL)
+	, _max_verts(0)
+	, _num_verts(0)
+	, _verts_gathered(true)
+	, _poly_high_water(0)
+	, _vert_high_water(0)
+	, _sort_pairs(NULL)
+	, _sort_ptrs(NULL)
+	, _max_sort(0)
+	, _sort_order(NULL)
+	, _num_sort_order(0)
+	, _inst_visible(NULL)
+	, _max_inst_visible(0)
+	, _inst_verts(NULL)
+	, _max_inst_verts(0)
+	, _vert_clip(NULL)
+	, _clip_buffer(0)
+	, _phong_table(NULL)
+	, _phong_updated(false)
+	, _phong_lights(NULL)
+	, _phong_lit(false)
+	, _phong_polys(0)
+{
+}
+
+RenderList::~RenderList()
+{
+	for (int chunk = 0; chunk < _num_chunks; chunk++)
+		free(_poly_chunks[chunk]);
+
+	free(_poly_chunks);
+	free(_poly_ptrs);
+
+	free(_vert_local);
+	free(_vert_trans);
+	free(_vert_mark);
+	free(_vert_light);
+	free(_vert_clip);
+
+	free(_sort_pairs);
+	free(_sort_ptrs);
+	free(_sort_order);
+
+	free(_inst_visible);
+	free(_inst_verts);
+
+	delete _phong_table;
+	delete _phong_lights;
+}
+
+bool RenderList::Reserve(int num_polys, int num_verts)
+{
+	// this function makes room for at least the sent number of polygons
+	// and pool vertices, so a list that is known to get big doesn't 
+	// have to grow during the first frames
+
+	// the polygons are allocated on demand by AllocPoly(), so simply
+	// allocate them all and hand them back
+	int curr_polys = _num_polys;
+
+	while (_num_polys < num_polys)
+	{
+		if (!AllocPoly())
+		{
+			_num_polys = curr_polys;
+			return false;
+		}
+
+		_num_polys++;
+	} // end while
+
+	_num_polys = curr_polys;
+
+	return GrowVerts(num_verts);
+}
+
+PolygonF* RenderList::AllocPoly()
+{
+	// this function returns the storage for the next polygon in the list
+	// and points the next entry of the pointer list to it, the polygons live
+	// in fixed size chunks that are never moved or freed until the list is
+	// destroyed, thus the pointers to them (including the next/prev links)
+	// stay valid while the list grows and the memory is simply reused by the
+	// next frame after a Reset(), NULL is returned if we are out of memory
+
+	// step 1: grow the pointer list if needed, it's only an array of
+	// pointers so it can be reallocated
+	if (_num_polys >= _max_polys)
+	{
+		int max_polys = _max_polys ? 2*_max_polys : POLY_CHUNK_SIZE;
+
+		PolygonF** poly_ptrs = (PolygonF**)realloc(_poly_ptrs, max_polys*sizeof(PolygonF*));
+
+		if (!poly_ptrs)
+		{
+			Modules::GetLog().WriteError("\nRenderList: can't grow the polygon list to %d polygons.", max_polys);
+			return NULL;
+		}
+
+		_poly_ptrs = poly_ptrs;
+		_max_polys = max_polys;
+	} // end if
+
+	// step 2: allocate a new chunk of polygons if needed
+	int chunk = _num_polys >> POLY_CHUNK_SHIFT;
+
+	if (chunk >= _num_chunks)
+	{
+		// grow the chunk table first
+		if (_num_chunks >= _max_chunks)
+		{
+			int max_chunks = _max_chunks ? 2*_max_chunks : 16;
+
+			PolygonF** poly_chunks = (PolygonF**)realloc(_poly_chunks, max_chunks*sizeof(PolygonF*));
+
+			if (!poly_chunks)
+			{
+				Modules::GetLog().WriteError("\nRenderList: can't grow the chunk table to %d chunks.", max_chunks);
+				return NULL;
+			}
+
+			_poly_chunks = poly_chunks;
+			_max_chunks = max_chunks;
+		} // end if
+
+		PolygonF* polys = (PolygonF*)malloc(POLY_CHUNK_SIZE*sizeof(PolygonF));
+
+		if (!polys)
+		{
+			Modules::GetLog().WriteError("\nRenderList: can't allocate polygon chunk %d.", _num_chunks);
+			return NULL;
+		}
+
+		// same as the PolygonF constructor
+		memset(polys, 0, POLY_CHUNK_SIZE*sizeof(PolygonF));
+		for (int i = 0; i < POLY_CHUNK_SIZE; i++)
+			polys[i].mati = -1;
+
+		_poly_chunks[_num_chunks++] = polys;
+	} // end if
+
+	// step 3: hook the polygon into the pointer list
+	PolygonF* poly = PolySlot(_num_polys);
+
+	_poly_ptrs[_num_polys] = poly;
+
+	return poly;
+}
+
+bool RenderList::GrowVerts(int num_verts)
+{
+	// this function makes sure the vertex pool can hold num_verts vertices,
+	// unlike the polygons the pool is referenced by index only, so the arrays
+	// can be reallocated, they grow by doubling, so after a few frames the
+	// pool is large enough and no more allocations happen
+
+	if (num_verts <= _max_verts)
+		return true;
+
+	int max_verts = _max_verts ? _max_verts : 4096;
+
+	while (max_verts < num_verts)
+		max_verts *= 2;
+
+	Vertex* vert_local = (Vertex*)realloc(_vert_local, max_verts*sizeof(Vertex));
+	if (vert_local)
+		_vert_local = vert_local;
+
+	Vertex* vert_trans = (Vertex*)realloc(_vert_trans, max_verts*sizeof(Vertex));
+	if (vert_trans)
+		_vert_trans = vert_trans;
+
+	unsigned char* vert_mark = (unsigned char*)realloc(_vert_mark, max_verts*sizeof(unsigned char));
+	if (vert_mark)
+		_vert_mark = vert_mark;
+
+	int* vert_light = (int*)realloc(_vert_light, 3*max_verts*sizeof(int));
+	if (vert_light)
+		_vert_light = vert_light;
+
+	unsigned char* vert_clip = (unsigned char*)realloc(_vert_clip, max_verts*sizeof(unsigned char));
+	if (vert_clip)
+		_vert_clip = vert_clip;
+
+	// the arrays that did grow are simply a bit bigger than needed
+	if (!vert_local || !vert_trans || !vert_mark || !vert_light || !vert_clip)
+	{
+		Modules::GetLog().WriteError("\nRenderList: can't grow the vertex pool to %d vertices.", max_verts);
+		return false;
+	}
+
+	_max_verts = max_verts;
+
+	return true;
+}
+
 bool RenderList::Insert(const Polygon& poly)
 {
-	// step 0: are we full?
-	if (_num_polys >= MAX_POLYS)
+	// step 0: get the next opening in the render list, this only
+	// fails if the list can't grow anymore
+	PolygonF* face = AllocPoly();
+	if (!face)
 		return(0);
 
 	// step 1: copy polygon into next opening in polygon render list
 
-	// point pointer to polygon structure
-	_poly_ptrs[_num_polys] = &_poly_data[_num_polys];
-
 	// copy fields
-	_poly_data[_num_polys].state		= poly.state;
-	_poly_data[_num_polys].attr			= poly.attr;
-	_poly_data[_num_polys].color		= poly.color;
-	_poly_data[_num_polys].nlength		= poly.nlength;
-	_poly_data[_num_polys].texture		= poly.texture;
+	face->state		= poly.state;
+	face->attr		= poly.attr;
+	face->color		= poly.color;
+	face->nlength	= poly.nlength;
+	face->texture	= poly.texture;
+	face->mati		= poly.mati;
 
 	// poly could be lit, so copy these too...
 	for (size_t i = 0; i < 3; ++i)
-		_poly_data[_num_polys].lit_color[i] = poly.lit_color[i];
+		face->lit_color[i] = poly.lit_color[i];
 
 	// now copy vertices, be careful! later put a loop, but for now
 	// know there are 3 vertices always!
 	for (size_t i = 0; i < 3; ++i)
-		_poly_data[_num_polys].tvlist[i] = poly.vlist[poly.vert[i]];
+		face->tvlist[i] = poly.vlist[poly.vert[i]];
 
 	// and copy into local vertices too
 	for (size_t i = 0; i < 3; ++i)
-		_poly_data[_num_polys].vlist[i] = poly.vlist[poly.vert[i]];
+		face->vlist[i] = poly.vlist[poly.vert[i]];
 
 	// finally the texture coordinates, this has to be performed manually
 	// since at this point in the pipeline the vertices do NOT have texture
@@ -53,8 +267,8 @@ bool RenderList::Insert(const Polygon& poly)
 	// EVERY polygon, rather than vertex sharing, so we can copy the texture
 	// coordinates out of the indexed arrays into the VERTEX4DTV1 structures
 	for (size_t i = 0; i < 3; ++i) {
-		_poly_data[_num_polys].tvlist[i].t = poly.tlist[poly.text[i]];
-		_poly_data[_num_polys].vlist[i].t = poly.tlist[poly.text[i]];
+		face->tvlist[i].t = poly.tlist[poly.text[i]];
+		face->vlist[i].t = poly.tlist[poly.text[i]];
 	}
 
 	// now the polygon is loaded into the next free array position, but
@@ -64,17 +278,17 @@ bool RenderList::Insert(const Polygon& poly)
 	if (_num_polys == 0)
 	{
 		// set pointers to null, could loop them around though to self
-		_poly_data[0].next = NULL;
-		_poly_data[0].prev = NULL;
+		face->next = NULL;
+		face->prev = NULL;
 	}
 	else
 	{
 		// first set this node to point to previous node and next node (null)
-		_poly_data[_num_polys].next = NULL;
-		_poly_data[_num_polys].prev = &_poly_data[_num_polys-1];
+		face->next = NULL;
+		face->prev = PolySlot(_num_polys-1);
 
 		// now set previous node to point to this node
-		_poly_data[_num_polys-1].next = &_poly_data[_num_polys];
+		face->prev->next = face;
 	}
 
 	// increment number of polys in list
@@ -87,17 +301,14 @@ bool RenderList::Insert(const PolygonF& poly)
 {
 	// inserts the sent polyface POLYF4DV1 into the render list
 
-	// step 0: are we full?
-	if (_num_polys >= MAX_POLYS)
+	// step 0: get the next opening in the render list, this only
+	// fails if the list can't grow anymore
+	PolygonF* face = AllocPoly();
+	if (!face)
 		return false;
 
-	// step 1: copy polygon into next opening in polygon render list
-
-	// point pointer to polygon structure
-	_poly_ptrs[_num_polys] = &_poly_data[_num_polys];
-
-	// copy face right into array, thats it
-	memcpy((void *)&_poly_data[_num_polys],(void *)&poly, sizeof(poly));
+	// step 1: copy face right into the opening, thats it
+	memcpy((void *)face,(void *)&poly, sizeof(poly));
 
 	// now the polygon is loaded into the next free array position, but
 	// we need to fix up the links
@@ -105,17 +316,17 @@ bool RenderList::Insert(const PolygonF& poly)
 	if (_num_polys == 0)
 	{
 		// set pointers to null, could loop them around though to self
-		_poly_data[0].next = NULL;
-		_poly_data[0].prev = NULL;
+		face->next = NULL;
+		face->prev = NULL;
 	} // end if
 	else
 	{
 		// first set this node to point to previous node and next node (null)
-		_poly_data[_num_polys].next = NULL;
-		_poly_data[_num_polys].prev = &_poly_data[_num_polys-1];
+		face->next = NULL;
+		face->prev = PolySlot(_num_polys-1);
 
 		// now set previous node to point to this node
-		_poly_data[_num_polys-1].next = &_poly_data[_num_polys];
+		face->prev->next = face;
 	} // end else
 
 	// increment number of polys in list
@@ -148,6 +359,13 @@ bool RenderList::Insert(const RenderObject& obj, bool insert_local)
 		!(obj._state & OBJECT_STATE_VISIBLE))
 		return(0); 
 
+	// in indexed mode the vertices are shared through the vertex pool,
+	// if the pool can't grow anymore fall back to the self contained 
+	// polygons
+	if ((_attr & RENDERLIST_ATTR_INDEXED) && 
+		GrowVerts(_num_verts + obj._num_vertices))
+		return InsertIndexed(obj, insert_local);
+
 	// the object is valid, let's rip it apart polygon by polygon
 	for (int poly = 0; poly < obj._num_polys; poly++)
 	{
@@ -187,17 +405,615 @@ bool RenderList::Insert(const RenderObject& obj, bool insert_local)
 	return true;
 }
 
+bool RenderList::InsertIndexed(const RenderObject& obj, bool insert_local)
+{
+	// this function works like Insert() above, but rather than copying 3
+	// vertices into every polygon, the vertices of the current frame of the 
+	// object are copied into the vertex pool once, and the polygons only
+	// store the indices of them, thus every later vertex stage of the 
+	// pipeline only has to process each shared vertex once, note the 
+	// texture coordinates are still copied into the polygons since they 
+	// are indexed per polygon in the mesh, the caller has already grown
+	// the pool to hold the vertices
+
+	const Vertex* vlist = insert_local ? obj._vlist_local : obj._vlist_trans;
+
+	// the vertex range of this object starts here in the pool
+	int base_vert = _num_verts;
+
+	memcpy((void *)&_vert_local[base_vert], (void *)vlist, obj._num_vertices*sizeof(Vertex));
+	memcpy((void *)&_vert_trans[base_vert], (void *)vlist, obj._num_vertices*sizeof(Vertex));
+
+	_num_verts += obj._num_vertices;
+
+	// the polygons tvlist[] have to be refreshed from the pool
+	_verts_gathered = false;
+
+	for (int poly = 0; poly < obj._num_polys; poly++)
+	{
+		// acquire polygon
+		const Polygon* curr_poly = &obj._plist[poly];
+
+		// first is this polygon even visible?
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
+
+		// get the next opening in the render list
+		PolygonF* face = AllocPoly();
+		if (!face)
+			return false;
+
+		// copy fields
+		face->state		= curr_poly->state | POLY_STATE_INDEXED;
+		face->attr		= curr_poly->attr;
+		face->color		= curr_poly->color;
+		face->nlength	= curr_poly->nlength;
+		face->texture	= curr_poly->texture;
+		face->mati		= curr_poly->mati;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			// poly could be lit, so copy these too...
+			face->lit_color[i] = curr_poly->lit_color[i];
+
+			// the vertices are referenced from the pool
+			face->vert[i] = base_vert + curr_poly->vert[i];
+
+			// and the texture coordinates are copied as usual
+			face->tvlist[i].t = curr_poly->tlist[curr_poly->text[i]];
+			face->vlist[i].t  = curr_poly->tlist[curr_poly->text[i]];
+		}
+
+		// fix up the links
+		if (_num_polys == 0)
+		{
+			face->next = NULL;
+			face->prev = NULL;
+		}
+		else
+		{
+			face->next = NULL;
+			face->prev = PolySlot(_num_polys-1);
+
+			face->prev->next = face;
+		}
+
+		// increment number of polys in list
+		_num_polys++;
+	}
+
+	return true;
+}
+
+bool RenderList::InsertPoint(const Camera& cam, const vec4& world_pos, int color, float size)
+{
+	// this function inserts a single small triangle in place of an object
+	// that covers only a pixel or two, it's sized from its distance to the
+	// camera and faces it, and it's 2 sided and constant shaded so the
+	// later stages let it through as is
+
+	vec4 cam_pos = cam.CameraMat() * world_pos;
+
+	if (cam_pos.z <= cam.NearClipZ())
+		return false;
+
+	// the size of a pixel in the world at that distance
+	float pixel = cam_pos.z * cam.ViewplaneWidth() / (cam.ViewDist() * cam.ViewportWidth());
+	float radius = 0.5f * size * pixel;
+
+	// the right and up axes of the camera are the columns of its matrix
+	const mat4& m = cam.CameraMat();
+
+	vec4 right(m.c[0][0], m.c[1][0], m.c[2][0], 1);
+	vec4 up(m.c[0][1], m.c[1][1], m.c[2][1], 1);
+
+	// get the next opening in the render list
+	PolygonF* face = AllocPoly();
+	if (!face)
+		return false;
+
+	face->state		= POLY_STATE_ACTIVE;
+	face->attr		= POLY_ATTR_2SIDED | POLY_ATTR_RGB24 | POLY_ATTR_SHADE_MODE_CONSTANT;
+	face->color		= color;
+	face->nlength	= 1;
+	face->texture	= NULL;
+	face->mati		= -1;
+
+	// an equilateral triangle around the center
+	face->tvlist[0].v = world_pos + up * (2*radius);
+	face->tvlist[1].v = world_pos + right * (1.732f*radius) - up * radius;
+	face->tvlist[2].v = world_pos - right * (1.732f*radius) - up * radius;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		face->lit_color[i] = color;
+
+		face->tvlist[i].n.Assign(0, 0, 0, 0);
+		face->tvlist[i].t.x = 0;
+		face->tvlist[i].t.y = 0;
+		face->tvlist[i].attr = 0;
+
+		face->vlist[i] = face->tvlist[i];
+	} // end for i
+
+	// fix up the links
+	if (_num_polys == 0)
+	{
+		face->next = NULL;
+		face->prev = NULL;
+	}
+	else
+	{
+		face->next = NULL;
+		face->prev = PolySlot(_num_polys-1);
+
+		face->prev->next = face;
+	}
+
+	// increment number of polys in list
+	_num_polys++;
+
+	return true;
+}
+
+bool RenderList::GrowInstances(int num_instances, int num_verts)
+{
+	// this function makes sure the scratch of InsertInstances() can hold
+	// the sent number of visible instances and placed vertices, like the
+	// pool it only grows
+
+	if (num_instances > _max_inst_visible)
+	{
+		int* inst_visible = (int*)realloc(_inst_visible, num_instances*sizeof(int));
+		if (!inst_visible)
+		{
+			Modules::GetLog().WriteError("\nRenderList: can't grow the instance list to %d instances.", num_instances);
+			return false;
+		}
+
+		_inst_visible = inst_visible;
+		_max_inst_visible = num_instances;
+	} // end if
+
+	if (num_verts > _max_inst_verts)
+	{
+		Vertex* inst_verts = (Vertex*)realloc(_inst_verts, num_verts*sizeof(Vertex));
+		if (!inst_verts)
+		{
+			Modules::GetLog().WriteError("\nRenderList: can't grow the instance vertices to %d vertices.", num_verts);
+			return false;
+		}
+
+		_inst_verts = inst_verts;
+		_max_inst_verts = num_verts;
+	} // end if
+
+	return true;
+}
+
+int RenderList::InsertInstances(const RenderObject& mesh, MeshInstance* instances,
+								int num_instances, const Camera& cam, int cull_flags,
+								float min_pixels)
+{
+	// this function inserts many copies of the same mesh, rather than
+	// resetting, transforming and culling one RenderObject per copy, the 
+	// mesh stays as it was loaded and every instance only brings its 
+	// position, orientation, frame and color, the work is done in 3 steps,
+	// the instances are culled first, then the vertices of all the visible
+	// ones are placed in a single parallel pass, and last the polygons of
+	// each facing the viewer are inserted, the backfaces are found in
+	// object space with the camera moved back into the mesh, like 
+	// RenderObject::RemoveBackfacesLocal() does
+
+	// is the mesh inactive or invisible?
+	if (!(mesh._state & OBJECT_STATE_ACTIVE) ||
+		!(mesh._state & OBJECT_STATE_VISIBLE) ||
+		num_instances <= 0)
+		return(0); 
+
+	int num_verts = mesh._num_vertices;
+
+	if (!GrowInstances(num_instances, 0))
+		return(0);
+
+	// step 1: cull the instances with the bounding sphere of their frame
+	int num_visible = 0;
+
+	for (int index = 0; index < num_instances; index++)
+	{
+		MeshInstance& inst = instances[index];
+
+		RESET_BIT(inst.state, OBJECT_STATE_CULLED);
+		RESET_BIT(inst.state, OBJECT_STATE_TINY);
+
+		if (!(inst.state & OBJECT_STATE_ACTIVE) ||
+			!(inst.state & OBJECT_STATE_VISIBLE))
+			continue;
+
+		// clamp the frame like RenderObject::SetFrame()
+		if (inst.frame < 0)
+			inst.frame = 0;
+		else if (inst.frame >= mesh._num_frames)
+			inst.frame = mesh._num_frames - 1;
+
+		if (cull_flags)
+		{
+			vec4 sphere_pos = cam.CameraMat() * inst.pos;
+
+			if (RenderObject::SphereOutside(cam, sphere_pos, mesh._max_radius[inst.frame], cull_flags))
+			{
+				SET_BIT(inst.state, OBJECT_STATE_CULLED);
+				continue;
+			} // end if
+
+			// too small to contribute anything
+			if ((cull_flags & CULL_OBJECT_CONTRIBUTION) &&
+				2*RenderObject::ProjectedRadius(cam, sphere_pos, mesh._max_radius[inst.frame]) < min_pixels)
+			{
+				SET_BIT(inst.state, OBJECT_STATE_CULLED);
+				SET_BIT(inst.state, OBJECT_STATE_TINY);
+				continue;
+			} // end if
+		} // end if
+
+		_inst_visible[num_visible++] = index;
+	} // end for index
+
+	if (num_visible == 0)
+		return(0);
+
+	// step 2: place the vertices of the visible instances, in indexed mode
+	// they go straight into the pool, else into the scratch the polygons
+	// copy them from
+	int total_verts = num_visible * num_verts;
+
+	Vertex* world;
+	int base_vert = -1;
+
+	bool indexed = (_attr & RENDERLIST_ATTR_INDEXED) && 
+		GrowVerts(_num_verts + total_verts);
+
+	if (indexed)
+	{
+		base_vert = _num_verts;
+		world = &_vert_trans[base_vert];
+	} 
+	else
+	{
+		if (!GrowInstances(num_visible, total_verts))
+			return(0);
+
+		world = _inst_verts;
+	} // end else
+
+	InstanceJob job(mesh, instances, _inst_visible, world);
+
+	Modules::GetJobs().ParallelFor(total_verts, VERT_JOB_SIZE, this, 
+		&RenderList::PlaceInstanceVerts, job);
+
+	if (indexed)
+	{
+		memcpy((void *)&_vert_local[base_vert], (void *)world, total_verts*sizeof(Vertex));
+
+		_num_verts += total_verts;
+
+		// the polygons tvlist[] have to be refreshed from the pool
+		_verts_gathered = false;
+	} // end if
+
+	// step 3: insert the polygons facing the viewer
+	for (int visible = 0; visible < num_visible; visible++)
+	{
+		const MeshInstance& inst = instances[_inst_visible[visible]];
+
+		// the local vertices go to the world as p*mrot + pos, so the
+		// camera comes back as (cam - pos)*transpose(mrot)
+		const mat4& m = inst.mrot;
+		vec4 d = cam.Pos() - inst.pos;
+		vec4 view;
+
+		view.x = d.x * m.c[0][0] + d.y * m.c[0][1] + d.z * m.c[0][2];
+		view.y = d.x * m.c[1][0] + d.y * m.c[1][1] + d.z * m.c[1][2];
+		view.z = d.x * m.c[2][0] + d.y * m.c[2][1] + d.z * m.c[2][2];
+		view.w = 1;
+
+		if (!InsertInstancePolys(mesh, inst, view, &world[visible*num_verts], 
+				indexed ? base_vert + visible*num_verts : -1))
+			return(visible);
+	} // end for visible
+
+	return(num_visible);
+}
+
+bool RenderList::InsertInstancePolys(const RenderObject& mesh, const MeshInstance& inst,
+									 const vec4& view, const Vertex* world, int base_vert)
+{
+	// inserts the polygons of the mesh for one instance, the backface test
+	// is RenderObject::RemoveBackfacesLocal() with the planes of the mesh
+	// if they are current for the frame, else with the normal taken from
+	// the local vertices of the frame, so nothing per instance is kept
+
+	const Vertex* local = &mesh._head_vlist_local[inst.frame * mesh._num_vertices];
+
+	const vec4* planes = (mesh._local_planes && 
+		mesh._planes_version == mesh._local_version && 
+		mesh._planes_frame == inst.frame) ? mesh._local_planes : NULL;
+
+	bool indexed = base_vert >= 0;
+
+	for (int poly = 0; poly < mesh._num_polys; poly++)
+	{
+		// acquire polygon
+		const Polygon* curr_poly = &mesh._plist[poly];
+
+		// the clipped and backface flags belong to the mesh drawn as an
+		// object, the instances have their own
+		if (!(curr_poly->state & POLY_STATE_ACTIVE))
+			continue;
+
+		int vindex_0 = curr_poly->vert[0];
+		int vindex_1 = curr_poly->vert[1];
+		int vindex_2 = curr_poly->vert[2];
+
+		// n.(view - p0) <= 0 is a backface, with n.p0 precomputed
+		if (!(curr_poly->attr & POLY_ATTR_2SIDED))
+		{
+			if (planes)
+			{
+				const vec4& plane = planes[poly];
+
+				if (plane.x * view.x + plane.y * view.y + plane.z * view.z - plane.w <= 0.0f)
+					continue;
+			} // end if
+			else
+			{
+				vec4 u = local[vindex_1].v - local[vindex_0].v;
+				vec4 v = local[vindex_2].v - local[vindex_0].v;
+				vec4 n = u.Cross(v);
+
+				if (n.Dot(view - local[vindex_0].v) <= 0.0f)
+					continue;
+			} // end else
+		} // end if
+
+		// get the next opening in the render list
+		PolygonF* face = AllocPoly();
+		if (!face)
+			return false;
+
+		// copy fields, the lighting of the mesh isn't the one of the
+		// instance, so it's lit again
+		face->state		= curr_poly->state & ~(POLY_STATE_CLIPPED | POLY_STATE_BACKFACE | POLY_STATE_LIT);
+		face->attr		= curr_poly->attr;
+		face->color		= (inst.attr & INSTANCE_ATTR_COLOR) ? inst.color : curr_poly->color;
+		face->nlength	= curr_poly->nlength;
+		face->texture	= curr_poly->texture;
+		face->mati		= curr_poly->mati;
+
+		if (indexed)
+			SET_BIT(face->state, POLY_STATE_INDEXED);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			// poly could be lit, so copy these too...
+			face->lit_color[i] = (inst.attr & INSTANCE_ATTR_COLOR) ? inst.color : curr_poly->lit_color[i];
+
+			// the vertices are referenced from the pool or copied
+			if (indexed)
+				face->vert[i] = base_vert + curr_poly->vert[i];
+			else
+			{
+				face->tvlist[i] = world[curr_poly->vert[i]];
+				face->vlist[i]  = world[curr_poly->vert[i]];
+			} // end else
+
+			// and the texture coordinates are copied as usual
+			face->tvlist[i].t = curr_poly->tlist[curr_poly->text[i]];
+			face->vlist[i].t  = curr_poly->tlist[curr_poly->text[i]];
+		} // end for i
+
+		// fix up the links
+		if (_num_polys == 0)
+		{
+			face->next = NULL;
+			face->prev = NULL;
+		}
+		else
+		{
+			face->next = NULL;
+			face->prev = PolySlot(_num_polys-1);
+
+			face->prev->next = face;
+		}
+
+		// increment number of polys in list
+		_num_polys++;
+	} // end for poly
+
+	return true;
+}
+
+void RenderList::PlaceInstanceVerts(const InstanceJob& job, int start, int end)
+{
+	// places the vertices [start, end) of the visible instances one after
+	// the other, local*mrot + pos, the normals are rotated only
+
+	const RenderObject& mesh = job.mesh;
+	int num_verts = mesh._num_vertices;
+
+	int visible = start / num_verts;
+	int vertex = start - visible*num_verts;
+
+	for (int dst = start; dst < end; visible++, vertex = 0)
+	{
+		const MeshInstance& inst = job.instances[job.visible[visible]];
+		const Vertex* src = &mesh._head_vlist_local[inst.frame * num_verts];
+		const mat4& mt = inst.mrot;
+
+		// the rest of this instance in the range
+		int last = num_verts - vertex;
+		if (last > end - dst)
+			last = end - dst;
+		last += vertex;
+
+		for (; vertex < last; vertex++, dst++)
+		{
+			Vertex& out = job.dst[dst];
+
+			out = src[vertex];
+			out.v = mt * src[vertex].v + inst.pos;
+
+			if (src[vertex].attr & VERTEX_ATTR_NORMAL)
+				out.n = mt * src[vertex].n;
+		} // end for vertex
+	} // end for dst
+}
+
+bool RenderList::Append(const RenderList& list)
+{
+	// appends all the polygons of the sent list to this one in the same
+	// order, the indexed polygons bring their pool vertices along and get
+	// their indices moved past the vertices already in the pool, this is
+	// the merge step of the lists filled in parallel by RenderSegments
+
+	int base = _num_verts;
+
+	if (list._num_verts > 0)
+	{
+		if (!GrowVerts(_num_verts + list._num_verts))
+			return false;
+
+		memcpy(_vert_local + base, list._vert_local, list._num_verts*sizeof(Vertex));
+		memcpy(_vert_trans + base, list._vert_trans, list._num_verts*sizeof(Vertex));
+
+		_num_verts += list._num_verts;
+		_verts_gathered = false;
+	} // end if
+
+	for (int poly = 0; poly < list._num_polys; poly++)
+	{
+		const PolygonF* curr_poly = list._poly_ptrs[poly];
+
+		if (!Insert(*curr_poly))
+			return false;
+
+		if (curr_poly->state & POLY_STATE_INDEXED)
+		{
+			PolygonF* face = _poly_ptrs[_num_polys-1];
+
+			face->vert[0] += base;
+			face->vert[1] += base;
+			face->vert[2] += base;
+		} // end if
+	} // end for poly
+
+	return true;
+}
+
+void RenderList::MarkIndexedVerts(bool unlit_gouraud_only)
+{
+	// this function flags every vertex in the pool that is referenced by
+	// an indexed polygon which is still alive, so the vertex stages don't
+	// waste time on vertices that only belong to backfaces or clipped polygons
+	// if unlit_gouraud_only is set then only the vertices of gouraud polygons
+	// that still have to be lit are flagged
+
+	memset(_vert_mark, 0, _num_verts*sizeof(unsigned char));
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		// acquire current polygon
+		PolygonF* curr_poly = _poly_ptrs[poly];
+
+		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_INDEXED) ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
+
+		if (unlit_gouraud_only && 
+			((curr_poly->state & POLY_STATE_LIT) ||
+			 (curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT) ||
+			!(curr_poly->attr & POLY_ATTR_SHADE_MODE_GOURAUD)) )
+			continue;
+
+		_vert_mark[curr_poly->vert[0]] = 1;
+		_vert_mark[curr_poly->vert[1]] = 1;
+		_vert_mark[curr_poly->vert[2]] = 1;
+	} // end for poly
+}
+
+void RenderList::GatherIndexedVerts()
+{
+	// this function copies the shared vertices back into the tvlist[] of
+	// each indexed polygon, this way the stages that work per polygon such 
+	// as backface removal, clipping, flat shading, sorting and the rasterizers
+	// don't need to know anything about the pool, only the position and 
+	// normal are copied, the texture coordinates are owned by the polygon
+
+	// nothing changed since the last time?
+	if (_verts_gathered)
+		return;
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		// acquire current polygon
+		PolygonF* curr_poly = _poly_ptrs[poly];
+
+		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_INDEXED) ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
+
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const Vertex& vtx = _vert_trans[curr_poly->vert[vertex]];
+
+			curr_poly->tvlist[vertex].v = vtx.v;
+			curr_poly->tvlist[vertex].n = vtx.n;
+		} // end for vertex
+	} // end for poly
+
+	_verts_gathered = true;
+}
+
 void RenderList::Transform(const mat4& mt, int coord_select)
 {
 	// this function simply transforms all of the polygons vertices in the local or trans
-	// array of the render list by the sent matrix
+	// array of the render list by the sent matrix, the indexed polygons are skipped
+	// and their shared vertices in the pool are transformed instead, once each
+	// the polygons don't depend on each other, so the list and the pool are split
+	// in chunks and transformed on all the threads of the job system
+
+	// flag the pool vertices still in use
+	if (_num_verts > 0)
+		MarkIndexedVerts();
+
+	TransformJob job(mt, coord_select);
+
+	JobSystem& jobs = Modules::GetJobs();
+	jobs.ParallelFor(_num_polys, POLY_JOB_SIZE, this, &RenderList::TransformPolys, job);
+	jobs.ParallelFor(_num_verts, VERT_JOB_SIZE, this, &RenderList::TransformVerts, job);
+
+	if (coord_select != TRANSFORM_LOCAL_ONLY)
+		_verts_gathered = false;
+}
+
+void RenderList::TransformPolys(const TransformJob& job, int start, int end)
+{
+	// transforms the polygons [start, end) of the list, see Transform()
+
+	const mat4& mt = job.mt;
 
 	// what coordinates should be transformed?
-	switch(coord_select)
+	switch(job.coord_select)
 	{
 	case TRANSFORM_LOCAL_ONLY:
 		{
-			for (int poly = 0; poly < _num_polys; poly++)
+			for (int poly = start; poly < end; poly++)
 			{
 				// acquire current polygon
 				PolygonF* curr_poly = _poly_ptrs[poly];
@@ -206,7 +1022,8 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 				// transform this polygon if and only if it's not clipped, not culled,
 				// active, and visible, note however the concept of "backface" is 
 				// irrelevant in a wire frame engine though
-				if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+				if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+					!(curr_poly->state & POLY_STATE_ACTIVE) ||
 					(curr_poly->state & POLY_STATE_CLIPPED ) ||
 					(curr_poly->state & POLY_STATE_BACKFACE) )
 					continue; // move onto next poly
@@ -234,7 +1051,7 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 			// transform each "transformed" vertex of the render list
 			// remember, the idea of the tvlist[] array is to accumulate
 			// transformations
-			for (int poly = 0; poly < _num_polys; poly++)
+			for (int poly = start; poly < end; poly++)
 			{
 				// acquire current polygon
 				PolygonF* curr_poly = _poly_ptrs[poly];
@@ -243,7 +1060,8 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 				// transform this polygon if and only if it's not clipped, not culled,
 				// active, and visible, note however the concept of "backface" is 
 				// irrelevant in a wire frame engine though
-				if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+				if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+					!(curr_poly->state & POLY_STATE_ACTIVE) ||
 					(curr_poly->state & POLY_STATE_CLIPPED ) ||
 					(curr_poly->state & POLY_STATE_BACKFACE) )
 					continue; // move onto next poly
@@ -269,7 +1087,7 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 		{
 			// transform each local/model vertex of the render list and store result
 			// in "transformed" vertex list
-			for (int poly = 0; poly < _num_polys; poly++)
+			for (int poly = start; poly < end; poly++)
 			{
 				// acquire current polygon
 				PolygonF* curr_poly = _poly_ptrs[poly];
@@ -278,7 +1096,8 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 				// transform this polygon if and only if it's not clipped, not culled,
 				// active, and visible, note however the concept of "backface" is 
 				// irrelevant in a wire frame engine though
-				if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+				if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+					!(curr_poly->state & POLY_STATE_ACTIVE) ||
 					(curr_poly->state & POLY_STATE_CLIPPED ) ||
 					(curr_poly->state & POLY_STATE_BACKFACE) )
 					continue; // move onto next poly
@@ -297,6 +1116,46 @@ void RenderList::Transform(const mat4& mt, int coord_select)
 	} // end switch	
 }
 
+void RenderList::TransformVerts(const TransformJob& job, int start, int end)
+{
+	// transforms the flagged pool vertices [start, end), see Transform()
+
+	const mat4& mt = job.mt;
+
+	switch(job.coord_select)
+	{
+	case TRANSFORM_LOCAL_ONLY:
+		{
+			for (int vertex = start; vertex < end; vertex++)
+			{
+				if (_vert_mark[vertex])
+					_vert_local[vertex].v = mt * _vert_local[vertex].v;
+			} // end for vertex
+		} break;
+
+	case TRANSFORM_TRANS_ONLY:
+		{
+			for (int vertex = start; vertex < end; vertex++)
+			{
+				if (_vert_mark[vertex])
+					_vert_trans[vertex].v = mt * _vert_trans[vertex].v;
+			} // end for vertex
+		} break;
+
+	case TRANSFORM_LOCAL_TO_TRANS:
+		{
+			for (int vertex = start; vertex < end; vertex++)
+			{
+				if (_vert_mark[vertex])
+					_vert_trans[vertex].v = mt * _vert_local[vertex].v;
+			} // end for vertex
+		} break;
+
+	default: break;
+
+	} // end switch
+}
+
 void RenderList::ModelToWorld(const vec4& world_pos, 
 							  int coord_select)
 {
@@ -310,6 +1169,10 @@ void RenderList::ModelToWorld(const vec4& world_pos,
 	// the amount world_pos and storing the results in tvlist[]
 	// is this polygon valid?
 
+	// flag the pool vertices still in use
+	if (_num_verts > 0)
+		MarkIndexedVerts();
+
 	if (coord_select == TRANSFORM_LOCAL_TO_TRANS)
 	{
 		for (int poly = 0; poly < _num_polys; poly++)
@@ -320,7 +1183,8 @@ void RenderList::ModelToWorld(const vec4& world_pos,
 			// transform this polygon if and only if it's not clipped, not culled,
 			// active, and visible, note however the concept of "backface" is 
 			// irrelevant in a wire frame engine though
-			if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+			if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+				!(curr_poly->state & POLY_STATE_ACTIVE) ||
 				(curr_poly->state & POLY_STATE_CLIPPED ) ||
 				(curr_poly->state & POLY_STATE_BACKFACE) )
 				continue; // move onto next poly
@@ -330,6 +1194,13 @@ void RenderList::ModelToWorld(const vec4& world_pos,
 				curr_poly->tvlist[vertex].v = curr_poly->vlist[vertex].v + world_pos;
 
 		} // end for poly
+
+		// now the shared vertices
+		for (int vertex = 0; vertex < _num_verts; vertex++)
+		{
+			if (_vert_mark[vertex])
+				_vert_trans[vertex].v = _vert_local[vertex].v + world_pos;
+		} // end for vertex
 	} // end if local
 	else // TRANSFORM_TRANS_ONLY
 	{
@@ -341,7 +1212,8 @@ void RenderList::ModelToWorld(const vec4& world_pos,
 			// transform this polygon if and only if it's not clipped, not culled,
 			// active, and visible, note however the concept of "backface" is 
 			// irrelevant in a wire frame engine though
-			if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+			if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+				!(curr_poly->state & POLY_STATE_ACTIVE) ||
 				(curr_poly->state & POLY_STATE_CLIPPED ) ||
 				(curr_poly->state & POLY_STATE_BACKFACE) )
 				continue; // move onto next poly
@@ -351,7 +1223,16 @@ void RenderList::ModelToWorld(const vec4& world_pos,
 
 		} // end for poly
 
+		// now the shared vertices
+		for (int vertex = 0; vertex < _num_verts; vertex++)
+		{
+			if (_vert_mark[vertex])
+				_vert_trans[vertex].v = _vert_trans[vertex].v + world_pos;
+		} // end for vertex
+
 	} // end else	
+
+	_verts_gathered = false;
 }
 
 void RenderList::RemoveBackfaces(const Camera& cam)
@@ -362,7 +1243,19 @@ void RenderList::RemoveBackfaces(const Camera& cam)
 	// tvlist along with the camera position (only)
 	// note that only the backface state is set in each polygon
 
-	for (int poly = 0; poly < _num_polys; poly++)
+	// the indexed polygons need their vertices
+	GatherIndexedVerts();
+
+	// each polygon is tested on its own, so split the list over the threads
+	Modules::GetJobs().ParallelFor(_num_polys, POLY_JOB_SIZE, this, 
+		&RenderList::RemoveBackfacesPolys, cam);
+}
+
+void RenderList::RemoveBackfacesPolys(const Camera& cam, int start, int end)
+{
+	// removes the backfaces of the polygons [start, end), see RemoveBackfaces()
+
+	for (int poly = start; poly < end; poly++)
 	{
 		// acquire current polygon
 		PolygonF* curr_poly = _poly_ptrs[poly];
@@ -425,31 +1318,22 @@ void RenderList::WorldToCamera(const Camera& cam)
 	// assumes the render list has already been transformed to world
 	// coordinates and the result is in tvlist[] of each polygon object
 
-	for (int poly = 0; poly < _num_polys; poly++)
-	{
-		// acquire current polygon
-		PolygonF* curr_poly = _poly_ptrs[poly];
+	// this is the same as transforming the trans coordinates by the camera
+	// matrix, so the chunks are handed to the same functions as Transform()
 
-		// is this polygon valid?
-		// transform this polygon if and only if it's not clipped, not culled,
-		// active, and visible, note however the concept of "backface" is 
-		// irrelevant in a wire frame engine though
-		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
-			(curr_poly->state & POLY_STATE_CLIPPED ) ||
-			(curr_poly->state & POLY_STATE_BACKFACE) )
-			continue; // move onto next poly
+	// flag the pool vertices still in use
+	if (_num_verts > 0)
+		MarkIndexedVerts();
 
-		// all good, let's transform 
-		for (int vertex = 0; vertex < 3; vertex++)
-		{
-			// transform the vertex by the mcam matrix within the camera
-			// it better be valid!
-			// transform point
-			curr_poly->tvlist[vertex].v = cam.CameraMat() * curr_poly->tvlist[vertex].v;
+	TransformJob job(cam.CameraMat(), TRANSFORM_TRANS_ONLY);
 
-		} // end for vertex
+	JobSystem& jobs = Modules::GetJobs();
+	jobs.ParallelFor(_num_polys, POLY_JOB_SIZE, this, &RenderList::TransformPolys, job);
+	jobs.ParallelFor(_num_verts, VERT_JOB_SIZE, this, &RenderList::TransformVerts, job);
 
-	} // end for poly
+	_verts_gathered = false;
+
+	SET_BIT(_state, RENDERLIST_STATE_CAMERA);
 }
 
 void RenderList::CameraToPerspective(const Camera& cam)
@@ -475,7 +1359,8 @@ void RenderList::CameraToPerspective(const Camera& cam)
 		// transform this polygon if and only if it's not clipped, not culled,
 		// active, and visible, note however the concept of "backface" is 
 		// irrelevant in a wire frame engine though
-		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+		if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
 			(curr_poly->state & POLY_STATE_CLIPPED ) ||
 			(curr_poly->state & POLY_STATE_BACKFACE) )
 			continue; // move onto next poly
@@ -496,6 +1381,25 @@ void RenderList::CameraToPerspective(const Camera& cam)
 		} // end for vertex
 
 	} // end for poly
+
+	// now the shared vertices of the indexed polygons, each one only once
+	if (_num_verts > 0)
+	{
+		MarkIndexedVerts();
+
+		for (int vertex = 0; vertex < _num_verts; vertex++)
+		{
+			if (!_vert_mark[vertex])
+				continue;
+
+			float z = _vert_trans[vertex].z;
+
+			_vert_trans[vertex].x = cam.ViewDist()*_vert_trans[vertex].x/z;
+			_vert_trans[vertex].y = cam.ViewDist()*_vert_trans[vertex].y*cam.AspectRatio()/z;
+		} // end for vertex
+
+		_verts_gathered = false;
+	}
 }
 
 void RenderList::PerspectiveToScreen(const Camera& cam)
@@ -522,7 +1426,8 @@ void RenderList::PerspectiveToScreen(const Camera& cam)
 		// transform this polygon if and only if it's not clipped, not culled,
 		// active, and visible, note however the concept of "backface" is 
 		// irrelevant in a wire frame engine though
-		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+		if ((curr_poly==NULL) || (curr_poly->state & POLY_STATE_INDEXED) ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
 			(curr_poly->state & POLY_STATE_CLIPPED ) ||
 			(curr_poly->state & POLY_STATE_BACKFACE) )
 			continue; // move onto next poly
@@ -543,6 +1448,26 @@ void RenderList::PerspectiveToScreen(const Camera& cam)
 		} // end for vertex
 
 	} // end for poly
+
+	// now the shared vertices of the indexed polygons, each one only once
+	if (_num_verts > 0)
+	{
+		float alpha = (0.5*cam.ViewportWidth()-0.5);
+		float beta  = (0.5*cam.ViewportHeight()-0.5);
+
+		MarkIndexedVerts();
+
+		for (int vertex = 0; vertex < _num_verts; vertex++)
+		{
+			if (!_vert_mark[vertex])
+				continue;
+
+			_vert_trans[vertex].x = alpha + alpha*_vert_trans[vertex].x;
+			_vert_trans[vertex].y = beta  - beta *_vert_trans[vertex].y;
+		} // end for vertex
+
+		_verts_gathered = false;
+	}
 }
 
 void RenderList::Reset()
@@ -558,7 +1483,37 @@ void RenderList::Reset()
 	// but later we will want a more robust scheme if
 	// we generalize the linked list more and disconnect
 	// it from the polygon pointer list
+	// keep track of the high water marks before forgetting the frame, the
+	// memory itself is kept and reused by the next frame
+	if (_num_polys > _poly_high_water)
+		_poly_high_water = _num_polys;
+
+	if (_num_verts > _vert_high_water)
+		_vert_high_water = _num_verts;
+
 	_num_polys = 0; // that was hard!	
+
+	// and empty the vertex pool of the indexed polygons
+	_num_verts = 0;
+	_verts_gathered = true;
+
+	_state = 0;
+
+	_phong_updated = false;
+	_phong_lit = false;
+}
+
+// copies what the fast phong rasterizers need into the temp face, the 
+// whole vertices since the normals are interpolated as well
+static void LoadPhongFace(const PolygonF* poly, PolygonF& face)
+{
+	for (int vertex = 0; vertex < 3; vertex++)
+	{
+		face.tvlist[vertex]    = poly->tvlist[vertex];
+		face.lit_color[vertex] = poly->lit_color[vertex];
+	} // end for vertex
+
+	face.color = poly->color;
 }
 
 void RenderList::DrawContext(const RenderContext& rc)
@@ -570,6 +1525,9 @@ void RenderList::DrawContext(const RenderContext& rc)
 	// we have written thus far, so its rather long, but better than having 
 	// 20-30 rendering functions for all possible permutations!
 
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	PolygonF face; // temp face used to render polygon
 	int alpha;      // alpha of the face
 
@@ -1025,6 +1983,35 @@ void RenderList::DrawContext(const RenderContext& rc)
 			   } // end if
 
 		   } // end if gouraud
+		else
+		if (_poly_ptrs[poly]->attr & POLY_ATTR_SHADE_MODE_PHONG)
+		   {
+			// the whole vertices are needed, the normals are interpolated too
+			LoadPhongFace(_poly_ptrs[poly], face);
+
+			const NormalLightTable* table = PhongTable();
+
+			// draw the fast phong shaded triangle
+			// test for transparency
+			if (!table)
+			   {
+			   // no table, the point lights still show
+			   DrawGouraudTriangle32(&face, rc.video_buffer, rc.lpitch);
+			   } // end if
+			else
+			if ((rc.attr & RENDER_ATTR_ALPHA) &&
+				  ((_poly_ptrs[poly]->attr & POLY_ATTR_TRANSPARENT) || rc.alpha_override>=0) )
+			   {
+			   // alpha version
+			   DrawPhongTriangleAlpha32(&face, *table, rc.video_buffer, rc.lpitch,alpha);
+			   } // end if
+			else
+			   { 
+			   // non alpha
+			   DrawPhongTriangle32(&face, *table, rc.video_buffer, rc.lpitch);
+			   } // end if
+
+		   } // end if phong
 
 		} // end for poly
 
@@ -1482,6 +2469,35 @@ void RenderList::DrawContext(const RenderContext& rc)
 			   } // end if
 
 		   } // end if gouraud
+		else
+		if (_poly_ptrs[poly]->attr & POLY_ATTR_SHADE_MODE_PHONG)
+		   {
+			// the whole vertices are needed, the normals are interpolated too
+			LoadPhongFace(_poly_ptrs[poly], face);
+
+			const NormalLightTable* table = PhongTable();
+
+			// draw the fast phong shaded triangle
+			// test for transparency
+			if (!table)
+			   {
+			   // no table, the point lights still show
+			   DrawGouraudTriangleZB32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+			   } // end if
+			else
+			if ((rc.attr & RENDER_ATTR_ALPHA) &&
+				  ((_poly_ptrs[poly]->attr & POLY_ATTR_TRANSPARENT) || rc.alpha_override>=0) )
+			   {
+			   // alpha version
+			   DrawPhongTriangleZBAlpha32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch,alpha);
+			   } // end if
+			else
+			   { 
+			   // non alpha
+			   DrawPhongTriangleZB32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+			   } // end if
+
+		   } // end if phong
 
 		} // end for poly
 
@@ -1907,26 +2923,55 @@ void RenderList::DrawContext(const RenderContext& rc)
 			face.tvlist[1].z  = (float)_poly_ptrs[poly]->tvlist[1].z;
 			face.lit_color[1] = _poly_ptrs[poly]->lit_color[1];
 
-			face.tvlist[2].x  = (float)_poly_ptrs[poly]->tvlist[2].x;
-			face.tvlist[2].y  = (float)_poly_ptrs[poly]->tvlist[2].y;
-			face.tvlist[2].z  = (float)_poly_ptrs[poly]->tvlist[2].z;
-			face.lit_color[2] = _poly_ptrs[poly]->lit_color[2];
+			face.tvlist[2].x  = (float)_poly_ptrs[poly]->tvlist[2].x;
+			face.tvlist[2].y  = (float)_poly_ptrs[poly]->tvlist[2].y;
+			face.tvlist[2].z  = (float)_poly_ptrs[poly]->tvlist[2].z;
+			face.lit_color[2] = _poly_ptrs[poly]->lit_color[2];
+
+			// draw the gouraud shaded triangle
+			// test for transparency
+			if ((rc.attr & RENDER_ATTR_ALPHA) &&
+				  ((_poly_ptrs[poly]->attr & POLY_ATTR_TRANSPARENT) || rc.alpha_override>=0) )
+			   {
+			   // alpha version
+			   DrawGouraudTriangleINVZBAlpha32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch,alpha);
+			   } // end if
+			else
+			   { 
+			   // non alpha
+			   DrawGouraudTriangleINVZB32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+			   } // end if
+
+		   } // end if gouraud
+		else
+		if (_poly_ptrs[poly]->attr & POLY_ATTR_SHADE_MODE_PHONG)
+		   {
+			// the whole vertices are needed, the normals are interpolated too
+			LoadPhongFace(_poly_ptrs[poly], face);
 
-			// draw the gouraud shaded triangle
+			const NormalLightTable* table = PhongTable();
+
+			// draw the fast phong shaded triangle
 			// test for transparency
+			if (!table)
+			   {
+			   // no table, the point lights still show
+			   DrawGouraudTriangleINVZB32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+			   } // end if
+			else
 			if ((rc.attr & RENDER_ATTR_ALPHA) &&
 				  ((_poly_ptrs[poly]->attr & POLY_ATTR_TRANSPARENT) || rc.alpha_override>=0) )
 			   {
 			   // alpha version
-			   DrawGouraudTriangleINVZBAlpha32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch,alpha);
+			   DrawPhongTriangleINVZBAlpha32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch,alpha);
 			   } // end if
 			else
 			   { 
 			   // non alpha
-			   DrawGouraudTriangleINVZB32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+			   DrawPhongTriangleINVZB32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
 			   } // end if
 
-		   } // end if gouraud
+		   } // end if phong
 
 		} // end for poly
 
@@ -2383,6 +3428,35 @@ if (rc.attr & RENDER_ATTR_WRITETHRUZBUFFER) ////////////////////////////////////
 					} // end if
 
 				} // end if gouraud
+				else
+				if (_poly_ptrs[poly]->attr & POLY_ATTR_SHADE_MODE_PHONG)
+				   {
+					// the whole vertices are needed, the normals are interpolated too
+					LoadPhongFace(_poly_ptrs[poly], face);
+
+					const NormalLightTable* table = PhongTable();
+
+					// draw the fast phong shaded triangle
+					// test for transparency
+					if (!table)
+					   {
+					   // no table, the point lights still show
+					   DrawGouraudTriangleWTZB32(&face, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+					   } // end if
+					else
+					if ((rc.attr & RENDER_ATTR_ALPHA) &&
+						  ((_poly_ptrs[poly]->attr & POLY_ATTR_TRANSPARENT) || rc.alpha_override>=0) )
+					   {
+					   // alpha version
+					   DrawPhongTriangleZBAlpha32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch,alpha);
+					   } // end if
+					else
+					   { 
+					   // non alpha
+					   DrawPhongTriangleWTZB32(&face, *table, rc.video_buffer, rc.lpitch,rc.zbuffer,rc.zpitch);
+					   } // end if
+
+				   } // end if phong
 
 	} // end for poly
 
@@ -2401,6 +3475,9 @@ void RenderList::DrawHybridTexturedSolidINVZB32(unsigned char* video_buffer, int
 	// will be affine
 
 
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	PolygonF face; // temp face used to render polygon
 
 	// at this point, all we have is a list of polygons and it's time
@@ -2558,7 +3635,74 @@ void RenderList::DrawHybridTexturedSolidINVZB32(unsigned char* video_buffer, int
 	} // end for poly
 }
 
+void RenderList::DrawGBuffer(const Camera& cam, GBuffer& gbuffer)
+{
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
+	const mat4& mcam = cam.CameraMat();
+
+	PolygonF face; // temp face used to render polygon
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		const PolygonF* curr_poly = _poly_ptrs[poly];
+
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			 (curr_poly->state & POLY_STATE_CLIPPED ) ||
+			 (curr_poly->state & POLY_STATE_BACKFACE) ||
+			 (curr_poly->attr & POLY_ATTR_TRANSPARENT) )
+		   continue; // move onto next poly
+
+		LoadPhongFace(curr_poly, face);
+
+		if (curr_poly->attr & (POLY_ATTR_SHADE_MODE_GOURAUD | POLY_ATTR_SHADE_MODE_PHONG))
+		{
+			// the normals of the list stay in world space, the lights
+			// are shaded in camera space
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				vec4 n(face.tvlist[vertex].nx, face.tvlist[vertex].ny, face.tvlist[vertex].nz, 0);
+				face.tvlist[vertex].n = mcam * n;
+			} // end for vertex
+		} // end if
+		else
+		{
+			// no vertex normals, a black albedo leaves it unlit
+			face.color = 0;
+		} // end else
+
+		DrawGBufferTriangle32(&face, gbuffer.Albedo(), gbuffer.AlbedoPitch(),
+			gbuffer.Normal(), gbuffer.NormalPitch(), gbuffer.Depth(), gbuffer.DepthPitch());
+	} // end for poly
+}
+
+void RenderList::DrawDepth(unsigned char* zbuffer, int zpitch, int width, int height)
+{
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		PolygonF* curr_poly = _poly_ptrs[poly];
+
+		// the backfaces cast shadows too, unless they were removed
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			 (curr_poly->state & POLY_STATE_CLIPPED ) ||
+			 (curr_poly->state & POLY_STATE_BACKFACE) )
+		   continue; // move onto next poly
+
+		DrawDepthTriangle32(curr_poly, zbuffer, zpitch, width, height);
+	} // end for poly
+}
+
 void RenderList::LightWorld32(const Camera& cam)
+{
+	// lights the list with the lights of the graphics module
+	LightWorld32(cam, Modules::GetGraphics().GetLights());
+}
+
+void RenderList::LightWorld32(const Camera& cam, const LightsMgr& lights)
 {
 	// 32-bit version of function
 	// function lights the entire rendering list based on the sent lights and camera. the function supports
@@ -2574,14 +3718,89 @@ void RenderList::LightWorld32(const Camera& cam)
 	// that is used for a concentration control must be 1,2,3,.... integral and non-fractional
 	// this function now performs emissive, flat, and gouraud lighting, results are stored in the 
 	// lit_color[] array of each polygon
+	// the lights are passed in, so a snapshot of them can be used while the
+	// game keeps changing its own, see FramePipeline
+
+	// the vertex lighting is done with SIMD against a structure of arrays 
+	// copy of the active lights, built once here for the whole list
+	LightsSoA soa;
+	soa.Build(lights);
+
+	// the specular term needs the viewer, it's at the origin once the 
+	// list is in camera space
+	vec4 view_pos = (_state & RENDERLIST_STATE_CAMERA) ? vec4(0, 0, 0, 1) : cam.Pos();
+
+	// the indexed gouraud polygons get their vertices lit once in the pool, 
+	// the rest of the indexed polygons are lit below like any other
+	if (_num_verts > 0)
+	{
+		GatherIndexedVerts();
+		LightIndexedVerts(soa, view_pos);
+	}
+
+	// the polygons are lit independently, so the list is split in chunks
+	// and lit on all the threads of the job system
+	_phong_polys = 0;
+
+	Modules::GetJobs().ParallelFor(_num_polys, POLY_JOB_SIZE, this, 
+		&RenderList::LightPolys32, LightJob(lights, soa, view_pos));
+
+	// the phong polygons get the directional lights per pixel from the 
+	// table, the lights are kept in case the table is first needed when 
+	// drawing, by then the sent lights may be changing
+	if (!_phong_lights)
+		_phong_lights = new LightsSoA;
+
+	_phong_lights->SelectDirectional(soa);
+	_phong_lit = true;
+
+	if (_phong_polys > 0)
+		UpdatePhongTable(*_phong_lights);
+}
+
+void RenderList::UpdatePhongTable(const LightsSoA& soa)
+{
+	if (!_phong_table)
+		_phong_table = new NormalLightTable;
+
+	if (!_phong_table->Build(soa))
+		Modules::GetLog().WriteError("\nRenderList::UpdatePhongTable: out of memory for the normal table");
+
+	_phong_updated = true;
+}
+
+const NormalLightTable* RenderList::PhongTable()
+{
+	if (!_phong_updated)
+	{
+		if (_phong_lit)
+		{
+			// the snapshot the list was lit with, see FramePipeline
+			UpdatePhongTable(*_phong_lights);
+		} // end if
+		else
+		{
+			// the objects lit their polygons with the lights of the 
+			// graphics module
+			LightsSoA soa;
+			soa.Build(Modules::GetGraphics().GetLights());
+
+			UpdatePhongTable(soa);
+		} // end else
+	} // end if
+
+	return _phong_table->IsBuilt() ? _phong_table : NULL;
+}
+
+void RenderList::LightPolys32(const LightJob& job, int start, int end)
+{
+	// lights the polygons [start, end) of the list, see LightWorld32()
+
+	const LightsMgr& lights = job.lights;
 
 	unsigned int tmpa;
 	unsigned int r_base, g_base, b_base,  // base color being lit
 				 r_sum,  g_sum,  b_sum,   // sum of lighting process over all lights
-				 r_sum0,  g_sum0,  b_sum0,
-				 r_sum1,  g_sum1,  b_sum1,
-				 r_sum2,  g_sum2,  b_sum2,
-				 ri,gi,bi,
 				 shaded_color;            // final color
 
 	float dp,     // dot product 
@@ -2593,11 +3812,36 @@ void RenderList::LightWorld32(const Camera& cam)
 
 	vec4 u, v, n, l, d, s; // used for cross product and light vector calculations
 
+#ifdef DEBUG_ON
+	// the stats are counted locally and added once at the end, since
+	// the other threads are updating them too
+	int polys_lit = 0;
+#endif
+
+	// the lights out of reach of a block of polygons are dropped 
+	// before the gouraud shader walks them, and marked by their index so
+	// the flat shader skips them too
+	LightsSoA block_lights;
+	bool block_marks[LightsMgr::MAX_LIGHTS];
+
+	// and the phong polygons only light the point and spot lights of them
+	LightsSoA local_lights;
+	int local_block = -1;
+	int phong_polys = 0;
+
+	const MaterialsMgr& materials = Modules::GetGraphics().GetMaterials();
+
 	//Write_Error("\nEntering lighting function");
 
 	// for each valid poly, light it...
-	for (int poly=0; poly < _num_polys; poly++)
+	for (int poly=start; poly < end; poly++)
 	{
+		if ((poly - start) % POLY_LIGHT_BLOCK == 0)
+		{
+			SelectPolyLights(job.soa, poly, min(poly + POLY_LIGHT_BLOCK, end), block_lights);
+			block_lights.Mark(block_marks);
+		} // end if
+
 		// acquire polygon
 		PolygonF* curr_poly = _poly_ptrs[poly];
 
@@ -2613,7 +3857,7 @@ void RenderList::LightWorld32(const Camera& cam)
 
 #ifdef DEBUG_ON
 		// track rendering stats
-		debug_polys_lit_per_frame++;
+		polys_lit++;
 #endif
 
 		// set state of polygon to lit
@@ -2622,8 +3866,6 @@ void RenderList::LightWorld32(const Camera& cam)
 		// we will use the transformed polygon vertex list since the backface removal
 		// only makes sense at the world coord stage further of the pipeline 
 
-		LightsMgr& lights = Modules::GetGraphics().GetLights();
-
 		// test the lighting mode of the polygon (use flat for flat, gouraud))
 		if (curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT)
 		{
@@ -2661,6 +3903,10 @@ void RenderList::LightWorld32(const Camera& cam)
 				if (lights[curr_light].state==LIGHT_STATE_OFF)
 					continue;
 
+				// out of reach of the block, or left to the GBuffer
+				if (!(lights[curr_light].attr & LIGHT_ATTR_AMBIENT) && !block_marks[curr_light])
+					continue;
+
 				//Write_Error("\nprocessing light %d",curr_light);
 
 				// what kind of light are we dealing with
@@ -2941,6 +4187,31 @@ void RenderList::LightWorld32(const Camera& cam)
 				} // end if spot light
 			} // end for light
 
+			// add the highlight of a specular material, computed at vertex 0
+			// with the face normal
+			const Material* mat = materials.GetSpecular(curr_poly->mati);
+			if (mat)
+			{
+				if (n.z == FLT_MAX)
+				{
+					u = curr_poly->tvlist[1].v - curr_poly->tvlist[0].v;
+					v = curr_poly->tvlist[2].v - curr_poly->tvlist[0].v;
+					n = u.Cross(v);
+				}
+
+				Vertex face_vert = curr_poly->tvlist[0];
+				face_vert.n = n * (1.0f / curr_poly->nlength);
+
+				const Vertex* verts[4] = { &face_vert, &face_vert, &face_vert, &face_vert };
+
+				int spec[4][3];
+				block_lights.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
+
+				r_sum += (mat->rs.r * spec[0][0]) / 256;
+				g_sum += (mat->rs.g * spec[0][1]) / 256;
+				b_sum += (mat->rs.b * spec[0][2]) / 256;
+			} // end if specular
+
 			// debug
 			if (r_sum == 0 && g_sum == 0 && b_sum == 0)
 				int zz = 0;
@@ -2960,492 +4231,317 @@ void RenderList::LightWorld32(const Camera& cam)
 			// mesh, and only have triangles, thus, many triangles will share the same vertices and
 			// they will get lit 2x since we don't have any way to tell this, alas, performing lighting
 			// at the object level is a better idea when gouraud shading is performed since the 
-			// commonality of vertices is still intact, in any case, lighting here is similar to polygon
-			// flat shaded, but we do it 3 times, once for each vertex, additionally there are lots
-			// of opportunities for optimization, but I am going to lay off them for now, so the code
-			// is intelligible, later we will optimize
+			// commonality of vertices is still intact, in any case, the 3 vertices are lit together
+			// in one SIMD batch (the 4th lane just repeats vertex 2), each at its own position, and
+			// the base color is factored out of the light sums like the indexed vertices
 
-			//Write_Error("\nEntering gouraud shader...");
-
-			// step 1: extract the base color out in RGB mode
-			// assume 888 format
+			// extract the base color out in RGB mode, assume 888 format
 			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-			//Write_Error("\nBase color=%d, %d, %d", r_base, g_base, b_base);
-
-			// initialize color sum(s) for vertices
-			r_sum0  = 0;
-			g_sum0  = 0;
-			b_sum0  = 0;
+			const Vertex* verts[4] = { &curr_poly->tvlist[0], &curr_poly->tvlist[1], 
+				&curr_poly->tvlist[2], &curr_poly->tvlist[2] };
 
-			r_sum1  = 0;
-			g_sum1  = 0;
-			b_sum1  = 0;
+			int light[4][3];
+			block_lights.LightVerts4(verts, light);
 
-			r_sum2  = 0;
-			g_sum2  = 0;
-			b_sum2  = 0;
+			// the highlight of a specular material is added on top
+			int spec[4][3] = { 0 };
 
-			//Write_Error("\nColor sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,   r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
-
-			// new optimization:
-			// when there are multiple lights in the system we will end up performing numerous
-			// redundant calculations to minimize this my strategy is to set key variables to 
-			// to MAX values on each loop, then during the lighting calcs to test the vars for
-			// the max value, if they are the max value then the first light that needs the math
-			// will do it, and then save the information into the variable (causing it to change state
-			// from an invalid number) then any other lights that need the math can use the previously
-			// computed value, however, since we already have the normals, not much here to cache on
-			// a large scale, but small scale stuff is there, however, we will optimize those later
+			const Material* mat = materials.GetSpecular(curr_poly->mati);
+			if (mat)
+				block_lights.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
 
-			// loop thru lights
-			for (int curr_light = 0; curr_light < lights.Size(); curr_light++)
+			for (int vertex = 0; vertex < 3; vertex++)
 			{
-				// is this light active
-				if (lights[curr_light].state==LIGHT_STATE_OFF)
-					continue;
+				r_sum = (r_base * light[vertex][0]) / 256;
+				g_sum = (g_base * light[vertex][1]) / 256;
+				b_sum = (b_base * light[vertex][2]) / 256;
 
-				//Write_Error("\nprocessing light %d", curr_light);
-
-				// what kind of light are we dealing with
-				if (lights[curr_light].attr & LIGHT_ATTR_AMBIENT) ///////////////////////////////
+				if (mat)
 				{
-					//Write_Error("\nEntering ambient light....");
-
-					// simply multiply each channel against the color of the 
-					// polygon then divide by 256 to scale back to 0..255
-					// use a shift in real life!!! >> 8
-					ri = ((lights[curr_light].c_ambient.r * r_base) / 256);
-					gi = ((lights[curr_light].c_ambient.g * g_base) / 256);
-					bi = ((lights[curr_light].c_ambient.b * b_base) / 256);
-
-					// ambient light has the same affect on each vertex
-					r_sum0+=ri;
-					g_sum0+=gi;
-					b_sum0+=bi;
-
-					r_sum1+=ri;
-					g_sum1+=gi;
-					b_sum1+=bi;
-
-					r_sum2+=ri;
-					g_sum2+=gi;
-					b_sum2+=bi;
-
-					// there better only be one ambient light!
-					//Write_Error("\nexiting ambient ,sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
-
+					r_sum += (mat->rs.r * spec[vertex][0]) / 256;
+					g_sum += (mat->rs.g * spec[vertex][1]) / 256;
+					b_sum += (mat->rs.b * spec[vertex][2]) / 256;
 				} // end if
-				else if (lights[curr_light].attr & LIGHT_ATTR_INFINITE) /////////////////////////////////
-				{
-					//Write_Error("\nentering infinite light...");
-
-					// infinite lighting, we need the surface normal, and the direction
-					// of the light source
-
-					// no longer need to compute normal or length, we already have the vertex normal
-					// and it's length is 1.0  
-					// ....
-
-					// ok, recalling the lighting model for infinite lights
-					// I(d)dir = I0dir * Cldir
-					// and for the diffuse model
-					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-					// so we basically need to multiple it all together
-					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-					// are slower, but the conversion to and from cost cycles
-
-					// need to perform lighting for each vertex (lots of redundant math, optimize later!)
-
-					//Write_Error("\nv0=[%f, %f, %f]=%f, v1=[%f, %f, %f]=%f, v2=[%f, %f, %f]=%f",
-					// curr_poly->tvlist[0].n.x, curr_poly->tvlist[0].n.y,curr_poly->tvlist[0].n.z, VECTOR4D_Length(&curr_poly->tvlist[0].n),
-					// curr_poly->tvlist[1].n.x, curr_poly->tvlist[1].n.y,curr_poly->tvlist[1].n.z, VECTOR4D_Length(&curr_poly->tvlist[1].n),
-					// curr_poly->tvlist[2].n.x, curr_poly->tvlist[2].n.y,curr_poly->tvlist[2].n.z, VECTOR4D_Length(&curr_poly->tvlist[2].n) );
-
-					// vertex 0
-					dp = curr_poly->tvlist[0].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp; 
-						r_sum0+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum0+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum0+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 1
-					dp = curr_poly->tvlist[1].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp; 
-						r_sum1+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum1+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum1+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 2
-					dp = curr_poly->tvlist[2].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp; 
-						r_sum2+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum2+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum2+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					//Write_Error("\nexiting infinite, color sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
-
-				} // end if infinite light
-				else
-					if (lights[curr_light].attr & LIGHT_ATTR_POINT) //////////////////////////////////////
-					{
-						// perform point light computations
-						// light model for point light is once again:
-						//              I0point * Clpoint
-						//  I(d)point = ___________________
-						//              kc +  kl*d + kq*d2              
-						//
-						//  Where d = |p - s|
-						// thus it's almost identical to the infinite light, but attenuates as a function
-						// of distance from the point source to the surface point being lit
-
-						// .. normal already in vertex
-
-						//Write_Error("\nEntering point light....");
-
-						// compute vector from surface to light
-						l = lights[curr_light].pos - curr_poly->tvlist[0].v;
-
-						// compute distance and attenuation
-						dist = l.LengthFast(); 
-
-						// and for the diffuse model
-						// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-						// so we basically need to multiple it all together
-						// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-						// are slower, but the conversion to and from cost cycles
-
-						// perform the calculation for all 3 vertices
-
-						// vertex 0
-						dp = curr_poly->tvlist[0].n.Dot(l);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
 
-							i = 128*dp / (dist * atten ); 
+				// make sure colors aren't out of range
+				if (r_sum  > 255) r_sum = 255;
+				if (g_sum  > 255) g_sum = 255;
+				if (b_sum  > 255) b_sum = 255;
 
-							r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end if
-
-
-						// vertex 1
-						dp = curr_poly->tvlist[1].n.Dot(l);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-							i = 128*dp / (dist * atten ); 
-
-							r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end if
-
-						// vertex 2
-						dp = curr_poly->tvlist[2].n.Dot(l);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-							i = 128*dp / (dist * atten ); 
-
-							r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end if
-
-						//Write_Error("\nexiting point light, rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
-
-					} // end if point
-					else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT1) ///////////////////////////////////////
-					{
-						// perform spotlight/point computations simplified model that uses
-						// point light WITH a direction to simulate a spotlight
-						// light model for point light is once again:
-						//              I0point * Clpoint
-						//  I(d)point = ___________________
-						//              kc +  kl*d + kq*d2              
-						//
-						//  Where d = |p - s|
-						// thus it's almost identical to the infinite light, but attenuates as a function
-						// of distance from the point source to the surface point being lit
-
-						//Write_Error("\nentering spotlight1....");
-
-						// .. normal is already computed
-
-						// compute vector from surface to light
-						l = lights[curr_light].pos - curr_poly->tvlist[0].v;
-
-						// compute distance and attenuation
-						dist = l.LengthFast();
-
-						// and for the diffuse model
-						// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-						// so we basically need to multiple it all together
-						// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-						// are slower, but the conversion to and from cost cycles
-
-						// note that I use the direction of the light here rather than a the vector to the light
-						// thus we are taking orientation into account which is similar to the spotlight model
-
-						// vertex 0
-						dp = curr_poly->tvlist[0].n.Dot(lights[curr_light].dir);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-							i = 128*dp / ( atten ); 
-
-							r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end if
-
-						// vertex 1
-						dp = curr_poly->tvlist[1].n.Dot(lights[curr_light].dir);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-							i = 128*dp / ( atten ); 
-
-							r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end i
-
-						// vertex 2
-						dp = curr_poly->tvlist[2].n.Dot(lights[curr_light].dir);
-
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
+				curr_poly->lit_color[vertex] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+			} // end for vertex
+		}
+		else if (curr_poly->attr & POLY_ATTR_SHADE_MODE_PHONG)
+		{
+			// fast phong shade, the ambient and infinite lights only depend on 
+			// the normal so the rasterizer fetches them per pixel from the
+			// normal table, the point and spot lights (and the highlight) are
+			// lit at the vertices like gouraud and added on top of it
+			phong_polys++;
+
+			// the point and spot lights of this block
+			int block = (poly - start) / POLY_LIGHT_BLOCK;
+			if (block != local_block)
+			{
+				local_lights.SelectLocal(block_lights);
+				local_block = block;
+			} // end if
 
-							i = 128*dp / ( atten ); 
+			// extract the base color out in RGB mode, assume 888 format
+			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-							r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end i
+			const Vertex* verts[4] = { &curr_poly->tvlist[0], &curr_poly->tvlist[1], 
+				&curr_poly->tvlist[2], &curr_poly->tvlist[2] };
 
-						//Write_Error("\nexiting spotlight1, sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
+			int light[4][3];
+			local_lights.LightVerts4(verts, light);
 
-					} // end if spotlight1
-					else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT2) // simple version //////////////////////////
-					{
-						// perform spot light computations
-						// light model for spot light simple version is once again:
-						//         	     I0spotlight * Clspotlight * MAX( (l . s), 0)^pf                     
-						// I(d)spotlight = __________________________________________      
-						//               		 kc + kl*d + kq*d2        
-						// Where d = |p - s|, and pf = power factor
+			int spec[4][3] = { 0 };
 
-						// thus it's almost identical to the point, but has the extra term in the numerator
-						// relating the angle between the light source and the point on the surface
+			const Material* mat = materials.GetSpecular(curr_poly->mati);
+			if (mat)
+				block_lights.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
 
-						// .. already have normals and length are 1.0
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				r_sum = (r_base * light[vertex][0]) / 256;
+				g_sum = (g_base * light[vertex][1]) / 256;
+				b_sum = (b_base * light[vertex][2]) / 256;
 
-						// and for the diffuse model
-						// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-						// so we basically need to multiple it all together
-						// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-						// are slower, but the conversion to and from cost cycles
+				if (mat)
+				{
+					r_sum += (mat->rs.r * spec[vertex][0]) / 256;
+					g_sum += (mat->rs.g * spec[vertex][1]) / 256;
+					b_sum += (mat->rs.b * spec[vertex][2]) / 256;
+				} // end if
 
-						//Write_Error("\nEntering spotlight2...");
+				// make sure colors aren't out of range
+				if (r_sum  > 255) r_sum = 255;
+				if (g_sum  > 255) g_sum = 255;
+				if (b_sum  > 255) b_sum = 255;
 
-						// tons of redundant math here! lots to optimize later!
+				curr_poly->lit_color[vertex] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+			} // end for vertex
+		}
+		else // assume POLY_ATTR_SHADE_MODE_CONSTANT
+		{
+			// emmisive shading only, do nothing
+			// ...
+			curr_poly->lit_color[0] = curr_poly->color;
 
-						// vertex 0
-						dp = curr_poly->tvlist[0].n.Dot(lights[curr_light].dir);
+			//Write_Error("\nentering constant shader, and exiting...");
 
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							// compute vector from light to surface (different from l which IS the light dir)
-							s = curr_poly->tvlist[0].v - lights[curr_light].pos;
+		} // end if
 
-							// compute length of s (distance to light source) to normalize s for lighting calc
-							dists = s.LengthFast();
+	} // end for poly
 
-							// compute spot light term (s . l)
-							float dpsl = s.Dot(lights[curr_light].dir) / dists;
+	JobSystem::AddCounter(_phong_polys, phong_polys);
 
-							// proceed only if term is positive
-							if (dpsl > 0) 
-							{
-								// compute attenuation
-								atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
+#ifdef DEBUG_ON
+	JobSystem::AddCounter(debug_polys_lit_per_frame, polys_lit);
+#endif
+}
 
-								// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-								// must be integral
-								float dpsl_exp = dpsl;
+void RenderList::LightIndexedVerts(const LightsSoA& soa, const vec4& view_pos)
+{
+	// this function lights the shared vertices of the gouraud shaded indexed
+	// polygons, the math is the same as the gouraud shader in LightWorld32(),
+	// but the base color is factored out of the sums, so each vertex is lit
+	// exactly once and every polygon that refers to it simply scales its own
+	// base color by the result, additionally since we know the real position
+	// of each vertex, the point and spot lights use it rather than the
+	// position of vertex 0 of the polygon, the specular term depends on the
+	// viewer as well as the polygon material so it's added per polygon
 
-								// exponentiate for positive integral powers
-								for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-									dpsl_exp*=dpsl;
+	const MaterialsMgr& materials = Modules::GetGraphics().GetMaterials();
 
-								// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+	unsigned int tmpa;
+	unsigned int r_base, g_base, b_base,  // base color being lit
+				 r_sum,  g_sum,  b_sum;   // final color
 
-								i = 128*dp * dpsl_exp / ( atten ); 
+#ifdef DEBUG_ON
+	// counted locally and added once, the list may be lit on the geometry
+	// thread of the frame pipeline
+	int polys_lit = 0;
+#endif
 
-								r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-								g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-								b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+	// flag the vertices of the polygons that still need lighting
+	MarkIndexedVerts(true);
 
-							} // end if
+	// the vertices are lit on all the threads, then gathered below
+	Modules::GetJobs().ParallelFor(_num_verts, VERT_JOB_SIZE, this, 
+		&RenderList::LightVerts32, soa);
 
-						} // end if
+	// now gather the vertex intensities into the polygons
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		// acquire polygon
+		PolygonF* curr_poly = _poly_ptrs[poly];
 
-						// vertex 1
-						dp = curr_poly->tvlist[1].n.Dot(lights[curr_light].dir);
+		if (!(curr_poly->state & POLY_STATE_INDEXED) ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) ||
+			(curr_poly->state & POLY_STATE_LIT) ||
+			(curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT) ||
+			!(curr_poly->attr & POLY_ATTR_SHADE_MODE_GOURAUD) )
+			continue; // move onto next poly
 
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							// compute vector from light to surface (different from l which IS the light dir)
-							s = curr_poly->tvlist[1].v - lights[curr_light].pos;
+#ifdef DEBUG_ON
+		// track rendering stats
+		polys_lit++;
+#endif
 
-							// compute length of s (distance to light source) to normalize s for lighting calc
-							dists = s.LengthFast();
+		// set state of polygon to lit
+		SET_BIT(curr_poly->state, POLY_STATE_LIT);
 
-							// compute spot light term (s . l)
-							float dpsl = s.Dot(lights[curr_light].dir) / dists;
+		// extract the base color out in RGB mode, assume 888 format
+		_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-							// proceed only if term is positive
-							if (dpsl > 0) 
-							{
-								// compute attenuation
-								atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
+		int spec[4][3];
 
-								// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-								// must be integral
-								float dpsl_exp = dpsl;
+		const Material* mat = materials.GetSpecular(curr_poly->mati);
+		if (mat)
+		{
+			const Vertex* verts[4] = { &curr_poly->tvlist[0], &curr_poly->tvlist[1], 
+				&curr_poly->tvlist[2], &curr_poly->tvlist[2] };
 
-								// exponentiate for positive integral powers
-								for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-									dpsl_exp*=dpsl;
+			soa.SpecularVerts4(verts, view_pos, mat->spec_table, spec);
+		} // end if
 
-								// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const int* light = &_vert_light[3*curr_poly->vert[vertex]];
 
-								i = 128*dp * dpsl_exp / ( atten ); 
+			r_sum = (r_base * light[0]) / 256;
+			g_sum = (g_base * light[1]) / 256;
+			b_sum = (b_base * light[2]) / 256;
 
-								r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-								g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-								b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+			if (mat)
+			{
+				r_sum += (mat->rs.r * spec[vertex][0]) / 256;
+				g_sum += (mat->rs.g * spec[vertex][1]) / 256;
+				b_sum += (mat->rs.b * spec[vertex][2]) / 256;
+			} // end if
 
-							} // end if
+			// make sure colors aren't out of range
+			if (r_sum  > 255) r_sum = 255;
+			if (g_sum  > 255) g_sum = 255;
+			if (b_sum  > 255) b_sum = 255;
 
-						} // end if
+			curr_poly->lit_color[vertex] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+		} // end for vertex
+	} // end for poly
 
-						// vertex 2
-						dp = curr_poly->tvlist[2].n.Dot(lights[curr_light].dir);
+#ifdef DEBUG_ON
+	JobSystem::AddCounter(debug_polys_lit_per_frame, polys_lit);
+#endif
+}
 
-						// only add light if dp > 0
-						if (dp > 0)
-						{ 
-							// compute vector from light to surface (different from l which IS the light dir)
-							s = curr_poly->tvlist[2].v - lights[curr_light].pos;
+void RenderList::LightVerts32(const LightsSoA& soa, int start, int end)
+{
+	// lights the flagged pool vertices [start, end), see LightIndexedVerts(),
+	// the flagged vertices are collected in batches of 4 and lit together
 
-							// compute length of s (distance to light source) to normalize s for lighting calc
-							dists = s.LengthFast();
+	const Vertex* verts[4];
+	int index[4];
+	int light[4][3];
 
-							// compute spot light term (s . l)
-							float dpsl = s.Dot(lights[curr_light].dir) / dists;
+	// the lights out of reach of a block of vertices are dropped first
+	LightsSoA block_lights;
 
-							// proceed only if term is positive
-							if (dpsl > 0) 
-							{
-								// compute attenuation
-								atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
+	int count = 0;
 
-								// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-								// must be integral
-								float dpsl_exp = dpsl;
+	for (int vertex = start; vertex < end; vertex++)
+	{
+		if ((vertex - start) % VERT_LIGHT_BLOCK == 0)
+			SelectVertLights(soa, vertex, min(vertex + VERT_LIGHT_BLOCK, end), block_lights);
 
-								// exponentiate for positive integral powers
-								for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-									dpsl_exp*=dpsl;
+		if (!_vert_mark[vertex])
+			continue;
 
-								// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+		verts[count] = &_vert_trans[vertex];
+		index[count] = vertex;
 
-								i = 128*dp * dpsl_exp / ( atten ); 
+		if (++count < 4 && vertex < end-1)
+			continue;
 
-								r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-								g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-								b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-							} // end if
+		// pad a partial batch with the last vertex
+		for (int pad = count; pad < 4; pad++)
+		{
+			verts[pad] = verts[count-1];
+			index[pad] = index[count-1];
+		} // end for pad
 
-						} // end if
+		block_lights.LightVerts4(verts, light);
 
-						//Write_Error("\nexiting spotlight2, sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,   r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
+		// light intensity sums of the vertices, 256 = full base color
+		for (int batch = 0; batch < count; batch++)
+		{
+			_vert_light[3*index[batch]+0] = light[batch][0];
+			_vert_light[3*index[batch]+1] = light[batch][1];
+			_vert_light[3*index[batch]+2] = light[batch][2];
+		} // end for batch
 
-					} // end if spot light
+		count = 0;
+	} // end for vertex
+}
 
-			} // end for light
+void RenderList::SelectPolyLights(const LightsSoA& soa, int start, int end, LightsSoA& block_lights) const
+{
+	vec4 box_min, box_max;
+	box_min.Assign(FLT_MAX, FLT_MAX, FLT_MAX);
+	box_max.Assign(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
-			// make sure colors aren't out of range
-			if (r_sum0  > 255) r_sum0 = 255;
-			if (g_sum0  > 255) g_sum0 = 255;
-			if (b_sum0  > 255) b_sum0 = 255;
+	for (int poly = start; poly < end; poly++)
+	{
+		const PolygonF* curr_poly = _poly_ptrs[poly];
 
-			if (r_sum1  > 255) r_sum1 = 255;
-			if (g_sum1  > 255) g_sum1 = 255;
-			if (b_sum1  > 255) b_sum1 = 255;
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) ||
+			(curr_poly->state & POLY_STATE_LIT) )
+			continue;
 
-			if (r_sum2  > 255) r_sum2 = 255;
-			if (g_sum2  > 255) g_sum2 = 255;
-			if (b_sum2  > 255) b_sum2 = 255;
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			const Vertex& vtx = curr_poly->tvlist[vertex];
+
+			box_min.x = min(box_min.x, vtx.x);
+			box_min.y = min(box_min.y, vtx.y);
+			box_min.z = min(box_min.z, vtx.z);
+			box_max.x = max(box_max.x, vtx.x);
+			box_max.y = max(box_max.y, vtx.y);
+			box_max.z = max(box_max.z, vtx.z);
+		} // end for vertex
+	} // end for poly
 
-			//Write_Error("\nwriting color for poly %d", poly);
+	block_lights.Select(soa, box_min, box_max);
+}
 
-			//Write_Error("\n******** final sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
+void RenderList::SelectVertLights(const LightsSoA& soa, int start, int end, LightsSoA& block_lights) const
+{
+	vec4 box_min, box_max;
+	box_min.Assign(FLT_MAX, FLT_MAX, FLT_MAX);
+	box_max.Assign(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
-			// write the colors
-			curr_poly->lit_color[0] = Modules::GetGraphics().GetColor(r_sum0, g_sum0, b_sum0);
-			curr_poly->lit_color[1] = Modules::GetGraphics().GetColor(r_sum1, g_sum1, b_sum1);
-			curr_poly->lit_color[2] = Modules::GetGraphics().GetColor(r_sum2, g_sum2, b_sum2);
-		}
-		else // assume POLY_ATTR_SHADE_MODE_CONSTANT
-		{
-			// emmisive shading only, do nothing
-			// ...
-			curr_poly->lit_color[0] = curr_poly->color;
+	for (int vertex = start; vertex < end; vertex++)
+	{
+		if (!_vert_mark[vertex])
+			continue;
 
-			//Write_Error("\nentering constant shader, and exiting...");
+		const Vertex& vtx = _vert_trans[vertex];
 
-		} // end if
+		box_min.x = min(box_min.x, vtx.x);
+		box_min.y = min(box_min.y, vtx.y);
+		box_min.z = min(box_min.z, vtx.z);
+		box_max.x = max(box_max.x, vtx.x);
+		box_max.y = max(box_max.y, vtx.y);
+		box_max.z = max(box_max.z, vtx.z);
+	} // end for vertex
 
-	} // end for poly
+	block_lights.Select(soa, box_min, box_max);
 }
 
 void RenderList::DrawWire32(unsigned char* video_buffer, int lpitch)
@@ -3459,6 +4555,10 @@ void RenderList::DrawWire32(unsigned char* video_buffer, int lpitch)
 
 	// at this point, all we have is a list of polygons and it's time
 	// to draw them
+
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	for (int poly=0; poly < _num_polys; poly++)
 	{
 		// render this polygon if and only if it's not clipped, not culled,
@@ -3508,6 +4608,9 @@ void RenderList::DrawSolid32(unsigned char* video_buffer, int lpitch)
 	// draws all the faces in the list, the function will call the 
 	// proper rasterizer based on the lighting model of the polygons
 
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	PolygonF face; // temp face used to render polygon
 
 	// at this point, all we have is a list of polygons and it's time
@@ -3630,6 +4733,9 @@ void RenderList::DrawSolidZB32(unsigned char* video_buffer, int lpitch,
 	// proper rasterizer based on the lighting model of the polygons
 
 
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	PolygonF face; // temp face used to render polygon
 
 	// at this point, all we have is a list of polygons and it's time
@@ -3750,6 +4856,9 @@ void RenderList::DrawTextured32(unsigned char* video_buffer,
 {
 	// TEST FUNCTION ONLY!!!!
 
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
 	PolygonF face; // temp face used to render polygon
 
 	// at this point, all we have is a list of polygons and it's time
@@ -3789,92 +4898,81 @@ void RenderList::DrawTextured32(unsigned char* video_buffer,
 	} // end for poly
 }
 
-int CompareAvgZ(const void *arg1, const void *arg2)
+static unsigned int SortKey(const PolygonF* poly, int sort_method)
 {
-	// this function comapares the average z's of two polygons and is used by the
-	// depth sort surface ordering algorithm
+	// this function computes the sort key of a polygon, first the z value
+	// is selected by the sort method, then the bits of the float are turned
+	// into an unsigned int that compares the same way the floats do, that is
+	// the sign bit is flipped for positive numbers, and all the bits are 
+	// flipped for negative numbers, finally the key is inverted since the 
+	// polygons are sorted in descending z order, farthest first
+
+	float z;
 
-	float z1, z2;
+	switch(sort_method)
+	{
+	case SORT_POLYLIST_NEARZ: // - sorts on closest z vertex of each poly
+		{
+			z = min(poly->tvlist[0].z, poly->tvlist[1].z);
+			z = min(z, poly->tvlist[2].z);
+		} break;
 
-	PolygonF *poly_1, *poly_2;
+	case SORT_POLYLIST_FARZ:  //  - sorts on farthest z vertex of each poly
+		{
+			z = max(poly->tvlist[0].z, poly->tvlist[1].z);
+			z = max(z, poly->tvlist[2].z);
+		} break;
 
-	// dereference the poly pointers
-	poly_1 = *((PolygonF**)(arg1));
-	poly_2 = *((PolygonF**)(arg2));
+	case SORT_POLYLIST_AVGZ:  //  - sorts on average of all vertices
+	default:
+		{
+			z = (float)0.33333*(poly->tvlist[0].z + poly->tvlist[1].z + poly->tvlist[2].z);
+		} break;
+	} // end switch
 
-	// compute z average of each polygon
-	z1 = (float)0.33333*(poly_1->tvlist[0].z + poly_1->tvlist[1].z + poly_1->tvlist[2].z);
+	union { float f; unsigned int i; } fi;
+	fi.f = z;
 
-	// now polygon 2
-	z2 = (float)0.33333*(poly_2->tvlist[0].z + poly_2->tvlist[1].z + poly_2->tvlist[2].z);
+	unsigned int key = fi.i ^ ((fi.i & 0x80000000) ? 0xffffffff : 0x80000000);
 
-	// compare z1 and z2, such that polys' will be sorted in descending Z order
-	if (z1 > z2)
-		return(-1);
-	else if (z1 < z2)
-		return(1);
-	else
-		return(0);
+	return ~key;
 }
 
-int CompareNearZ(const void *arg1, const void *arg2)
+bool RenderList::GrowSort(int num_polys)
 {
-	// this function comapares the closest z's of two polygons and is used by the
-	// depth sort surface ordering algorithm
+	// this function makes sure the scratch arrays of the sort can hold
+	// num_polys polygons, like the rest of the list they only ever grow
 
-	float z1, z2;
+	if (num_polys <= _max_sort)
+		return true;
 
-	PolygonF *poly_1, *poly_2;
+	int max_sort = _max_sort ? _max_sort : POLY_CHUNK_SIZE;
 
-	// dereference the poly pointers
-	poly_1 = *((PolygonF**)(arg1));
-	poly_2 = *((PolygonF**)(arg2));
+	while (max_sort < num_polys)
+		max_sort *= 2;
 
-	// compute the near z of each polygon
-	z1 = min(poly_1->tvlist[0].z, poly_1->tvlist[1].z);
-	z1 = min(z1, poly_1->tvlist[2].z);
+	SortPair* sort_pairs = (SortPair*)realloc(_sort_pairs, 2*max_sort*sizeof(SortPair));
+	if (sort_pairs)
+		_sort_pairs = sort_pairs;
 
-	z2 = min(poly_2->tvlist[0].z, poly_2->tvlist[1].z);
-	z2 = min(z2, poly_2->tvlist[2].z);
+	PolygonF** sort_ptrs = (PolygonF**)realloc(_sort_ptrs, max_sort*sizeof(PolygonF*));
+	if (sort_ptrs)
+		_sort_ptrs = sort_ptrs;
 
-	// compare z1 and z2, such that polys' will be sorted in descending Z order
-	if (z1 > z2)
-		return(-1);
-	else if (z1 < z2)
-		return(1);
-	else
-		return(0);
-}
-
-int CompareFarZ(const void *arg1, const void *arg2)
-{
-	// this function comapares the farthest z's of two polygons and is used by the
-	// depth sort surface ordering algorithm
-
-	float z1, z2;
-
-	PolygonF *poly_1, *poly_2;
-
-	// dereference the poly pointers
-	poly_1 = *((PolygonF**)(arg1));
-	poly_2 = *((PolygonF**)(arg2));
+	int* sort_order = (int*)realloc(_sort_order, max_sort*sizeof(int));
+	if (sort_order)
+		_sort_order = sort_order;
 
-	// compute the near z of each polygon
-	z1 = max(poly_1->tvlist[0].z, poly_1->tvlist[1].z);
-	z1 = max(z1, poly_1->tvlist[2].z);
-
-	z2 = max(poly_2->tvlist[0].z, poly_2->tvlist[1].z);
-	z2 = max(z2, poly_2->tvlist[2].z);
+	if (!sort_pairs || !sort_ptrs || !sort_order)
+	{
+		Modules::GetLog().WriteError("\nRenderList: can't grow the sort buffers to %d polygons.", max_sort);
+		return false;
+	}
 
-	// compare z1 and z2, such that polys' will be sorted in descending Z order
-	if (z1 > z2)
-		return(-1);
-	else if (z1 < z2)
-		return(1);
-	else
-		return(0);
+	_max_sort = max_sort;
 
-} // end CompareFarZ
+	return true;
+}
 
 void RenderList::Sort(int sort_method)
 {
@@ -3883,545 +4981,514 @@ void RenderList::Sort(int sort_method)
 	// #define SORT_POLYLIST_AVGZ  0 - sorts on average of all vertices
 	// #define SORT_POLYLIST_NEARZ 1 - sorts on closest z vertex of each poly
 	// #define SORT_POLYLIST_FARZ  2 - sorts on farthest z vertex of each poly
-
-	switch(sort_method)
+	// additionally SORT_POLYLIST_COHERENT can be or'ed in, in that case the
+	// order of the previous frame is used as the starting point and fixed
+	// up with an insertion sort, as long as the list has the same polygons
+	// and the camera didn't move much this is almost linear, otherwise the 
+	// function falls back to the radix sort
+	// rather than comparing polygons with qsort, the key of each polygon is
+	// computed only once and the (key, index) pairs are radix sorted, 8 bits
+	// per pass, least significant byte first
+
+	// make sure the indexed polygons have their final vertices
+	GatherIndexedVerts();
+
+	if (_num_polys < 2 || !GrowSort(_num_polys))
+		return;
+
+	SortPair* pairs = _sort_pairs;
+	SortPair* temp  = _sort_pairs + _max_sort;
+
+	// step 1: compute the keys, the polygons that won't be drawn anyway
+	// get the largest key, so they end up at the end of the list
+	for (int poly = 0; poly < _num_polys; poly++)
 	{
-	case SORT_POLYLIST_AVGZ:  //  - sorts on average of all vertices
-		{
-			qsort((void *)_poly_ptrs, _num_polys, sizeof(PolygonF*), CompareAvgZ);
-		} break;
-
-	case SORT_POLYLIST_NEARZ: // - sorts on closest z vertex of each poly
-		{
-			qsort((void *)_poly_ptrs, _num_polys, sizeof(PolygonF*), CompareNearZ);
-		} break;
-
-	case SORT_POLYLIST_FARZ:  //  - sorts on farthest z vertex of each poly
-		{
-			qsort((void *)_poly_ptrs, _num_polys, sizeof(PolygonF*), CompareFarZ);
-		} break;
-
-	default: break;
-	} // end switch
-}
-
-void RenderList::ClipPolys(const Camera& cam, int clip_flags)
-{
-	// this function clips the polygons in the list against the requested clipping planes
-	// and sets the clipped flag on the poly, so it's not rendered
-	// note the function ONLY performs clipping on the near and far clipping plane
-	// but will perform trivial tests on the top/bottom, left/right clipping planes
-	// if a polygon is completely out of the viewing frustrum in these cases, it will
-	// be culled, however, this test isn't as effective on games based on objects since
-	// in most cases objects that are visible have polygons that are visible, but in the
-	// case where the polygon list is based on a large object that ALWAYS has some portion
-	// visible, testing for individual polys is worthwhile..
-	// the function assumes the polygons have been transformed into camera space
+		PolygonF* curr_poly = _poly_ptrs[poly];
 
-	// internal clipping codes
-#define CLIP_CODE_GZ   0x0001    // z > z_max
-#define CLIP_CODE_LZ   0x0002    // z < z_min
-#define CLIP_CODE_IZ   0x0004    // z_min < z < z_max
+		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			pairs[poly].key = 0xffffffff;
+		else
+			pairs[poly].key = SortKey(curr_poly, sort_method & SORT_POLYLIST_METHOD_MASK);
 
-#define CLIP_CODE_GX   0x0001    // x > x_max
-#define CLIP_CODE_LX   0x0002    // x < x_min
-#define CLIP_CODE_IX   0x0004    // x_min < x < x_max
+		pairs[poly].index = poly;
+	} // end for poly
 
-#define CLIP_CODE_GY   0x0001    // y > y_max
-#define CLIP_CODE_LY   0x0002    // y < y_min
-#define CLIP_CODE_IY   0x0004    // y_min < y < y_max
+	bool sorted = false;
 
-#define CLIP_CODE_NULL 0x0000
+	// step 2: try to reuse the order of the last frame
+	if ((sort_method & SORT_POLYLIST_COHERENT) && _num_sort_order == _num_polys)
+	{
+		// apply the previous order
+		for (int i = 0; i < _num_polys; i++)
+			temp[i] = pairs[_sort_order[i]];
 
-	int vertex_ccodes[3]; // used to store clipping flags
-	int num_verts_in;     // number of vertices inside
-	int v0, v1, v2;       // vertex indices
+		// and fix it up with an insertion sort, but give up if the order
+		// changed too much, then the radix sort is faster
+		int moves_left = 4*_num_polys;
 
-	float z_factor,       // used in clipping computations
-		  z_test;         // used in clipping computations
+		sorted = true;
 
-	float xi, yi, x01i, y01i, x02i, y02i, // vertex intersection points
-		  t1, t2,                         // parametric t values
-		  ui, vi, u01i, v01i, u02i, v02i; // texture intersection points
+		for (int i = 1; i < _num_polys && sorted; i++)
+		{
+			SortPair curr = temp[i];
+			int j = i - 1;
 
-	int last_poly_index,            // last valid polygon in polylist
-		insert_poly_index;          // the current position new polygons are inserted at
+			while (j >= 0 && temp[j].key > curr.key)
+			{
+				temp[j+1] = temp[j];
+				j--;
 
-	vec4 u,v,n;                 // used in vector calculations
+				if (--moves_left < 0)
+				{
+					sorted = false;
+					break;
+				}
+			} // end while
 
-	PolygonF temp_poly;            // used when we need to split a poly into 2 polys
+			temp[j+1] = curr;
+		} // end for i
 
-	// set last, current insert index to end of polygon list
-	// we don't want to clip poly's two times
-	insert_poly_index = last_poly_index = _num_polys;
+		if (sorted)
+		{
+			// the result is in temp, swap the buffers
+			SortPair* swap = pairs;
+			pairs = temp;
+			temp = swap;
+		}
+	} // end if
 
-	// traverse polygon list and clip/cull polygons
-	for (int poly = 0; poly < last_poly_index; poly++)
+	// step 3: the radix sort
+	if (!sorted)
 	{
-		// acquire current polygon
-		PolygonF* curr_poly = _poly_ptrs[poly];
-
-		// is this polygon valid?
-		// test this polygon if and only if it's not clipped, not culled,
-		// active, and visible and not 2 sided. Note we test for backface in the event that
-		// a previous call might have already determined this, so why work
-		// harder!
-		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
-			(curr_poly->state & POLY_STATE_CLIPPED ) || 
-			(curr_poly->state & POLY_STATE_BACKFACE) )
-			continue; // move onto next poly
+		// build the histograms of all 4 bytes in one go
+		int counts[4][256];
+		memset(counts, 0, sizeof(counts));
 
-		// clip/cull to x-planes       
-		if (clip_flags & CLIP_POLY_X_PLANE)
+		for (int i = 0; i < _num_polys; i++)
 		{
-			// clip/cull only based on x clipping planes
-			// for each vertice determine if it's in the clipping region or beyond it and
-			// set the appropriate clipping code
-			// we do NOT clip the final triangles, we are only trying to trivally reject them 
-			// we are going to clip polygons in the rasterizer to the screen rectangle
-			// but we do want to clip/cull polys that are totally outside the viewfrustrum
-
-			// since we are clipping to the right/left x-planes we need to use the FOV or
-			// the plane equations to find the z value that at the current x position would
-			// be outside the plane
-			z_factor = (0.5)*cam.ViewplaneWidth()/cam.ViewDist();  
-
-			// vertex 0
-
-			z_test = z_factor*curr_poly->tvlist[0].z;
-
-			if (curr_poly->tvlist[0].x > z_test)
-				vertex_ccodes[0] = CLIP_CODE_GX;
-			else if (curr_poly->tvlist[0].x < -z_test)
-				vertex_ccodes[0] = CLIP_CODE_LX;
-			else
-				vertex_ccodes[0] = CLIP_CODE_IX;
-
-			// vertex 1
-
-			z_test = z_factor*curr_poly->tvlist[1].z;         
+			unsigned int key = pairs[i].key;
 
-			if (curr_poly->tvlist[1].x > z_test)
-				vertex_ccodes[1] = CLIP_CODE_GX;
-			else if (curr_poly->tvlist[1].x < -z_test)
-				vertex_ccodes[1] = CLIP_CODE_LX;
-			else
-				vertex_ccodes[1] = CLIP_CODE_IX;
+			counts[0][key & 0xff]++;
+			counts[1][(key >> 8) & 0xff]++;
+			counts[2][(key >> 16) & 0xff]++;
+			counts[3][key >> 24]++;
+		} // end for i
 
-			// vertex 2
+		for (int pass = 0; pass < 4; pass++)
+		{
+			int shift = pass*8;
 
-			z_test = z_factor*curr_poly->tvlist[2].z;              
+			// if all keys have the same byte, this pass wouldn't change anything
+			if (counts[pass][(pairs[0].key >> shift) & 0xff] == _num_polys)
+				continue;
 
-			if (curr_poly->tvlist[2].x > z_test)
-				vertex_ccodes[2] = CLIP_CODE_GX;
-			else if (curr_poly->tvlist[2].x < -z_test)
-				vertex_ccodes[2] = CLIP_CODE_LX;
-			else
-				vertex_ccodes[2] = CLIP_CODE_IX;
+			// turn the counts into offsets
+			int offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				int count = counts[pass][bucket];
+				counts[pass][bucket] = offset;
+				offset += count;
+			} // end for bucket
+
+			// scatter
+			for (int i = 0; i < _num_polys; i++)
+				temp[counts[pass][(pairs[i].key >> shift) & 0xff]++] = pairs[i];
+
+			SortPair* swap = pairs;
+			pairs = temp;
+			temp = swap;
+		} // end for pass
+	} // end if
 
-			// test for trivial rejections, polygon completely beyond right or left
-			// clipping planes
-			if ( ((vertex_ccodes[0] == CLIP_CODE_GX) && 
-				(vertex_ccodes[1] == CLIP_CODE_GX) && 
-				(vertex_ccodes[2] == CLIP_CODE_GX) ) ||
+	// step 4: reorder the polygon pointers and remember the order for
+	// the next frame
+	memcpy(_sort_ptrs, _poly_ptrs, _num_polys*sizeof(PolygonF*));
 
-				((vertex_ccodes[0] == CLIP_CODE_LX) && 
-				(vertex_ccodes[1] == CLIP_CODE_LX) && 
-				(vertex_ccodes[2] == CLIP_CODE_LX) ) )
+	for (int i = 0; i < _num_polys; i++)
+	{
+		_poly_ptrs[i] = _sort_ptrs[pairs[i].index];
+		_sort_order[i] = pairs[i].index;
+	} // end for i
 
-			{
-				// clip the poly completely out of frustrum
-				SET_BIT(curr_poly->state, POLY_STATE_CLIPPED);
+	_num_sort_order = _num_polys;
+}
 
-				// move on to next polygon
-				continue;
-			} // end if
+// internal clipping codes, one bit per frustum plane
+#define CLIP_CODE_NEAR   0x0001    // z < z_min
+#define CLIP_CODE_FAR    0x0002    // z > z_max
+#define CLIP_CODE_LEFT   0x0004    // x < -z*x_factor
+#define CLIP_CODE_RIGHT  0x0008    // x > z*x_factor
+#define CLIP_CODE_BOTTOM 0x0010    // y < -z*y_factor
+#define CLIP_CODE_TOP    0x0020    // y > z*y_factor
+
+// the frustum planes in camera space as used by the clipper, the scalar
+// values are for the sutherland-hodgman clipper and the broadcast ones
+// for the vectorized outcodes
+struct ClipFrustum
+{
+	float near_z, far_z;      // near and far clipping planes
+	float x_factor, y_factor; // the x/y planes are at |x| = z*x_factor, |y| = z*y_factor
 
-		} // end if x planes
+	__m128 near4, far4, x_factor4, y_factor4;
+};
 
-		// clip/cull to y-planes       
-		if (clip_flags & CLIP_POLY_Y_PLANE)
-		{
-			// clip/cull only based on y clipping planes
-			// for each vertice determine if it's in the clipping region or beyond it and
-			// set the appropriate clipping code
-			// we do NOT clip the final triangles, we are only trying to trivally reject them 
-			// we are going to clip polygons in the rasterizer to the screen rectangle
-			// but we do want to clip/cull polys that are totally outside the viewfrustrum
-
-			// since we are clipping to the top/bottom y-planes we need to use the FOV or
-			// the plane equations to find the z value that at the current y position would
-			// be outside the plane
-			z_factor = (0.5)*cam.ViewplaneHeight()/cam.ViewDist();  
-
-			// vertex 0
-			z_test = z_factor*curr_poly->tvlist[0].z;
-
-			if (curr_poly->tvlist[0].y > z_test)
-				vertex_ccodes[0] = CLIP_CODE_GY;
-			else if (curr_poly->tvlist[0].y < -z_test)
-				vertex_ccodes[0] = CLIP_CODE_LY;
-			else
-				vertex_ccodes[0] = CLIP_CODE_IY;
+static inline void ComputeOutcodes4(const ClipFrustum& frustum, 
+									const Vertex& v0, const Vertex& v1, 
+									const Vertex& v2, const Vertex& v3, 
+									int* codes)
+{
+	// this function computes the clipping codes of 4 vertices at once, the
+	// vertices are swizzled into x,y,z registers, all 6 planes are tested
+	// with one compare each, and the resulting lane masks are turned back
+	// into one code per vertex
+	__m128 x = _mm_set_ps(v3.x, v2.x, v1.x, v0.x);
+	__m128 y = _mm_set_ps(v3.y, v2.y, v1.y, v0.y);
+	__m128 z = _mm_set_ps(v3.z, v2.z, v1.z, v0.z);
+
+	__m128 xz = _mm_mul_ps(z, frustum.x_factor4);
+	__m128 yz = _mm_mul_ps(z, frustum.y_factor4);
+
+	int near_mask   = _mm_movemask_ps(_mm_cmplt_ps(z, frustum.near4));
+	int far_mask    = _mm_movemask_ps(_mm_cmpgt_ps(z, frustum.far4));
+	int left_mask   = _mm_movemask_ps(_mm_cmplt_ps(x, _mm_sub_ps(_mm_setzero_ps(), xz)));
+	int right_mask  = _mm_movemask_ps(_mm_cmpgt_ps(x, xz));
+	int bottom_mask = _mm_movemask_ps(_mm_cmplt_ps(y, _mm_sub_ps(_mm_setzero_ps(), yz)));
+	int top_mask    = _mm_movemask_ps(_mm_cmpgt_ps(y, yz));
+
+	for (int i = 0; i < 4; i++)
+	{
+		codes[i] = (((near_mask   >> i) & 1) ? CLIP_CODE_NEAR   : 0) |
+				   (((far_mask    >> i) & 1) ? CLIP_CODE_FAR    : 0) |
+				   (((left_mask   >> i) & 1) ? CLIP_CODE_LEFT   : 0) |
+				   (((right_mask  >> i) & 1) ? CLIP_CODE_RIGHT  : 0) |
+				   (((bottom_mask >> i) & 1) ? CLIP_CODE_BOTTOM : 0) |
+				   (((top_mask    >> i) & 1) ? CLIP_CODE_TOP    : 0);
+	} // end for i
+}
 
-			// vertex 1
-			z_test = z_factor*curr_poly->tvlist[1].z;         
+static inline float ClipDistance(const ClipFrustum& frustum, int plane, const Vertex& v)
+{
+	// returns the signed distance like value of the vertex to the plane,
+	// positive is inside, it's not normalized but it's linear along an edge 
+	// and that's all the clipper needs
+	switch(plane)
+	{
+	case CLIP_CODE_NEAR:   return v.z - frustum.near_z;
+	case CLIP_CODE_FAR:    return frustum.far_z - v.z;
+	case CLIP_CODE_LEFT:   return frustum.x_factor*v.z + v.x;
+	case CLIP_CODE_RIGHT:  return frustum.x_factor*v.z - v.x;
+	case CLIP_CODE_BOTTOM: return frustum.y_factor*v.z + v.y;
+	case CLIP_CODE_TOP:    return frustum.y_factor*v.z - v.y;
+	default: return 0;
+	} // end switch
+}
 
-			if (curr_poly->tvlist[1].y > z_test)
-				vertex_ccodes[1] = CLIP_CODE_GY;
-			else if (curr_poly->tvlist[1].y < -z_test)
-				vertex_ccodes[1] = CLIP_CODE_LY;
-			else
-				vertex_ccodes[1] = CLIP_CODE_IY;
+static inline int LerpColor(int c0, int c1, float t)
+{
+	// interpolates 2 lit colors, assumes 888 format
+	unsigned int a, r0, g0, b0, r1, g1, b1;
 
-			// vertex 2
-			z_test = z_factor*curr_poly->tvlist[2].z;              
+	_RGB8888FROM32BIT(c0, &a, &r0, &g0, &b0);
+	_RGB8888FROM32BIT(c1, &a, &r1, &g1, &b1);
 
-			if (curr_poly->tvlist[2].y > z_test)
-				vertex_ccodes[2] = CLIP_CODE_GY;
-			else if (curr_poly->tvlist[2].x < -z_test)
-				vertex_ccodes[2] = CLIP_CODE_LY;
-			else
-				vertex_ccodes[2] = CLIP_CODE_IY;
+	return Modules::GetGraphics().GetColor((int)(r0 + (float)((int)r1 - (int)r0)*t),
+										   (int)(g0 + (float)((int)g1 - (int)g0)*t),
+										   (int)(b0 + (float)((int)b1 - (int)b0)*t));
+}
 
-			// test for trivial rejections, polygon completely beyond top or bottom
-			// clipping planes
-			if ( ((vertex_ccodes[0] == CLIP_CODE_GY) && 
-				(vertex_ccodes[1] == CLIP_CODE_GY) && 
-				(vertex_ccodes[2] == CLIP_CODE_GY) ) ||
+int RenderList::ClipPolygon(const ClipFrustum& frustum, int planes, int num_verts, bool lerp_colors)
+{
+	// this function clips the polygon in the clip buffer against the sent 
+	// planes with the sutherland-hodgman algorithm, the polygon ping pongs 
+	// between the 2 halves of the clip buffer, each plane can add at most
+	// 1 vertex, so the buffers can hold a triangle clipped to all 6 planes,
+	// every vertex attribute (position, normal, texture coordinates) is 
+	// interpolated, and so are the lit colors if requested, the function 
+	// returns the number of vertices of the clipped polygon, the polygon 
+	// ends up in _clip_verts[_clip_buffer]
+
+	int in = 0;
+
+	for (int plane = CLIP_CODE_NEAR; plane <= CLIP_CODE_TOP; plane <<= 1)
+	{
+		if (!(planes & plane))
+			continue;
 
-				((vertex_ccodes[0] == CLIP_CODE_LY) && 
-				(vertex_ccodes[1] == CLIP_CODE_LY) && 
-				(vertex_ccodes[2] == CLIP_CODE_LY) ) )
+		int out = in ^ 1;
+		int num_out = 0;
 
-			{
-				// clip the poly completely out of frustrum
-				SET_BIT(curr_poly->state, POLY_STATE_CLIPPED);
+		for (int i = 0; i < num_verts; i++)
+		{
+			int j = (i + 1 == num_verts) ? 0 : i + 1;
 
-				// move on to next polygon
-				continue;
-			} // end if
+			const Vertex& vi = _clip_verts[in][i];
+			const Vertex& vj = _clip_verts[in][j];
 
-		} // end if y planes
+			float di = ClipDistance(frustum, plane, vi);
+			float dj = ClipDistance(frustum, plane, vj);
 
-		// clip/cull to z planes
-		if (clip_flags & CLIP_POLY_Z_PLANE)
-		{
-			// clip/cull only based on z clipping planes
-			// for each vertice determine if it's in the clipping region or beyond it and
-			// set the appropriate clipping code
-			// then actually clip all polygons to the near clipping plane, this will result
-			// in at most 1 additional triangle
-
-			// reset vertex counters, these help in classification
-			// of the final triangle 
-			num_verts_in = 0;
-
-			// vertex 0
-			if (curr_poly->tvlist[0].z > cam.FarClipZ())
-			{
-				vertex_ccodes[0] = CLIP_CODE_GZ;
-			} 
-			else if (curr_poly->tvlist[0].z < cam.NearClipZ())
-			{
-				vertex_ccodes[0] = CLIP_CODE_LZ;
-			}
-			else
+			// keep the vertex if it's inside
+			if (di >= 0)
 			{
-				vertex_ccodes[0] = CLIP_CODE_IZ;
-				num_verts_in++;
-			} 
+				_clip_verts[out][num_out] = vi;
+				_clip_colors[out][num_out] = _clip_colors[in][i];
+				num_out++;
+			} // end if
 
-			// vertex 1
-			if (curr_poly->tvlist[1].z > cam.FarClipZ())
-			{
-				vertex_ccodes[1] = CLIP_CODE_GZ;
-			} 
-			else if (curr_poly->tvlist[1].z < cam.NearClipZ())
-			{
-				vertex_ccodes[1] = CLIP_CODE_LZ;
-			}
-			else
+			// and add the intersection if the edge crosses the plane
+			if ((di >= 0) != (dj >= 0))
 			{
-				vertex_ccodes[1] = CLIP_CODE_IZ;
-				num_verts_in++;
-			}     
+				float t = di / (di - dj);
 
-			// vertex 2
-			if (curr_poly->tvlist[2].z > cam.FarClipZ())
-			{
-				vertex_ccodes[2] = CLIP_CODE_GZ;
-			} 
-			else
-			if (curr_poly->tvlist[2].z < cam.NearClipZ())
-			{
-				vertex_ccodes[2] = CLIP_CODE_LZ;
-			}
-			else
-			{
-				vertex_ccodes[2] = CLIP_CODE_IZ;
-				num_verts_in++;
-			} 
+				Vertex& vo = _clip_verts[out][num_out];
 
-			// test for trivial rejections, polygon completely beyond far or near
-			// z clipping planes
-			if ( ((vertex_ccodes[0] == CLIP_CODE_GZ) && 
-				(vertex_ccodes[1] == CLIP_CODE_GZ) && 
-				(vertex_ccodes[2] == CLIP_CODE_GZ) ) ||
+				// everything but the attr field at the end is a float
+				for (int k = 0; k < 11; k++)
+					vo.M[k] = vi.M[k] + (vj.M[k] - vi.M[k])*t;
 
-				((vertex_ccodes[0] == CLIP_CODE_LZ) && 
-				(vertex_ccodes[1] == CLIP_CODE_LZ) && 
-				(vertex_ccodes[2] == CLIP_CODE_LZ) ) )
+				vo.attr = vi.attr;
 
-			{
-				// clip the poly completely out of frustrum
-				SET_BIT(curr_poly->state, POLY_STATE_CLIPPED);
+				if (lerp_colors)
+					_clip_colors[out][num_out] = LerpColor(_clip_colors[in][i], _clip_colors[in][j], t);
+				else
+					_clip_colors[out][num_out] = _clip_colors[in][i];
 
-				// move on to next polygon
-				continue;
+				num_out++;
 			} // end if
+		} // end for i
 
-			// test if any vertex has protruded beyond near clipping plane?
-			if ( ( (vertex_ccodes[0] | vertex_ccodes[1] | vertex_ccodes[2]) & CLIP_CODE_LZ) )
-			{
-				// at this point we are ready to clip the polygon to the near 
-				// clipping plane no need to clip to the far plane since it can't 
-				// possible cause problems. We have two cases: case 1: the triangle 
-				// has 1 vertex interior to the near clipping plane and 2 vertices 
-				// exterior, OR case 2: the triangle has two vertices interior of 
-				// the near clipping plane and 1 exterior
-
-				// step 1: classify the triangle type based on number of vertices
-				// inside/outside
-				// case 1: easy case :)
-				if (num_verts_in == 1)
-				{
-					// we need to clip the triangle against the near clipping plane
-					// the clipping procedure is done to each edge leading away from
-					// the interior vertex, to clip we need to compute the intersection
-					// with the near z plane, this is done with a parametric equation of 
-					// the edge, once the intersection is computed the old vertex position
-					// is overwritten along with re-computing the texture coordinates, if
-					// there are any, what's nice about this case, is clipping doesn't 
-					// introduce any added vertices, so we can overwrite the old poly
-					// the other case below results in 2 polys, so at very least one has
-					// to be added to the end of the rendering list -- bummer
-
-					// step 1: find vertex index for interior vertex
-					if ( vertex_ccodes[0] == CLIP_CODE_IZ) { 
-						v0 = 0; v1 = 1; v2 = 2; 
-					} else if (vertex_ccodes[1] == CLIP_CODE_IZ) { 
-						v0 = 1; v1 = 2; v2 = 0; 
-					} else { 
-						v0 = 2; v1 = 0; v2 = 1; 
-					}
+		in = out;
+		num_verts = num_out;
+
+		// completely clipped away?
+		if (num_verts < 3)
+			return 0;
+	} // end for plane
 
-					// step 2: clip each edge
-					// basically we are going to generate the parametric line p = v0 + v01*t
-					// then solve for t when the z component is equal to near z, then plug that
-					// back into to solve for x,y of the 3D line, we could do this with high
-					// level code and parametric lines, but to save time, lets do it manually
+	_clip_buffer = in;
 
-					// clip edge v0->v1
-					v = curr_poly->tvlist[v1].v - curr_poly->tvlist[v0].v;                   
+	return num_verts;
+}
 
-					// the intersection occurs when z = near z, so t = 
-					t1 = ( (cam.NearClipZ() - curr_poly->tvlist[v0].z) / v.z );
+void RenderList::ClipPolys(const Camera& cam, int clip_flags)
+{
+	// this function clips the polygons in the list against the requested clipping planes
+	// CLIP_POLY_X_PLANE selects the left/right planes, CLIP_POLY_Y_PLANE the top/bottom
+	// and CLIP_POLY_Z_PLANE the near/far planes, the function assumes the polygons have
+	// been transformed into camera space
+	// first the outcodes of all vertices are computed 4 at a time with SSE, the shared 
+	// vertices of the indexed polygons only once, then polygons that are completely
+	// outside of one of the planes are flagged as clipped, polygons that are completely
+	// inside are left alone, and only the few polygons that straddle a plane are clipped
+	// with the sutherland-hodgman algorithm, the clipped polygon is then turned into a 
+	// fan of triangles, the first one replaces the original polygon and the rest are 
+	// added to the end of the list, thus the rasterizers never see a vertex outside
+	// of the view frustum
 
-					// now plug t back in and find x,y intersection with the plane
-					xi = curr_poly->tvlist[v0].x + v.x * t1;
-					yi = curr_poly->tvlist[v0].y + v.y * t1;
+	// select the planes to clip against
+	int clip_planes = 0;
 
-					// now overwrite vertex with new vertex
-					curr_poly->tvlist[v1].x = xi;
-					curr_poly->tvlist[v1].y = yi;
-					curr_poly->tvlist[v1].z = cam.NearClipZ(); 
+	if (clip_flags & CLIP_POLY_X_PLANE)
+		clip_planes |= CLIP_CODE_LEFT | CLIP_CODE_RIGHT;
 
-					// clip edge v0->v2
-					v = curr_poly->tvlist[v2].v - curr_poly->tvlist[v0].v;                     
+	if (clip_flags & CLIP_POLY_Y_PLANE)
+		clip_planes |= CLIP_CODE_BOTTOM | CLIP_CODE_TOP;
 
-					// the intersection occurs when z = near z, so t = 
-					t2 = ( (cam.NearClipZ() - curr_poly->tvlist[v0].z) / v.z );
+	if (clip_flags & CLIP_POLY_Z_PLANE)
+		clip_planes |= CLIP_CODE_NEAR | CLIP_CODE_FAR;
 
-					// now plug t back in and find x,y intersection with the plane
-					xi = curr_poly->tvlist[v0].x + v.x * t2;
-					yi = curr_poly->tvlist[v0].y + v.y * t2;
+	if (!clip_planes)
+		return;
 
-					// now overwrite vertex with new vertex
-					curr_poly->tvlist[v2].x = xi;
-					curr_poly->tvlist[v2].y = yi;
-					curr_poly->tvlist[v2].z = cam.NearClipZ(); 
+	// the indexed polygons need their vertices
+	GatherIndexedVerts();
 
-					// now that we have both t1, t2, check if the poly is textured, if so clip
-					// texture coordinates
-					if (curr_poly->attr & POLY_ATTR_SHADE_MODE_TEXTURE)
-					{
-						ui = curr_poly->tvlist[v0].u0 + (curr_poly->tvlist[v1].u0 - curr_poly->tvlist[v0].u0)*t1;
-						vi = curr_poly->tvlist[v0].v0 + (curr_poly->tvlist[v1].v0 - curr_poly->tvlist[v0].v0)*t1;
-						curr_poly->tvlist[v1].u0 = ui;
-						curr_poly->tvlist[v1].v0 = vi;
+	// set up the frustum, the x/y planes go thru the edges of the viewplane
+	ClipFrustum frustum;
 
-						ui = curr_poly->tvlist[v0].u0 + (curr_poly->tvlist[v2].u0 - curr_poly->tvlist[v0].u0)*t2;
-						vi = curr_poly->tvlist[v0].v0 + (curr_poly->tvlist[v2].v0 - curr_poly->tvlist[v0].v0)*t2;
-						curr_poly->tvlist[v2].u0 = ui;
-						curr_poly->tvlist[v2].v0 = vi;
-					} // end if textured
+	frustum.near_z   = cam.NearClipZ();
+	frustum.far_z    = cam.FarClipZ();
+	frustum.x_factor = (0.5)*cam.ViewplaneWidth()/cam.ViewDist();
+	frustum.y_factor = (0.5)*cam.ViewplaneHeight()/cam.ViewDist();
 
-					// finally, we have obliterated our pre-computed normal length
-					// it needs to be recomputed!!!!
+	frustum.near4     = _mm_set1_ps(frustum.near_z);
+	frustum.far4      = _mm_set1_ps(frustum.far_z);
+	frustum.x_factor4 = _mm_set1_ps(frustum.x_factor);
+	frustum.y_factor4 = _mm_set1_ps(frustum.y_factor);
 
-					// build u, v
-					u = curr_poly->tvlist[v1].v - curr_poly->tvlist[v0].v;
-					v = curr_poly->tvlist[v2].v - curr_poly->tvlist[v0].v;
+	int vertex_ccodes[4]; // used to store clipping flags
 
-					// compute cross product
-					n = u.Cross(v);
+	// step 1: compute the outcodes of the shared vertices in batches of 4
+	if (_num_verts > 0)
+	{
+		MarkIndexedVerts();
 
-					// compute length of normal accurately and store in poly nlength
-					// +- epsilon later to fix over/underflows
-					curr_poly->nlength = n.LengthFast();
+		int batch[4];   // vertices of the current batch
+		int num_batch = 0;
 
-				} // end if
-				else if (num_verts_in == 2)
-				{   // num_verts = 2
-
-					// must be the case with num_verts_in = 2 
-					// we need to clip the triangle against the near clipping plane
-					// the clipping procedure is done to each edge leading away from
-					// the interior vertex, to clip we need to compute the intersection
-					// with the near z plane, this is done with a parametric equation of 
-					// the edge, however unlike case 1 above, the triangle will be split
-					// into two triangles, thus during the first clip, we will store the 
-					// results into a new triangle at the end of the rendering list, and 
-					// then on the last clip we will overwrite the triangle being clipped
-
-					// step 0: copy the polygon
-					memcpy(&temp_poly, curr_poly, sizeof(PolygonF) );
-
-					// step 1: find vertex index for exterior vertex
-					if ( vertex_ccodes[0] == CLIP_CODE_LZ) { 
-						v0 = 0; v1 = 1; v2 = 2; 
-					} else if (vertex_ccodes[1] == CLIP_CODE_LZ) { 
-						v0 = 1; v1 = 2; v2 = 0; 
-					} else { 
-						v0 = 2; v1 = 0; v2 = 1; 
-					}
+		for (int vertex = 0; vertex < _num_verts; vertex++)
+		{
+			if (!_vert_mark[vertex])
+				continue;
 
-					// step 2: clip each edge
-					// basically we are going to generate the parametric line p = v0 + v01*t
-					// then solve for t when the z component is equal to near z, then plug that
-					// back into to solve for x,y of the 3D line, we could do this with high
-					// level code and parametric lines, but to save time, lets do it manually
+			batch[num_batch++] = vertex;
 
-					// clip edge v0->v1
-					v = curr_poly->tvlist[v1].v - curr_poly->tvlist[v0].v;                        
+			if (num_batch == 4)
+			{
+				ComputeOutcodes4(frustum, _vert_trans[batch[0]], _vert_trans[batch[1]],
+					_vert_trans[batch[2]], _vert_trans[batch[3]], vertex_ccodes);
 
-					// the intersection occurs when z = near z, so t = 
-					t1 = ( (cam.NearClipZ() - curr_poly->tvlist[v0].z) / v.z );
+				for (int i = 0; i < num_batch; i++)
+					_vert_clip[batch[i]] = (unsigned char)vertex_ccodes[i];
 
-					// now plug t back in and find x,y intersection with the plane
-					x01i = curr_poly->tvlist[v0].x + v.x * t1;
-					y01i = curr_poly->tvlist[v0].y + v.y * t1;
+				num_batch = 0;
+			} // end if
+		} // end for vertex
 
-					// clip edge v0->v2
-					v = curr_poly->tvlist[v2].v - curr_poly->tvlist[v0].v;            
+		// the last partial batch, pad it with its last vertex
+		if (num_batch > 0)
+		{
+			for (int i = num_batch; i < 4; i++)
+				batch[i] = batch[num_batch-1];
 
-					// the intersection occurs when z = near z, so t = 
-					t2 = ( (cam.NearClipZ() - curr_poly->tvlist[v0].z) / v.z );
+			ComputeOutcodes4(frustum, _vert_trans[batch[0]], _vert_trans[batch[1]],
+				_vert_trans[batch[2]], _vert_trans[batch[3]], vertex_ccodes);
 
-					// now plug t back in and find x,y intersection with the plane
-					x02i = curr_poly->tvlist[v0].x + v.x * t2;
-					y02i = curr_poly->tvlist[v0].y + v.y * t2; 
+			for (int i = 0; i < num_batch; i++)
+				_vert_clip[batch[i]] = (unsigned char)vertex_ccodes[i];
+		} // end if
+	} // end if
 
-					// now we have both intersection points, we must overwrite the inplace
-					// polygon's vertex 0 with the intersection point, this poly 1 of 2 from
-					// the split
+	// set last index to end of polygon list, we don't want to clip
+	// the polygons we add
+	int last_poly_index = _num_polys;
 
-					// now overwrite vertex with new vertex
-					curr_poly->tvlist[v0].x = x01i;
-					curr_poly->tvlist[v0].y = y01i;
-					curr_poly->tvlist[v0].z = cam.NearClipZ(); 
+	// step 2: traverse polygon list and clip/cull polygons
+	for (int poly = 0; poly < last_poly_index; poly++)
+	{
+		// acquire current polygon
+		PolygonF* curr_poly = _poly_ptrs[poly];
 
-					// now comes the hard part, we have to carefully create a new polygon
-					// from the 2 intersection points and v2, this polygon will be inserted
-					// at the end of the rendering list, but for now, we are building it up
-					// in  temp_poly
+		// is this polygon valid?
+		// test this polygon if and only if it's not clipped, not culled,
+		// active, and visible
+		if ((curr_poly==NULL) || !(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) || 
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
 
-					// so leave v2 alone, but overwrite v1 with v01, and overwrite v0 with v02
-					temp_poly.tvlist[v1].x = x01i;
-					temp_poly.tvlist[v1].y = y01i;
-					temp_poly.tvlist[v1].z = cam.NearClipZ();              
+		// get the outcodes, either from the pool or computed right here
+		if (curr_poly->state & POLY_STATE_INDEXED)
+		{
+			vertex_ccodes[0] = _vert_clip[curr_poly->vert[0]];
+			vertex_ccodes[1] = _vert_clip[curr_poly->vert[1]];
+			vertex_ccodes[2] = _vert_clip[curr_poly->vert[2]];
+		}
+		else
+		{
+			ComputeOutcodes4(frustum, curr_poly->tvlist[0], curr_poly->tvlist[1],
+				curr_poly->tvlist[2], curr_poly->tvlist[2], vertex_ccodes);
+		}
 
-					temp_poly.tvlist[v0].x = x02i;
-					temp_poly.tvlist[v0].y = y02i;
-					temp_poly.tvlist[v0].z = cam.NearClipZ();    
+		// only the planes we were asked for
+		int code_and = vertex_ccodes[0] & vertex_ccodes[1] & vertex_ccodes[2] & clip_planes;
+		int code_or  = (vertex_ccodes[0] | vertex_ccodes[1] | vertex_ccodes[2]) & clip_planes;
 
-					// now that we have both t1, t2, check if the poly is textured, if so clip
-					// texture coordinates
-					if (curr_poly->attr & POLY_ATTR_SHADE_MODE_TEXTURE)
-					{
-						// compute poly 1 new texture coordinates from split
-						u01i = curr_poly->tvlist[v0].u0 + (curr_poly->tvlist[v1].u0 - curr_poly->tvlist[v0].u0)*t1;
-						v01i = curr_poly->tvlist[v0].v0 + (curr_poly->tvlist[v1].v0 - curr_poly->tvlist[v0].v0)*t1;
+		// trivial accept, polygon totally inside
+		if (!code_or)
+			continue;
 
-						// compute poly 2 new texture coordinates from split
-						u02i = curr_poly->tvlist[v0].u0 + (curr_poly->tvlist[v2].u0 - curr_poly->tvlist[v0].u0)*t2;
-						v02i = curr_poly->tvlist[v0].v0 + (curr_poly->tvlist[v2].v0 - curr_poly->tvlist[v0].v0)*t2;
+		// trivial reject, all vertices beyond the same plane
+		if (code_and)
+		{
+			// clip the poly completely out of frustrum
+			SET_BIT(curr_poly->state, POLY_STATE_CLIPPED);
 
-						// write them all at the same time         
-						// poly 1
-						curr_poly->tvlist[v0].u0 = u01i;
-						curr_poly->tvlist[v0].v0 = v01i;
+#ifdef DEBUG_ON
+			// track rendering stats
+			debug_polys_clipped_per_frame++;
+#endif
+			// move on to next polygon
+			continue;
+		} // end if
 
-						// poly 2
-						temp_poly.tvlist[v0].u0 = u02i;
-						temp_poly.tvlist[v0].v0 = v02i;
-						temp_poly.tvlist[v1].u0 = u01i;
-						temp_poly.tvlist[v1].v0 = v01i;
+		// the polygon straddles at least one plane, an indexed polygon can't
+		// touch the shared vertices since other polygons refer to them, so 
+		// from now on it owns the copies of its vertices in tvlist[]
+		RESET_BIT(curr_poly->state, POLY_STATE_INDEXED);
 
-					} // end if textured
+		// the lit colors are per vertex only for lit gouraud and phong polygons
+		bool lerp_colors = (curr_poly->state & POLY_STATE_LIT) && 
+			(curr_poly->attr & (POLY_ATTR_SHADE_MODE_GOURAUD | POLY_ATTR_SHADE_MODE_PHONG)) &&
+			!(curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT);
 
+		// load the clip buffer
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			_clip_verts[0][vertex] = curr_poly->tvlist[vertex];
+			_clip_colors[0][vertex] = curr_poly->lit_color[lerp_colors ? vertex : 0];
+		} // end for vertex
 
-					// finally, we have obliterated our pre-computed normal lengths
-					// they need to be recomputed!!!!
+		int num_verts = ClipPolygon(frustum, code_or, 3, lerp_colors);
 
-					// poly 1 first, in place
+		// the polygon can still vanish, e.g. it's only outside the corner
+		// of two planes
+		if (num_verts < 3)
+		{
+			SET_BIT(curr_poly->state, POLY_STATE_CLIPPED);
 
-					// build u, v
-					u = curr_poly->tvlist[v1].v - curr_poly->tvlist[v0].v;
-					v = curr_poly->tvlist[v2].v - curr_poly->tvlist[v0].v;
+#ifdef DEBUG_ON
+			// track rendering stats
+			debug_polys_clipped_per_frame++;
+#endif
+			continue;
+		} // end if
 
-					// compute cross product
-					n = u.Cross(v);
+		const Vertex* clip_verts = _clip_verts[_clip_buffer];
+		const int* clip_colors = _clip_colors[_clip_buffer];
 
-					// compute length of normal accurately and store in poly nlength
-					// +- epsilon later to fix over/underflows
-					curr_poly->nlength = n.LengthFast();
+		// step 3: build the triangle fan 0,i,i+1, the winding is kept
+		for (int tri = 0; tri < num_verts - 2; tri++)
+		{
+			PolygonF* face = curr_poly;
 
-					// now poly 2, temp_poly
-					// build u, v
-					u = temp_poly.tvlist[v1].v - temp_poly.tvlist[v0].v;
-					v = temp_poly.tvlist[v2].v - temp_poly.tvlist[v0].v;
+			// the first triangle overwrites the polygon, the rest are copies
+			// of it that are added to the end of the list
+			if (tri > 0)
+			{
+				if (!Insert(*curr_poly))
+					break;
 
-					// compute cross product
-					n = u.Cross(v);
+				face = _poly_ptrs[_num_polys-1];
+			} // end if
 
-					// compute length of normal accurately and store in poly nlength
-					// +- epsilon later to fix over/underflows
-					temp_poly.nlength = n.LengthFast();
+			face->tvlist[0] = clip_verts[0];
+			face->tvlist[1] = clip_verts[tri+1];
+			face->tvlist[2] = clip_verts[tri+2];
 
-					// now we are good to go, insert the polygon into list
-					// if the poly won't fit, it won't matter, the function will
-					// just return 0
-					Insert(temp_poly);
+			if (lerp_colors)
+			{
+				face->lit_color[0] = clip_colors[0];
+				face->lit_color[1] = clip_colors[tri+1];
+				face->lit_color[2] = clip_colors[tri+2];
+			} // end if
 
-				} // end else
+			// finally, we have obliterated our pre-computed normal length
+			// it needs to be recomputed!!!!
+			vec4 u = face->tvlist[1].v - face->tvlist[0].v;
+			vec4 v = face->tvlist[2].v - face->tvlist[0].v;
 
-			} // end if near_z clipping has occured
+			// compute cross product
+			vec4 n = u.Cross(v);
 
-		} // end if z planes
+			// compute length of normal accurately and store in poly nlength
+			face->nlength = n.LengthFast();
+		} // end for tri
 
 	} // end for poly
 }
 
-}
+}
\ No newline at end of file
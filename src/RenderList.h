@@ -1,6 +1,7 @@
 #include "Polygon.h"
 #include "Matrix.h"
 #include "defines.h"
+#include "RenderObject.h"
 
 namespace t3d {
 
@@ -9,6 +10,16 @@ namespace t3d {
 #define CLIP_POLY_Y_PLANE           0x0002 // cull on the y clipping planes
 #define CLIP_POLY_Z_PLANE           0x0004 // cull on the z clipping planes
 
+// attributes of the render list
+// indexed mode, objects inserted into the list share their vertices through
+// a vertex pool, so each vertex is transformed and gouraud lit only once
+#define RENDERLIST_ATTR_INDEXED     0x0001
+
+// states of the render list
+// the polygons were moved into camera space by WorldToCamera(), so the
+// viewer sits at the origin when the specular term is computed
+#define RENDERLIST_STATE_CAMERA     0x0001
+
 // defines that control the rendering function state attributes
 // note each class of control flags is contained within
 // a 4-bit nibble where possible, this helps with future expansion
@@ -73,16 +84,44 @@ struct RenderContext
 };
 
 class Camera;
-class RenderObject;
+class LightsMgr;
+class LightsSoA;
+class NormalLightTable;
+class GBuffer;
+struct ClipFrustum;
+struct MeshInstance;
 
 class RenderList
 {
 public:
+	RenderList();
+	~RenderList();
+
+	void SetAttr(int attr) { _attr = attr; }
+	int Attr() const { return _attr; }
 
 	bool Insert(const Polygon& poly);
 	bool Insert(const PolygonF& poly);
 	bool Insert(const RenderObject& obj, bool insert_local = false);
 
+	// inserts copies of a shared mesh, each instance is culled with the
+	// bounding sphere of its frame and has its backfaces removed in object
+	// space, then the vertices of all of them are placed straight into the
+	// list in one parallel pass, the mesh itself is only read, so it can be
+	// shared between threads, cull_flags and min_pixels work like in 
+	// RenderObject::Cull(), returns the number of instances inserted
+	int InsertInstances(const RenderObject& mesh, MeshInstance* instances,
+		int num_instances, const Camera& cam, int cull_flags, 
+		float min_pixels = RenderObject::CULL_PIXELS);
+
+	// inserts a constant shaded triangle facing the camera about size
+	// pixels across at world_pos, the impostor of an object culled for
+	// being too small, so it doesn't just vanish in the distance
+	bool InsertPoint(const Camera& cam, const vec4& world_pos, int color, float size = 1);
+
+	// appends the polygons of another list, see RenderSegments
+	bool Append(const RenderList& list);
+
 	void Transform(const mat4& mt, int coord_select);
 
 	void ModelToWorld(const vec4& world_pos, 
@@ -108,34 +147,250 @@ public:
 	void DrawHybridTexturedSolidINVZB32(unsigned char* video_buffer, int lpitch,
 		unsigned char* zbuffer, int zpitch, float dist1, float dist2);
 
+	// fills the sent GBuffer with the opaque polygons of the list, call
+	// it after the list is drawn and before GBuffer::Shade(), the gouraud
+	// and phong polygons take the deferred lights, the others only hide
+	// what's behind them, the point lights flagged LIGHT_ATTR_DEFERRED are
+	// skipped by the lighting of the list and objects, so they don't count
+	// twice
+	void DrawGBuffer(const Camera& cam, GBuffer& gbuffer);
+
+	// writes only the 1/z of the polygons into a float buffer of the sent
+	// size, see ShadowMap
+	void DrawDepth(unsigned char* zbuffer, int zpitch, int width, int height);
+
 	void LightWorld32(const Camera& cam);
+	void LightWorld32(const Camera& cam, const LightsMgr& lights);
 
 	// z-sort algorithm (simple painters algorithm)
+	// radix sort on precomputed keys, optionally frame coherent
 	void Sort(int sort_method = SORT_POLYLIST_AVGZ);
 
 	void ClipPolys(const Camera& cam, int clip_flags);
 
 	int GetNumPolys() const { return _num_polys; }
+	int GetNumVerts() const { return _num_verts; }
+
+	// the list grows on demand, but if the size is known up front the
+	// memory can be allocated right away
+	bool Reserve(int num_polys, int num_verts = 0);
+
+	// memory statistics, the high water marks are the most polygons and
+	// pool vertices the list has held in a single frame so far
+	int GetPolyCapacity() const { return _num_chunks << POLY_CHUNK_SHIFT; }
+	int GetVertCapacity() const { return _max_verts; }
+	int GetPolyHighWater() const { return _num_polys > _poly_high_water ? _num_polys : _poly_high_water; }
+	int GetVertHighWater() const { return _num_verts > _vert_high_water ? _num_verts : _vert_high_water; }
+
+private:
+	// the list owns its buffers, a copy would free them twice, so it can't
+	// be copied, not implemented
+	RenderList(const RenderList&);
+	RenderList& operator=(const RenderList&);
+
+	// returns the storage of the index'th polygon, it must be allocated
+	PolygonF* PolySlot(int index) const { 
+		return &_poly_chunks[index >> POLY_CHUNK_SHIFT][index & (POLY_CHUNK_SIZE-1)]; 
+	}
+
+	PolygonF* AllocPoly();
+	bool GrowVerts(int num_verts);
+	bool GrowSort(int num_polys);
+
+	bool InsertIndexed(const RenderObject& obj, bool insert_local);
+
+	// the scratch of InsertInstances()
+	bool GrowInstances(int num_instances, int num_verts);
+
+	// inserts the polygons of one placed instance facing the viewer, view
+	// is the camera in the space of the mesh, world the placed vertices of
+	// the instance, which start at base_vert of the pool in indexed mode
+	// and are copied into the polygons if base_vert is -1
+	bool InsertInstancePolys(const RenderObject& mesh, const MeshInstance& inst,
+		const vec4& view, const Vertex* world, int base_vert);
+
+	// flags the pool vertices referenced by live indexed polygons
+	void MarkIndexedVerts(bool unlit_gouraud_only = false);
+
+	// copies the pool vertices back into the tvlist[] of each live
+	// indexed polygon, so the per polygon stages can work on them
+	void GatherIndexedVerts();
+
+	void LightIndexedVerts(const LightsSoA& soa, const vec4& view_pos);
+
+	// the lighting of the normals for the fast phong polygons, rebuilt
+	// when the lights change, PhongTable() builds it from the directional
+	// lights LightWorld32() was sent this frame, or from the lights of the
+	// graphics module if the objects lit the list themselves, returns NULL
+	// if out of memory
+	void UpdatePhongTable(const LightsSoA& soa);
+	const NormalLightTable* PhongTable();
+
+	// the stages split in ranges of polygons or pool vertices, these
+	// are run in parallel by the job system
+	struct TransformJob
+	{
+		TransformJob(const mat4& _mt, int _coord_select)
+			: mt(_mt)
+			, coord_select(_coord_select)
+		{}
+
+		const mat4& mt;
+		int coord_select;
+	};
+
+	// the flat shader walks the lights as they are, the gouraud shader
+	// lights the vertices in batches with the SIMD copy of them, the
+	// specular term needs the position of the viewer in the list space
+	struct LightJob
+	{
+		LightJob(const LightsMgr& _lights, const LightsSoA& _soa, const vec4& _view_pos)
+			: lights(_lights)
+			, soa(_soa)
+			, view_pos(_view_pos)
+		{}
+
+		const LightsMgr& lights;
+		const LightsSoA& soa;
+		vec4 view_pos;
+	};
+
+	// the visible instances one after the other, each with the vertices of
+	// a frame of the mesh
+	struct InstanceJob
+	{
+		InstanceJob(const RenderObject& _mesh, const MeshInstance* _instances,
+			const int* _visible, Vertex* _dst)
+			: mesh(_mesh)
+			, instances(_instances)
+			, visible(_visible)
+			, dst(_dst)
+		{}
+
+		const RenderObject& mesh;
+		const MeshInstance* instances;
+		const int* visible;   // indices of the visible instances
+		Vertex* dst;
+	};
+
+	void TransformPolys(const TransformJob& job, int start, int end);
+	void TransformVerts(const TransformJob& job, int start, int end);
+	void PlaceInstanceVerts(const InstanceJob& job, int start, int end);
+	void RemoveBackfacesPolys(const Camera& cam, int start, int end);
+	void LightPolys32(const LightJob& job, int start, int end);
+	void LightVerts32(const LightsSoA& soa, int start, int end);
+
+	// keeps the lights that reach the bounding box of the live polygons 
+	// or the flagged pool vertices [start, end)
+	void SelectPolyLights(const LightsSoA& soa, int start, int end, LightsSoA& block_lights) const;
+	void SelectVertLights(const LightsSoA& soa, int start, int end, LightsSoA& block_lights) const;
+
+	// clips the polygon in the clip buffer against the sent planes
+	int ClipPolygon(const ClipFrustum& frustum, int planes, int num_verts, bool lerp_colors);
 
 private:
 	// render list defines
-	static const int MAX_POLYS = 32768;
+	// the polygons are allocated in chunks of 1024
+	static const int POLY_CHUNK_SHIFT = 10;
+	static const int POLY_CHUNK_SIZE  = 1 << POLY_CHUNK_SHIFT;
+
+	// number of polygons and pool vertices handed to a thread at once
+	static const int POLY_JOB_SIZE = 256;
+	static const int VERT_JOB_SIZE = 512;
+
+	// number of polygons and pool vertices that share a culled light list,
+	// the objects are inserted whole so neighbours are close in space
+	static const int POLY_LIGHT_BLOCK = 64;
+	static const int VERT_LIGHT_BLOCK = 128;
 
 private:
-	int _state; // _state of renderlist ???
+	int _state; // state of renderlist, RENDERLIST_STATE_*
 	int _attr;  // attributes of renderlist ???
 
 	// the render list is an array of pointers each pointing to 
 	// a self contained "renderable" polygon face POLYF4DV1
-	PolygonF* _poly_ptrs[MAX_POLYS];
+	PolygonF** _poly_ptrs;
+	int _max_polys; // size of the pointer array
 
 	// additionally to cut down on allocatation, de-allocation
 	// of polygons each frame, here's where the actual polygon
-	// faces will be stored
-	PolygonF _poly_data[MAX_POLYS];
+	// faces will be stored, the chunks are kept across frames
+	// and new ones are only added when a frame needs more
+	PolygonF** _poly_chunks;
+	int _num_chunks;  // chunks allocated so far
+	int _max_chunks;  // size of the chunk table
 
 	int _num_polys; // number of polys in render list
 
+	// the vertex pool used by indexed polygons, every object inserted
+	// in indexed mode gets its vertex range copied in here once, the
+	// polygons then only refer to it with PolygonF::vert[]
+	Vertex* _vert_local;
+	Vertex* _vert_trans;
+
+	// per vertex flags built by MarkIndexedVerts()
+	unsigned char* _vert_mark;
+
+	// per vertex gouraud light intensity (r,g,b), scaled so 256 is the
+	// full base color of the polygon that gathers it
+	int* _vert_light;
+
+	int _max_verts; // size of the pool arrays
+	int _num_verts; // number of vertices in the pool
+
+	// true if the tvlist[] of the indexed polygons are up to date
+	bool _verts_gathered;
+
+	// high water marks of the previous frames
+	int _poly_high_water;
+	int _vert_high_water;
+
+	// sort key of a polygon and its index in the list
+	struct SortPair
+	{
+		unsigned int key;
+		int index;
+	};
+
+	// scratch buffers of the sort, the pairs are 2x the size
+	// since the radix sort ping pongs between 2 halves
+	SortPair* _sort_pairs;
+	PolygonF** _sort_ptrs;
+	int _max_sort;
+
+	// the order the polygons ended up in last frame, used
+	// by the SORT_POLYLIST_COHERENT sort
+	int* _sort_order;
+	int _num_sort_order;
+
+	// scratch of InsertInstances(), the indices of the instances that
+	// survived the culling and their placed vertices if the list isn't
+	// indexed
+	int* _inst_visible;
+	int _max_inst_visible;
+	Vertex* _inst_verts;
+	int _max_inst_verts;
+
+	// per vertex clipping codes of the pool
+	unsigned char* _vert_clip;
+
+	// scratch buffer of the polygon clipper, a triangle clipped
+	// against all 6 planes has at most 9 vertices, the clipper
+	// ping pongs between the 2 halves, _clip_buffer is the one
+	// holding the result
+	static const int MAX_CLIP_VERTS = 12;
+
+	Vertex _clip_verts[2][MAX_CLIP_VERTS];
+	int _clip_colors[2][MAX_CLIP_VERTS];
+	int _clip_buffer;
+
+	// directional lighting of the fast phong polygons, see UpdatePhongTable()
+	NormalLightTable* _phong_table;
+	bool _phong_updated;  // _phong_table is up to date this frame
+	LightsSoA* _phong_lights;  // directional lights of the last LightWorld32()
+	bool _phong_lit;           // _phong_lights are from this frame
+	int _phong_polys;     // phong polygons lit by the last LightWorld32()
+
 }; // RenderList
 
 }
\ No newline at end of file
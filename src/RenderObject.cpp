@@ -1,6 +1,7 @@
 #include "RenderObject.h"
 
 #include <float.h>
+#include <algorithm>
 
 #include "Modules.h"
 #include "Log.h"
@@ -10,6 +11,9 @@
 #include "Light.h"
 #include "BmpFile.h"
 #include "BmpImg.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "MeshSimplifier.h"
 
 namespace t3d {
 
@@ -17,6 +21,13 @@ RenderObject::RenderObject()
 {
 	memset(this, 0, sizeof(RenderObject));
 	_state = OBJECT_STATE_NULL;
+
+	// nothing is known about the vertices or cached yet
+	_trans_version  = -1;
+	_light_version  = -1;
+	_lights_version = -1;
+	_planes_version = -1;
+	_clusters_version = -1;
 }
 
 int RenderObject::Init(int num_vertices, int num_polys, int num_frames, bool destroy)
@@ -84,6 +95,12 @@ int RenderObject::Init(int num_vertices, int num_polys, int num_frames, bool des
 	_num_vertices   = num_vertices;
 	_total_vertices = num_vertices*num_frames;
 
+	// the vertices are about to be filled in
+	++_local_version;
+	_trans_version  = -1;
+	_light_version  = -1;
+	_lights_version = -1;
+
 	// return success
 	return(1);
 }
@@ -116,6 +133,43 @@ int RenderObject::Destroy()
 	if (_max_radius)
 		free(_max_radius);
 
+	// vertex lighting arrays
+	if (_vert_light)
+		free(_vert_light);
+
+	if (_vert_mark)
+		free(_vert_mark);
+
+	if (_poly_lit)
+		free(_poly_lit);
+
+	// object space backface arrays
+	if (_local_planes)
+		free(_local_planes);
+
+	if (_vert_live)
+		free(_vert_live);
+
+	// clusters
+	if (_clusters)
+		free(_clusters);
+
+	if (_cluster_polys)
+		free(_cluster_polys);
+
+	if (_frame_serial)
+		free(_frame_serial);
+
+	// the simplified copies
+	for (int level = 0; level < _num_lods; level++)
+	{
+		_lods[level]->Destroy();
+		delete _lods[level];
+	} // end for level
+
+	if (_lods)
+		free(_lods);
+
 	// now clear out object completely
 	memset((void *)this, 0, sizeof(RenderObject));
 
@@ -144,6 +198,9 @@ int RenderObject::SetFrame(int frame)
 	// set frame
 	_curr_frame = frame;
 
+	// the backfaces found belong to the old frame
+	_live_valid = false;
+
 	// update pointers to point to "block" of vertices that represent this frame
 	// the vertices from each frame are 1-1 and onto relative to the polygons that
 	// make up the object, they are simply shifted, this we need to re-vector the 
@@ -152,6 +209,16 @@ int RenderObject::SetFrame(int frame)
 	_vlist_local = &(_head_vlist_local[frame*_num_vertices]);
 	_vlist_trans = &(_head_vlist_trans[frame*_num_vertices]);
 
+	// a transformation of all the frames only reaches each one when it's
+	// shown, unless the local vertices changed since
+	if (_trans_lazy && _frame_serial[frame] != _trans_serial)
+	{
+		if (_trans_version == _local_version)
+			PlaceFrame();
+		else
+			_trans_version = -1;
+	} // end if
+
 	// return success
 	return(1);
 }
@@ -509,6 +576,9 @@ int RenderObject::GenerateTerrain(float twidth, float theight, float vscale,
 	// compute vertex normals for any gouraud shaded polys
 	ComputeVertexNormals();
 
+	// group the polygons for culling
+	BuildClusters();
+
 	// return success
 	return(1);
 }
@@ -523,6 +593,10 @@ void RenderObject::Reset()
 
 	// reset object's culled flag
 	RESET_BIT(_state, OBJECT_STATE_CULLED);
+	RESET_BIT(_state, OBJECT_STATE_TINY);
+
+	// the vertices in use are found again by RemoveBackfacesLocal()
+	_live_valid = false;
 
 	// now the clipped and backface flags for the polygons 
 	for (int poly = 0; poly < _num_polys; poly++)
@@ -628,6 +702,8 @@ void RenderObject::Scale(const vec3& scale, bool all_frames)
 	{
 		_plist[poly].nlength*=(scale.x * scale.y * scale.z);
 	} // end for poly
+
+	++_local_version;
 }
 
 void RenderObject::Transform(const mat4& mt, int coord_select, 
@@ -642,272 +718,376 @@ void RenderObject::Transform(const mat4& mt, int coord_select,
 	// null out the last row of the matrix before transforming the normals?
 	// future optimization: set flag in object attributes, and objects without 
 	// vertex normals can be rotated without the test in line
+	// the vertices are independent of each other, so they are split in chunks
+	// and transformed on all the threads of the job system
 
+	// a rotation from the local vertices is only done again if something
+	// changed since the last one
+	vec4 no_pos(0, 0, 0, 1);
 
-	// single frame or all frames?
-	if (!all_frames)
-	{
-		// what coordinates should be transformed?
-		switch(coord_select)
-		{
-		case TRANSFORM_LOCAL_ONLY:
-			{
-				// transform each local/model vertex of the object mesh in place
-				for (int vertex=0; vertex < _num_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
-
-					// transform point
-					_vlist_local[vertex].v = mt * _vlist_local[vertex].v;
+	bool current = coord_select == TRANSFORM_LOCAL_TO_TRANS && 
+		TransCurrent(&mt, no_pos, all_frames);
 
-					// transform vertex normal if needed
-					if (_vlist_local[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform normal
-						_vlist_local[vertex].n = mt * _vlist_local[vertex].n;
-					} // end if
+	// only the frame shown of an animation is rotated now
+	bool lazy = coord_select == TRANSFORM_LOCAL_TO_TRANS && LazyFrames(all_frames);
 
-				} // end for index
-			} break;
+	VertexJob job;
+	if (!current && SelectVerts(coord_select, all_frames && !lazy, job))
+	{
+		job.mt = &mt;
+		Modules::GetJobs().ParallelFor(job.num_verts, VERT_JOB_SIZE, this, 
+			&RenderObject::TransformVerts, job);
 
-		case TRANSFORM_TRANS_ONLY:
-			{
-				// transform each "transformed" vertex of the object mesh in place
-				// remember, the idea of the vlist_trans[] array is to accumulate
-				// transformations
-				for (int vertex=0; vertex < _num_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
+		// either list may have changed
+		if (coord_select == TRANSFORM_LOCAL_TO_TRANS)
+			SetTransKey(&mt, no_pos, all_frames, job.live != NULL);
+		else if (coord_select == TRANSFORM_LOCAL_ONLY)
+			++_local_version;
+		else
+			_trans_version = -1;
+	} // end if
 
-					// transform point
-					_vlist_trans[vertex].v = mt * _vlist_trans[vertex].v;
+	// finally, test if transform should be applied to orientation basis
+	// hopefully this is a rotation, otherwise the basis will get corrupted
+	if (transform_basis)
+	{
+		// now rotate orientation basis for object
+		vec4 vresult; // use to rotate each orientation vector axis
 
-					// transform vertex normal if needed
-					if (_vlist_trans[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform normal
-						_vlist_trans[vertex].n = mt * _vlist_trans[vertex].n;
-					} // end if
+		// rotate ux of basis
+		_ux = mt * _ux;
 
-				} // end for index
+		// rotate uy of basis
+		_uy = mt * _uy;
 
-			} break;
+		// rotate uz of basis
+		_uz = mt * _uz;
+	} // end if
+}
 
-		case TRANSFORM_LOCAL_TO_TRANS:
-			{
-				// transform each local/model vertex of the object mesh and store result
-				// in "transformed" vertex list
-				for (int vertex=0; vertex < _num_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
+void RenderObject::ModelToWorld(int coord_select, bool all_frames)
+{
 
-					// transform point
-					_vlist_trans[vertex].v = mt * _vlist_local[vertex].v;
+	// NOTE: Not matrix based
+	// this function converts the local model coordinates of the
+	// sent object into world coordinates, the results are stored
+	// in the transformed vertex list (vlist_trans) within the object
 
-					// transform vertex normal if needed
-					if (_vlist_local[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform point
-						_vlist_trans[vertex].n = mt * _vlist_local[vertex].n;
-					} // end if
+	// interate thru vertex list and transform all the model/local 
+	// coords to world coords by translating the vertex list by
+	// the amount world_pos and storing the results in vlist_trans[]
+	// no need to transform vertex normals, they are invariant of position
 
-				} // end for index
-			} break;
+	// nothing changed since the last time
+	if (coord_select == TRANSFORM_LOCAL_TO_TRANS && 
+		TransCurrent(NULL, _world_pos, all_frames))
+		return;
 
-		default: break;
+	// only the frame shown of an animation is moved now, the others when
+	// they're shown, if what's in them is known
+	bool lazy = LazyFrames(all_frames) && (coord_select == TRANSFORM_LOCAL_TO_TRANS ||
+		(coord_select == TRANSFORM_TRANS_ONLY && _trans_lazy && _trans_version >= 0));
 
-		} // end switch
+	VertexJob job;
+	if (!SelectVerts(coord_select, all_frames && !lazy, job))
+		return;
 
-	} // end if single frame
-	else // transform all frames
+	Modules::GetJobs().ParallelFor(job.num_verts, VERT_JOB_SIZE, this, 
+		&RenderObject::TranslateVerts, job);
+
+	// the world vertices straight from the local ones are known for the 
+	// caches, and still are when a known rotation is translated
+	if (coord_select == TRANSFORM_LOCAL_TO_TRANS)
+		SetTransKey(NULL, _world_pos, all_frames, job.live != NULL);
+	else if (coord_select == TRANSFORM_LOCAL_ONLY)
+		++_local_version;
+	else if (_trans_version >= 0 && 
+		(all_frames || _trans_frame < 0 || _trans_frame == _curr_frame))
 	{
-		// what coordinates should be transformed?
-		switch(coord_select)
+		// the known vertices moved by the world position are still known,
+		// for the current frame if that's all that moved
+		if (!all_frames)
 		{
-		case TRANSFORM_LOCAL_ONLY:
-			{
-				// transform each local/model vertex of the object mesh in place
-				for (int vertex=0; vertex < _total_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
+			_trans_frame = _curr_frame;
+			_trans_lazy  = false;
+		} // end if
 
-					// transform point
-					_head_vlist_local[vertex].v = mt * _head_vlist_local[vertex].v;
+		_trans_pos.x += _world_pos.x;
+		_trans_pos.y += _world_pos.y;
+		_trans_pos.z += _world_pos.z;
 
-					// transform vertex normal if needed
-					if (_head_vlist_local[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform normal
-						_head_vlist_local[vertex].n = mt * _head_vlist_local[vertex].n;
-					} // end if
+		_trans_partial = _trans_partial || job.live != NULL;
+		++_trans_serial;
 
+		// the other frames are now behind
+		if (_trans_lazy)
+			_frame_serial[_curr_frame] = _trans_serial;
+	} // end else if
+	else
+		_trans_version = -1;
+}
 
-				} // end for index
-			} break;
+void RenderObject::ModelToWorld(const mat4& mrot, bool all_frames)
+{
+	// the usual rotation followed by the translation to the world position
+	// in one pass over the vertices, and none if they already hold that
 
-		case TRANSFORM_TRANS_ONLY:
-			{
-				// transform each "transformed" vertex of the object mesh in place
-				// remember, the idea of the vlist_trans[] array is to accumulate
-				// transformations
-				for (int vertex=0; vertex < _total_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
+	if (TransCurrent(&mrot, _world_pos, all_frames))
+		return;
 
-					// transform point
-					_head_vlist_trans[vertex].v = mt * _head_vlist_trans[vertex].v;
+	VertexJob job;
+	SelectVerts(TRANSFORM_LOCAL_TO_TRANS, all_frames && !LazyFrames(all_frames), job);
+	job.mt  = &mrot;
+	job.pos = &_world_pos;
 
-					// transform vertex normal if needed
-					if (_head_vlist_trans[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform normal
-						_head_vlist_trans[vertex].n = mt * _head_vlist_trans[vertex].n;
-					} // end if
+	Modules::GetJobs().ParallelFor(job.num_verts, VERT_JOB_SIZE, this, 
+		&RenderObject::PlaceVerts, job);
 
-				} // end for index
+	SetTransKey(&mrot, _world_pos, all_frames, job.live != NULL);
+}
 
-			} break;
+bool RenderObject::TransCurrent(const mat4* mrot, const vec4& pos, bool all_frames) const
+{
+	// unknown, stale or incomplete
+	if (_trans_version != _local_version || _trans_partial)
+		return false;
 
-		case TRANSFORM_LOCAL_TO_TRANS:
-			{
-				// transform each local/model vertex of the object mesh and store result
-				// in "transformed" vertex list
-				for (int vertex=0; vertex < _total_vertices; vertex++)
-				{
-					vec4 presult; // hold result of each transformation
+	// all the frames are needed but only one is there, or another one
+	if (_trans_frame >= 0 && (all_frames || _trans_frame != _curr_frame))
+		return false;
 
-					// transform point
-					_head_vlist_trans[vertex].v = mt * _head_vlist_local[vertex].v;
+	// exact, like the rotation, a move under the epsilon of Equal() still
+	// moves the vertices
+	if (memcmp(&_trans_pos, &pos, sizeof(vec4)) != 0)
+		return false;
 
-					// transform vertex normal if needed
-					if (_head_vlist_local[vertex].attr & VERTEX_ATTR_NORMAL)
-					{
-						// transform point
-						_head_vlist_trans[vertex].n = mt * _head_vlist_local[vertex].n;
-					} // end if
+	if (!mrot)
+		return !_trans_rotated;
 
-				} // end for index
-			} break;
+	return _trans_rotated && memcmp(&_trans_mat, mrot, sizeof(mat4)) == 0;
+}
 
-		default: break;
+void RenderObject::SetTransKey(const mat4* mrot, const vec4& pos, bool all_frames, bool partial)
+{
+	// the frames of an animation not transformed yet are left to SetFrame()
+	// if LazyFrames() could track them, otherwise all of them were just
+	// transformed
+	bool lazy = all_frames && _num_frames > 1 && _num_frames <= _max_frame_serials;
 
-		} // end switch
+	int frame = all_frames ? -1 : _curr_frame;
 
-	} // end else multiple frames
+	// the lighting cache only lasts while the vertices hold the same thing
+	bool same = _trans_version == _local_version && _trans_frame == frame &&
+		memcmp(&_trans_pos, &pos, sizeof(vec4)) == 0 && (mrot ? _trans_rotated && 
+		memcmp(&_trans_mat, mrot, sizeof(mat4)) == 0 : !_trans_rotated);
 
-	// finally, test if transform should be applied to orientation basis
-	// hopefully this is a rotation, otherwise the basis will get corrupted
-	if (transform_basis)
-	{
-		// now rotate orientation basis for object
-		vec4 vresult; // use to rotate each orientation vector axis
+	if (!same)
+		++_trans_serial;
 
-		// rotate ux of basis
-		_ux = mt * _ux;
+	_trans_version = _local_version;
+	_trans_rotated = mrot != NULL;
+	_trans_pos     = pos;
+	_trans_frame   = frame;
+	_trans_partial = partial;
+	_trans_lazy    = lazy;
 
-		// rotate uy of basis
-		_uy = mt * _uy;
+	if (mrot)
+		_trans_mat = *mrot;
 
-		// rotate uz of basis
-		_uz = mt * _uz;
+	if (lazy)
+		_frame_serial[_curr_frame] = _trans_serial;
+}
+
+bool RenderObject::LazyFrames(bool all_frames)
+{
+	// a transformation of all the frames of an animation is only applied
+	// to the frame shown, and to the others by SetFrame() when they are,
+	// that needs to know which frames are behind, without it every frame
+	// is transformed now
+	if (!all_frames || _num_frames <= 1)
+		return false;
+
+	if (!AllocFrameSerials())
+	{
+		Modules::GetLog().WriteError("\nRenderObject::LazyFrames: out of memory for the frame serials, transforming all the frames");
+		return false;
 	} // end if
+
+	return true;
 }
 
-void RenderObject::ModelToWorld(int coord_select, bool all_frames)
+bool RenderObject::AllocFrameSerials()
 {
+	if (_num_frames <= _max_frame_serials)
+		return true;
 
-	// NOTE: Not matrix based
-	// this function converts the local model coordinates of the
-	// sent object into world coordinates, the results are stored
-	// in the transformed vertex list (vlist_trans) within the object
+	int* serials = (int*)realloc(_frame_serial, sizeof(int)*_num_frames);
+	if (!serials)
+		return false;
 
-	// interate thru vertex list and transform all the model/local 
-	// coords to world coords by translating the vertex list by
-	// the amount world_pos and storing the results in vlist_trans[]
-	// no need to transform vertex normals, they are invariant of position
+	// nothing in the new ones yet
+	for (int frame = _max_frame_serials; frame < _num_frames; frame++)
+		serials[frame] = -1;
 
-	if (!all_frames)
+	_frame_serial = serials;
+	_max_frame_serials = _num_frames;
+
+	return true;
+}
+
+void RenderObject::PlaceFrame()
+{
+	// catches the current frame up with the transformation of the others
+
+	VertexJob job;
+	SelectVerts(TRANSFORM_LOCAL_TO_TRANS, false, job);
+	job.mt   = _trans_rotated ? &_trans_mat : NULL;
+	job.pos  = &_trans_pos;
+	job.live = NULL;
+
+	Modules::GetJobs().ParallelFor(job.num_verts, VERT_JOB_SIZE, this, 
+		&RenderObject::PlaceVerts, job);
+
+	_frame_serial[_curr_frame] = _trans_serial;
+}
+
+bool RenderObject::SelectVerts(int coord_select, bool all_frames, VertexJob& job)
+{
+	// picks the source and destination vertex lists of a transformation,
+	// either the current frame or all of them, returns false if the
+	// coordinates selected are unknown
+
+	Vertex* vlist_local = all_frames ? _head_vlist_local : _vlist_local;
+	Vertex* vlist_trans = all_frames ? _head_vlist_trans : _vlist_trans;
+
+	switch(coord_select)
 	{
-		if (coord_select == TRANSFORM_LOCAL_TO_TRANS)
-		{
-			for (int vertex=0; vertex < _num_vertices; vertex++)
-			{
-				// translate vertex
-				_vlist_trans[vertex].v = _vlist_local[vertex].v + _world_pos;
-				// copy normal
-				_vlist_trans[vertex].n = _vlist_local[vertex].n;
+	case TRANSFORM_LOCAL_ONLY:
+		job.src = job.dst = vlist_local; 
+		break;
+	case TRANSFORM_TRANS_ONLY:
+		job.src = job.dst = vlist_trans; 
+		break;
+	case TRANSFORM_LOCAL_TO_TRANS:
+		job.src = vlist_local;
+		job.dst = vlist_trans;
+		break;
+	default: 
+		return false;
+	} // end switch
+
+	job.num_verts = all_frames ? _total_vertices : _num_vertices;
+	job.mt  = NULL;
+	job.pos = NULL;
+
+	// skip the vertices of the backfaces, never when the local vertices
+	// themselves are rewritten, and only the current frame is marked
+	if (_live_valid && coord_select != TRANSFORM_LOCAL_ONLY &&
+		(!all_frames || _num_frames == 1))
+		job.live = _vert_live;
+	else
+		job.live = NULL;
 
-			} // end for vertex
-		} // end if local
-		else
-		{ // TRANSFORM_TRANS_ONLY
-			for (int vertex=0; vertex < _num_vertices; vertex++)
-			{
-				// translate vertex
-				_vlist_trans[vertex].v = _vlist_trans[vertex].v + _world_pos;
-			} // end for vertex
-		} // end else trans
+	return true;
+}
 
-	} // end if single frame
-	else // all frames
+void RenderObject::TransformVerts(const VertexJob& job, int start, int end)
+{
+	// transforms the vertices [start, end) of the job, see Transform()
+
+	const mat4& mt = *job.mt;
+
+	for (int vertex = start; vertex < end; vertex++)
 	{
-		if (coord_select == TRANSFORM_LOCAL_TO_TRANS)
+		// only backfaces use it
+		if (job.live && !job.live[vertex])
+			continue;
+
+		// transform point
+		job.dst[vertex].v = mt * job.src[vertex].v;
+
+		// transform vertex normal if needed
+		if (job.src[vertex].attr & VERTEX_ATTR_NORMAL)
 		{
-			for (int vertex=0; vertex < _total_vertices; vertex++)
-			{
-				// translate vertex
-				_head_vlist_trans[vertex].v = _head_vlist_local[vertex].v + _world_pos;
-				// copy normal
-				_head_vlist_trans[vertex].n = _head_vlist_local[vertex].n;
-			} // end for vertex
-		} // end if local
-		else
-		{ // TRANSFORM_TRANS_ONLY
-			for (int vertex=0; vertex < _total_vertices; vertex++)
-			{
-				// translate vertex
-				_head_vlist_trans[vertex].v = _head_vlist_trans[vertex].v + _world_pos;
-			} // end for vertex
-		} // end else trans
+			// transform normal
+			job.dst[vertex].n = mt * job.src[vertex].n;
+		} // end if
 
-	} // end if all frames
+	} // end for vertex
 }
 
-int RenderObject::Cull(const Camera& cam,	// camera to cull relative to
-					   int cull_flags)		// clipping planes to consider
+void RenderObject::PlaceVerts(const VertexJob& job, int start, int end)
 {
+	// rotates the vertices [start, end) of the job, if there's a matrix,
+	// and translates them to the position of the job, see 
+	// ModelToWorld(mrot), the normals are rotated only
 
-	// NOTE: is matrix based
-	// this function culls an entire object from the viewing
-	// frustrum by using the sent camera information and object
-	// the cull_flags determine what axes culling should take place
-	// x, y, z or all which is controlled by ORing the flags
-	// together
-	// if the object is culled its state is modified thats all
-	// this function assumes that both the camera and the object
-	// are valid!
-	// also for OBJECT4DV2, only the current frame matters for culling
+	const vec4& pos = *job.pos;
 
+	if (!job.mt)
+	{
+		for (int vertex = start; vertex < end; vertex++)
+		{
+			if (job.live && !job.live[vertex])
+				continue;
 
-	// step 1: transform the center of the object's bounding
-	// sphere into camera space
+			job.dst[vertex].v = job.src[vertex].v + pos;
+			job.dst[vertex].n = job.src[vertex].n;
+		} // end for vertex
 
-	vec4 sphere_pos; // hold result of transforming center of bounding sphere
+		return;
+	} // end if
 
-	// transform point
-	sphere_pos = cam.CameraMat() * _world_pos;
+	const mat4& mt = *job.mt;
 
-	// step 2:  based on culling flags remove the object
+	for (int vertex = start; vertex < end; vertex++)
+	{
+		// only backfaces use it
+		if (job.live && !job.live[vertex])
+			continue;
+
+		job.dst[vertex].v = mt * job.src[vertex].v + pos;
+
+		if (job.src[vertex].attr & VERTEX_ATTR_NORMAL)
+			job.dst[vertex].n = mt * job.src[vertex].n;
+
+	} // end for vertex
+}
+
+void RenderObject::TranslateVerts(const VertexJob& job, int start, int end)
+{
+	// translates the vertices [start, end) of the job to the world position,
+	// see ModelToWorld()
+
+	for (int vertex = start; vertex < end; vertex++)
+	{
+		// only backfaces use it
+		if (job.live && !job.live[vertex])
+			continue;
+
+		// translate vertex
+		job.dst[vertex].v = job.src[vertex].v + _world_pos;
+		// copy normal, does nothing for TRANSFORM_TRANS_ONLY
+		job.dst[vertex].n = job.src[vertex].n;
+	} // end for vertex
+}
+
+bool RenderObject::SphereOutside(const Camera& cam, const vec4& sphere_pos, float radius,
+								int cull_flags)
+{
+	// tests a bounding sphere in camera space against the planes of the
+	// frustum selected by cull_flags, true if it's entirely outside
+
+	// based on culling flags reject the sphere
 	if (cull_flags & CULL_OBJECT_Z_PLANE)
 	{
 		// cull only based on z clipping planes
 
 		// test far plane
-		if ( ((sphere_pos.z - _max_radius[_curr_frame]) > cam.FarClipZ()) ||
-			((sphere_pos.z + _max_radius[_curr_frame]) < cam.NearClipZ()) )
+		if ( ((sphere_pos.z - radius) > cam.FarClipZ()) ||
+			((sphere_pos.z + radius) < cam.NearClipZ()) )
 		{ 
-			SET_BIT(_state, OBJECT_STATE_CULLED);
-			return(1);
+			return true;
 		} // end if
 
 	} // end if
@@ -924,11 +1104,10 @@ int RenderObject::Cull(const Camera& cam,	// camera to cull relative to
 		// points of the bounding sphere
 		float z_test = (0.5)*cam.ViewplaneWidth()*sphere_pos.z/cam.ViewDist();
 
-		if ( ((sphere_pos.x-_max_radius[_curr_frame]) > z_test)  || // right side
-			((sphere_pos.x+_max_radius[_curr_frame]) < -z_test) )  // left side, note sign change
+		if ( ((sphere_pos.x-radius) > z_test)  || // right side
+			((sphere_pos.x+radius) < -z_test) )  // left side, note sign change
 		{ 
-			SET_BIT(_state, OBJECT_STATE_CULLED);
-			return(1);
+			return true;
 		} // end if
 	} // end if
 
@@ -944,75 +1123,555 @@ int RenderObject::Cull(const Camera& cam,	// camera to cull relative to
 		// points of the bounding sphere
 		float z_test = (0.5)*cam.ViewplaneHeight()*sphere_pos.z/cam.ViewDist();
 
-		if ( ((sphere_pos.y-_max_radius[_curr_frame]) > z_test)  || // top side
-			((sphere_pos.y+_max_radius[_curr_frame]) < -z_test) )  // bottom side, note sign change
+		if ( ((sphere_pos.y-radius) > z_test)  || // top side
+			((sphere_pos.y+radius) < -z_test) )  // bottom side, note sign change
 		{ 
-			SET_BIT(_state, OBJECT_STATE_CULLED);
-			return(1);
+			return true;
 		} // end if
 
 	} // end if
 
-	// return failure to cull
-	return(0);
+	return false;
 }
 
-void RenderObject::RemoveBackfaces(const Camera& cam)
+float RenderObject::ProjectedRadius(const Camera& cam, const vec4& sphere_pos, float radius)
 {
+	// projects the radius of the sphere like a point at its center, the
+	// viewplane units are scaled to pixels of the viewport
 
-	// NOTE: this is not a matrix based function
-	// this function removes the backfaces from an object's
-	// polygon mesh, the function does this based on the vertex
-	// data in vlist_trans along with the camera position (only)
-	// note that only the backface state is set in each polygon
-	// also since this works on polygons the current frame is the frame
-	// that's vertices are used by the backface cull
-	// note: only operates on the current frame
-
-	// test if the object is culled
-	if (_state & OBJECT_STATE_CULLED)
-		return;
+	if (sphere_pos.z - radius <= cam.NearClipZ())
+		return FLT_MAX;
 
-	// process each poly in mesh
-	for (int poly=0; poly < _num_polys; poly++)
-	{
-		// acquire polygon
-		Polygon* curr_poly = &_plist[poly];
+	return radius * cam.ViewDist() / sphere_pos.z * cam.ViewportWidth() / cam.ViewplaneWidth();
+}
 
-		// is this polygon valid?
-		// test this polygon if and only if it's not clipped, not culled,
-		// active, and visible and not 2 sided. Note we test for backface in the event that
-		// a previous call might have already determined this, so why work
-		// harder!
-		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
-			(curr_poly->state & POLY_STATE_CLIPPED ) ||
-			(curr_poly->attr  & POLY_ATTR_2SIDED)    ||
-			(curr_poly->state & POLY_STATE_BACKFACE) )
-			continue; // move onto next poly
+int RenderObject::Cull(const Camera& cam,	// camera to cull relative to
+					   int cull_flags,		// clipping planes to consider
+					   float min_pixels)	// smallest size on screen drawn
+{
 
-		// extract vertex indices into master list, rember the polygons are 
-		// NOT self contained, but based on the vertex list stored in the object
-		// itself
-		int vindex_0 = curr_poly->vert[0];
-		int vindex_1 = curr_poly->vert[1];
-		int vindex_2 = curr_poly->vert[2];
+	// NOTE: is matrix based
+	// this function culls an entire object from the viewing
+	// frustrum by using the sent camera information and object
+	// the cull_flags determine what axes culling should take place
+	// x, y, z or all which is controlled by ORing the flags
+	// together
+	// if the object is culled its state is modified thats all
+	// this function assumes that both the camera and the object
+	// are valid!
+	// also for OBJECT4DV2, only the current frame matters for culling
 
-		// we will use the transformed polygon vertex list since the backface removal
-		// only makes sense at the world coord stage further of the pipeline 
 
-		// we need to compute the normal of this polygon face, and recall
-		// that the vertices are in cw order, u = p0->p1, v=p0->p2, n=uxv
-		vec4 u, v, n;
+	// step 1: transform the center of the object's bounding
+	// sphere into camera space
 
-		// build u, v
-		u = _vlist_trans[ vindex_1 ].v - _vlist_trans[ vindex_0 ].v;
-		v = _vlist_trans[ vindex_2 ].v - _vlist_trans[ vindex_0 ].v;
+	vec4 sphere_pos; // hold result of transforming center of bounding sphere
 
-		// compute cross product
-		n = u.Cross(v);
+	// transform point
+	sphere_pos = cam.CameraMat() * _world_pos;
 
-		// now create eye vector to viewpoint
-		vec4 view = cam.Pos() - _vlist_trans[ vindex_0 ].v;
+	// step 2:  based on culling flags remove the object
+	if (SphereOutside(cam, sphere_pos, _max_radius[_curr_frame], cull_flags))
+	{
+		SET_BIT(_state, OBJECT_STATE_CULLED);
+		return(1);
+	} // end if
+
+	// step 3: remove the object if it's too small to contribute anything,
+	// its transformation, lighting and setup would cost more than the
+	// couple of pixels it draws
+	if ((cull_flags & CULL_OBJECT_CONTRIBUTION) &&
+		2*ProjectedRadius(cam, sphere_pos, _max_radius[_curr_frame]) < min_pixels)
+	{
+		SET_BIT(_state, OBJECT_STATE_CULLED);
+		SET_BIT(_state, OBJECT_STATE_TINY);
+		return(1);
+	} // end if
+
+	// return failure to cull
+	return(0);
+}
+
+int RenderObject::BuildLODs(int num_levels, float ratio)
+{
+	// this function builds the levels of detail of the object, every level
+	// is simplified from the full mesh rather than from the level before,
+	// so the errors don't add up, the levels stop early once the mesh
+	// can't lose any more polygons without tearing it up
+
+	// the animations would need a mesh per frame
+	if (_num_frames > 1)
+		return(0);
+
+	// throw away the old levels
+	for (int level = 0; level < _num_lods; level++)
+	{
+		_lods[level]->Destroy();
+		delete _lods[level];
+	} // end for level
+
+	_num_lods = 0;
+
+	if (num_levels <= 0)
+		return(0);
+
+	RenderObject** lods = (RenderObject**)realloc(_lods, num_levels*sizeof(RenderObject*));
+	if (!lods)
+	{
+		Modules::GetLog().WriteError("\nCan't allocate %d levels of detail.", num_levels);
+		return(0);
+	} // end if
+
+	_lods = lods;
+
+	MeshSimplifier simplifier;
+
+	int num_polys = _num_polys;
+
+	for (int level = 0; level < num_levels; level++)
+	{
+		int target_polys = (int)(num_polys * ratio);
+
+		RenderObject* lod = new RenderObject;
+
+		if (!simplifier.Simplify(*this, *lod, target_polys) || lod->_num_polys >= num_polys)
+		{
+			lod->Destroy();
+			delete lod;
+			break;
+		} // end if
+
+		Modules::GetLog().WriteError("\nLevel of detail %d of object %s: %d polygons.",
+			level + 1, _name, lod->_num_polys);
+
+		_lods[_num_lods++] = lod;
+		num_polys = lod->_num_polys;
+	} // end for level
+
+	return(_num_lods);
+}
+
+int RenderObject::SelectLOD(const Camera& cam, const vec4& world_pos, float full_detail_pixels) const
+{
+	if (_num_lods == 0)
+		return(0);
+
+	// the bounding sphere goes to camera space like in Cull()
+	vec4 sphere_pos = cam.CameraMat() * world_pos;
+
+	float pixels = ProjectedRadius(cam, sphere_pos, _max_radius[_curr_frame]);
+
+	int level = 0;
+
+	while (level < _num_lods && pixels < full_detail_pixels)
+	{
+		pixels *= 2;
+		level++;
+	} // end while
+
+	return(level);
+}
+
+RenderObject* RenderObject::GetLOD(int level)
+{
+	if (level <= 0 || _num_lods == 0)
+		return this;
+
+	return _lods[(level > _num_lods ? _num_lods : level) - 1];
+}
+
+const RenderObject* RenderObject::GetLOD(int level) const
+{
+	if (level <= 0 || _num_lods == 0)
+		return this;
+
+	return _lods[(level > _num_lods ? _num_lods : level) - 1];
+}
+
+// orders polygons by the center of mass along one axis
+struct PolyCenterLess
+{
+	PolyCenterLess(const vec4* _centers, int _axis) : centers(_centers), axis(_axis) {}
+
+	bool operator()(int a, int b) const
+	{
+		return (&centers[a].x)[axis] < (&centers[b].x)[axis];
+	}
+
+	const vec4* centers;
+	int axis;
+};
+
+int RenderObject::BuildClusters(int polys_per_cluster)
+{
+	// the polygons are split recursively in halves along the longest axis
+	// of their centers, like a kd-tree, until a half has few enough of
+	// them, so each cluster is compact and its sphere small
+
+	if (_clusters)
+		free(_clusters);
+
+	if (_cluster_polys)
+		free(_cluster_polys);
+
+	_clusters = NULL;
+	_cluster_polys = NULL;
+	_num_clusters = 0;
+	_max_clusters = 0;
+	_clusters_version = -1;
+
+	// the frames of an animation would each need their own
+	if (_num_frames > 1 || _num_polys <= 0 || polys_per_cluster <= 0)
+		return(0);
+
+	// a split only happens above polys_per_cluster, so the clusters hold
+	// at least half of that, unless the whole mesh is smaller
+	_max_clusters = 2 * _num_polys / polys_per_cluster + 2;
+
+	if (!(_clusters = (Cluster*)malloc(sizeof(Cluster)*_max_clusters)))
+		return(0);
+
+	if (!(_cluster_polys = (int*)malloc(sizeof(int)*_num_polys)))
+		return(0);
+
+	vec4* centers = (vec4*)malloc(sizeof(vec4)*_num_polys);
+	if (!centers)
+		return(0);
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		const vec4& p0 = _vlist_local[ _plist[poly].vert[0] ].v;
+		const vec4& p1 = _vlist_local[ _plist[poly].vert[1] ].v;
+		const vec4& p2 = _vlist_local[ _plist[poly].vert[2] ].v;
+
+		centers[poly].x = (p0.x + p1.x + p2.x) * (1.0f / 3);
+		centers[poly].y = (p0.y + p1.y + p2.y) * (1.0f / 3);
+		centers[poly].z = (p0.z + p1.z + p2.z) * (1.0f / 3);
+
+		_cluster_polys[poly] = poly;
+	} // end for poly
+
+	SplitClusters(0, _num_polys, centers, polys_per_cluster);
+
+	free(centers);
+
+	_clusters_version = _local_version;
+
+	return(1);
+}
+
+void RenderObject::SplitClusters(int first, int count, const vec4* centers, 
+								 int polys_per_cluster)
+{
+	if (count <= polys_per_cluster)
+	{
+		Cluster& cluster = _clusters[_num_clusters++];
+		cluster.first = first;
+		cluster.count = count;
+
+		BoundCluster(cluster);
+		return;
+	} // end if
+
+	// the extents of the centers
+	vec4 vmin = centers[ _cluster_polys[first] ];
+	vec4 vmax = vmin;
+
+	for (int i = first + 1; i < first + count; i++)
+	{
+		const vec4& c = centers[ _cluster_polys[i] ];
+
+		if (c.x < vmin.x) vmin.x = c.x;
+		if (c.y < vmin.y) vmin.y = c.y;
+		if (c.z < vmin.z) vmin.z = c.z;
+
+		if (c.x > vmax.x) vmax.x = c.x;
+		if (c.y > vmax.y) vmax.y = c.y;
+		if (c.z > vmax.z) vmax.z = c.z;
+	} // end for i
+
+	int axis = 0;
+	float extent = vmax.x - vmin.x;
+
+	if (vmax.y - vmin.y > extent)
+	{
+		axis = 1;
+		extent = vmax.y - vmin.y;
+	} // end if
+
+	if (vmax.z - vmin.z > extent)
+		axis = 2;
+
+	// split at the median
+	int half = count / 2;
+
+	std::nth_element(_cluster_polys + first, _cluster_polys + first + half,
+		_cluster_polys + first + count, PolyCenterLess(centers, axis));
+
+	SplitClusters(first, half, centers, polys_per_cluster);
+	SplitClusters(first + half, count - half, centers, polys_per_cluster);
+}
+
+void RenderObject::BoundCluster(Cluster& cluster) const
+{
+	const int* polys = _cluster_polys + cluster.first;
+
+	// the sphere around the box of the vertices
+	vec4 vmin = _vlist_local[ _plist[ polys[0] ].vert[0] ].v;
+	vec4 vmax = vmin;
+
+	for (int i = 0; i < cluster.count; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			const vec4& p = _vlist_local[ _plist[ polys[i] ].vert[j] ].v;
+
+			if (p.x < vmin.x) vmin.x = p.x;
+			if (p.y < vmin.y) vmin.y = p.y;
+			if (p.z < vmin.z) vmin.z = p.z;
+
+			if (p.x > vmax.x) vmax.x = p.x;
+			if (p.y > vmax.y) vmax.y = p.y;
+			if (p.z > vmax.z) vmax.z = p.z;
+		} // end for j
+	} // end for i
+
+	cluster.center.Assign(0.5f * (vmin.x + vmax.x), 
+		0.5f * (vmin.y + vmax.y), 0.5f * (vmin.z + vmax.z));
+
+	float radius2 = 0;
+
+	// the axis of the cone is the average of the unit normals
+	vec4 axis(0, 0, 0, 1);
+	bool two_sided = false;
+
+	for (int i = 0; i < cluster.count; i++)
+	{
+		const Polygon& poly = _plist[ polys[i] ];
+
+		for (int j = 0; j < 3; j++)
+		{
+			vec4 d = _vlist_local[ poly.vert[j] ].v - cluster.center;
+			float dist2 = d.Dot(d);
+
+			if (dist2 > radius2)
+				radius2 = dist2;
+		} // end for j
+
+		if (poly.attr & POLY_ATTR_2SIDED)
+			two_sided = true;
+
+		// the same normal as RemoveBackfaces(), u=p0->p1, v=p0->p2, n=uxv
+		vec4 u = _vlist_local[ poly.vert[1] ].v - _vlist_local[ poly.vert[0] ].v;
+		vec4 v = _vlist_local[ poly.vert[2] ].v - _vlist_local[ poly.vert[0] ].v;
+		vec4 n = u.Cross(v);
+
+		float length = n.Length();
+		if (length > EPSILON_E5)
+		{
+			axis.x += n.x / length;
+			axis.y += n.y / length;
+			axis.z += n.z / length;
+		} // end if
+	} // end for i
+
+	cluster.radius = sqrtf(radius2);
+
+	cluster.axis = axis;
+	cluster.cos_cone = -1;
+	cluster.sin_cone = 0;
+
+	float length = axis.Length();
+
+	// a two sided polygon is never a backface
+	if (two_sided || length <= EPSILON_E5)
+		return;
+
+	cluster.axis.x /= length;
+	cluster.axis.y /= length;
+	cluster.axis.z /= length;
+
+	// the widest angle between the axis and a normal
+	float cos_cone = 1;
+
+	for (int i = 0; i < cluster.count; i++)
+	{
+		const Polygon& poly = _plist[ polys[i] ];
+
+		vec4 u = _vlist_local[ poly.vert[1] ].v - _vlist_local[ poly.vert[0] ].v;
+		vec4 v = _vlist_local[ poly.vert[2] ].v - _vlist_local[ poly.vert[0] ].v;
+		vec4 n = u.Cross(v);
+
+		float length = n.Length();
+		if (length <= EPSILON_E5)
+			continue;
+
+		float c = cluster.axis.Dot(n) / length;
+		if (c < cos_cone)
+			cos_cone = c;
+	} // end for i
+
+	// from 90 degrees on every camera sees some of the polygons
+	if (cos_cone <= 0)
+		return;
+
+	cluster.cos_cone = cos_cone;
+	cluster.sin_cone = sqrtf(1 - cos_cone * cos_cone);
+}
+
+int RenderObject::CullClusters(const Camera& cam, int cull_flags, const mat4* mrot)
+{
+	// for each cluster the sphere is tested against the frustum like
+	// Cull() does for the whole object, and the cone against the camera,
+	// the cluster faces away if no normal of the cone points toward the
+	// camera from any point of the sphere, with v the camera from the
+	// center, at the angle theta from the axis, and alpha the half angle
+	// of the cone, the normal nearest to v is at theta - alpha from it,
+	// so all of them face away when |v|*cos(theta - alpha) + radius <= 0
+
+	// test if the object is culled
+	if (_state & OBJECT_STATE_CULLED)
+		return(0);
+
+	// nothing to cull with
+	if (!_num_clusters || _clusters_version != _local_version)
+		return(_num_clusters);
+
+	// the camera in object space, see RemoveBackfacesLocal()
+	vec4 d = cam.Pos() - _world_pos;
+	vec4 view = d;
+
+	if (mrot)
+	{
+		const mat4& m = *mrot;
+		view.x = d.x * m.c[0][0] + d.y * m.c[0][1] + d.z * m.c[0][2];
+		view.y = d.x * m.c[1][0] + d.y * m.c[1][1] + d.z * m.c[1][2];
+		view.z = d.x * m.c[2][0] + d.y * m.c[2][1] + d.z * m.c[2][2];
+	} // end if
+
+	int clusters_left = 0;
+
+	for (int index = 0; index < _num_clusters; index++)
+	{
+		const Cluster& cluster = _clusters[index];
+		const vec4& c = cluster.center;
+
+		int state = 0;
+
+		// the center in world space and then camera space
+		vec4 world_pos(c.x, c.y, c.z, 1);
+
+		if (mrot)
+		{
+			const mat4& m = *mrot;
+			world_pos.x = c.x * m.c[0][0] + c.y * m.c[1][0] + c.z * m.c[2][0];
+			world_pos.y = c.x * m.c[0][1] + c.y * m.c[1][1] + c.z * m.c[2][1];
+			world_pos.z = c.x * m.c[0][2] + c.y * m.c[1][2] + c.z * m.c[2][2];
+		} // end if
+
+		world_pos.x += _world_pos.x;
+		world_pos.y += _world_pos.y;
+		world_pos.z += _world_pos.z;
+
+		if (SphereOutside(cam, cam.CameraMat() * world_pos, cluster.radius, cull_flags))
+			state = POLY_STATE_CLIPPED;
+		else if (cluster.cos_cone > 0)
+		{
+			vec4 v = view - c;
+			float dist = v.Length();
+
+			// the camera isn't inside the sphere
+			if (dist > cluster.radius)
+			{
+				float cos_theta = cluster.axis.Dot(v) / dist;
+
+				// and is outside the cone, theta > alpha
+				if (cos_theta < cluster.cos_cone)
+				{
+					float sin_theta = sqrtf(1 - cos_theta * cos_theta);
+
+					// cos(theta - alpha)
+					float cos_diff = cos_theta * cluster.cos_cone + sin_theta * cluster.sin_cone;
+
+					if (dist * cos_diff + cluster.radius <= 0)
+						state = POLY_STATE_BACKFACE;
+				} // end if
+			} // end if
+		} // end else if
+
+		if (!state)
+		{
+			++clusters_left;
+			continue;
+		} // end if
+
+		// the whole cluster is gone
+		const int* polys = _cluster_polys + cluster.first;
+
+		for (int i = 0; i < cluster.count; i++)
+			SET_BIT(_plist[ polys[i] ].state, state);
+
+	} // end for index
+
+	return(clusters_left);
+}
+
+void RenderObject::RemoveBackfaces(const Camera& cam)
+{
+
+	// NOTE: this is not a matrix based function
+	// this function removes the backfaces from an object's
+	// polygon mesh, the function does this based on the vertex
+	// data in vlist_trans along with the camera position (only)
+	// note that only the backface state is set in each polygon
+	// also since this works on polygons the current frame is the frame
+	// that's vertices are used by the backface cull
+	// note: only operates on the current frame
+
+	// test if the object is culled
+	if (_state & OBJECT_STATE_CULLED)
+		return;
+
+	// process each poly in mesh
+	for (int poly=0; poly < _num_polys; poly++)
+	{
+		// acquire polygon
+		Polygon* curr_poly = &_plist[poly];
+
+		// is this polygon valid?
+		// test this polygon if and only if it's not clipped, not culled,
+		// active, and visible and not 2 sided. Note we test for backface in the event that
+		// a previous call might have already determined this, so why work
+		// harder!
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->attr  & POLY_ATTR_2SIDED)    ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
+
+		// extract vertex indices into master list, rember the polygons are 
+		// NOT self contained, but based on the vertex list stored in the object
+		// itself
+		int vindex_0 = curr_poly->vert[0];
+		int vindex_1 = curr_poly->vert[1];
+		int vindex_2 = curr_poly->vert[2];
+
+		// we will use the transformed polygon vertex list since the backface removal
+		// only makes sense at the world coord stage further of the pipeline 
+
+		// we need to compute the normal of this polygon face, and recall
+		// that the vertices are in cw order, u = p0->p1, v=p0->p2, n=uxv
+		vec4 u, v, n;
+
+		// build u, v
+		u = _vlist_trans[ vindex_1 ].v - _vlist_trans[ vindex_0 ].v;
+		v = _vlist_trans[ vindex_2 ].v - _vlist_trans[ vindex_0 ].v;
+
+		// compute cross product
+		n = u.Cross(v);
+
+		// now create eye vector to viewpoint
+		vec4 view = cam.Pos() - _vlist_trans[ vindex_0 ].v;
 
 		// and finally, compute the dot product
 		float dp = n.Dot(view);
@@ -1024,6 +1683,121 @@ void RenderObject::RemoveBackfaces(const Camera& cam)
 	} // end for poly
 }
 
+void RenderObject::RemoveBackfacesLocal(const Camera& cam, const mat4* mrot)
+{
+	// the same test as RemoveBackfaces() but in object space, so it can
+	// run before the vertices are transformed, rather than transforming
+	// every vertex to find the polygons facing away, the camera alone is
+	// moved back into the space of the local vertices, the vertices the
+	// remaining polygons use are flagged and the transformations that
+	// follow skip the rest
+	// note: only operates on the current frame
+
+	// test if the object is culled
+	if (_state & OBJECT_STATE_CULLED)
+		return;
+
+	if (!UpdateLocalPlanes())
+		return;
+
+	// grow the vertex flags to the vertices of a frame
+	if (_num_vertices > _max_live_verts)
+	{
+		unsigned char* vert_live = (unsigned char*)realloc(_vert_live, _num_vertices);
+		if (!vert_live)
+			return;
+		_vert_live = vert_live;
+		_max_live_verts = _num_vertices;
+	} // end if
+
+	// the local vertices go to the world as p*mrot + world_pos, so the
+	// camera comes back as (cam - world_pos)*transpose(mrot)
+	vec4 d = cam.Pos() - _world_pos;
+	vec4 view = d;
+
+	if (mrot)
+	{
+		const mat4& m = *mrot;
+		view.x = d.x * m.c[0][0] + d.y * m.c[0][1] + d.z * m.c[0][2];
+		view.y = d.x * m.c[1][0] + d.y * m.c[1][1] + d.z * m.c[1][2];
+		view.z = d.x * m.c[2][0] + d.y * m.c[2][1] + d.z * m.c[2][2];
+	} // end if
+
+	memset(_vert_live, 0, _num_vertices);
+
+	// process each poly in mesh
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		// acquire polygon
+		Polygon* curr_poly = &_plist[poly];
+
+		// dead polygons don't need their vertices
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
+
+		// n.(view - p0) <= 0 is a backface, with n.p0 precomputed
+		if (!(curr_poly->attr & POLY_ATTR_2SIDED))
+		{
+			const vec4& plane = _local_planes[poly];
+
+			if (plane.x * view.x + plane.y * view.y + plane.z * view.z - plane.w <= 0.0f)
+			{
+				SET_BIT(curr_poly->state, POLY_STATE_BACKFACE);
+				continue;
+			} // end if
+		} // end if
+
+		// this polygon survives, so do its vertices
+		_vert_live[curr_poly->vert[0]] = 1;
+		_vert_live[curr_poly->vert[1]] = 1;
+		_vert_live[curr_poly->vert[2]] = 1;
+
+	} // end for poly
+
+	_live_valid = true;
+}
+
+bool RenderObject::UpdateLocalPlanes()
+{
+	// the planes only change with the local vertices
+	if (_planes_version == _local_version && _planes_frame == _curr_frame)
+		return true;
+
+	if (_num_polys > _max_local_planes)
+	{
+		vec4* planes = (vec4*)realloc(_local_planes, sizeof(vec4)*_num_polys);
+		if (!planes)
+			return false;
+		_local_planes = planes;
+		_max_local_planes = _num_polys;
+	} // end if
+
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		const Vertex& p0 = _vlist_local[ _plist[poly].vert[0] ];
+		const Vertex& p1 = _vlist_local[ _plist[poly].vert[1] ];
+		const Vertex& p2 = _vlist_local[ _plist[poly].vert[2] ];
+
+		// the same normal as RemoveBackfaces(), u=p0->p1, v=p0->p2, n=uxv
+		vec4 u = p1.v - p0.v;
+		vec4 v = p2.v - p0.v;
+		vec4 n = u.Cross(v);
+
+		vec4& plane = _local_planes[poly];
+		plane.x = n.x;
+		plane.y = n.y;
+		plane.z = n.z;
+		plane.w = n.Dot(p0.v);
+	} // end for poly
+
+	_planes_version = _local_version;
+	_planes_frame   = _curr_frame;
+
+	return true;
+}
+
 void RenderObject::WorldToCamera(const Camera& cam)
 {
 	// NOTE: this is a matrix based function
@@ -1050,6 +1824,8 @@ void RenderObject::WorldToCamera(const Camera& cam)
 		_vlist_trans[vertex].v = cam.CameraMat() * _vlist_trans[vertex].v;
 
 	} // end for vertex
+
+	_trans_version = -1;
 }
 
 void RenderObject::CameraToPerspective(const Camera& cam)
@@ -1087,6 +1863,8 @@ void RenderObject::CameraToPerspective(const Camera& cam)
 
 	} // end for vertex
 
+	_trans_version = -1;
+
 } // end CameraToPerspective
 
 void RenderObject::PerspectiveToScreen(const Camera& cam)
@@ -1127,6 +1905,8 @@ void RenderObject::PerspectiveToScreen(const Camera& cam)
 		_vlist_trans[vertex].y = beta  - beta *_vlist_trans[vertex].y;
 
 	} // end for vertex
+
+	_trans_version = -1;
 }
 
 // float RenderObject::GetMaxRadius() const
@@ -1153,420 +1933,289 @@ void RenderObject::LightWorld32(const Camera& cam)
 	// angle from the surface point to the light direction just like in the optimized model, but the pf term
 	// that is used for a concentration control must be 1,2,3,.... integral and non-fractional
 
-	unsigned int tmpa;
-	unsigned int r_base, g_base, b_base,  // base color being lit
-				 r_sum,  g_sum,  b_sum,   // sum of lighting process over all lights
-				 r_sum0,  g_sum0,  b_sum0,
-				 r_sum1,  g_sum1,  b_sum1,
-				 r_sum2,  g_sum2,  b_sum2,
-				 ri, gi, bi,
-				 shaded_color;            // final color
-
-	float dp,     // dot product 
-		  dist,   // distance from light to surface
-		  dists,
-		  i,      // general intensities
-		  nl,     // length of normal
-		  atten;  // attenuation computations
-
-	vec4 u, v, n, l, d, s; // used for cross product and light vector calculations
-
 	// test if the object is culled
 	if (!(_state & OBJECT_STATE_ACTIVE) ||
 		(_state & OBJECT_STATE_CULLED) ||
 		!(_state & OBJECT_STATE_VISIBLE))
 		return; 
 
-	// for each valid poly, light it...
-	for (int poly=0; poly < _num_polys; poly++)
-	{
-		// acquire polygon
-		Polygon* curr_poly = &_plist[poly];
+	// the lighting is cached across frames, the results of the last frames
+	// are still good if the world vertices are the output of ModelToWorld()
+	// for the same local vertices, rotation, position and frame, and the
+	// lights that reach the object didn't change, static objects under 
+	// static lights then only light what becomes visible for the first time
 
-		// is this polygon valid?
-		// test this polygon if and only if it's not clipped, not culled,
-		// active, and visible. Note we test for backface in the event that
-		// a previous call might have already determined this, so why work
-		// harder!
-		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
-			(curr_poly->state & POLY_STATE_CLIPPED ) ||
-			(curr_poly->state & POLY_STATE_BACKFACE) )
-			continue; // move onto next poly
-
-		// set state of polygon to lit, so we don't light again in renderlist
-		// lighting system if it happens to get called
-		SET_BIT(curr_poly->state, POLY_STATE_LIT);
-
-		// extract vertex indices into master list, rember the polygons are 
-		// NOT self contained, but based on the vertex list stored in the object
-		// itself
-		int vindex_0 = curr_poly->vert[0];
-		int vindex_1 = curr_poly->vert[1];
-		int vindex_2 = curr_poly->vert[2];
-
-		// we will use the transformed polygon vertex list since the backface removal
-		// only makes sense at the world coord stage further of the pipeline 
-
-		//Modules::GetLog().WriteError("\npoly %d",poly);
-
-		// we will use the transformed polygon vertex list since the backface removal
-		// only makes sense at the world coord stage further of the pipeline 
-
-		LightsMgr& lights = Modules::GetGraphics().GetLights();
-
-		// test the lighting mode of the polygon (use flat for flat, gouraud))
-		if (curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT)
-		{
-			// step 1: extract the base color out in RGB mode, assume RGB 888
-			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
+	const LightsMgr& lights = Modules::GetGraphics().GetLights();
 
-			// initialize color sum
-			r_sum  = 0;
-			g_sum  = 0;
-			b_sum  = 0;
-
-			//Modules::GetLog().WriteError("\nsum color=%d,%d,%d", r_sum, g_sum, b_sum);
-
-			// new optimization:
-			// when there are multiple lights in the system we will end up performing numerous
-			// redundant calculations to minimize this my strategy is to set key variables to 
-			// to MAX values on each loop, then during the lighting calcs to test the vars for
-			// the max value, if they are the max value then the first light that needs the math
-			// will do it, and then save the information into the variable (causing it to change state
-			// from an invalid number) then any other lights that need the math can use the previously
-			// computed value
-
-			// set surface normal.z to FLT_MAX to flag it as non-computed
-			n.z = FLT_MAX;
-
-			// loop thru lights
-			for (int curr_light = 0; curr_light < lights.Size(); curr_light++)
-			{
-				// is this light active
-				if (lights[curr_light].state==LIGHT_STATE_OFF)
-					continue;
-
-				//Modules::GetLog().WriteError("\nprocessing light %d",curr_light);
-
-				// what kind of light are we dealing with
-				if (lights[curr_light].attr & LIGHT_ATTR_AMBIENT)
-				{
-					//Modules::GetLog().WriteError("\nEntering ambient light...");
+	if (!AllocLightCache())
+	{
+		Modules::GetLog().WriteError("\nRenderObject::LightWorld32: out of memory for vertex lighting");
+		return;
+	}
 
-					// simply multiply each channel against the color of the 
-					// polygon then divide by 256 to scale back to 0..255
-					// use a shift in real life!!! >> 8
-					r_sum+= ((lights[curr_light].c_ambient.r * r_base) / 256);
-					g_sum+= ((lights[curr_light].c_ambient.g * g_base) / 256);
-					b_sum+= ((lights[curr_light].c_ambient.b * b_base) / 256);
+	bool world_known = _trans_version >= 0 && 
+		(_trans_frame < 0 || _trans_frame == _curr_frame);
 
-					//Modules::GetLog().WriteError("\nambient sum=%d,%d,%d", r_sum, g_sum, b_sum);
+	if (!world_known ||
+		_light_version != _trans_serial ||
+		_light_frame != _curr_frame)
+		ClearLightCache();
 
-					// there better only be one ambient light!
+	// the gouraud vertices are lit with SIMD against a structure of arrays
+	// copy of the lights that reach the object, needed every frame anyway
+	// for the specular term
+	LightsSoA soa;
+	SelectLights(lights, soa);
 
-				} // end if
-				else if (lights[curr_light].attr & LIGHT_ATTR_INFINITE)
-				{
-					//Modules::GetLog().WriteError("\nEntering infinite light...");
+	// the lights written through LightsMgr::operator [] don't bump the 
+	// version, so the hash catches them, and a change marked in the 
+	// version isn't missed if the hash happens to match
+	unsigned int hash = soa.Hash();
 
-					// infinite lighting, we need the surface normal, and the direction
-					// of the light source
+	if (lights.Version() != _lights_version || hash != _lights_hash)
+		ClearLightCache();
 
-					// test if we already computed poly normal in previous calculation
-					if (n.z==FLT_MAX)       
-					{
-						// we need to compute the normal of this polygon face, and recall
-						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+	_lights_version = lights.Version();
+	_lights_hash    = hash;
 
-						// build u, v
-						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
-						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+	// remember what the cache is for, unknown world vertices are relit
+	// every time
+	_light_version = world_known ? _trans_serial : -1;
+	_light_frame   = _curr_frame;
 
-						// compute cross product
-						n = u.Cross(v);
-					}
-
-					// at this point, we are almost ready, but we have to normalize the normal vector!
-					// this is a key optimization we can make later, we can pre-compute the length of all polygon
-					// normals, so this step can be optimized
-					// compute length of normal
-					//nl = n.LengthFast();
-					nl = curr_poly->nlength;
-
-					// ok, recalling the lighting model for infinite lights
-					// I(d)dir = I0dir * Cldir
-					// and for the diffuse model
-					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-					// so we basically need to multiple it all together
-					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-					// are slower, but the conversion to and from cost cycles
-
-					dp = n.Dot(lights[curr_light].dir);
+	// light each vertex of the gouraud polygons once, rather than once per
+	// polygon sharing it, then the polygons only gather the results
+	if (MarkGouraudVerts() > 0)
+	{
+		Modules::GetJobs().ParallelFor(_num_vertices, VERT_JOB_SIZE, this, 
+			&RenderObject::LightVerts32, soa);
+	} // end if
 
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp/nl; 
-						r_sum+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+	// the phong polygons only light the point and spot lights at the 
+	// vertices, the rest is lit per pixel by the rasterizer
+	LightsSoA local_lights;
+	local_lights.SelectLocal(soa);
 
-						//Modules::GetLog().WriteError("\ninfinite sum=%d,%d,%d", r_sum, g_sum, b_sum);
-					}
-				}
-				else if (lights[curr_light].attr & LIGHT_ATTR_POINT)
-				{
-					//Modules::GetLog().WriteError("\nEntering point light...");
+	// the polygons are lit independently, so split them over the threads,
+	// they only read the shared vertex list
+	Modules::GetJobs().ParallelFor(_num_polys, POLY_JOB_SIZE, this, 
+		&RenderObject::LightPolys32, LightJob(lights, soa, local_lights, cam.Pos()));
+}
 
-					// perform point light computations
-					// light model for point light is once again:
-					//              I0point * Clpoint
-					//  I(d)point = ___________________
-					//              kc +  kl*d + kq*d2              
-					//
-					//  Where d = |p - s|
-					// thus it's almost identical to the infinite light, but attenuates as a function
-					// of distance from the point source to the surface point being lit
+bool RenderObject::AllocLightCache()
+{
+	bool grown = false;
 
-					// test if we already computed poly normal in previous calculation
-					if (n.z==FLT_MAX)       
-					{
-						// we need to compute the normal of this polygon face, and recall
-						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+	// grow the lighting arrays to the vertices of a frame
+	if (_num_vertices > _max_lit_verts)
+	{
+		int* vert_light = (int*)realloc(_vert_light, sizeof(int)*3*_num_vertices);
+		if (!vert_light)
+			return false;
+		_vert_light = vert_light;
+
+		unsigned char* vert_mark = (unsigned char*)realloc(_vert_mark, _num_vertices);
+		if (!vert_mark)
+			return false;
+		_vert_mark = vert_mark;
+
+		_max_lit_verts = _num_vertices;
+		grown = true;
+	} // end if
 
-						// build u, v
-						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
-						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+	if (_num_polys > _max_lit_polys)
+	{
+		unsigned char* poly_lit = (unsigned char*)realloc(_poly_lit, _num_polys);
+		if (!poly_lit)
+			return false;
+		_poly_lit = poly_lit;
 
-						// compute cross product
-						n = u.Cross(v);
-					}
+		_max_lit_polys = _num_polys;
+		grown = true;
+	} // end if
 
-					// at this point, we are almost ready, but we have to normalize the normal vector!
-					// this is a key optimization we can make later, we can pre-compute the length of all polygon
-					// normals, so this step can be optimized
-					// compute length of normal
-					//nl = n.LengthFast();
-					nl = curr_poly->nlength;  
+	if (grown)
+		ClearLightCache();
 
-					// compute vector from surface to light
-					l = lights[curr_light].pos - _vlist_trans[vindex_0].v;
+	return true;
+}
 
-					// compute distance and attenuation
-					dist = l.LengthFast(); 
+void RenderObject::ClearLightCache()
+{
+	memset(_vert_mark, VERT_UNLIT, _max_lit_verts);
+	memset(_poly_lit, 0, _max_lit_polys);
+}
 
-					// and for the diffuse model
-					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-					// so we basically need to multiple it all together
-					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-					// are slower, but the conversion to and from cost cycles
-					dp = n.Dot(l);
+void RenderObject::SelectLights(const LightsMgr& lights, LightsSoA& soa) const
+{
+	LightsSoA all_lights;
+	all_lights.Build(lights);
 
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
+	float radius = _max_radius[_curr_frame];
 
-						i = 128*dp / (nl * dist * atten ); 
+	vec4 box_min, box_max;
+	box_min.Assign(_world_pos.x - radius, _world_pos.y - radius, _world_pos.z - radius);
+	box_max.Assign(_world_pos.x + radius, _world_pos.y + radius, _world_pos.z + radius);
 
-						r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} 
+	soa.Select(all_lights, box_min, box_max);
+}
 
-					//Modules::GetLog().WriteError("\npoint sum=%d,%d,%d",r_sum,g_sum,b_sum);
-				}
-				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT1)
-				{
-					//Modules::GetLog().WriteError("\nentering spot light1...");
+int RenderObject::MarkGouraudVerts()
+{
+	int pending = 0;
 
-					// perform spotlight/point computations simplified model that uses
-					// point light WITH a direction to simulate a spotlight
-					// light model for point light is once again:
-					//              I0point * Clpoint
-					//  I(d)point = ___________________
-					//              kc +  kl*d + kq*d2              
-					//
-					//  Where d = |p - s|
-					// thus it's almost identical to the infinite light, but attenuates as a function
-					// of distance from the point source to the surface point being lit
+	for (int poly = 0; poly < _num_polys; poly++)
+	{
+		const Polygon* curr_poly = &_plist[poly];
 
-					// test if we already computed poly normal in previous calculation
-					if (n.z==FLT_MAX)       
-					{
-						// we need to compute the normal of this polygon face, and recall
-						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+		// the same tests as LightPolys32(), flat takes precedence
+		if (_poly_lit[poly] ||
+			!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) ||
+			(curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT) ||
+			!(curr_poly->attr & POLY_ATTR_SHADE_MODE_GOURAUD) )
+			continue;
 
-						// build u, v
-						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
-						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			unsigned char& mark = _vert_mark[curr_poly->vert[vertex]];
 
-						// compute cross product
-						n = u.Cross(v);
-					}
+			if (mark == VERT_UNLIT)
+			{
+				mark = VERT_PENDING;
+				pending++;
+			}
+		} // end for vertex
+	} // end for poly
 
-					// at this point, we are almost ready, but we have to normalize the normal vector!
-					// this is a key optimization we can make later, we can pre-compute the length of all polygon
-					// normals, so this step can be optimized
-					// compute length of normal
-					//nl = n.LengthFast();
-					nl = curr_poly->nlength;
+	return pending;
+}
 
-					// compute vector from surface to light
-					l = lights[curr_light].pos - _vlist_trans[vindex_0].v;
+void RenderObject::LightVerts32(const LightsSoA& soa, int start, int end)
+{
+	// lights the pending vertices [start, end) of the current frame in 
+	// batches of 4, see LightWorld32()
 
-					// compute distance and attenuation
-					dist = l.LengthFast();
+	const Vertex* verts[4];
+	int index[4];
+	int light[4][3];
 
-					// and for the diffuse model
-					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-					// so we basically need to multiple it all together
-					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-					// are slower, but the conversion to and from cost cycles
+	int count = 0;
 
-					// note that I use the direction of the light here rather than a the vector to the light
-					// thus we are taking orientation into account which is similar to the spotlight model
-					dp = n.Dot(lights[curr_light].dir);
+	for (int vertex = start; vertex < end; vertex++)
+	{
+		if (_vert_mark[vertex] != VERT_PENDING)
+			continue;
 
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
+		verts[count] = &_vlist_trans[vertex];
+		index[count] = vertex;
 
-						i = 128*dp / (nl * atten ); 
+		if (++count < 4 && vertex < end-1)
+			continue;
 
-						r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					}
+		// pad a partial batch with the last vertex
+		for (int pad = count; pad < 4; pad++)
+			verts[pad] = verts[count-1];
 
-					//Modules::GetLog().WriteError("\nspotlight sum=%d,%d,%d",r_sum, g_sum, b_sum);
-				}
-				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT2) // simple version
-				{
-					//Modules::GetLog().WriteError("\nEntering spotlight2 ...");
+		soa.LightVerts4(verts, light);
 
-					// perform spot light computations
-					// light model for spot light simple version is once again:
-					//         	     I0spotlight * Clspotlight * MAX( (l . s), 0)^pf                     
-					// I(d)spotlight = __________________________________________      
-					//               		 kc + kl*d + kq*d2        
-					// Where d = |p - s|, and pf = power factor
+		for (int batch = 0; batch < count; batch++)
+		{
+			_vert_light[3*index[batch]+0] = light[batch][0];
+			_vert_light[3*index[batch]+1] = light[batch][1];
+			_vert_light[3*index[batch]+2] = light[batch][2];
 
-					// thus it's almost identical to the point, but has the extra term in the numerator
-					// relating the angle between the light source and the point on the surface
+			_vert_mark[index[batch]] = VERT_LIT;
+		} // end for batch
 
-					// test if we already computed poly normal in previous calculation
-					if (n.z==FLT_MAX)       
-					{
-						// we need to compute the normal of this polygon face, and recall
-						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+		count = 0;
+	} // end for vertex
+}
 
-						// build u, v
-						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
-						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+void RenderObject::LightPolys32(const LightJob& job, int start, int end)
+{
+	// lights the polygons [start, end) of the object, see LightWorld32()
 
-						// compute cross product
-						n = u.Cross(v);
-					}
+	const LightsMgr& lights = job.lights;
+	const MaterialsMgr& materials = Modules::GetGraphics().GetMaterials();
 
-					// at this point, we are almost ready, but we have to normalize the normal vector!
-					// this is a key optimization we can make later, we can pre-compute the length of all polygon
-					// normals, so this step can be optimized
-					// compute length of normal
-					//nl = n.LengthFast();
-					 nl = curr_poly->nlength;
+	unsigned int tmpa;
+	unsigned int r_base, g_base, b_base,  // base color being lit
+				 r_sum,  g_sum,  b_sum,   // sum of lighting process over all lights
+				 shaded_color;            // final color
 
-					// and for the diffuse model
-					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
-					// so we basically need to multiple it all together
-					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
-					// are slower, but the conversion to and from cost cycles
-					dp = n.Dot(lights[curr_light].dir);
+	float dp,     // dot product 
+		  dist,   // distance from light to surface
+		  dists,
+		  i,      // general intensities
+		  nl,     // length of normal
+		  atten;  // attenuation computations
 
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						// compute vector from light to surface (different from l which IS the light dir)
-						s = _vlist_trans[vindex_0].v - lights[curr_light].pos;
+	vec4 u, v, n, l, d, s; // used for cross product and light vector calculations
 
-						// compute length of s (distance to light source) to normalize s for lighting calc
-						dists = s.LengthFast();
+	// the flat shader skips the lights out of reach of the object too
+	bool light_marks[LightsMgr::MAX_LIGHTS];
+	job.soa.Mark(light_marks);
 
-						// compute spot light term (s . l)
-						float dpsl = s.Dot(lights[curr_light].dir) / dists;
+	// for each valid poly, light it...
+	for (int poly=start; poly < end; poly++)
+	{
+		// acquire polygon
+		Polygon* curr_poly = &_plist[poly];
 
-						// proceed only if term is positive
-						if (dpsl > 0) 
-						{
-							// compute attenuation
-							atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
+		// is this polygon valid?
+		// test this polygon if and only if it's not clipped, not culled,
+		// active, and visible. Note we test for backface in the event that
+		// a previous call might have already determined this, so why work
+		// harder!
+		if (!(curr_poly->state & POLY_STATE_ACTIVE) ||
+			(curr_poly->state & POLY_STATE_CLIPPED ) ||
+			(curr_poly->state & POLY_STATE_BACKFACE) )
+			continue; // move onto next poly
 
-							// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-							// must be integral
-							float dpsl_exp = dpsl;
+		// set state of polygon to lit, so we don't light again in renderlist
+		// lighting system if it happens to get called
+		SET_BIT(curr_poly->state, POLY_STATE_LIT);
 
-							// exponentiate for positive integral powers
-							for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-								dpsl_exp*=dpsl;
+		// the highlight moves with the viewer, so specular polygons are
+		// relit every frame, their gouraud vertices are still cached
+		const Material* mat = materials.GetSpecular(curr_poly->mati);
 
-							// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+		// lit_color[] is still good from an earlier frame
+		if (_poly_lit[poly])
+			continue;
 
-							i = 128*dp * dpsl_exp / (nl * atten ); 
+		if (!mat)
+			_poly_lit[poly] = 1;
 
-							r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+		// extract vertex indices into master list, rember the polygons are 
+		// NOT self contained, but based on the vertex list stored in the object
+		// itself
+		int vindex_0 = curr_poly->vert[0];
+		int vindex_1 = curr_poly->vert[1];
+		int vindex_2 = curr_poly->vert[2];
 
-							//Modules::GetLog().WriteError("\nSpotlight sum=%d,%d,%d",r_sum, g_sum, b_sum);
-						} // end if
-					} // end if
-				} // end if spot light
-			} // end for light
+		// we will use the transformed polygon vertex list since the backface removal
+		// only makes sense at the world coord stage further of the pipeline 
 
-			// make sure colors aren't out of range
-			if (r_sum  > 255) r_sum = 255;
-			if (g_sum  > 255) g_sum = 255;
-			if (b_sum  > 255) b_sum = 255;
+		//Modules::GetLog().WriteError("\npoly %d",poly);
 
-			//Modules::GetLog().WriteError("\nWriting final values to polygon %d = %d,%d,%d", poly, r_sum, g_sum, b_sum);
+		// we will use the transformed polygon vertex list since the backface removal
+		// only makes sense at the world coord stage further of the pipeline 
 
-			// write the color over current color
-			curr_poly->lit_color[0] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
-		} // end if
-		else if (curr_poly->attr & POLY_ATTR_SHADE_MODE_GOURAUD)
+		// test the lighting mode of the polygon (use flat for flat, gouraud))
+		if (curr_poly->attr & POLY_ATTR_SHADE_MODE_FLAT)
 		{
-			// gouraud shade, unfortunetly at this point in the pipeline, we have lost the original
-			// mesh, and only have triangles, thus, many triangles will share the same vertices and
-			// they will get lit 2x since we don't have any way to tell this, alas, performing lighting
-			// at the object level is a better idea when gouraud shading is performed since the 
-			// commonality of vertices is still intact, in any case, lighting here is similar to polygon
-			// flat shaded, but we do it 3 times, once for each vertex, additionally there are lots
-			// of opportunities for optimization, but I am going to lay off them for now, so the code
-			// is intelligible, later we will optimize
-
-			//Modules::GetLog().WriteError("\nEntering gouraud shader...");
-
-			// step 1: extract the base color out in RGB mode
-			// assume 888 format
+			// step 1: extract the base color out in RGB mode, assume RGB 888
 			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-			//Modules::GetLog().WriteError("\nBase color=%d, %d, %d", r_base, g_base, b_base);
-
-			// initialize color sum(s) for vertices
-			r_sum0  = 0;
-			g_sum0  = 0;
-			b_sum0  = 0;
-
-			r_sum1  = 0;
-			g_sum1  = 0;
-			b_sum1  = 0;
-
-			r_sum2  = 0;
-			g_sum2  = 0;
-			b_sum2  = 0;
+			// initialize color sum
+			r_sum  = 0;
+			g_sum  = 0;
+			b_sum  = 0;
 
-			//Modules::GetLog().WriteError("\nColor sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,   r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
+			//Modules::GetLog().WriteError("\nsum color=%d,%d,%d", r_sum, g_sum, b_sum);
 
 			// new optimization:
 			// when there are multiple lights in the system we will end up performing numerous
@@ -1577,7 +2226,8 @@ void RenderObject::LightWorld32(const Camera& cam)
 			// from an invalid number) then any other lights that need the math can use the previously
 			// computed value
 
-			LightsMgr& lights = Modules::GetGraphics().GetLights();
+			// set surface normal.z to FLT_MAX to flag it as non-computed
+			n.z = FLT_MAX;
 
 			// loop thru lights
 			for (int curr_light = 0; curr_light < lights.Size(); curr_light++)
@@ -1586,47 +2236,56 @@ void RenderObject::LightWorld32(const Camera& cam)
 				if (lights[curr_light].state==LIGHT_STATE_OFF)
 					continue;
 
-				//Modules::GetLog().WriteError("\nprocessing light %d", curr_light);
+				// out of reach of the object, or left to the GBuffer
+				if (!(lights[curr_light].attr & LIGHT_ATTR_AMBIENT) && !light_marks[curr_light])
+					continue;
+
+				//Modules::GetLog().WriteError("\nprocessing light %d",curr_light);
 
 				// what kind of light are we dealing with
-				if (lights[curr_light].attr & LIGHT_ATTR_AMBIENT) ///////////////////////////////
+				if (lights[curr_light].attr & LIGHT_ATTR_AMBIENT)
 				{
-					//Modules::GetLog().WriteError("\nEntering ambient light....");
+					//Modules::GetLog().WriteError("\nEntering ambient light...");
 
 					// simply multiply each channel against the color of the 
 					// polygon then divide by 256 to scale back to 0..255
 					// use a shift in real life!!! >> 8
-					ri = ((lights[curr_light].c_ambient.r * r_base) / 256);
-					gi = ((lights[curr_light].c_ambient.g * g_base) / 256);
-					bi = ((lights[curr_light].c_ambient.b * b_base) / 256);
-
-					// ambient light has the same affect on each vertex
-					r_sum0+=ri;
-					g_sum0+=gi;
-					b_sum0+=bi;
-
-					r_sum1+=ri;
-					g_sum1+=gi;
-					b_sum1+=bi;
+					r_sum+= ((lights[curr_light].c_ambient.r * r_base) / 256);
+					g_sum+= ((lights[curr_light].c_ambient.g * g_base) / 256);
+					b_sum+= ((lights[curr_light].c_ambient.b * b_base) / 256);
 
-					r_sum2+=ri;
-					g_sum2+=gi;
-					b_sum2+=bi;
+					//Modules::GetLog().WriteError("\nambient sum=%d,%d,%d", r_sum, g_sum, b_sum);
 
 					// there better only be one ambient light!
-					//Modules::GetLog().WriteError("\nexiting ambient ,sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
 
 				} // end if
-				else if (lights[curr_light].attr & LIGHT_ATTR_INFINITE) /////////////////////////////////
+				else if (lights[curr_light].attr & LIGHT_ATTR_INFINITE)
 				{
-					//Modules::GetLog().WriteError("\nentering infinite light...");
+					//Modules::GetLog().WriteError("\nEntering infinite light...");
 
 					// infinite lighting, we need the surface normal, and the direction
 					// of the light source
 
-					// no longer need to compute normal or length, we already have the vertex normal
-					// and it's length is 1.0  
-					// ....
+					// test if we already computed poly normal in previous calculation
+					if (n.z==FLT_MAX)       
+					{
+						// we need to compute the normal of this polygon face, and recall
+						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+
+						// build u, v
+						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
+						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+
+						// compute cross product
+						n = u.Cross(v);
+					}
+
+					// at this point, we are almost ready, but we have to normalize the normal vector!
+					// this is a key optimization we can make later, we can pre-compute the length of all polygon
+					// normals, so this step can be optimized
+					// compute length of normal
+					//nl = n.LengthFast();
+					nl = curr_poly->nlength;
 
 					// ok, recalling the lighting model for infinite lights
 					// I(d)dir = I0dir * Cldir
@@ -1636,54 +2295,23 @@ void RenderObject::LightWorld32(const Camera& cam)
 					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
 					// are slower, but the conversion to and from cost cycles
 
-					// need to perform lighting for each vertex (lots of redundant math, optimize later!)
-
-					//Modules::GetLog().WriteError("\nv0=[%f, %f, %f]=%f, v1=[%f, %f, %f]=%f, v2=[%f, %f, %f]=%f",
-					// curr_poly->tvlist[0].n.x, curr_poly->tvlist[0].n.y,curr_poly->tvlist[0].n.z, VECTOR4D_Length(&curr_poly->tvlist[0].n),
-					// curr_poly->tvlist[1].n.x, curr_poly->tvlist[1].n.y,curr_poly->tvlist[1].n.z, VECTOR4D_Length(&curr_poly->tvlist[1].n),
-					// curr_poly->tvlist[2].n.x, curr_poly->tvlist[2].n.y,curr_poly->tvlist[2].n.z, VECTOR4D_Length(&curr_poly->tvlist[2].n) );
-
-					// vertex 0
-					dp = _vlist_trans[ vindex_0].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp; 
-						r_sum0+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum0+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum0+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 1
-					dp = _vlist_trans[ vindex_1].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						i = 128*dp; 
-						r_sum1+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum1+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum1+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 2
-					dp = _vlist_trans[ vindex_2].n.Dot(lights[curr_light].dir);
+					dp = n.Dot(lights[curr_light].dir);
 
 					// only add light if dp > 0
 					if (dp > 0)
 					{ 
-						i = 128*dp; 
-						r_sum2+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum2+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum2+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					//Modules::GetLog().WriteError("\nexiting infinite, color sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
+						i = 128*dp/nl; 
+						r_sum+= (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
+						g_sum+= (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
+						b_sum+= (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
 
-				} // end if infinite light
-				else if (lights[curr_light].attr & LIGHT_ATTR_POINT) //////////////////////////////////////
+						//Modules::GetLog().WriteError("\ninfinite sum=%d,%d,%d", r_sum, g_sum, b_sum);
+					}
+				}
+				else if (lights[curr_light].attr & LIGHT_ATTR_POINT)
 				{
+					//Modules::GetLog().WriteError("\nEntering point light...");
+
 					// perform point light computations
 					// light model for point light is once again:
 					//              I0point * Clpoint
@@ -1694,75 +2322,58 @@ void RenderObject::LightWorld32(const Camera& cam)
 					// thus it's almost identical to the infinite light, but attenuates as a function
 					// of distance from the point source to the surface point being lit
 
-					// .. normal already in vertex
+					// test if we already computed poly normal in previous calculation
+					if (n.z==FLT_MAX)       
+					{
+						// we need to compute the normal of this polygon face, and recall
+						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+
+						// build u, v
+						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
+						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+
+						// compute cross product
+						n = u.Cross(v);
+					}
 
-					//Modules::GetLog().WriteError("\nEntering point light....");
+					// at this point, we are almost ready, but we have to normalize the normal vector!
+					// this is a key optimization we can make later, we can pre-compute the length of all polygon
+					// normals, so this step can be optimized
+					// compute length of normal
+					//nl = n.LengthFast();
+					nl = curr_poly->nlength;  
 
 					// compute vector from surface to light
-					l = lights[curr_light].pos - _vlist_trans[ vindex_0].v;
+					l = lights[curr_light].pos - _vlist_trans[vindex_0].v;
 
 					// compute distance and attenuation
-					dist = l.LengthFast();
+					dist = l.LengthFast(); 
 
 					// and for the diffuse model
 					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
 					// so we basically need to multiple it all together
 					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
 					// are slower, but the conversion to and from cost cycles
-
-					// perform the calculation for all 3 vertices
-
-					// vertex 0
-					dp = _vlist_trans[ vindex_0].n.Dot(l);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-						i = 128*dp / (dist * atten ); 
-
-						r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-
-					// vertex 1
-					dp = _vlist_trans[ vindex_1].n.Dot(l);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-						i = 128*dp / (dist * atten ); 
-
-						r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 2
-					dp = _vlist_trans[ vindex_2].n.Dot(l);
+					dp = n.Dot(l);
 
 					// only add light if dp > 0
 					if (dp > 0)
 					{ 
 						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
 
-						i = 128*dp / (dist * atten ); 
-
-						r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
+						i = 128*dp / (nl * dist * atten ); 
 
-					//Modules::GetLog().WriteError("\nexiting point light, rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
+						r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
+						g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
+						b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+					} 
 
-				} // end if point
-				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT1) ///////////////////////////////////////
+					//Modules::GetLog().WriteError("\npoint sum=%d,%d,%d",r_sum,g_sum,b_sum);
+				}
+				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT1)
 				{
+					//Modules::GetLog().WriteError("\nentering spot light1...");
+
 					// perform spotlight/point computations simplified model that uses
 					// point light WITH a direction to simulate a spotlight
 					// light model for point light is once again:
@@ -1774,12 +2385,29 @@ void RenderObject::LightWorld32(const Camera& cam)
 					// thus it's almost identical to the infinite light, but attenuates as a function
 					// of distance from the point source to the surface point being lit
 
-					//Modules::GetLog().WriteError("\nentering spotlight1....");
+					// test if we already computed poly normal in previous calculation
+					if (n.z==FLT_MAX)       
+					{
+						// we need to compute the normal of this polygon face, and recall
+						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+
+						// build u, v
+						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
+						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+
+						// compute cross product
+						n = u.Cross(v);
+					}
 
-					// .. normal is already computed
+					// at this point, we are almost ready, but we have to normalize the normal vector!
+					// this is a key optimization we can make later, we can pre-compute the length of all polygon
+					// normals, so this step can be optimized
+					// compute length of normal
+					//nl = n.LengthFast();
+					nl = curr_poly->nlength;
 
 					// compute vector from surface to light
-					l = lights[curr_light].pos - _vlist_trans[ vindex_0].v;
+					l = lights[curr_light].pos - _vlist_trans[vindex_0].v;
 
 					// compute distance and attenuation
 					dist = l.LengthFast();
@@ -1792,57 +2420,26 @@ void RenderObject::LightWorld32(const Camera& cam)
 
 					// note that I use the direction of the light here rather than a the vector to the light
 					// thus we are taking orientation into account which is similar to the spotlight model
-
-					// vertex 0
-					dp = _vlist_trans[ vindex_0].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-						i = 128*dp / ( atten ); 
-
-						r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end if
-
-					// vertex 1
-					dp = _vlist_trans[ vindex_1].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
-
-						i = 128*dp / ( atten ); 
-
-						r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end i
-
-					// vertex 2
-					dp = _vlist_trans[ vindex_2].n.Dot(lights[curr_light].dir);
+					dp = n.Dot(lights[curr_light].dir);
 
 					// only add light if dp > 0
 					if (dp > 0)
 					{ 
 						atten =  (lights[curr_light].kc + lights[curr_light].kl*dist + lights[curr_light].kq*dist*dist);    
 
-						i = 128*dp / ( atten ); 
-
-						r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-						g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-						b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-					} // end i
+						i = 128*dp / (nl * atten ); 
 
-					//Modules::GetLog().WriteError("\nexiting spotlight1, sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
+						r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
+						g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
+						b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+					}
 
-				} // end if spotlight1
-				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT2) // simple version //////////////////////////
+					//Modules::GetLog().WriteError("\nspotlight sum=%d,%d,%d",r_sum, g_sum, b_sum);
+				}
+				else if (lights[curr_light].attr & LIGHT_ATTR_SPOTLIGHT2) // simple version
 				{
+					//Modules::GetLog().WriteError("\nEntering spotlight2 ...");
+
 					// perform spot light computations
 					// light model for spot light simple version is once again:
 					//         	     I0spotlight * Clspotlight * MAX( (l . s), 0)^pf                     
@@ -1853,33 +2450,46 @@ void RenderObject::LightWorld32(const Camera& cam)
 					// thus it's almost identical to the point, but has the extra term in the numerator
 					// relating the angle between the light source and the point on the surface
 
-					// .. already have normals and length are 1.0
+					// test if we already computed poly normal in previous calculation
+					if (n.z==FLT_MAX)       
+					{
+						// we need to compute the normal of this polygon face, and recall
+						// that the vertices are in cw order, u=p0->p1, v=p0->p2, n=uxv
+
+						// build u, v
+						u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
+						v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+
+						// compute cross product
+						n = u.Cross(v);
+					}
+
+					// at this point, we are almost ready, but we have to normalize the normal vector!
+					// this is a key optimization we can make later, we can pre-compute the length of all polygon
+					// normals, so this step can be optimized
+					// compute length of normal
+					//nl = n.LengthFast();
+					 nl = curr_poly->nlength;
 
 					// and for the diffuse model
 					// Itotald =   Rsdiffuse*Idiffuse * (n . l)
 					// so we basically need to multiple it all together
 					// notice the scaling by 128, I want to avoid floating point calculations, not because they 
 					// are slower, but the conversion to and from cost cycles
-
-					//Modules::GetLog().WriteError("\nEntering spotlight2...");
-
-					// tons of redundant math here! lots to optimize later!
-
-					// vertex 0
-					dp = _vlist_trans[ vindex_0].n.Dot(lights[curr_light].dir);
+					dp = n.Dot(lights[curr_light].dir);
 
 					// only add light if dp > 0
 					if (dp > 0)
 					{ 
 						// compute vector from light to surface (different from l which IS the light dir)
-						s = _vlist_trans[ vindex_0].v - lights[curr_light].pos;
+						s = _vlist_trans[vindex_0].v - lights[curr_light].pos;
 
 						// compute length of s (distance to light source) to normalize s for lighting calc
 						dists = s.LengthFast();
 
 						// compute spot light term (s . l)
 						float dpsl = s.Dot(lights[curr_light].dir) / dists;
-							
+
 						// proceed only if term is positive
 						if (dpsl > 0) 
 						{
@@ -1896,124 +2506,135 @@ void RenderObject::LightWorld32(const Camera& cam)
 
 							// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
 
-							i = 128*dp * dpsl_exp / ( atten ); 
+							i = 128*dp * dpsl_exp / (nl * atten ); 
 
-							r_sum0 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum0 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum0 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+							r_sum += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
+							g_sum += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
+							b_sum += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
 
+							//Modules::GetLog().WriteError("\nSpotlight sum=%d,%d,%d",r_sum, g_sum, b_sum);
 						} // end if
-
 					} // end if
+				} // end if spot light
+			} // end for light
 
-					// vertex 1
-					dp = _vlist_trans[ vindex_1].n.Dot(lights[curr_light].dir);
-
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						// compute vector from light to surface (different from l which IS the light dir)
-						s = _vlist_trans[ vindex_1].v - lights[curr_light].pos;
-
-						// compute length of s (distance to light source) to normalize s for lighting calc
-						dists = s.LengthFast();
-
-						// compute spot light term (s . l)
-						float dpsl = s.Dot(lights[curr_light].dir) / dists;
-
-						// proceed only if term is positive
-						if (dpsl > 0) 
-						{
-							// compute attenuation
-							atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
-
-							// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-							// must be integral
-							float dpsl_exp = dpsl;
-
-							// exponentiate for positive integral powers
-							for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-								dpsl_exp*=dpsl;
+			// add the highlight of a specular material, computed at vertex 0
+			// with the face normal
+			if (mat)
+			{
+				if (n.z == FLT_MAX)
+				{
+					u = _vlist_trans[vindex_1].v - _vlist_trans[vindex_0].v;
+					v = _vlist_trans[vindex_2].v - _vlist_trans[vindex_0].v;
+					n = u.Cross(v);
+				}
 
-							// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+				Vertex face_vert = _vlist_trans[vindex_0];
+				face_vert.n = n * (1.0f / curr_poly->nlength);
 
-							i = 128*dp * dpsl_exp / ( atten ); 
+				const Vertex* verts[4] = { &face_vert, &face_vert, &face_vert, &face_vert };
 
-							r_sum1 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum1 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum1 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
+				int spec[4][3];
+				job.soa.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
 
-						} // end if
+				r_sum += (mat->rs.r * spec[0][0]) / 256;
+				g_sum += (mat->rs.g * spec[0][1]) / 256;
+				b_sum += (mat->rs.b * spec[0][2]) / 256;
+			} // end if specular
 
-					} // end if
+			// make sure colors aren't out of range
+			if (r_sum  > 255) r_sum = 255;
+			if (g_sum  > 255) g_sum = 255;
+			if (b_sum  > 255) b_sum = 255;
 
-					// vertex 2
-					dp = _vlist_trans[ vindex_2].n.Dot(lights[curr_light].dir);
+			//Modules::GetLog().WriteError("\nWriting final values to polygon %d = %d,%d,%d", poly, r_sum, g_sum, b_sum);
 
-					// only add light if dp > 0
-					if (dp > 0)
-					{ 
-						// compute vector from light to surface (different from l which IS the light dir)
-						s = _vlist_trans[ vindex_2].v - lights[curr_light].pos;
+			// write the color over current color
+			curr_poly->lit_color[0] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+		} // end if
+		else if (curr_poly->attr & POLY_ATTR_SHADE_MODE_GOURAUD)
+		{
+			// gouraud shade, the vertices were already lit once each by
+			// LightVerts32(), with the base color factored out, 256 = full
+			// base color, so each vertex is simply scaled by the polygon color
 
-						// compute length of s (distance to light source) to normalize s for lighting calc
-						dists = s.LengthFast();
+			// extract the base color out in RGB mode, assume 888 format
+			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-						// compute spot light term (s . l)
-						float dpsl = s.Dot(lights[curr_light].dir) / dists;
+			// the highlight of a specular material is added on top
+			int spec[4][3];
 
-						// proceed only if term is positive
-						if (dpsl > 0) 
-						{
-							// compute attenuation
-							atten = (lights[curr_light].kc + lights[curr_light].kl*dists + lights[curr_light].kq*dists*dists);    
+			if (mat)
+			{
+				const Vertex* verts[4] = { &_vlist_trans[vindex_0], &_vlist_trans[vindex_1], 
+					&_vlist_trans[vindex_2], &_vlist_trans[vindex_2] };
 
-							// for speed reasons, pf exponents that are less that 1.0 are out of the question, and exponents
-							// must be integral
-							float dpsl_exp = dpsl;
+				job.soa.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
+			} // end if
 
-							// exponentiate for positive integral powers
-							for (int e_index = 1; e_index < (int)lights[curr_light].pf; e_index++)
-								dpsl_exp*=dpsl;
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				const int* light = &_vert_light[3*curr_poly->vert[vertex]];
 
-							// now dpsl_exp holds (dpsl)^pf power which is of course (s . l)^pf 
+				r_sum = (r_base * light[0]) / 256;
+				g_sum = (g_base * light[1]) / 256;
+				b_sum = (b_base * light[2]) / 256;
 
-							i = 128*dp * dpsl_exp / ( atten ); 
+				if (mat)
+				{
+					r_sum += (mat->rs.r * spec[vertex][0]) / 256;
+					g_sum += (mat->rs.g * spec[vertex][1]) / 256;
+					b_sum += (mat->rs.b * spec[vertex][2]) / 256;
+				} // end if
 
-							r_sum2 += (lights[curr_light].c_diffuse.r * r_base * i) / (256*128);
-							g_sum2 += (lights[curr_light].c_diffuse.g * g_base * i) / (256*128);
-							b_sum2 += (lights[curr_light].c_diffuse.b * b_base * i) / (256*128);
-						} // end if
+				// make sure colors aren't out of range
+				if (r_sum  > 255) r_sum = 255;
+				if (g_sum  > 255) g_sum = 255;
+				if (b_sum  > 255) b_sum = 255;
 
-					} // end if
+				curr_poly->lit_color[vertex] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+			} // end for vertex
+		}
+		else if (curr_poly->attr & POLY_ATTR_SHADE_MODE_PHONG)
+		{
+			// fast phong shade, the ambient and infinite lights are fetched per
+			// pixel from the normal table by the rasterizer, so only the point
+			// and spot lights (and the highlight) are lit at the vertices
 
-					//Modules::GetLog().WriteError("\nexiting spotlight2, sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,   r_sum1, g_sum1, b_sum1,  r_sum2, g_sum2, b_sum2);
+			// extract the base color out in RGB mode, assume 888 format
+			_RGB8888FROM32BIT(curr_poly->color, &tmpa, &r_base, &g_base, &b_base);
 
-				} // end if spot light
+			const Vertex* verts[4] = { &_vlist_trans[vindex_0], &_vlist_trans[vindex_1], 
+				&_vlist_trans[vindex_2], &_vlist_trans[vindex_2] };
 
-			} // end for light
+			int light[4][3];
+			job.local.LightVerts4(verts, light);
 
-			// make sure colors aren't out of range
-			if (r_sum0  > 255) r_sum0 = 255;
-			if (g_sum0  > 255) g_sum0 = 255;
-			if (b_sum0  > 255) b_sum0 = 255;
+			int spec[4][3];
 
-			if (r_sum1  > 255) r_sum1 = 255;
-			if (g_sum1  > 255) g_sum1 = 255;
-			if (b_sum1  > 255) b_sum1 = 255;
+			if (mat)
+				job.soa.SpecularVerts4(verts, job.view_pos, mat->spec_table, spec);
 
-			if (r_sum2  > 255) r_sum2 = 255;
-			if (g_sum2  > 255) g_sum2 = 255;
-			if (b_sum2  > 255) b_sum2 = 255;
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				r_sum = (r_base * light[vertex][0]) / 256;
+				g_sum = (g_base * light[vertex][1]) / 256;
+				b_sum = (b_base * light[vertex][2]) / 256;
 
-			//Modules::GetLog().WriteError("\nwriting color for poly %d", poly);
+				if (mat)
+				{
+					r_sum += (mat->rs.r * spec[vertex][0]) / 256;
+					g_sum += (mat->rs.g * spec[vertex][1]) / 256;
+					b_sum += (mat->rs.b * spec[vertex][2]) / 256;
+				} // end if
 
-			//Modules::GetLog().WriteError("\n******** final sums rgb0[%d, %d, %d], rgb1[%d,%d,%d], rgb2[%d,%d,%d]", r_sum0, g_sum0, b_sum0,  r_sum1, g_sum1, b_sum1, r_sum2, g_sum2, b_sum2);
+				// make sure colors aren't out of range
+				if (r_sum  > 255) r_sum = 255;
+				if (g_sum  > 255) g_sum = 255;
+				if (b_sum  > 255) b_sum = 255;
 
-			// write the colors
-			curr_poly->lit_color[0] = Modules::GetGraphics().GetColor(r_sum0, g_sum0, b_sum0);
-			curr_poly->lit_color[1] = Modules::GetGraphics().GetColor(r_sum1, g_sum1, b_sum1);
-			curr_poly->lit_color[2] = Modules::GetGraphics().GetColor(r_sum2, g_sum2, b_sum2);
+				curr_poly->lit_color[vertex] = Modules::GetGraphics().GetColor(r_sum, g_sum, b_sum);
+			} // end for vertex
 		}
 		else // assume POLY_ATTR_SHADE_MODE_CONSTANT
 		{
@@ -2300,8 +2921,13 @@ int RenderObject::ComputeVertexNormals()
 	// the array is used to count the number of contributors to the vertex
 	// so at the end of the process we can divide each "accumulated" normal
 	// and average
-	int polys_touch_vertex[MAX_VERTICES];
-	memset((void *)polys_touch_vertex, 0, sizeof(int)*MAX_VERTICES);
+	// the meshes have no upper size, so it comes from the heap
+	int* polys_touch_vertex = (int*)calloc(_num_vertices, sizeof(int));
+	if (!polys_touch_vertex)
+	{
+		Modules::GetLog().WriteError("\nCan't allocate the vertex normal counters of %d vertices.", _num_vertices);
+		return(0);
+	} // end if
 
 	// iterate thru the poly list of the object, compute its normal, then add
 	// each vertice that composes it to the "touching" vertex array
@@ -2312,7 +2938,7 @@ int RenderObject::ComputeVertexNormals()
 		Modules::GetLog().WriteError("\nprocessing poly %d", poly);
 
 		// test if this polygon needs vertex normals
-		if (_plist[poly].attr & POLY_ATTR_SHADE_MODE_GOURAUD)
+		if (_plist[poly].attr & (POLY_ATTR_SHADE_MODE_GOURAUD | POLY_ATTR_SHADE_MODE_PHONG))
 		{
 			// extract vertex indices into master list, rember the polygons are 
 			// NOT self contained, but based on the vertex list stored in the object
@@ -2383,6 +3009,8 @@ int RenderObject::ComputeVertexNormals()
 
 	} // end for
 
+	free(polys_touch_vertex);
+
 	// return success
 	return(1);
 }
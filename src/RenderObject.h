@@ -28,6 +28,7 @@ namespace t3d {
 #define OBJECT_STATE_ACTIVE           0x0001
 #define OBJECT_STATE_VISIBLE          0x0002 
 #define OBJECT_STATE_CULLED           0x0004
+#define OBJECT_STATE_TINY             0x0008 // culled for covering too few pixels
 
 #define OBJECT_ATTR_SINGLE_FRAME      0x0001 // single frame object (emulates ver 1.0)
 #define OBJECT_ATTR_MULTI_FRAME       0x0002 // multi frame object for .md2 support etc.
@@ -39,9 +40,12 @@ namespace t3d {
 #define CULL_OBJECT_Y_PLANE           0x0002 // cull on the y clipping planes
 #define CULL_OBJECT_Z_PLANE           0x0004 // cull on the z clipping planes
 #define CULL_OBJECT_XYZ_PLANES        (CULL_OBJECT_X_PLANE | CULL_OBJECT_Y_PLANE | CULL_OBJECT_Z_PLANE)
+#define CULL_OBJECT_CONTRIBUTION      0x0008 // cull the objects too small on the screen
 
 class Camera;
 class RenderObject;
+class LightsMgr;
+class LightsSoA;
 
 int load_plg(RenderObject* obj, const char* filename, 
 			const vec4* scale, const vec4* pos, const vec4* rot);
@@ -92,20 +96,94 @@ public:
 	void Transform(const mat4& mt, int coord_select, int transform_basis,
 		bool all_frames = true);
 
+	// both skip the work when the transformed vertices already hold the
+	// result, the same local vertices, rotation, position and frame as 
+	// last time, so static objects aren't transformed again every frame
 	void ModelToWorld(int coord_select=TRANSFORM_LOCAL_TO_TRANS,
 		bool all_frames = true);
 
-	int Cull(const Camera& cam, int cull_flags);
+	// Transform(mrot, TRANSFORM_LOCAL_TO_TRANS) and ModelToWorld(
+	// TRANSFORM_TRANS_ONLY) in one pass, local*mrot + world_pos, the
+	// orientation basis is left alone
+	void ModelToWorld(const mat4& mrot, bool all_frames = true);
+
+	// with CULL_OBJECT_CONTRIBUTION the objects whose bounding sphere is
+	// less than min_pixels across on the screen are culled as well and
+	// flagged OBJECT_STATE_TINY, so the caller can draw a point instead,
+	// see RenderList::InsertPoint()
+	int Cull(const Camera& cam, int cull_flags, float min_pixels = CULL_PIXELS);
+
+	// tests a bounding sphere in camera space against the planes of the
+	// frustum selected by cull_flags, true if it's entirely outside
+	static bool SphereOutside(const Camera& cam, const vec4& sphere_pos, float radius,
+		int cull_flags);
+
+	// the radius in pixels of a bounding sphere in camera space once it's
+	// projected on the viewport, FLT_MAX if it reaches the near plane
+	static float ProjectedRadius(const Camera& cam, const vec4& sphere_pos, float radius);
+
+	// builds num_levels simplified copies of the mesh, each with about
+	// ratio times the polygons of the one before, see MeshSimplifier, call
+	// it once after loading, the levels are objects of their own that share
+	// the texture, returns the number of levels built, 0 for multi frame
+	int BuildLODs(int num_levels = LOD_LEVELS, float ratio = 0.5f);
+
+	// the level to draw at world_pos, the full mesh while its bounding 
+	// sphere covers full_detail_pixels of radius on the screen, then one
+	// level coarser each time the radius halves
+	int SelectLOD(const Camera& cam, const vec4& world_pos, 
+		float full_detail_pixels = LOD_PIXELS) const;
+
+	// level 0 is the object itself
+	RenderObject* GetLOD(int level);
+	const RenderObject* GetLOD(int level) const;
+	int LODsNum() const { return _num_lods; }
+
+	// recomputes the object space planes of the polygons of the current 
+	// frame if the local vertices changed, returns false if out of memory,
+	// RenderList::InsertInstances() tests the backfaces of the instances 
+	// with them, call it before the mesh is shared between threads
+	bool UpdateLocalPlanes();
+
+	// splits the mesh into clusters of about polys_per_cluster polygons
+	// that lie close together, each with a bounding sphere and a cone that
+	// holds the normals of its polygons, the loaders do this for the
+	// single frame meshes, returns 0 if out of memory or multi frame
+	int BuildClusters(int polys_per_cluster = CLUSTER_POLYS);
+
+	// rejects the clusters outside the frustum or facing away from the
+	// camera with one test each, before anything is done per polygon,
+	// their polygons are flagged clipped or backface, mrot is the rotation
+	// the local vertices will go through, if any, the clusters are lost
+	// once the local vertices change, returns the number of clusters left
+	int CullClusters(const Camera& cam, int cull_flags, const mat4* mrot = NULL);
+
+	int ClustersNum() const { return _num_clusters; }
 
 	void RemoveBackfaces(const Camera& cam);
 
+	// removes the backfaces before the vertices are transformed, the camera
+	// is moved into object space once and tested against the planes of the
+	// local polygons, then Transform() and ModelToWorld() up to the next 
+	// Reset() skip the vertices only the backfaces use, their transformed
+	// copies are left stale, mrot is the rotation the local vertices will
+	// go through, if any, translation is taken from the world position
+	void RemoveBackfacesLocal(const Camera& cam, const mat4* mrot = NULL);
+
 	void WorldToCamera(const Camera& cam);
 
 	void CameraToPerspective(const Camera& cam);
 
 	void PerspectiveToScreen(const Camera& cam);
 
+	// the lighting is kept across frames while the world vertices and the
+	// lights reaching the object stay the same, see LightWorld32(), call
+	// this after changing something else the lighting depends on
 	void LightWorld32(const Camera& cam);
+	void InvalidateLighting() { _light_version = -1; }
+
+	// call after writing the local vertices directly
+	void LocalVertsChanged() { ++_local_version; }
 
 	void DrawWire32(unsigned char* video_buffer, int lpitch);
 	void DrawSolid32(unsigned char* video_buffer, int lpitch);
@@ -126,10 +204,10 @@ public:
 	const Vertex& GetLocalVertex(size_t index) const { return _vlist_local[index]; }
 
 	const Vertex& GetTransVertex(size_t index) const { return _vlist_trans[index]; }
-	Vertex& GetTransVertexRef(size_t index) { return _vlist_trans[index]; }
+	Vertex& GetTransVertexRef(size_t index) { _trans_version = -1; return _vlist_trans[index]; }
 
 	const Polygon& GetPolygon(size_t index) const { return _plist[index]; }
-	Polygon& GetPolygonRef(size_t index) { return _plist[index]; }
+	Polygon& GetPolygonRef(size_t index) { _light_version = -1; return _plist[index]; }
 
 	int VerticesNum() const { return _num_vertices; }
 	int PolyNum() const { return _num_polys; }
@@ -144,9 +222,102 @@ private:
 	int ComputePolyNormals();
 	int ComputeVertexNormals();
 
+	// the vertex lists a transformation reads and writes, the stages
+	// are split in ranges of vertices or polygons and run in parallel
+	struct VertexJob
+	{
+		const Vertex* src;
+		Vertex* dst;
+		int num_verts;
+		const mat4* mt;
+		const vec4* pos;			// translation of PlaceVerts()
+		const unsigned char* live;	// NULL or 0 for the vertices to skip
+	};
+
+	bool SelectVerts(int coord_select, bool all_frames, VertexJob& job);
+	void TransformVerts(const VertexJob& job, int start, int end);
+	void TranslateVerts(const VertexJob& job, int start, int end);
+	void PlaceVerts(const VertexJob& job, int start, int end);
+
+	// whether the transformed vertices are local*mrot + pos, mrot NULL
+	// for none, for the current local vertices and all of them
+	bool TransCurrent(const mat4* mrot, const vec4& pos, bool all_frames) const;
+
+	// records what a transformation from the local vertices wrote
+	void SetTransKey(const mat4* mrot, const vec4& pos, bool all_frames, bool partial);
+
+	// the frames of an animation are transformed as they're shown, or all
+	// at once if there's no memory to track them
+	bool LazyFrames(bool all_frames);
+	bool AllocFrameSerials();
+	void PlaceFrame();
+
+	// the flat shader walks the lights as they are, the specular term is
+	// added with the SIMD copy of them and needs the viewer, the phong 
+	// polygons only light the point and spot lights of the copy
+	struct LightJob
+	{
+		LightJob(const LightsMgr& _lights, const LightsSoA& _soa, 
+			const LightsSoA& _local, const vec4& _view_pos)
+			: lights(_lights)
+			, soa(_soa)
+			, local(_local)
+			, view_pos(_view_pos)
+		{}
+
+		const LightsMgr& lights;
+		const LightsSoA& soa;
+		const LightsSoA& local;
+		vec4 view_pos;
+	};
+
+	void LightPolys32(const LightJob& job, int start, int end);
+	void LightVerts32(const LightsSoA& soa, int start, int end);
+
+	// grows the lighting arrays to the object, returns false if out of memory
+	bool AllocLightCache();
+	void ClearLightCache();
+
+	// the lights whose range reaches the bounding sphere of the object
+	void SelectLights(const LightsMgr& lights, LightsSoA& soa) const;
+
+	// flags the vertices of the live gouraud polygons that aren't lit yet,
+	// so LightVerts32() lights each of them once, returns how many
+	int MarkGouraudVerts();
+
+	// a group of polygons culled together, in local space
+	struct Cluster
+	{
+		int first;			// polygons in _cluster_polys[]
+		int count;
+		vec4 center;		// bounding sphere
+		float radius;
+		vec4 axis;			// unit axis of the normal cone
+		float cos_cone;		// half angle of the cone, -1 if it can't be culled
+		float sin_cone;
+	};
+
+	// splits the polygons [first, first+count) of _cluster_polys[] along
+	// the longest axis of their centers until they are small enough
+	void SplitClusters(int first, int count, const vec4* centers, int polys_per_cluster);
+	void BoundCluster(Cluster& cluster) const;
+
+	// number of vertices and polygons handed to a thread at once
+	static const int VERT_JOB_SIZE = 512;
+	static const int POLY_JOB_SIZE = 256;
+
+	// states of the vertices in _vert_mark[]
+	static const int VERT_UNLIT   = 0;
+	static const int VERT_PENDING = 1;  // lit by the next LightVerts32()
+	static const int VERT_LIT     = 2;  // _vert_light[] holds its lighting
+
 public:
-	static const int MAX_VERTICES = 4096;
-	static const int MAX_POLYS = 8192;
+	static const int CLUSTER_POLYS = 64;
+
+	static const int CULL_PIXELS = 2;
+
+	static const int LOD_LEVELS = 3;
+	static const int LOD_PIXELS = 64;
 
 private:
 	int  _id;				// numeric id of this object
@@ -171,8 +342,8 @@ private:
 	int _total_vertices;	// total vertices, redudant, but it saves a multiply in a lot of places
 	int _curr_frame;		// current animation frame (0) if single frame
 
-	Vertex* _vlist_local;	// [MAX_VERTICES] // array of local vertices
-	Vertex* _vlist_trans;	// [MAX_VERTICES] // array of transformed vertices
+	Vertex* _vlist_local;	// [vertices] // array of local vertices
+	Vertex* _vlist_trans;	// [vertices] // array of transformed vertices
 
 	// these are needed to track the "head" of the vertex list for mult-frame objects
 	Vertex* _head_vlist_local;
@@ -185,11 +356,62 @@ private:
 	int _num_polys;			// number of polygons in object mesh
 	Polygon* _plist;		// array of polygons
 
+	// the gouraud polygons share their vertices, so the vertices are lit
+	// once and the polygons scale their colors by the results
+	int* _vert_light;		// [3*vertices] light r,g,b of each vertex, 256 = full base color
+	unsigned char* _vert_mark;	// [vertices] VERT_UNLIT, VERT_PENDING or VERT_LIT
+	unsigned char* _poly_lit;	// [polys] lit_color[] of the polygon is still good
+	int _max_lit_verts;		// size of the arrays above, grown on demand
+	int _max_lit_polys;
+
+	// the transformed vertices are known to be local*_trans_mat + 
+	// _trans_pos after Transform() or ModelToWorld() from the local 
+	// vertices, anything else writing the local or transformed vertices
+	// resets this
+	int  _local_version;	// bumped when the local vertices change
+	int  _trans_version;	// _local_version that was read, -1 if unknown
+	mat4 _trans_mat;		// rotation applied, if _trans_rotated
+	bool _trans_rotated;
+	vec4 _trans_pos;		// translation applied
+	int  _trans_frame;		// frame transformed, -1 all of them
+	bool _trans_partial;	// the vertices of the backfaces were skipped
+	bool _trans_lazy;		// all frames, but only those in _frame_serial[] are done
+	int  _trans_serial;		// bumped whenever the above change
+	int* _frame_serial;		// [frames] _trans_serial each frame was transformed for
+	int  _max_frame_serials;
+
+	// what the cached lighting is for
+	int  _light_version;	// _trans_serial, -1 if nothing is cached
+	int  _light_frame;
+	int  _lights_version;	// LightsMgr::Version() last seen
+	unsigned int _lights_hash;	// hash of the lights that reached the object
+
+	// object space backface removal, see RemoveBackfacesLocal()
+	vec4* _local_planes;	// [polys] normal in x,y,z, n.p0 in w
+	int   _max_local_planes;
+	int   _planes_version;	// _local_version the planes were built from
+	int   _planes_frame;
+	unsigned char* _vert_live;	// [vertices] 1 if a front facing polygon uses it
+	int   _max_live_verts;
+	bool  _live_valid;		// _vert_live[] holds for this frame
+
+	// clusters of polygons, see BuildClusters()
+	Cluster* _clusters;
+	int   _num_clusters;
+	int   _max_clusters;
+	int*  _cluster_polys;	// [polys] polygon indices grouped by cluster
+	int   _clusters_version;	// _local_version the clusters were built from
+
+	// simplified copies of the mesh, see BuildLODs()
+	RenderObject** _lods;	// [levels] level 1 and up
+	int   _num_lods;
+
 	int   _ivar1, _ivar2;   // auxiliary vars
 	float _fvar1, _fvar2;   // auxiliary vars
 
 	friend class RenderList;
 	friend class MD2Container;
+	friend class MeshSimplifier;
 
 	// todo
 	friend class raider3d::AlienList;
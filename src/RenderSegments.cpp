@@ -0,0 +1,94 @@
+#include "RenderSegments.h"
+
+#include <stdlib.h>
+
+#include "Modules.h"
+#include "Log.h"
+#include "RenderList.h"
+
+namespace t3d {
+
+RenderSegments::RenderSegments()
+	: _segments(NULL)
+	, _num_segments(0)
+{
+}
+
+RenderSegments::~RenderSegments()
+{
+	for (int i = 0; i < _num_segments; i++)
+		delete _segments[i];
+	free(_segments);
+}
+
+bool RenderSegments::GrowSegments(int num_segments)
+{
+	if (num_segments <= _num_segments)
+		return true;
+
+	RenderList** segments = (RenderList**)realloc(_segments, num_segments*sizeof(RenderList*));
+	if (!segments)
+	{
+		Modules::GetLog().WriteError("\nRenderSegments: can't grow to %d segments.", num_segments);
+		return false;
+	}
+
+	_segments = segments;
+	while (_num_segments < num_segments)
+		_segments[_num_segments++] = new RenderList;
+
+	return true;
+}
+
+void RenderSegments::Build(RenderList& list, int count, ObjectPreparer& preparer)
+{
+	int num_segments = (count + OBJECTS_PER_SEGMENT - 1) / OBJECTS_PER_SEGMENT;
+
+	// no segments, then prepare them right into the list
+	if (!GrowSegments(num_segments))
+	{
+		preparer.PrepareObjects(0, count, list);
+		return;
+	}
+
+	for (int i = 0; i < num_segments; i++)
+	{
+		_segments[i]->Reset();
+		_segments[i]->SetAttr(list.Attr());
+	} // end for i
+
+	// the chunks of the job system line up with the segments, so each
+	// segment is only ever filled by one thread
+	PrepareTask task(*this, preparer);
+	Modules::GetJobs().ParallelFor(count, OBJECTS_PER_SEGMENT, task);
+
+	// now the deterministic merge
+	for (int i = 0; i < num_segments; i++)
+	{
+		if (!list.Append(*_segments[i]))
+		{
+			Modules::GetLog().WriteError("\nRenderSegments: out of memory merging segment %d of %d.", i, num_segments);
+			return;
+		}
+	} // end for i
+}
+
+void RenderSegments::PrepareTask::Run(int start, int end)
+{
+	// the range is handed over a segment at a time, so the preparer can
+	// batch the objects of each
+	while (start < end)
+	{
+		int segment = start / OBJECTS_PER_SEGMENT;
+
+		int last = (segment + 1) * OBJECTS_PER_SEGMENT;
+		if (last > end)
+			last = end;
+
+		_preparer.PrepareObjects(start, last, *_segments._segments[segment]);
+
+		start = last;
+	} // end while
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "JobSystem.h"
+
+namespace t3d {
+
+class RenderList;
+
+// prepares one object of a scene for rendering, PrepareObject() is called
+// on any thread of the job system, it culls, transforms and inserts the
+// object into the sent segment, so any scratch data it writes must belong
+// to the object, the calls for different objects run at the same time
+class ObjectPreparer
+{
+public:
+	virtual ~ObjectPreparer() {}
+
+	virtual void PrepareObject(int index, RenderList& segment) = 0;
+
+	// prepares the objects [start, end), which all go to the same segment,
+	// one by one, override it to insert them in batches
+	virtual void PrepareObjects(int start, int end, RenderList& segment) {
+		for (int index = start; index < end; index++)
+			PrepareObject(index, segment);
+	}
+
+}; // ObjectPreparer
+
+// per thread render list segments, the objects are prepared in parallel
+// each run of OBJECTS_PER_SEGMENT objects into its own segment, then the
+// segments are appended to the final list in object order, so the list 
+// comes out exactly as if the objects were inserted one after another
+class RenderSegments
+{
+public:
+	RenderSegments();
+	~RenderSegments();
+
+	// prepares the objects [0, count) and merges them into list
+	void Build(RenderList& list, int count, ObjectPreparer& preparer);
+
+private:
+	bool GrowSegments(int num_segments);
+
+	// runs the preparer over a range of objects
+	class PrepareTask : public ParallelTask
+	{
+	public:
+		PrepareTask(RenderSegments& segments, ObjectPreparer& preparer)
+			: _segments(segments)
+			, _preparer(preparer)
+		{}
+
+		virtual void Run(int start, int end);
+
+	private:
+		RenderSegments& _segments;
+		ObjectPreparer& _preparer;
+
+	}; // PrepareTask
+
+private:
+	static const int OBJECTS_PER_SEGMENT = 16;
+
+	// the segments are kept across frames, so their memory is reused
+	RenderList** _segments;
+	int _num_segments;
+
+}; // RenderSegments
+
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "ShadowMap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "Camera.h"
+#include "RenderList.h"
+#include "Modules.h"
+#include "Graphics.h"
+#include "JobSystem.h"
+
+namespace t3d {
+
+// number of image rows handed to a thread at once by Apply()
+static const int APPLY_JOB_ROWS = 16;
+
+static mat4 RigidInverse(const mat4& m)
+{
+	// the camera matrices are a rotation followed by a translation, with
+	// row vectors p' = p*R + t, so p = (p' - t)*transpose(R)
+	mat4 inv;
+
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			inv.c[i][j] = m.c[j][i];
+
+	for (int j = 0; j < 3; j++)
+		inv.c[3][j] = -(m.c[3][0] * inv.c[0][j] + m.c[3][1] * inv.c[1][j] + m.c[3][2] * inv.c[2][j]);
+
+	return inv;
+}
+
+ShadowMap::ShadowMap()
+	: _depth(NULL)
+	, _size(0)
+	, _alpha(0)
+	, _beta(0)
+	, _scale_x(0)
+	, _scale_y(0)
+	, _near_z(0)
+	, _bias(5)
+	, _pcf(false)
+	, _rendered(false)
+{
+}
+
+ShadowMap::~ShadowMap()
+{
+	Delete();
+}
+
+int ShadowMap::Create(int size)
+{
+	// is there any memory already allocated
+	Delete();
+
+	if (!(_depth = (float*)malloc(size * size * sizeof(float))))
+		return(0);
+
+	_size = size;
+
+	return(1);
+}
+
+int ShadowMap::Delete()
+{
+	if (_depth)
+		free(_depth);
+
+	_depth = NULL;
+	_size = 0;
+	_rendered = false;
+
+	return(1);
+}
+
+void ShadowMap::Render(RenderList& list, const Camera& light_cam)
+{
+	if (!_depth)
+		return;
+
+	// 0.0f is all zero bits
+	memset(_depth, 0, _size * _size * sizeof(float));
+
+	// the usual pipeline, only from the light
+	list.WorldToCamera(light_cam);
+	list.ClipPolys(light_cam, CLIP_POLY_X_PLANE | CLIP_POLY_Y_PLANE | CLIP_POLY_Z_PLANE);
+	list.CameraToPerspective(light_cam);
+	list.PerspectiveToScreen(light_cam);
+
+	list.DrawDepth((unsigned char*)_depth, _size * sizeof(float), _size, _size);
+
+	// remember the projection for the lookups
+	_mlight  = light_cam.CameraMat();
+	_alpha   = 0.5f * light_cam.ViewportWidth() - 0.5f;
+	_beta    = 0.5f * light_cam.ViewportHeight() - 0.5f;
+	_scale_x = _alpha * light_cam.ViewDist();
+	_scale_y = _beta * light_cam.ViewDist() * light_cam.AspectRatio();
+	_near_z  = light_cam.NearClipZ();
+
+	_rendered = true;
+}
+
+float ShadowMap::Lookup(const vec4& world_pos) const
+{
+	if (!_rendered)
+		return 1;
+
+	vec4 p(world_pos.x, world_pos.y, world_pos.z, 1);
+	vec4 pl = _mlight * p;
+
+	return Visibility(pl.x, pl.y, pl.z);
+}
+
+float ShadowMap::Visibility(float x, float y, float z) const
+{
+	// behind the light
+	if (z <= _near_z)
+		return 1;
+
+	float inv_z = 1.0f / z;
+
+	int sx = (int)(_alpha + _scale_x * x * inv_z + 0.5f);
+	int sy = (int)(_beta - _scale_y * y * inv_z + 0.5f);
+
+	// the point is in shadow if an occluder is nearer than z - bias, in 1/z
+	// that's w * (z - bias) > 1
+	float z_test = z - _bias;
+
+	if (z_test <= 0)
+		return 1;
+
+	if (!_pcf)
+	{
+		if (sx < 0 || sy < 0 || sx >= _size || sy >= _size)
+			return 1;
+
+		return _depth[sy * _size + sx] * z_test > 1 ? 0.0f : 1.0f;
+	} // end if
+
+	// percentage closer filtering, the fraction of the 3x3 texels that
+	// don't cover the point
+	int lit = 0, samples = 0;
+
+	for (int ty = sy - 1; ty <= sy + 1; ty++)
+	{
+		if (ty < 0 || ty >= _size)
+			continue;
+
+		const float* row = _depth + ty * _size;
+
+		for (int tx = sx - 1; tx <= sx + 1; tx++)
+		{
+			if (tx < 0 || tx >= _size)
+				continue;
+
+			++samples;
+
+			if (row[tx] * z_test <= 1)
+				++lit;
+		} // end for tx
+	} // end for ty
+
+	return samples ? (float)lit / samples : 1.0f;
+}
+
+void ShadowMap::Apply(const Camera& cam, const RenderContext& rc, int darkness)
+{
+	if (!_rendered || !rc.zbuffer)
+		return;
+
+	ApplyJob job;
+	job.video_buffer = (unsigned int*)rc.video_buffer;
+	job.lpitch       = rc.lpitch >> 2;
+	job.zbuffer      = (const unsigned int*)rc.zbuffer;
+	job.zpitch       = rc.zpitch >> 2;
+	job.inv_z        = (rc.attr & RENDER_ATTR_INVZBUFFER) != 0;
+	job.far_z        = cam.FarClipZ();
+	job.darkness     = darkness < 0 ? 0 : (darkness > 255 ? 255 : darkness);
+	job.width        = (int)cam.ViewportWidth();
+	job.alpha        = 0.5f * cam.ViewportWidth() - 0.5f;
+	job.beta         = 0.5f * cam.ViewportHeight() - 0.5f;
+	job.inv_dx       = 1.0f / (job.alpha * cam.ViewDist());
+	job.inv_dy       = 1.0f / (job.beta * cam.ViewDist() * cam.AspectRatio());
+	job.to_light     = RigidInverse(cam.CameraMat()) * _mlight;
+
+	Modules::GetJobs().ParallelFor((int)cam.ViewportHeight(), APPLY_JOB_ROWS, this,
+		&ShadowMap::ApplyRows, job);
+}
+
+void ShadowMap::ApplyRows(const ApplyJob& job, int start, int end)
+{
+	const mat4& m = job.to_light;
+
+	for (int y = start; y < end; y++)
+	{
+		const unsigned int* z_ptr = job.zbuffer + y * job.zpitch;
+		unsigned int* screen_ptr  = job.video_buffer + y * job.lpitch;
+
+		// a pixel at camera depth z is the camera point z*(dx, dy, 1), in
+		// light space that's z*(dx*row0 + dy*row1 + row2) + row3
+		float dy = (job.beta - y) * job.inv_dy;
+
+		float bx = dy * m.c[1][0] + m.c[2][0];
+		float by = dy * m.c[1][1] + m.c[2][1];
+		float bz = dy * m.c[1][2] + m.c[2][2];
+
+		for (int x = 0; x < job.width; x++)
+		{
+			float z;
+
+			if (job.inv_z)
+			{
+				// nothing drawn
+				if (!z_ptr[x])
+					continue;
+
+				z = (float)(1 << FIXP28_SHIFT) / z_ptr[x];
+			} // end if
+			else
+			{
+				z = (float)z_ptr[x] * (1.0f / (1 << FIXP16_SHIFT));
+
+				// still the clear value
+				if (z >= job.far_z)
+					continue;
+			} // end else
+
+			float dx = (x - job.alpha) * job.inv_dx;
+
+			float lx = z * (dx * m.c[0][0] + bx) + m.c[3][0];
+			float ly = z * (dx * m.c[0][1] + by) + m.c[3][1];
+			float lz = z * (dx * m.c[0][2] + bz) + m.c[3][2];
+
+			float visibility = Visibility(lx, ly, lz);
+
+			if (visibility >= 1)
+				continue;
+
+			int scale = 256 - (int)(job.darkness * (1 - visibility));
+
+			int a, r, g, b;
+			_RGB8888FROM32BIT(screen_ptr[x], &a, &r, &g, &b);
+
+			screen_ptr[x] = _RGB32BIT(a, (r * scale) >> 8, (g * scale) >> 8, (b * scale) >> 8);
+		} // end for x
+	} // end for y
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Matrix.h"
+
+namespace t3d {
+
+class Camera;
+class RenderList;
+struct RenderContext;
+
+// a shadow map, the occluders are drawn from the point of view of a light
+// with the depth only rasterizer, the light is a regular Camera looking
+// from the light with the size of the map as its viewport, then a point
+// is in shadow if something nearer to the light covers it in the map
+//
+// typical use, each frame the light or the occluders move
+//
+// shadow_list.Reset();
+// shadow_list.Insert(*obj);   // world space
+// shadow_map.Render(shadow_list, light_cam);
+//
+// and after the scene is drawn
+//
+// shadow_map.Apply(*cam, rc, 128);
+class ShadowMap
+{
+public:
+	ShadowMap();
+	~ShadowMap();
+
+	// allocates a size x size map, returns 0 if out of memory
+	int Create(int size);
+	int Delete();
+
+	// distance in world units a point must be behind the nearest occluder
+	// to be in shadow, this keeps the surfaces from shadowing themselves
+	void SetBias(float bias) { _bias = bias; }
+
+	// percentage closer filtering, each lookup averages the 3x3 texels
+	// around the point so the shadow edges are soft rather than blocky
+	void SetPCF(bool pcf) { _pcf = pcf; }
+
+	// clears the map and draws the polygons of the list, which must be in
+	// world space, from the light, the list is transformed to the light
+	void Render(RenderList& list, const Camera& light_cam);
+
+	// how much of the light reaches the world point, 0 in shadow .. 1 lit,
+	// the points outside the map are lit
+	float Lookup(const vec4& world_pos) const;
+
+	// darkens the pixels of a drawn image that are in shadow by darkness
+	// 0..255, their positions are rebuilt from the z or 1/z buffer of the
+	// context, the same camera must have drawn it
+	void Apply(const Camera& cam, const RenderContext& rc, int darkness);
+
+	int Size() const { return _size; }
+	const float* Buffer() const { return _depth; }
+
+private:
+	// how much of the light reaches the point in light camera space
+	float Visibility(float x, float y, float z) const;
+
+	// a range of rows of the image for Apply(), run by the job system
+	struct ApplyJob
+	{
+		unsigned int* video_buffer;
+		int lpitch;
+		const unsigned int* zbuffer;
+		int zpitch;
+		bool inv_z;
+		float far_z;
+		int darkness;
+		int width;
+		float alpha, beta;     // half the viewport of the camera
+		float inv_dx, inv_dy;  // pixel to view plane of the camera
+		mat4 to_light;         // camera space to light camera space
+	};
+
+	void ApplyRows(const ApplyJob& job, int start, int end);
+
+private:
+	float* _depth;  // 1/z from the light, 0 = nothing
+	int _size;
+
+	// the light camera the map was drawn with
+	mat4 _mlight;
+	float _alpha, _beta;     // half the viewport
+	float _scale_x, _scale_y;  // view plane to map pixels
+	float _near_z;
+
+	float _bias;
+	bool _pcf;
+	bool _rendered;
+
+}; // ShadowMap
+
+}
\ No newline at end of file
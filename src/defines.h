@@ -71,5 +71,8 @@
 #define SORT_POLYLIST_NEARZ 1  // sorts on closest z vertex of each poly
 #define SORT_POLYLIST_FARZ  2  // sorts on farthest z vertex of each poly
 
+#define SORT_POLYLIST_METHOD_MASK 0x00ff // selects one of the above
+#define SORT_POLYLIST_COHERENT    0x0100 // or'ed in, start from the order of the last frame
+
 // alpha blending defines
 #define NUM_ALPHA_LEVELS              8   // total number of alpha levels
\ No newline at end of file
@@ -221,9 +221,6 @@ void Game::Step()
 		// generate rotation matrix around y axis
 		mrot = mat4::RotateY(_tanks[index].w);
 
-		// rotate the local coords of the object
-		_obj_tank.Transform(mrot, TRANSFORM_LOCAL_TO_TRANS, 1);
-
 		// set position of tank
 		_obj_tank.SetWorldPos(_tanks[index].x,
 							  _tanks[index].y,
@@ -234,6 +231,13 @@ void Game::Step()
 		{
 			// if we get here then the object is visible at this world position
 			// so we can insert it into the rendering list
+			// remove the backfaces before transforming, so only the vertices
+			// of the front faces are rotated and moved
+			_obj_tank.RemoveBackfacesLocal(*_cam, &mrot);
+
+			// rotate the local coords of the object
+			_obj_tank.Transform(mrot, TRANSFORM_LOCAL_TO_TRANS, 1);
+
 			// perform local/model to world transform
 			_obj_tank.ModelToWorld(TRANSFORM_TRANS_ONLY);
 
@@ -273,17 +277,25 @@ void Game::Step()
 		_obj_tower.SetWorldPos(_towers[index].x,
 			_towers[index].y, _towers[index].z);
 
-		// attempt to cull object
-		if (!_obj_tower.Cull(*_cam, CULL_OBJECT_XYZ_PLANES))
+		// attempt to cull object, the far ones are too small to bother
+		if (!_obj_tower.Cull(*_cam, CULL_OBJECT_XYZ_PLANES | CULL_OBJECT_CONTRIBUTION))
 		{
 			// if we get here then the object is visible at this world position
 			// so we can insert it into the rendering list
+			// remove the backfaces in object space first
+			_obj_tower.RemoveBackfacesLocal(*_cam);
+
 			// perform local/model to world transform
 			_obj_tower.ModelToWorld();
 
 			// insert the object into render list
 			_list->Insert(_obj_tower);
 		}
+		else if (_obj_tower.State() & OBJECT_STATE_TINY)
+		{
+			// a dot is all that would be seen of it anyway
+			_list->InsertPoint(*_cam, _obj_tower.GetWorldPos(), _obj_tower.GetPolygon(0).color);
+		}
 	}
 
 	// seed number generator so that modulation of markers is always the same
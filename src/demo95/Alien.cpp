@@ -339,6 +339,8 @@ void AlienList::DrawExplosions(t3d::RenderList& rlist)
 
 			} // end for pindex
 
+			explobj[eindex]->LocalVertsChanged();
+
 			// update counter, test for terminate
 			if (--explobj[eindex]->_ivar2 < 0)
 			{
@@ -358,6 +360,16 @@ void AlienList::DrawExplosions(t3d::RenderList& rlist)
 				if (explobj[eindex]->_plist)
 					free(explobj[eindex]->_plist);
 
+				// vertex lighting arrays
+				if (explobj[eindex]->_vert_light)
+					free(explobj[eindex]->_vert_light);
+
+				if (explobj[eindex]->_vert_mark)
+					free(explobj[eindex]->_vert_mark);
+
+				if (explobj[eindex]->_poly_lit)
+					free(explobj[eindex]->_poly_lit);
+
 				// trajectory list
 				if ((vec4*)(explobj[eindex]->_ivar1))
 					free((vec4*)explobj[eindex]->_ivar1);
@@ -503,6 +515,34 @@ int AlienList::StartMeshExplosion(const mat4& mrot, int detail, float rate, int
 			explobj[eindex]->_head_vlist_local = explobj[eindex]->_vlist_local;
 			explobj[eindex]->_head_vlist_trans = explobj[eindex]->_vlist_trans;
 
+			// the vertex lighting arrays are grown on demand by the explosion itself
+			explobj[eindex]->_vert_light    = NULL;
+			explobj[eindex]->_vert_mark     = NULL;
+			explobj[eindex]->_poly_lit      = NULL;
+			explobj[eindex]->_max_lit_verts = 0;
+			explobj[eindex]->_max_lit_polys = 0;
+			explobj[eindex]->InvalidateLighting();
+
+			// the same for the caches built from the mesh of the alien, they
+			// don't hold for the explosion and must not be freed twice
+			explobj[eindex]->_local_planes      = NULL;
+			explobj[eindex]->_max_local_planes  = 0;
+			explobj[eindex]->_planes_version    = -1;
+			explobj[eindex]->_vert_live         = NULL;
+			explobj[eindex]->_max_live_verts    = 0;
+			explobj[eindex]->_live_valid        = false;
+			explobj[eindex]->_trans_version     = -1;
+			explobj[eindex]->_frame_serial      = NULL;
+			explobj[eindex]->_max_frame_serials = 0;
+			explobj[eindex]->_trans_lazy        = false;
+			explobj[eindex]->_clusters          = NULL;
+			explobj[eindex]->_num_clusters      = 0;
+			explobj[eindex]->_max_clusters      = 0;
+			explobj[eindex]->_cluster_polys     = NULL;
+			explobj[eindex]->_clusters_version  = -1;
+			explobj[eindex]->_lods              = NULL;
+			explobj[eindex]->_num_lods          = 0;
+
 			// set the lifetime in ivar2
 			explobj[eindex]->_ivar2 = lifetime;
 
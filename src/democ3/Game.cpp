@@ -17,6 +17,7 @@
 #include "BmpFile.h"
 #include "BmpImg.h"
 #include "ZBuffer.h"
+#include "ImpostorCache.h"
 #include "BOB.h"
 
 namespace t3d {
@@ -45,6 +46,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 
 	zbuffer = new ZBuffer;
 
+	impostors = new ImpostorCache;
+
 	curr_object = 2;
 
 	cam_speed = 0;
@@ -52,6 +55,7 @@ Game::Game(HWND handle, HINSTANCE instance)
 
 Game::~Game()
 {
+	delete impostors;
 	delete zbuffer;
 	for (size_t i = 0; i < NUM_OBJECTS; ++i)
 		delete obj_array[i];
@@ -204,6 +208,9 @@ void Game::Init()
 	// create the z buffer
 	zbuffer->Create(WINDOW_WIDTH, WINDOW_HEIGHT, ZBUFFER_ATTR_32BIT);
 
+	// one impostor per scenery object
+	impostors->Create(NUM_SCENE_OBJECTS);
+
 	// load in the background
 	background->Create(0,0,800,600,1, BOB_ATTR_VISIBLE | BOB_ATTR_SINGLE_FRAME, DDSCAPS_SYSTEMMEMORY, 0, 32);
 	BmpFile* bitmap = new BmpFile("../../assets/chap12/checkerboard800.bmp");
@@ -251,6 +258,7 @@ void Game::Step()
 	static bool z_clip_mode    = true;
 	static bool z_buffer_mode   = true;
 	static bool display_mode    = true;
+	static bool impostor_mode   = true;
 	static float turning      = 0;
 
 	char work_string[256]; // temp string
@@ -377,6 +385,14 @@ void Game::Step()
 		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
 	} // end if
 
+	// impostors
+	if (Modules::GetInput().KeyboardState()[DIK_M])
+	{
+		// toggle impostors for the far objects
+		impostor_mode = !impostor_mode;
+		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
+	} // end if
+
 	// object and camera movement
 
 	// rotate around y axis or yaw
@@ -455,6 +471,9 @@ void Game::Step()
 	// generate camera matrix
 	_cam->BuildMatrixEuler(CAM_ROT_SEQ_ZYX);
 
+	// the lights the impostors are checked against this frame
+	impostors->Begin();
+
 	////////////////////////////////////////////////////////
 	// insert the scenery into universe
 	for (int index = 0; index < NUM_SCENE_OBJECTS; index++)
@@ -497,6 +516,16 @@ void Game::Step()
 		// attempt to cull object   
 		if (!obj_work->Cull(*_cam, CULL_OBJECT_XYZ_PLANES))
 		{
+			// the far ones are drawn from their cached image, 2 polygons each
+			if (impostor_mode)
+			{
+				vec4 sphere_pos = _cam->CameraMat() * obj_work->GetWorldPos();
+
+				if (RenderObject::ProjectedRadius(*_cam, sphere_pos, obj_work->GetMaxRadius()) < IMPOSTOR_PIXELS &&
+					impostors->Insert(*_list, *_cam, index, *obj_work))
+					continue;
+			} // end if
+
 			mrot = mrot.Identity();
 
 			// rotate the local coords of the object
@@ -620,6 +649,7 @@ void Game::Step()
 		graphics.DrawTextGDI("<B>..............Toggle backface removal.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<S>..............Toggle Z sorting.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<Z>..............Toggle Z buffering.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
+		graphics.DrawTextGDI("<M>..............Toggle impostors for the far objects.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<D>..............Toggle Normal 3D display / Z buffer visualization mode.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<H>..............Toggle Help.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<ESC>............Exit demo.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
@@ -631,6 +661,9 @@ void Game::Step()
 	sprintf(work_string,"CAM [%5.2f, %5.2f, %5.2f]",  _cam->Pos().x, _cam->Pos().y, _cam->Pos().z);
 	graphics.DrawTextGDI(work_string, 0, WINDOW_HEIGHT-34-16-16-16, RGB(0,255,0), graphics.GetBackSurface());
 
+	sprintf(work_string,"Impostors [%s], images drawn: %d", (impostor_mode ? "ON" : "OFF"), impostors->Renders());
+	graphics.DrawTextGDI(work_string, 0, WINDOW_HEIGHT-34-16-16-16-16-16, RGB(0,255,0), graphics.GetBackSurface());
+
 	sprintf(work_string,"FPS: %d", Modules::GetTimer().FPS());
 	graphics.DrawTextGDI(work_string, 0, WINDOW_HEIGHT-34-16-16-16-16, RGB(0,255,0), graphics.GetBackSurface());
 
@@ -9,6 +9,7 @@ class Camera;
 class RenderList;
 class RenderObject;
 class ZBuffer;
+class ImpostorCache;
 class BOB;
 
 class Game
@@ -43,6 +44,7 @@ private:
 	static const int NUM_SCENE_OBJECTS = 100;   // number of scenery objects
 	static const int UNIVERSE_RADIUS = 2000;    // size of universe
 	static const int MAX_VEL = 20;				// maxium velocity of objects
+	static const int IMPOSTOR_PIXELS = 24;      // radius on screen below which objects are impostors
 
 private:
 	Camera* _cam;
@@ -61,6 +63,8 @@ private:
 
 	ZBuffer* zbuffer;
 
+	ImpostorCache* impostors;         // images of the far scenery objects
+
 	float cam_speed;
 
 	// why ?!
@@ -12,6 +12,7 @@
 #include "PrimitiveDraw.h"
 #include "Light.h"
 #include "RenderList.h"
+#include "FramePipeline.h"
 #include "RenderObject.h"
 #include "BitmapFont.h"
 #include "BmpFile.h"
@@ -66,7 +67,9 @@ Game::Game(HWND handle, HINSTANCE instance)
 	obj_terrain = new RenderObject;
 	obj_terrain2 = new RenderObject;
 	obj_player = new RenderObject;
-	_list = new RenderList;
+	_pipeline = new FramePipeline;
+	// the terrains share most of their vertices
+	_pipeline->SetListAttr(RENDERLIST_ATTR_INDEXED);
 
 	intro_image = new BOB;
 	ready_image = new BOB;
@@ -104,7 +107,7 @@ Game::~Game()
 	delete ready_image;
 	delete nice_one_image;
 
-	delete _list;
+	delete _pipeline;
 	delete obj_player;
 	delete obj_terrain;
 	delete obj_terrain2;
@@ -285,10 +288,69 @@ void Game::Init()
 
 	// allocate memory for zbuffer
 	zbuffer->Create(WINDOW_WIDTH, WINDOW_HEIGHT, ZBUFFER_ATTR_32BIT);
+
+	// start the geometry thread, the render lists are built by BuildFrame()
+	_pipeline->Init(this);
+}
+
+void Game::BuildFrame(RenderList& list, const Camera& cam, LightsMgr& lights)
+{
+	// the geometry half of the frame, this runs on the pipeline thread while
+	// Step() rasterizes the previous frame, so only the snapshots of the camera
+	// and lights and the modes in _modes are used here
+
+	// reset the render list
+	list.Reset();
+
+	// insert terrain objects into render list, check if sea floor is disabled
+	if (_modes.seafloor)
+		list.Insert(*obj_terrain2,false);
+
+	// insert the object into render list
+	list.Insert(*obj_terrain, false);
+
+	// don't show model unless in play state
+	if (_modes.model_view)
+	{
+		// insert the object into render list
+		list.Insert(*obj_player, false);
+	} // end if
+
+	// remove backfaces
+	if (_modes.backface)
+		list.RemoveBackfaces(cam);
+
+	// apply world to camera transform
+	list.WorldToCamera(cam);
+
+	// clip the polygons themselves now
+	list.ClipPolys(cam, (_modes.x_clip ? CLIP_POLY_X_PLANE : 0) | 
+						(_modes.y_clip ? CLIP_POLY_Y_PLANE : 0) | 
+						(_modes.z_clip ? CLIP_POLY_Z_PLANE : 0) );
+
+	// light scene all at once 
+	if (_modes.lighting)
+	{
+		lights.Transform(cam.CameraMat(), TRANSFORM_LOCAL_TO_TRANS);
+		list.LightWorld32(cam, lights);
+	} // end if
+
+	// sort the polygon list (hurry up!)
+	if (_modes.zsort)
+		list.Sort(SORT_POLYLIST_AVGZ | SORT_POLYLIST_COHERENT);
+
+	// apply camera to perspective transformation
+	list.CameraToPerspective(cam);
+
+	// apply screen transform
+	list.PerspectiveToScreen(cam);
 }
 
 void Game::Shutdown()
 {
+	// stop the geometry thread before the objects go away
+	_pipeline->Shutdown();
+
 	delete _cam;
 
 	Modules::GetSound().StopAllSounds();
@@ -453,9 +515,6 @@ void Game::Step()
 
 			// game logic here...
 
-			// reset the render list
-			_list->Reset();
-
 			// modes and lights
 
 			// wireframe mode
@@ -797,13 +856,6 @@ void Game::Step()
 			// generate camera matrix
 			_cam->BuildMatrixEuler(CAM_ROT_SEQ_ZYX);
 
-			// insert terrain objects into render list, check if sea floor is disabled
- 			if (seafloor_mode == 1)
- 				_list->Insert(*obj_terrain2,false);
- 
- 			// insert the object into render list
- 			_list->Insert(*obj_terrain, false);
-
 #if 1
 			//MAT_IDENTITY_4X4(&mrot);
 
@@ -815,48 +867,28 @@ void Game::Step()
 
 			// perform world transform
 			obj_player->ModelToWorld(TRANSFORM_TRANS_ONLY);
-
-			// don't show model unless in play state
-			if (enable_model_view)
-			{
-				// insert the object into render list
-				_list->Insert(*obj_player, false);
-			} // end if
-
 #endif
 
 			// reset number of polys rendered
 			debug_polys_rendered_per_frame = 0;
 			debug_polys_lit_per_frame = 0;
 
-			// remove backfaces
-			if (backface_mode)
-				_list->RemoveBackfaces(*_cam);
+			// hand the next frame over to the geometry thread, it works on
+			// copies of the camera, the lights and the modes, the objects 
+			// are left alone until EndFrame()
+			_modes.backface   = backface_mode;
+			_modes.lighting   = lighting_mode;
+			_modes.zsort      = zsort_mode;
+			_modes.x_clip     = x_clip_mode;
+			_modes.y_clip     = y_clip_mode;
+			_modes.z_clip     = z_clip_mode;
+			_modes.seafloor   = seafloor_mode;
+			_modes.model_view = (enable_model_view != 0);
 
-			// apply world to camera transform
-			_list->WorldToCamera(*_cam);
+			_pipeline->BeginFrame(*_cam, lights);
 
-			// clip the polygons themselves now
-			_list->ClipPolys(*_cam, (x_clip_mode ? CLIP_POLY_X_PLANE : 0) | 
-									(y_clip_mode ? CLIP_POLY_Y_PLANE : 0) | 
-									(z_clip_mode ? CLIP_POLY_Z_PLANE : 0) );
-
-			// light scene all at once 
-			if (lighting_mode)
-			{
-				lights.Transform(_cam->CameraMat(), TRANSFORM_LOCAL_TO_TRANS);
-				_list->LightWorld32(*_cam);
-			} // end if
-
-			// sort the polygon list (hurry up!)
-			if (zsort_mode)
-				_list->Sort(SORT_POLYLIST_AVGZ);
-
-			// apply camera to perspective transformation
-			_list->CameraToPerspective(*_cam);
-
-			// apply screen transform
-			_list->PerspectiveToScreen(*_cam);
+			// meanwhile draw the frame built last time around
+			RenderList& list = _pipeline->DrawList();
 
 			// lock the back buffer
 			graphics.LockBackSurface();
@@ -869,8 +901,8 @@ void Game::Step()
 			if (wireframe_mode)
 			{
 // 				zbuffer->Clear((32000 << FIXP16_SHIFT));
-// 				_list->DrawSolidZB32(graphics.GetBackBuffer(), graphics.GetBackLinePitch(), zbuffer->Buffer(), WINDOW_WIDTH*4);
-				_list->DrawWire32(graphics.GetBackBuffer(), graphics.GetBackLinePitch());
+// 				list.DrawSolidZB32(graphics.GetBackBuffer(), graphics.GetBackLinePitch(), zbuffer->Buffer(), WINDOW_WIDTH*4);
+				list.DrawWire32(graphics.GetBackBuffer(), graphics.GetBackLinePitch());
 			}
 			else
 			{
@@ -895,7 +927,7 @@ void Game::Step()
 					rc.alpha_override = -1;
 
 					// render scene
-					_list->DrawContext(rc);
+					list.DrawContext(rc);
 				}
 				else
 				{
@@ -918,7 +950,7 @@ void Game::Step()
 					rc.alpha_override = -1;
 
 					// render scene
-					_list->DrawContext(rc);
+					list.DrawContext(rc);
 				} 
 
 			} // end if
@@ -1010,6 +1042,9 @@ void Game::Step()
 			// flip the surfaces
 			graphics.Flip(main_window_handle);
 
+			// wait for the geometry thread, its list is drawn next frame
+			_pipeline->EndFrame();
+
 			// sync to 30ish fps
 			Modules::GetTimer().Wait_Clock(30);
 
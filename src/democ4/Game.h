@@ -1,6 +1,8 @@
 #include <windows.h>
 #include <stdio.h>
 
+#include "FramePipeline.h"
+
 namespace t3d {
 
 class Camera;
@@ -10,7 +12,7 @@ class BOB;
 class BmpImg;
 class ZBuffer;
 
-class Game
+class Game : public FrameBuilder
 {
 public:
 	static const int WINDOW_WIDTH = 800;
@@ -31,6 +33,9 @@ public:
 	void Shutdown();
 	void Step();
 
+	// the geometry half of a frame, run on the thread of the pipeline
+	virtual void BuildFrame(RenderList& list, const Camera& cam, LightsMgr& lights);
+
 private:
 	static const int AMBIENT_LIGHT_INDEX	= 0; // ambient light index
 	static const int INFINITE_LIGHT_INDEX	= 1; // infinite light index
@@ -61,7 +66,21 @@ private:
 	RenderObject *obj_terrain, *obj_terrain2;		// the terrain object
 	RenderObject* obj_player;
 
-	RenderList* _list;
+	// the render lists are built a frame ahead by BuildFrame()
+	FramePipeline* _pipeline;
+
+	// the render modes BuildFrame() works with, copied from the toggles
+	// in Step() right before each frame is handed over
+	struct RenderModes
+	{
+		bool backface;
+		bool lighting;
+		bool zsort;
+		bool x_clip, y_clip, z_clip;
+		bool seafloor;
+		bool model_view;
+	};
+	RenderModes _modes;
 
 	// ambient and in game sounds
 	int wind_sound_id          , 
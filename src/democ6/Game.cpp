@@ -480,11 +480,9 @@ void Game::Step()
  	// generate rotation matrix around y axis
 	mrot = mat4::Identity();
  
- 	// rotate the local coords of the object
- 	obj_terrain->Transform(mrot, TRANSFORM_LOCAL_TO_TRANS,true);
-
-	// perform world transform
-	obj_terrain->ModelToWorld(TRANSFORM_TRANS_ONLY);
+	// rotate the local coords of the object and perform world transform,
+	// the terrain doesn't move so this is only done the first time
+	obj_terrain->ModelToWorld(mrot);
 
 	// insert the object into render list
 	_list->Insert(*obj_terrain, false);
@@ -19,6 +19,9 @@
 #include "ZBuffer.h"
 #include "BOB.h"
 #include "BHV.h"
+#include "JobSystem.h"
+#include "RenderSegments.h"
+#include "MeshInstance.h"
 
 namespace t3d {
 
@@ -39,10 +42,14 @@ Game::Game(HWND handle, HINSTANCE instance)
 	background = new BOB;
 
 	_list = new RenderList;
+	_segments = new RenderSegments;
 
+	// the objects are only read while the scene is transformed in
+	// parallel, so a single copy is shared by all the threads
 	for (size_t i = 0; i < NUM_OBJECTS; ++i)
 		obj_array[i] = new RenderObject;
-	obj_work = new RenderObject;
+	obj_work = NULL;
+	_objects_processed = 0;
 
 	bhv_tree = new BHVNode;
 
@@ -57,9 +64,9 @@ Game::~Game()
 {
 	delete zbuffer;
 	delete bhv_tree;
-	delete obj_work;
 	for (size_t i = 0; i < NUM_OBJECTS; ++i)
 		delete obj_array[i];
+	delete _segments;
 	delete _list;
 	delete background;
 }
@@ -124,6 +131,14 @@ void Game::Init()
 									  /* VERTEX_FLAGS_TRANSFORM_LOCAL_WORLD*/
 									  VERTEX_FLAGS_INVERT_TEXTURE_V);
 
+		// the far objects are drawn with fewer polygons
+		obj_array[index_obj]->BuildLODs();
+
+		// the instances find their backfaces with the planes of the levels,
+		// built now since the levels are shared by the threads
+		for (int lod = 0; lod <= obj_array[index_obj]->LODsNum(); lod++)
+			obj_array[index_obj]->GetLOD(lod)->UpdateLocalPlanes();
+
 	} // end for index_obj
 
 	// set current object
@@ -247,6 +262,94 @@ void Game::Shutdown()
 	Modules::GetLog().Shutdown();
 }
 
+void Game::PrepareObject(int index, RenderList& segment)
+{
+	PrepareObjects(index, index + 1, segment);
+}
+
+void Game::PrepareObjects(int start, int end, RenderList& segment)
+{
+	// this is run on the threads of the job system by RenderSegments, the
+	// current object is shared by all of them, each scene object is only
+	// an instance of it, the instances of a segment are culled, placed and
+	// inserted in one batch per level of detail without touching the 
+	// object itself
+
+	const RenderObject* obj = obj_array[curr_object];
+
+	MeshInstance* instances = &_instances[start];
+	int* lods = &_instance_lods[start];
+	int num_instances = 0;
+
+	for (int index = start; index < end; index++)
+	{
+		// test if container has been culled already by BHV
+		if (scene_objects[index].state & OBJECT_STATE_CULLED)
+			continue;
+
+		// rotate object
+		if ((scene_objects[index].rot.y+=scene_objects[index].auxi[0]) >= 360)
+			scene_objects[index].rot.y = 0;
+
+		MeshInstance& inst = instances[num_instances];
+
+		inst.state = OBJECT_STATE_ACTIVE | OBJECT_STATE_VISIBLE;
+
+		// set position and orientation of the instance
+		inst.pos.Assign(scene_objects[index].pos.x,
+						scene_objects[index].pos.y,
+						scene_objects[index].pos.z);
+
+		inst.mrot = mat4::RotateY(scene_objects[index].rot.y);
+
+		// pick the level of detail from its size on the screen
+		lods[num_instances] = obj->SelectLOD(*_cam, inst.pos);
+
+		num_instances++;
+	} // end for index
+
+	JobSystem::AddCounter(_objects_processed, num_instances);
+
+	// group the instances by level and insert each group at once
+	int first = 0;
+
+	for (int lod = 0; lod <= obj->LODsNum() && first < num_instances; lod++)
+	{
+		int last = first;
+
+		for (int i = first; i < num_instances; i++)
+		{
+			if (lods[i] != lod)
+				continue;
+
+			MeshInstance inst = instances[i];
+			instances[i] = instances[last];
+			instances[last] = inst;
+
+			lods[i] = lods[last];
+			lods[last] = lod;
+
+			last++;
+		} // end for i
+
+		if (last == first)
+			continue;
+
+		const RenderObject* mesh = obj->GetLOD(lod);
+
+		// cull, transform and insert them into the segment of the render
+		// list, the ones only a pixel or two across are drawn as a point
+		segment.InsertInstances(*mesh, &instances[first], last - first, *_cam, 
+			CULL_OBJECT_XYZ_PLANES | CULL_OBJECT_CONTRIBUTION);
+
+		for (int i = first; i < last; i++)
+			if (instances[i].state & OBJECT_STATE_TINY)
+				segment.InsertPoint(*_cam, instances[i].pos, mesh->GetPolygon(0).color);
+
+		first = last;
+	} // end for lod
+}
+
 void Game::Step()
 {
 	Modules::GetTimer().Step();
@@ -461,47 +564,12 @@ void Game::Step()
 		                   CULL_OBJECT_XYZ_PLANES);  // clipping planes to consider
 
 	// statistic tracking 
-	int objects_processed = 0;
+	_objects_processed = 0;
 
 	////////////////////////////////////////////////////////
-	// insert the scenery into universe
-	for (int index = 0; index < NUM_SCENE_OBJECTS; index++)
-	{
-		// test if container has been culled already by BHV
-		if (scene_objects[index].state & OBJECT_STATE_CULLED)
-			continue;
-
-		// reset the object (this only matters for backface and object removal)
-		obj_work->Reset();
-
-		 objects_processed++;
-
-		// set position of tower
-		obj_work->SetWorldPos(scene_objects[index].pos.x,
-							   scene_objects[index].pos.y,
-							   scene_objects[index].pos.z);
-
-		// rotate object
-		if ((scene_objects[index].rot.y+=scene_objects[index].auxi[0]) >= 360)
-			scene_objects[index].rot.y = 0;
-
-		// attempt to cull object   
-		if (!obj_work->Cull(*_cam, CULL_OBJECT_XYZ_PLANES))
-		{
-			mrot = mat4::RotateY(scene_objects[index].rot.y);
-
-			// rotate the local coords of the object
-			obj_work->Transform(mrot, TRANSFORM_LOCAL_TO_TRANS,1);
-
-			// perform world transform
-			obj_work->ModelToWorld(TRANSFORM_TRANS_ONLY);
-
-			// insert the object into render list
-			_list->Insert(*obj_work, false);
-
-		} // end if
-
-	} // end for
+	// insert the scenery into universe, the objects are prepared 
+	// on all the threads, see PrepareObject()
+	_segments->Build(*_list, NUM_SCENE_OBJECTS, *this);
 
 	// reset number of polys rendered
 	debug_polys_rendered_per_frame = 0;
@@ -604,7 +672,7 @@ void Game::Step()
 	sprintf(work_string,"Polys Rendered: %d, Polys lit: %d, Object Pre-Culled by BHV: %d, Nodes visited in BHV Tree: %d", 
 																				 debug_polys_rendered_per_frame, 
 																				 debug_polys_lit_per_frame,
-																				 NUM_SCENE_OBJECTS - objects_processed,
+																				 NUM_SCENE_OBJECTS - _objects_processed,
 																				 bhv_nodes_visited);
 	graphics.DrawTextGDI(work_string, 0, WINDOW_HEIGHT-34-16-16, RGB(0,255,0), graphics.GetBackSurface());
 
@@ -628,4 +696,4 @@ void Game::Step()
 
 }
 
-}
+}
\ No newline at end of file
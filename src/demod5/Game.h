@@ -2,6 +2,8 @@
 #include <stdio.h>
 
 #include "Vector.h"
+#include "RenderSegments.h"
+#include "MeshInstance.h"
 
 namespace t3d {
 
@@ -12,7 +14,7 @@ class ZBuffer;
 class BOB;
 class BHVNode;
 
-class Game
+class Game : public ObjectPreparer
 {
 public:
 	static const int WINDOW_WIDTH = 800;
@@ -33,6 +35,11 @@ public:
 	void Shutdown();
 	void Step();
 
+	// culls, transforms and inserts the scene objects [start, end) of a
+	// segment, run in parallel
+	virtual void PrepareObject(int index, RenderList& segment);
+	virtual void PrepareObjects(int start, int end, RenderList& segment);
+
 private:
 	static const int AMBIENT_LIGHT_INDEX	= 0; // ambient light index
 	static const int INFINITE_LIGHT_INDEX	= 1; // infinite light index
@@ -54,8 +61,16 @@ private:
 	BOB* background;
 
 	RenderObject* obj_work;               // pointer to active working object
-	RenderObject *obj_array[NUM_OBJECTS]; // array of objects 
+	RenderObject *obj_array[NUM_OBJECTS]; // array of objects, shared by the threads
 	RenderList* _list;
+	RenderSegments* _segments;            // the list is filled in parallel
+
+	// the instances of the scene objects, each thread only fills the slots
+	// of the objects it prepares, see PrepareObjects()
+	MeshInstance _instances[NUM_SCENE_OBJECTS];
+	int _instance_lods[NUM_SCENE_OBJECTS];
+
+	int _objects_processed;
 
 	BHVNode*  bhv_tree;               // the bounding hierarchical volume tree
 
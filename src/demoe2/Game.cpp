@@ -18,6 +18,7 @@
 #include "BOB.h"
 #include "BmpImg.h"
 #include "ZBuffer.h"
+#include "PlanarShadows.h"
  
 namespace t3d {
 
@@ -62,7 +63,7 @@ Game::Game(HWND handle, HINSTANCE instance)
 		obj_array[index_obj] = new RenderObject;
 	for (int index_obj=0; index_obj < NUM_LIGHT_OBJECTS; index_obj++)
 		obj_light_array[index_obj] = new RenderObject;
-	shadow_obj = new RenderObject;
+	shadows = new PlanarShadows;
 	_list = new RenderList;
 	_zbuffer = new ZBuffer;
 
@@ -84,7 +85,7 @@ Game::~Game()
 	delete cockpit;
 	delete _zbuffer;
 	delete _list;
-	delete shadow_obj;
+	delete shadows;
 	for (int index_obj=0; index_obj < NUM_LIGHT_OBJECTS; index_obj++)
 		delete obj_light_array[index_obj];
 	for (int index_obj=0; index_obj < NUM_OBJECTS; index_obj++)
@@ -188,13 +189,9 @@ void Game::Init()
 	obj_light    = obj_light_array[curr_light_object];
 
 
-	// load the shadow object in, basically a single plane with a circular alpha shadow texture
-	vscale.Assign(1, 1, 1); 
-	shadow_obj->LoadCOB("../../assets/chap14/shadow_poly_01.cob",  
-		&vscale, &vpos, &vrot, VERTEX_FLAGS_INVERT_WINDING_ORDER | VERTEX_FLAGS_SWAP_YZ 
-		| VERTEX_FLAGS_TRANSFORM_LOCAL 
-		| VERTEX_FLAGS_TRANSFORM_LOCAL_WORLD
-		,0 );
+	// the shadows fall on the terrain
+	shadows->SetReceiver(obj_terrain);
+	shadows->SetShadow(128, 25);
 
 	// set up lights
 	LightsMgr& lights = Modules::GetGraphics().GetLights();
@@ -261,6 +258,9 @@ void Game::Init()
 		WINDOW_HEIGHT,
 		ZBUFFER_ATTR_32BIT);
 
+	// and the shadow buffer
+	shadows->Create(WINDOW_WIDTH, WINDOW_HEIGHT);
+
 // 	// build alpha lookup table
 // 	RGB_Alpha_Table_Builder(NUM_ALPHA_LEVELS, rgb_alpha_table);
 
@@ -321,9 +321,6 @@ void Game::Step()
 	static bool y_clip_mode    = true;
 	static bool z_clip_mode    = true;
 
-	static float hl = 300, // artificial light height
-             ks = 1.0; // generic scaling factor to make things look good
-
 	char work_string[256]; // temp string
 
 	Graphics& graphics = Modules::GetGraphics();
@@ -745,127 +742,14 @@ void Game::Step()
 
 			// render scene
 			_list->DrawContext(rc);
-		} // end if
-
-		// now make second rendering pass and draw shadow(s)
-
-		// reset the render _list
-		_list->Reset();
-
-		//////////////////////////////////////////////////////////////////////////
-		// shadow object
-
-		// reset the object (this only matters for backface and object removal)
-		shadow_obj->Reset();
-
-		// compute terrain cell shadow is over
-		cell_x = (obj_work->GetWorldPos().x  + TERRAIN_WIDTH/2) / obj_terrain->GetFVar1();
-		cell_y = (obj_work->GetWorldPos().z  + TERRAIN_HEIGHT/2) / obj_terrain->GetFVar1();
-
-		// compute vertex indices into vertex _list of the current quad
-		int v0 = cell_x + cell_y*obj_terrain->GetIVar2();
-		int v1 = v0 + 1;
-		int v2 = v1 + obj_terrain->GetIVar2(); 
-		int v3 = v0 + obj_terrain->GetIVar2();   
-
-		// now simply index into table 
-		terrain_height = max(max(obj_terrain->GetTransVertex(v0).y, obj_terrain->GetTransVertex(v1).y), 
-			max(obj_terrain->GetTransVertex(v2).y, obj_terrain->GetTransVertex(v3).y) );
-
-		// update position
-		shadow_obj->SetWorldPos(obj_work->GetWorldPos().x,
-							    terrain_height+25,
-								obj_work->GetWorldPos().z);
-
-		// now compute the size of the shadow radius based on the calculations shown in the book
-		// the size of the projected shadow, assuming a sphere as the occluder with a point lightsource
-		// height hl above the ground plane, a spherical object with radius ro, and height above
-		// the groundplane ho, the radius of the shadow is rs:
-		//
-		//    rs = ro * (hl)/(hl - ho)
-
-		// set height to altitude of green light for fun
-		hl = lights[POINT_LIGHT_INDEX].pos.y;
 
-		// use the average radius of the object to base calcs on, better than nothing
-		float rs = ks * ( obj_work->GetAvgRadius() * (hl/ (hl - obj_work->GetWorldPos().y)) );
-
-		// create identity matrix
-		mrot = mat4::Identity();
-
-		// set scaling values to scale in X-Z plane
-		mrot.c[0][0] = rs;
-		mrot.c[1][1] = 1.0;
-		mrot.c[2][2] = rs;
-
-		// transform the local coords of the object
-		shadow_obj->Transform(mrot, TRANSFORM_LOCAL_TO_TRANS,1);
-
-		// perform world transform
-		shadow_obj->ModelToWorld(TRANSFORM_TRANS_ONLY);
-
-		// insert the object into render _list
-		_list->Insert(*shadow_obj,0);
-
-		//////////////////////////////////////////////////////////////////////////
-
-		// remove backfaces
-		if (backface_mode)
-			_list->RemoveBackfaces(*_cam);
-
-		// apply world to camera transform
-		_list->WorldToCamera(*_cam);
-
-		// clip the polygons themselves now
-		_list->ClipPolys(*_cam, CLIP_POLY_X_PLANE | CLIP_POLY_Y_PLANE | CLIP_POLY_Z_PLANE );
-
-		// light scene all at once 
-		if (lighting_mode)
-		{
-			lights.Transform(_cam->CameraMat(), TRANSFORM_LOCAL_TO_TRANS);
-			_list->LightWorld32(*_cam);
+			// now darken the shadow of the object on the terrain, the
+			// projected shadow grows and shrinks with the height of the
+			// green light by itself
+			shadows->Begin();
+			shadows->Cast(*obj_work, lights[POINT_LIGHT_INDEX]);
+			shadows->Draw(*_cam, rc);
 		} // end if
-
-		// sort the polygon _list (hurry up!)
-		if (zsort_mode)
-			_list->Sort(SORT_POLYLIST_AVGZ);
-
-		// apply camera to perspective transformation
-		_list->CameraToPerspective(*_cam);
-
-		// apply screen transform
-		_list->PerspectiveToScreen(*_cam);
-
-		// render the object
-
-		if (wireframe_mode)
-			_list->DrawWire32(graphics.GetBackBuffer(), graphics.GetBackLinePitch());
-		else {
-			RenderContext rc;
-
-				// perspective mode affine texturing
-				// set up rendering context
-				rc.attr =    RENDER_ATTR_ZBUFFER  
-					 | RENDER_ATTR_ALPHA  
-					// | RENDER_ATTR_MIPMAP  
-					// | RENDER_ATTR_BILERP
-					| RENDER_ATTR_TEXTURE_PERSPECTIVE_AFFINE;
-
-				// initialize _zbuffer to 0 fixed point
-			//	_zbuffer->Clear(16000 << FIXP16_SHIFT);
-
-				// set up remainder of rendering context
-				rc.video_buffer   = graphics.GetBackBuffer();
-				rc.lpitch         = graphics.GetBackLinePitch();
-				rc.mip_dist       = 0;
-				rc.zbuffer        = (unsigned char*)_zbuffer->Buffer();
-				rc.zpitch         = WINDOW_WIDTH*4;
-				rc.texture_dist   = 0;
-				rc.alpha_override = -1;
-
-				// render scene
-				_list->DrawContext(rc);
-		}
 	}
 
 	// unlock the back buffer
@@ -7,6 +7,7 @@ class Camera;
 class ZBuffer;
 class RenderList;
 class RenderObject;
+class PlanarShadows;
 class BOB;
 
 class Game
@@ -61,7 +62,7 @@ private:
 	RenderObject* obj_light;
 	RenderObject* obj_light_array[NUM_LIGHT_OBJECTS];
 
-	RenderObject* shadow_obj;
+	PlanarShadows* shadows;
 
 	RenderList* _list;
 
@@ -18,6 +18,7 @@
 #include "BOB.h"
 #include "BmpImg.h"
 #include "ZBuffer.h"
+#include "ShadowMap.h"
  
 namespace t3d {
 
@@ -65,6 +66,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 	shadow_obj = new RenderObject;
 	_list = new RenderList;
 	_zbuffer = new ZBuffer;
+	_shadow_map = new ShadowMap;
+	_shadow_list = new RenderList;
 
 	cockpit = new BOB;
 
@@ -82,6 +85,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 Game::~Game()
 {
 	delete cockpit;
+	delete _shadow_list;
+	delete _shadow_map;
 	delete _zbuffer;
 	delete _list;
 	delete shadow_obj;
@@ -261,6 +266,12 @@ void Game::Init()
 		WINDOW_HEIGHT,
 		ZBUFFER_ATTR_32BIT);
 
+	// and the depth of the occluder seen from the green light
+	if (!_shadow_map->Create(SHADOW_MAP_SIZE))
+		Modules::GetLog().WriteError("\nGame::Init: out of memory for the shadow map");
+
+	_shadow_map->SetPCF(true);
+
 // 	// build alpha lookup table
 // 	RGB_Alpha_Table_Builder(NUM_ALPHA_LEVELS, rgb_alpha_table);
 
@@ -330,6 +341,7 @@ void Game::Step()
 	static bool x_clip_mode    = true;
 	static bool y_clip_mode    = true;
 	static bool z_clip_mode    = true;
+	static bool shadow_map_mode = false;
 
 	static float hl = 300, // artificial light height
              ks = 1.25; // generic scaling factor to make things look good
@@ -441,6 +453,14 @@ void Game::Step()
 		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
 	} // end if
 
+	// shadow map
+	if (Modules::GetInput().KeyboardState()[DIK_M])
+	{
+		// toggle between the shadow disks and the shadow map of the green light
+		shadow_map_mode = !shadow_map_mode;
+		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
+	} // end if
+
 	// move to next object
 	if (Modules::GetInput().KeyboardState()[DIK_O])
 	{
@@ -651,6 +671,28 @@ void Game::Step()
 	// insert the object into render _list
 	_list->Insert(*obj_work,0);
 
+	// draw the depth of the object seen from the green light, the light
+	// camera looks at the object with the map as its viewport
+	if (shadow_map_mode && lights[POINT_LIGHT_INDEX].state == LIGHT_STATE_ON)
+	{
+		_shadow_list->Reset();
+		_shadow_list->Insert(*obj_work,0);
+
+		Camera light_cam(CAM_MODEL_UVN,
+						 lights[POINT_LIGHT_INDEX].pos,
+						 vec4(0,0,0,1),
+						 obj_work->GetWorldPos(),
+						 10.0,
+						 12000.0,
+						 90.0,
+						 SHADOW_MAP_SIZE,
+						 SHADOW_MAP_SIZE);
+
+		light_cam.BuildMatrixUVN(UVN_MODE_SIMPLE);
+
+		_shadow_map->Render(*_shadow_list, light_cam);
+	} // end if
+
 	//////////////////////////////////////////////////////////////////////////
 
 	//////////////////////////////////////////////////////////////////////////
@@ -766,6 +808,10 @@ void Game::Step()
 
 			// render scene
 			_list->DrawContext(rc);
+
+			// darken the pixels the object hides from the green light
+			if (shadow_map_mode && lights[POINT_LIGHT_INDEX].state == LIGHT_STATE_ON)
+				_shadow_map->Apply(*_cam, rc, 128);
 		} // end if
 
 		// now make second rendering pass and draw shadow(s)
@@ -862,7 +908,8 @@ void Game::Step()
 		shadow_obj->ModelToWorld(TRANSFORM_TRANS_ONLY);
 
 		// insert the object into render _list
-		_list->Insert(*shadow_obj,0);
+		if (!shadow_map_mode)
+			_list->Insert(*shadow_obj,0);
 
 		//////////////////////////////////////////////////////////////////////////
 
@@ -952,7 +999,8 @@ void Game::Step()
 		shadow_obj->ModelToWorld(TRANSFORM_TRANS_ONLY);
 
 		// insert the object into render list
-		_list->Insert(*shadow_obj,0);
+		if (!shadow_map_mode)
+			_list->Insert(*shadow_obj,0);
 
 		//////////////////////////////////////////////////////////////////////////
 
@@ -1031,11 +1079,12 @@ void Game::Step()
 
 	cockpit->Draw(graphics.GetBackSurface());
 
-	sprintf(work_string,"Lighting [%s]: Ambient=%d, Infinite=%d, Point=%d, Zsort [%s], BckFceRM [%s], Green Light y=%f, Red Light y=%f", 
+	sprintf(work_string,"Lighting [%s]: Ambient=%d, Infinite=%d, Point=%d, Shadow Map [%s], Zsort [%s], BckFceRM [%s], Green Light y=%f, Red Light y=%f", 
 		(lighting_mode ? "ON" : "OFF"),
 		lights[AMBIENT_LIGHT_INDEX].state,
 		lights[INFINITE_LIGHT_INDEX].state, 
 		lights[POINT_LIGHT_INDEX].state,
+		(shadow_map_mode ? "ON" : "OFF"),
 		(zsort_mode ? "ON" : "OFF"),
 		(backface_mode ? "ON" : "OFF"),
 		lights[POINT_LIGHT_INDEX].pos.y, lights[POINT_LIGHT2_INDEX].pos.y);
@@ -1056,6 +1105,7 @@ void Game::Step()
 		graphics.DrawTextGDI("<W>..............Toggle wire frame/solid mode.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<B>..............Toggle backface removal.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<O>..............Select different objects.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
+		graphics.DrawTextGDI("<M>..............Toggle shadow disks/shadow map of the green light.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<1>,<2>..........Change height of green point light.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<3>,<4>..........Change height of red point light.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<O>..............Select next object.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
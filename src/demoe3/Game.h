@@ -8,6 +8,7 @@ class ZBuffer;
 class RenderList;
 class RenderObject;
 class BOB;
+class ShadowMap;
 
 class Game
 {
@@ -46,6 +47,8 @@ public:
 	static const int TERRAIN_SCALE		= 700;
 	static const int MAX_SPEED			= 20;
 
+	static const int SHADOW_MAP_SIZE    = 512; // texels on a side of the shadow map
+
 private:
 	Camera* _cam;
 
@@ -67,6 +70,10 @@ private:
 
 	ZBuffer* _zbuffer;
 
+	// the object seen from the green light, for the shadow map mode
+	ShadowMap* _shadow_map;
+	RenderList* _shadow_list;
+
 	// sounds
 	int wind_sound_id;
 
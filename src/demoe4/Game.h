@@ -63,6 +63,11 @@ private:
 
 	RenderObject* shadow_obj;
 
+	// the colors and attributes of the polygons saved while the shadow is
+	// inserted, allocated once the model is loaded
+	int* pcolor;
+	int* pattr;
+
 	RenderList* _list;
 
 	ZBuffer* _zbuffer;
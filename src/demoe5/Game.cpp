@@ -56,6 +56,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 	: _cam(NULL)
 	, main_window_handle(handle)
 	, main_instance(instance)
+	, pcolor(NULL)
+	, pattr(NULL)
 {
 	obj_terrain = new RenderObject;
 	for (int index_obj=0; index_obj < NUM_OBJECTS; index_obj++)
@@ -81,6 +83,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 
 Game::~Game()
 {
+	free(pattr);
+	free(pcolor);
 	delete cockpit;
 	delete _zbuffer;
 	delete _list;
@@ -170,6 +174,20 @@ void Game::Init()
 	curr_object = 0;
 	obj_work    = obj_array[curr_object];
 
+	// the shadow saves the colors and attributes of the polygons of the 
+	// current object every frame, into arrays sized once here for the
+	// largest object
+	int max_polys = 0;
+	for (int index_obj=0; index_obj < NUM_OBJECTS; index_obj++)
+		if (obj_array[index_obj]->PolyNum() > max_polys)
+			max_polys = obj_array[index_obj]->PolyNum();
+
+	pcolor = (int*)malloc(sizeof(int)*max_polys);
+	pattr  = (int*)malloc(sizeof(int)*max_polys);
+
+	if (!pcolor || !pattr)
+		Modules::GetLog().WriteError("\nGame::Init: out of memory for the shadow, it won't be drawn");
+
 	// set a scaling vector
 	vscale.Assign(20, 20, 20);
 
@@ -768,92 +786,94 @@ void Game::Step()
 	// project shaded object into shadow by projecting it's vertices onto
 	// the ground plane
 
-	// reset the object (this only matters for backface and object removal)
-	obj_work->Reset();
+	// no room to save the colors, see Init()
+	if (pcolor && pattr)
+	{
+		// reset the object (this only matters for backface and object removal)
+		obj_work->Reset();
 
-	// save the shading attributes/color of each polygon, and override them with
-	// attributes of a shadow then restore them
-	int pcolor[RenderObject::MAX_POLYS],    // used to store color
-		pattr[RenderObject::MAX_POLYS];     // used to store attribute
+		// save the shading attributes/color of each polygon, and override them with
+		// attributes of a shadow then restore them, into the arrays of Init()
 
-	// save all the color and attributes for each polygon
-	for (int pindex = 0; pindex < obj_work->PolyNum(); pindex++)
-	{
-		// save attribute and color
-		pattr[pindex]  = obj_work->GetPolygon(pindex).attr;
-		pcolor[pindex] = obj_work->GetPolygon(pindex).color;
+		// save all the color and attributes for each polygon
+		for (int pindex = 0; pindex < obj_work->PolyNum(); pindex++)
+		{
+			// save attribute and color
+			pattr[pindex]  = obj_work->GetPolygon(pindex).attr;
+			pcolor[pindex] = obj_work->GetPolygon(pindex).color;
 
-		// set attributes for shadow rendering
-		obj_work->GetPolygonRef(pindex).attr    = POLY_ATTR_RGB16 | POLY_ATTR_SHADE_MODE_CONSTANT | POLY_ATTR_TRANSPARENT;
-		obj_work->GetPolygonRef(pindex).color   = _RGB32BIT(0,0,0,0) + (64 << 24);
+			// set attributes for shadow rendering
+			obj_work->GetPolygonRef(pindex).attr    = POLY_ATTR_RGB16 | POLY_ATTR_SHADE_MODE_CONSTANT | POLY_ATTR_TRANSPARENT;
+			obj_work->GetPolygonRef(pindex).color   = _RGB32BIT(0,0,0,0) + (64 << 24);
 
-	} // end for pindex
+		} // end for pindex
 
-	// create identity matrix
-	mrot = mat4::Identity();
+		// create identity matrix
+		mrot = mat4::Identity();
 
-	// solve for t when the projected vertex intersects ground plane
-	pl = lights[POINT_LIGHT_INDEX].pos;
+		// solve for t when the projected vertex intersects ground plane
+		pl = lights[POINT_LIGHT_INDEX].pos;
 
-	// transform each local/model vertex of the object mesh and store result
-	// in "transformed" vertex list, note 
-	for (int vertex=0; vertex < obj_work->VerticesNum(); vertex++)
-	{
-		// compute parameter t0 when projected ray pierces y=0 plane
-		vec4 vi;
+		// transform each local/model vertex of the object mesh and store result
+		// in "transformed" vertex list, note 
+		for (int vertex=0; vertex < obj_work->VerticesNum(); vertex++)
+		{
+			// compute parameter t0 when projected ray pierces y=0 plane
+			vec4 vi;
 
-		// transform coordinates to worldspace right now...
-		vi = obj_work->GetLocalVertex(vertex).v + obj_work->GetWorldPos();
+			// transform coordinates to worldspace right now...
+			vi = obj_work->GetLocalVertex(vertex).v + obj_work->GetWorldPos();
 
-		float t0 = -pl.y / (vi.y - pl.y);
+			float t0 = -pl.y / (vi.y - pl.y);
 
-		// transform point
-		obj_work->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
-		obj_work->GetTransVertexRef(vertex).v.y = 10; // pl.y + t0*(vi.y - pl.y);
-		obj_work->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
-		obj_work->GetTransVertexRef(vertex).v.w = 1.0;
+			// transform point
+			obj_work->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
+			obj_work->GetTransVertexRef(vertex).v.y = 10; // pl.y + t0*(vi.y - pl.y);
+			obj_work->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
+			obj_work->GetTransVertexRef(vertex).v.w = 1.0;
 
-	} // end for index
+		} // end for index
 
-	// insert the object into render list
-	_list->Insert(*obj_work,0);
+		// insert the object into render list
+		_list->Insert(*obj_work,0);
 
-	// and now second shadow object from second light source...
+		// and now second shadow object from second light source...
 
-	// solve for t when the projected vertex intersects
-	pl = lights[POINT_LIGHT2_INDEX].pos;
+		// solve for t when the projected vertex intersects
+		pl = lights[POINT_LIGHT2_INDEX].pos;
 
-	// transform each local/model vertex of the object mesh and store result
-	// in "transformed" vertex list
-	for (int vertex=0; vertex < obj_work->VerticesNum(); vertex++)
-	{
-		// compute parameter t0 when projected ray pierces y=0 plane
-		vec4 vi;
+		// transform each local/model vertex of the object mesh and store result
+		// in "transformed" vertex list
+		for (int vertex=0; vertex < obj_work->VerticesNum(); vertex++)
+		{
+			// compute parameter t0 when projected ray pierces y=0 plane
+			vec4 vi;
 
-		// transform coordinates to worldspace right now...
-		vi = obj_work->GetLocalVertex(vertex).v + obj_work->GetWorldPos();
+			// transform coordinates to worldspace right now...
+			vi = obj_work->GetLocalVertex(vertex).v + obj_work->GetWorldPos();
 
-		float t0 = -pl.y / (vi.y - pl.y);
+			float t0 = -pl.y / (vi.y - pl.y);
 
-		// transform point
-		obj_work->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
-		obj_work->GetTransVertexRef(vertex).v.y = 10; // pl.y + t0*(vi.y - pl.y);
-		obj_work->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
-		obj_work->GetTransVertexRef(vertex).v.w = 1.0;
+			// transform point
+			obj_work->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
+			obj_work->GetTransVertexRef(vertex).v.y = 10; // pl.y + t0*(vi.y - pl.y);
+			obj_work->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
+			obj_work->GetTransVertexRef(vertex).v.w = 1.0;
 
-	} // end for index
+		} // end for index
 
-	// insert the object into render list
-	_list->Insert(*obj_work,0);
+		// insert the object into render list
+		_list->Insert(*obj_work,0);
 
-	// restore attributes and color
-	for (int pindex = 0; pindex < obj_work->PolyNum(); pindex++)
-	{
-		// save attribute and color
-		obj_work->GetPolygonRef(pindex).attr  = pattr[pindex];
-		obj_work->GetPolygonRef(pindex).color = pcolor[pindex]; 
+		// restore attributes and color
+		for (int pindex = 0; pindex < obj_work->PolyNum(); pindex++)
+		{
+			// save attribute and color
+			obj_work->GetPolygonRef(pindex).attr  = pattr[pindex];
+			obj_work->GetPolygonRef(pindex).color = pcolor[pindex]; 
 
-	} // end for pindex
+		} // end for pindex
+	} // end if
 
 	//////////////////////////////////////////////////////////////////////////
 
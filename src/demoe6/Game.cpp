@@ -18,6 +18,7 @@
 #include "BOB.h"
 #include "BmpImg.h"
 #include "ZBuffer.h"
+#include "GBuffer.h"
  
 namespace t3d {
 
@@ -65,6 +66,7 @@ Game::Game(HWND handle, HINSTANCE instance)
 	shadow_obj = new RenderObject;
 	_list = new RenderList;
 	_zbuffer = new ZBuffer;
+	_gbuffer = new GBuffer;
 
 	cockpit = new BOB;
 
@@ -84,6 +86,7 @@ Game::Game(HWND handle, HINSTANCE instance)
 Game::~Game()
 {
 	delete cockpit;
+	delete _gbuffer;
 	delete _zbuffer;
 	delete _list;
 	delete shadow_obj;
@@ -270,6 +273,10 @@ void Game::Init()
 		WINDOW_HEIGHT,
 		ZBUFFER_ATTR_32BIT);
 
+	// and the geometry buffer for the deferred point lights
+	if (!_gbuffer->Create(WINDOW_WIDTH, WINDOW_HEIGHT))
+		Modules::GetLog().WriteError("\nGame::Init: out of memory for the G-buffer");
+
 // 	// build alpha lookup table
 // 	RGB_Alpha_Table_Builder(NUM_ALPHA_LEVELS, rgb_alpha_table);
 
@@ -331,6 +338,7 @@ void Game::Step()
 	static bool x_clip_mode    = true;
 	static bool y_clip_mode    = true;
 	static bool z_clip_mode    = true;
+	static bool deferred_mode  = false;
 
 	static float hl = 300, // artificial light height
              ks = 1.25; // generic scaling factor to make things look good
@@ -442,6 +450,29 @@ void Game::Step()
 		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
 	} // end if
 
+	// deferred point lights
+	if (Modules::GetInput().KeyboardState()[DIK_G])
+	{
+		// toggle the point lights between the vertex lighting and the
+		// per pixel shading of the G-buffer
+		deferred_mode = !deferred_mode;
+
+		if (deferred_mode)
+		{
+			lights[POINT_LIGHT_INDEX].attr  |= LIGHT_ATTR_DEFERRED;
+			lights[POINT_LIGHT2_INDEX].attr |= LIGHT_ATTR_DEFERRED;
+		} // end if
+		else
+		{
+			lights[POINT_LIGHT_INDEX].attr  &= ~LIGHT_ATTR_DEFERRED;
+			lights[POINT_LIGHT2_INDEX].attr &= ~LIGHT_ATTR_DEFERRED;
+		} // end else
+
+		lights.MarkChanged();
+
+		Modules::GetTimer().Wait_Clock(100); // wait, so keyboard doesn't bounce
+	} // end if
+
 	// move to next object
 	if (Modules::GetInput().KeyboardState()[DIK_O])
 	{
@@ -835,16 +866,25 @@ void Game::Step()
 
 		// render scene
 		_list->DrawContext(rc);
+
+		// add the deferred point lights on top, only where they reach
+		if (lighting_mode && deferred_mode)
+		{
+			_gbuffer->Clear();
+			_list->DrawGBuffer(*_cam, *_gbuffer);
+			_gbuffer->Shade(lights, *_cam, graphics.GetBackBuffer(), graphics.GetBackLinePitch());
+		} // end if
 	} // end if
 
 	// unlock the back buffer
 	graphics.UnlockBackSurface();
 
-	sprintf(work_string,"Lighting [%s]: Ambient=%d, Infinite=%d, Point=%d, Zsort [%s], BckFceRM [%s], Green Light y=%f, Red Light y=%f", 
+	sprintf(work_string,"Lighting [%s]: Ambient=%d, Infinite=%d, Point=%d, Deferred [%s], Zsort [%s], BckFceRM [%s], Green Light y=%f, Red Light y=%f", 
 		(lighting_mode ? "ON" : "OFF"),
 		lights[AMBIENT_LIGHT_INDEX].state,
 		lights[INFINITE_LIGHT_INDEX].state, 
 		lights[POINT_LIGHT_INDEX].state,
+		(deferred_mode ? "ON" : "OFF"),
 		(zsort_mode ? "ON" : "OFF"),
 		(backface_mode ? "ON" : "OFF"),
 		lights[POINT_LIGHT_INDEX].pos.y, lights[POINT_LIGHT2_INDEX].pos.y);
@@ -862,6 +902,7 @@ void Game::Step()
 		graphics.DrawTextGDI("<A>..............Toggle ambient light source.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<I>..............Toggle infinite light source.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<P>..............Toggle point light source.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
+		graphics.DrawTextGDI("<G>..............Toggle deferred per pixel point lights.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<W>..............Toggle wire frame/solid mode.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<B>..............Toggle backface removal.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
 		graphics.DrawTextGDI("<O>..............Select different objects.", 0, text_y+=12, RGB(255,255,255), graphics.GetBackSurface());
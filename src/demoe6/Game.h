@@ -9,6 +9,7 @@ class RenderList;
 class RenderObject;
 class BOB;
 class BmpImg;
+class GBuffer;
 
 class Game
 {
@@ -70,6 +71,9 @@ private:
 
 	ZBuffer* _zbuffer;
 
+	// the point lights are added per pixel from it in deferred mode
+	GBuffer* _gbuffer;
+
 	// sounds
 	int wind_sound_id;
 
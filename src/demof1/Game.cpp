@@ -48,6 +48,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 	: _cam(NULL)
 	, main_window_handle(handle)
 	, main_instance(instance)
+	, pcolor(NULL)
+	, pattr(NULL)
 {
 	obj_terrain = new RenderObject;
 	for (int index_obj=0; index_obj < NUM_LIGHT_OBJECTS; index_obj++)
@@ -73,6 +75,8 @@ Game::Game(HWND handle, HINSTANCE instance)
 
 Game::~Game()
 {
+	free(pattr);
+	free(pcolor);
 	delete cockpit;
 	delete obj_md2;
 	delete _zbuffer;
@@ -264,6 +268,14 @@ void Game::Init()
 	// prepare OBJECT4DV2 for md2
 	obj_md2->PrepareObject(obj_model);
 
+	// the shadow saves the colors and attributes of the polygons of the mech
+	// every frame, into arrays sized once here
+	pcolor = (int*)malloc(sizeof(int)*obj_model->PolyNum());
+	pattr  = (int*)malloc(sizeof(int)*obj_model->PolyNum());
+
+	if (!pcolor || !pattr)
+		Modules::GetLog().WriteError("\nGame::Init: out of memory for the shadow, it won't be drawn");
+
 	// set the animation
 	obj_md2->SetAnimation(MD2_ANIM_STATE_STANDING_IDLE, MD2_ANIM_LOOP);
 
@@ -797,102 +809,104 @@ void Game::Step()
 	// project shaded object into shadow by projecting it's vertices onto
 	// the ground plane
 
-	// reset the object (this only matters for backface and object removal)
-	obj_model->Reset();
+	// no room to save the colors, see Init()
+	if (pcolor && pattr)
+	{
+		// reset the object (this only matters for backface and object removal)
+		obj_model->Reset();
 
-	// save the shading attributes/color of each polygon, and override them with
-	// attributes of a shadow then restore them
-	int pcolor[RenderObject::MAX_POLYS],    // used to store color
-		pattr[RenderObject::MAX_POLYS];     // used to store attribute
+		// save the shading attributes/color of each polygon, and override them with
+		// attributes of a shadow then restore them, into the arrays of Init()
 
-	// save all the color and attributes for each polygon
-	for (int pindex = 0; pindex < obj_model->PolyNum(); pindex++)
-	{
-		// save attribute and color
-		pattr[pindex]  = obj_model->GetPolygon(pindex).attr;
-		pcolor[pindex] = obj_model->GetPolygon(pindex).color;
+		// save all the color and attributes for each polygon
+		for (int pindex = 0; pindex < obj_model->PolyNum(); pindex++)
+		{
+			// save attribute and color
+			pattr[pindex]  = obj_model->GetPolygon(pindex).attr;
+			pcolor[pindex] = obj_model->GetPolygon(pindex).color;
 
-		// set attributes for shadow rendering
-		obj_model->GetPolygonRef(pindex).attr    = POLY_ATTR_RGB16 | POLY_ATTR_SHADE_MODE_CONSTANT | POLY_ATTR_TRANSPARENT;
-		obj_model->GetPolygonRef(pindex).color   = _RGB32BIT(255,50,50,50) + (216 << 24);
+			// set attributes for shadow rendering
+			obj_model->GetPolygonRef(pindex).attr    = POLY_ATTR_RGB16 | POLY_ATTR_SHADE_MODE_CONSTANT | POLY_ATTR_TRANSPARENT;
+			obj_model->GetPolygonRef(pindex).color   = _RGB32BIT(255,50,50,50) + (216 << 24);
 
-	} // end for pindex
+		} // end for pindex
 
-	// create identity matrix
-	mrot = mat4::Identity();
+		// create identity matrix
+		mrot = mat4::Identity();
 
-	// solve for t when the projected vertex intersects ground plane
-	pl = lights[POINT_LIGHT_INDEX].pos;
+		// solve for t when the projected vertex intersects ground plane
+		pl = lights[POINT_LIGHT_INDEX].pos;
 
-	// transform each local/model vertex of the object mesh and store result
-	// in "transformed" vertex list, note 
-	for (int vertex=0; vertex < obj_model->VerticesNum(); vertex++)
-	{
-		vec4 presult; // hold result of each transformation
+		// transform each local/model vertex of the object mesh and store result
+		// in "transformed" vertex list, note 
+		for (int vertex=0; vertex < obj_model->VerticesNum(); vertex++)
+		{
+			vec4 presult; // hold result of each transformation
 
-		// compute parameter t0 when projected ray pierces y=0 plane
-		vec4 vi;
+			// compute parameter t0 when projected ray pierces y=0 plane
+			vec4 vi;
 
-		// set position of object 
-		obj_model->SetWorldPos(0, 100, 0);
+			// set position of object 
+			obj_model->SetWorldPos(0, 100, 0);
 
-		// transform coordinates to worldspace right now...
-		vi = obj_model->GetLocalVertex(vertex).v + obj_model->GetWorldPos();
+			// transform coordinates to worldspace right now...
+			vi = obj_model->GetLocalVertex(vertex).v + obj_model->GetWorldPos();
 
-		float t0 = -pl.y / (vi.y - pl.y);
+			float t0 = -pl.y / (vi.y - pl.y);
 
-		// transform point
-		obj_model->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
-		obj_model->GetTransVertexRef(vertex).v.y = 10.0; // pl.y + t0*(vi.y - pl.y);
-		obj_model->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
-		obj_model->GetTransVertexRef(vertex).v.w = 1.0;
+			// transform point
+			obj_model->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
+			obj_model->GetTransVertexRef(vertex).v.y = 10.0; // pl.y + t0*(vi.y - pl.y);
+			obj_model->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
+			obj_model->GetTransVertexRef(vertex).v.w = 1.0;
 
-	} // end for index
+		} // end for index
 
-	// insert the object into render list
-	_list->Insert(*obj_model,0);
+		// insert the object into render list
+		_list->Insert(*obj_model,0);
 
-	// and now second shadow object from second light source...
+		// and now second shadow object from second light source...
 
-	// solve for t when the projected vertex intersects
-	pl = lights[POINT_LIGHT_INDEX].pos; 
+		// solve for t when the projected vertex intersects
+		pl = lights[POINT_LIGHT_INDEX].pos; 
 
-	// transform each local/model vertex of the object mesh and store result
-	// in "transformed" vertex list
-	for (int vertex=0; vertex < obj_model->VerticesNum(); vertex++)
-	{
-		vec4 presult; // hold result of each transformation
+		// transform each local/model vertex of the object mesh and store result
+		// in "transformed" vertex list
+		for (int vertex=0; vertex < obj_model->VerticesNum(); vertex++)
+		{
+			vec4 presult; // hold result of each transformation
 
-		// compute parameter t0 when projected ray pierces y=0 plane
-		vec4 vi;
+			// compute parameter t0 when projected ray pierces y=0 plane
+			vec4 vi;
 
-		// set position of object 
-		obj_model->SetWorldPos(0, 100, 200);
+			// set position of object 
+			obj_model->SetWorldPos(0, 100, 200);
 
-		// transform coordinates to worldspace right now...
-		vi = obj_model->GetLocalVertex(vertex).v + obj_model->GetWorldPos();
+			// transform coordinates to worldspace right now...
+			vi = obj_model->GetLocalVertex(vertex).v + obj_model->GetWorldPos();
 
-		float t0 = -pl.y / (vi.y - pl.y);
+			float t0 = -pl.y / (vi.y - pl.y);
 
-		// transform point
-		obj_model->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
-		obj_model->GetTransVertexRef(vertex).v.y = 10.0; // pl.y + t0*(vi.y - pl.y);
-		obj_model->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
-		obj_model->GetTransVertexRef(vertex).v.w = 1.0;
+			// transform point
+			obj_model->GetTransVertexRef(vertex).v.x = pl.x + t0*(vi.x - pl.x);
+			obj_model->GetTransVertexRef(vertex).v.y = 10.0; // pl.y + t0*(vi.y - pl.y);
+			obj_model->GetTransVertexRef(vertex).v.z = pl.z + t0*(vi.z - pl.z);
+			obj_model->GetTransVertexRef(vertex).v.w = 1.0;
 
-	} // end for index
+		} // end for index
 
-	// insert the object into render list
-	_list->Insert(*obj_model,0);
+		// insert the object into render list
+		_list->Insert(*obj_model,0);
 
-	// restore attributes and color
-	for (int pindex = 0; pindex < obj_model->PolyNum(); pindex++)
-	{
-		// save attribute and color
-		obj_model->GetPolygonRef(pindex).attr  = pattr[pindex];
-		obj_model->GetPolygonRef(pindex).color = pcolor[pindex]; 
+		// restore attributes and color
+		for (int pindex = 0; pindex < obj_model->PolyNum(); pindex++)
+		{
+			// save attribute and color
+			obj_model->GetPolygonRef(pindex).attr  = pattr[pindex];
+			obj_model->GetPolygonRef(pindex).color = pcolor[pindex]; 
 
-	} // end for pindex
+		} // end for pindex
+	} // end if
 
 	//////////////////////////////////////////////////////////////////////////
 
@@ -62,6 +62,11 @@ private:
 
 	RenderObject* obj_model;		// this holds the mech
 
+	// the colors and attributes of the polygons saved while the shadow is
+	// inserted, allocated once the model is loaded
+	int* pcolor;
+	int* pattr;
+
 	RenderList* _list;
 
 	ZBuffer* _zbuffer;